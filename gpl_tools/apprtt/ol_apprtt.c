@@ -11,6 +11,7 @@
 #include <libgen.h>
 
 #include "ol_cmdline.h"
+#include "ol_poll.h"
 #include "ol_client.h"
 #include "ol_server.h"
 #include "ol_apprtt.h"
@@ -24,6 +25,14 @@ static int          chunk_size = 0;
 static int          time_to_run = OL_CLIENT_LIM_UNSPEC;
 static int          bytes_to_send = OL_CLIENT_LIM_UNSPEC;
 static bool         data_check = false;
+static char        *report = NULL;
+static int          connections = 1;
+static int          threads = 1;
+static char        *cpus = NULL;
+static int          rate = 0;
+static char        *arrival = NULL;
+static char        *poll_engine = NULL;
+static int          spin_usec = OL_POLL_SPIN_USEC_DEF;
 
 static ol_cmdline_opt opts[] =
 {
@@ -33,18 +42,41 @@ static ol_cmdline_opt opts[] =
     {"time-to-run", OL_OPT_INT, &time_to_run,
                     "How long to run test in seconds"},
     {"bytes-to-send", OL_OPT_INT, &bytes_to_send, "How much bytes to send"},
+    {"report", OL_OPT_STR, &report,
+               "How to report RTT in nanoseconds: samples (default, print "
+               "every value), "
+               "summary (print histogram summary) or hist (print summary "
+               "and histogram buckets)"},
+    {"threads", OL_OPT_INT, &threads,
+                "Number of threads serving the connections (default 1)"},
+    {"cpus", OL_OPT_STR, &cpus,
+             "CPUs to pin the threads to, e.g. 0,2,4-7"},
+    {"rate", OL_OPT_INT, &rate,
+             "Open-loop mode: send chunks at this rate per second over "
+             "every connection and measure RTT from intended send time "
+             "(default 0, closed-loop mode)"},
+    {"arrival", OL_OPT_STR, &arrival,
+                "Open-loop mode send times: fixed (default) or poisson"},
 
     /* Generic options */
     {"chunk-size", OL_OPT_INT, &chunk_size,
                "Chunk of data that the server \"acks\""},
+    {"connections", OL_OPT_INT, &connections,
+                    "Number of connections (default 1), the same on both "
+                    "sides"},
     {"data-check", OL_OPT_FLAG, &data_check,
                "The client sends data according to the pattern. The server "
                "checks that the received data matches the pattern."},
+    {"poll-engine", OL_OPT_STR, &poll_engine,
+                    "Event engine: poll (default), epoll or busy"},
+    {"spin-usec", OL_OPT_INT, &spin_usec,
+                  "How long busy engine spins before blocking, in "
+                  "microseconds (negative means forever)"},
     {"help", OL_OPT_FLAG, &print_help, "Print help"},
 };
 #define OPTS_NUM            (sizeof(opts) / sizeof(opts[0]))
 #define SERVER_OPTS_NUM     0
-#define CLIENT_OPTS_NUM     3
+#define CLIENT_OPTS_NUM     8
 
 static void usage(const char *prog_name)
 {
@@ -68,6 +100,11 @@ static void usage(const char *prog_name)
 
     printf("\nExamples:\n");
     printf("  %s --srv_addr 1.2.3.4   - run client side app\n", prog_name);
+    printf("  %s --srv_addr 1.2.3.4 --connections 8 --threads 2 --cpus 2,3\n"
+           "      - run client side app with 8 connections served by two\n"
+           "        threads pinned to CPUs 2 and 3\n", prog_name);
+    printf("  %s --connections 8       - run server side app accepting 8\n"
+           "                             connections\n", prog_name);
     printf("  %s                      - run server side app\n\n", prog_name);
 }
 
@@ -97,6 +134,12 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (ol_poll_init(ol_poll_engine_by_name(poll_engine), spin_usec) != 0)
+    {
+        usage(basename(argv[0]));
+        return -1;
+    }
+
     if (srv_addr != NULL)
         is_client = true;
 
@@ -105,15 +148,40 @@ int main(int argc, char **argv)
 
     if (is_client)
     {
-        ret = ol_rtt_client(&app, srv_addr, time_to_run, bytes_to_send,
-                            chunk_size, data_check);
+        ol_client_opts client_opts = {
+            .host = srv_addr,
+            .time_to_run = time_to_run,
+            .bytes_to_send = bytes_to_send,
+            .chunk_size = chunk_size,
+            .use_pattern = data_check,
+            .report = ol_client_report_by_name(report),
+            .connections = connections,
+            .threads = threads,
+            .cpus = cpus,
+            .rate = rate,
+            .arrival = ol_client_arrival_by_name(arrival),
+        };
+
+        if (client_opts.report == OL_CLIENT_REPORT_UNKNOWN ||
+            client_opts.arrival == OL_CLIENT_ARRIVAL_UNKNOWN ||
+            client_opts.rate < 0)
+        {
+            usage(basename(argv[0]));
+            return -1;
+        }
+
+        ret = ol_rtt_client(&app, &client_opts);
     }
     else
     {
-        ret = ol_rtt_server(&app, chunk_size, data_check);
+        ret = ol_rtt_server(&app, chunk_size, data_check, connections);
     }
 
     free(srv_addr);
+    free(report);
+    free(cpus);
+    free(arrival);
+    free(poll_engine);
 
     return ret;
 }
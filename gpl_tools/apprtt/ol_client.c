@@ -4,19 +4,22 @@
  * @author Sergey Nikitin <Sergey.Nikitin@oktetlabs.ru>
  */
 
-/* for pthread_tryjoin_np() */
+/* for pthread_tryjoin_np() and pthread_attr_setaffinity_np() */
 #define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 #include <errno.h>
 #include <netdb.h>
 #include <time.h>
+#include <math.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -25,100 +28,195 @@
 #include "ol_poll.h"
 #include "ol_apprtt.h"
 #include "ol_client.h"
-#include "ol_ringbuf.h"
+#include "ol_spsc_ring.h"
+#include "ol_hist.h"
 #include "ol_helpers.h"
 #include "ol_pattern.h"
 
-/** Size of a ring buffer for RTT samples - see @ref ol_sample_entry. */
-#define RTT_BUF_SIZE 256
+/**
+ * Size of a queue of Tx timestamps of a connection, it must hold timestamps
+ * of all chunks which may be in flight. It is also the size of a ring
+ * buffer of RTT values which a thread passes to the main thread for
+ * printing.
+ */
+#define RTT_BUF_SIZE 4096
+
+/**
+ * Maximum number of RTT values printed at once and maximum number of
+ * server answers received at once.
+ */
+#define RTT_BATCH_SIZE 64
 
 /**
- * Data structure containing information to count and print RTT values.
- * The structure is filled on every received answer from server and is
- * stored in the ring buffer to be processed by @ref ol_client_print_rtt_th().
+ * Maximum acceptable difference of TSC offsets between CPUs, in
+ * nanoseconds.
  */
+#define OL_CLIENT_TSC_DRIFT_MAX 1000
+
+/** How long the main thread sleeps if there is nothing to print. */
+#define RTT_PRINT_SLEEP_USEC 100
+
+/**
+ * Maximum time a thread waits for events before checking whether it has
+ * to stop because another thread failed, in milliseconds.
+ */
+#define OL_CLIENT_STOP_CHECK_MSEC 100
+
+/** Timestamp of a sent chunk. */
 typedef struct ol_sample_entry
 {
-    unsigned char   id;     /**< Index number of a server answer. */
-    uint64_t        ts;     /**< Timestamp of a server answer. */
+    unsigned char   id;         /**< Index number of a chunk. */
+    uint64_t        ts;         /**< Timestamp of the chunk first byte. */
+    uint64_t        intended;   /**< Time when the chunk had to be sent in
+                                     open-loop mode, @p ts otherwise. */
 } ol_sample_entry;
 
+struct ol_client_data;
+struct ol_client_worker;
+
+/**
+ * Connection data. It is accessed by the thread serving the connection
+ * only, until the thread terminates.
+ */
+typedef struct ol_client_conn
+{
+    int                      s;             /**< Connected socket */
+    unsigned int             idx;           /**< Connection number */
+    struct ol_client_worker *worker;        /**< Thread serving the
+                                                 connection */
+    uint64_t                 sent;          /**< Amount of sent data */
+    unsigned char            n_sent;        /**< Number of sent data
+                                                 chunks */
+    ol_sample_entry          tx_ts[RTT_BUF_SIZE]; /**< Queue of timestamps
+                                                       of chunks waiting
+                                                       for an answer */
+    size_t                   tx_head;       /**< Number of answered
+                                                 chunks */
+    size_t                   tx_tail;       /**< Number of chunks which
+                                                 started to be sent */
+    bool                     poll_rx_only;  /**< Flag telling to stop
+                                                 sending data, and receive
+                                                 only */
+    bool                     done;          /**< All answers are received,
+                                                 the connection is not
+                                                 polled */
+    uint64_t                 next_send;     /**< Time when the next chunk
+                                                 has to be sent in
+                                                 open-loop mode */
+    bool                     blocked;       /**< Sending would block, wait
+                                                 for POLLOUT in open-loop
+                                                 mode */
+    ol_hist                  rtt_hist;      /**< RTT values histogram, it is
+                                                 filled if report is not
+                                                 @c OL_CLIENT_REPORT_SAMPLES */
+    ol_hist                  raw_hist;      /**< Histogram of RTT values
+                                                 measured from the actual
+                                                 send time in open-loop
+                                                 mode */
+    ol_hist                  lag_hist;      /**< Histogram of delays
+                                                 between intended and
+                                                 actual send time in
+                                                 open-loop mode */
+} ol_client_conn;
+
+/** Thread serving a subset of connections. */
+typedef struct ol_client_worker
+{
+    struct ol_client_data  *client;     /**< Client data */
+    unsigned int            idx;        /**< Thread number */
+    pthread_t               thread_id;  /**< Thread ID */
+    bool                    running;    /**< The thread is created and not
+                                             joined yet */
+    int                     cpu;        /**< CPU to pin the thread to, or
+                                             @c -1 */
+    char                   *buf;        /**< Send buffer */
+    size_t                  bufsize;    /**< Size of @p buf */
+    unsigned int            n_active;   /**< Number of connections which
+                                             are still polled */
+    ol_spsc_ring           *rtt_buf;    /**< Ring buffer of RTT values to
+                                             print in samples mode */
+    unsigned short          rand_state[3]; /**< State of random intervals
+                                                generator */
+    int                     rc;         /**< Thread status code,
+                                             @c OL_POLL_RC_* */
+} ol_client_worker;
+
 /**
  * Client internal data structure.
  */
 typedef struct ol_client_data
 {
-    int             sent;               /**< Total amount of sent data */
-    pthread_t       thread_id;          /**< ID of RTT printing thread */
-    int             bytes_to_send;      /**< How much data the client has to
-                                             send */
-    int             time_to_run;        /**< How much time the client has to
-                                             run, in seconds */
-    time_t          client_start_time;  /**< Client execution start time */
-    int             chunk_size;         /**< Size of sent data for RTT
-                                             measuring */
-    ol_ringbuffer  *rx_ts_buf;          /**< Ring buffer for storing Rx
-                                             timestamps */
-    ol_ringbuffer  *tx_ts_buf;          /**< Ring buffer for storing Tx
-                                             timestamps */
-    unsigned char   n_sent;             /**< Number of sent data chunks */
-    bool            use_pattern;        /**< Send data according to the pattern */
-    bool            poll_rx_only;       /**< Flag telling to stop sending data,
-                                             and receive only */
+    const ol_client_opts   *opts;               /**< Client options */
+    time_t                  client_start_time;  /**< Client execution start
+                                                     time */
+    ol_client_conn         *conns;              /**< Connections */
+    int                     n_conns;            /**< Number of
+                                                     connections */
+    ol_client_worker       *workers;            /**< Threads */
+    int                     n_workers;          /**< Number of threads */
+    int                    *cpus;               /**< CPUs to pin threads
+                                                     to, or @c NULL */
+    int                     n_cpus;             /**< Number of CPUs in
+                                                     @p cpus */
+    bool                    stop;               /**< Set if a thread
+                                                     failed to stop
+                                                     other threads */
 } ol_client_data;
 
-static void *
-ol_client_print_rtt_th(void *arg)
+ol_client_report
+ol_client_report_by_name(const char *name)
 {
-    ol_client_data *state = arg;
-    ol_sample_entry e_rx;
-    ol_sample_entry e_tx;
+    if (name == NULL || strcmp(name, "samples") == 0)
+        return OL_CLIENT_REPORT_SAMPLES;
+    else if (strcmp(name, "summary") == 0)
+        return OL_CLIENT_REPORT_SUMMARY;
+    else if (strcmp(name, "hist") == 0)
+        return OL_CLIENT_REPORT_HIST;
+
+    return OL_CLIENT_REPORT_UNKNOWN;
+}
 
-    assert(arg != NULL);
+ol_client_arrival
+ol_client_arrival_by_name(const char *name)
+{
+    if (name == NULL || strcmp(name, "fixed") == 0)
+        return OL_CLIENT_ARRIVAL_FIXED;
+    else if (strcmp(name, "poisson") == 0)
+        return OL_CLIENT_ARRIVAL_POISSON;
 
-    while (true)
-    {
-        while (!is_empty(state->rx_ts_buf) &&
-               !is_empty(state->tx_ts_buf))
-        {
-            if (ol_ringbuf_pop(state->rx_ts_buf, &e_rx) == 0 &&
-                ol_ringbuf_pop(state->tx_ts_buf, &e_tx) == 0)
-            {
-                if (e_rx.id != e_tx.id)
-                {
-                    printf("client: invalid answer from server "
-                           "(id=%u, sent_id=%u)\n", e_rx.id, e_tx.id);
-                    pthread_exit(NULL);
-                }
-                printf("%lu\n", e_rx.ts - e_tx.ts);
-            }
-            else
-            {
-                printf("client: getting sample failed\n");
-                pthread_exit(NULL);
-            }
-        }
-        pthread_testcancel();
-    }
+    return OL_CLIENT_ARRIVAL_UNKNOWN;
+}
 
-    return NULL;
+/** Stop polling a connection which got all answers. */
+static void
+ol_client_conn_done(ol_client_conn *conn)
+{
+    ol_poll_delfd(conn->s);
+    conn->done = true;
+    conn->worker->n_active--;
 }
 
 static int
 ol_client_pollin_func(int s, void *user_data)
 {
-    unsigned char           id;
-    ol_client_data         *state;
-    ol_sample_entry         sample;
+    ol_client_conn         *conn = user_data;
+    ol_client_worker       *worker;
+    unsigned char           ids[RTT_BATCH_SIZE];
+    ol_sample_entry        *tx;
+    uint64_t                ts;
+    uint64_t                rtt;
     ssize_t                 rc = 0;
+    ssize_t                 i;
 
     assert(user_data != NULL);
+    worker = conn->worker;
 
-    state = ((ol_app_state *)user_data)->internal_data;
-
-    rc = recv(s, &id, sizeof(id), 0);
+    rc = recv(s, ids, sizeof(ids), MSG_DONTWAIT);
     if (rc < 0)
     {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return OL_POLL_RC_AGAIN;
+
         printf("client: recv(): %s\n", strerror(errno));
         return OL_POLL_RC_FAIL;
     }
@@ -128,28 +226,69 @@ ol_client_pollin_func(int s, void *user_data)
         return OL_POLL_RC_STOP;
     }
 
-    sample.id = id;
-    sample.ts = ol_time_get_usec();
+    ts = ol_time_get_nsec();
 
-    if (ol_ringbuf_push(state->rx_ts_buf, &sample) != 0)
+    for (i = 0; i < rc; ++i)
     {
-        printf("client: failed to print rtt value\n");
-        return OL_POLL_RC_FAIL;
+        if (conn->tx_head == conn->tx_tail)
+        {
+            printf("client: unexpected answer from server (id=%u)\n",
+                   ids[i]);
+            return OL_POLL_RC_FAIL;
+        }
+
+        tx = &conn->tx_ts[conn->tx_head % RTT_BUF_SIZE];
+        if (ids[i] != tx->id)
+        {
+            printf("client: invalid answer from server "
+                   "(id=%u, sent_id=%u)\n", ids[i], tx->id);
+            return OL_POLL_RC_FAIL;
+        }
+        conn->tx_head++;
+
+        /*
+         * In open-loop mode the time a chunk waited to be sent is counted
+         * too, otherwise stalls of sending are hidden.
+         */
+        rtt = ts - tx->intended;
+        if (worker->client->opts->rate != 0 &&
+            worker->client->opts->report != OL_CLIENT_REPORT_SAMPLES)
+        {
+            ol_hist_record(&conn->raw_hist, ts - tx->ts);
+            ol_hist_record(&conn->lag_hist, tx->ts - tx->intended);
+        }
+
+        if (worker->client->opts->report == OL_CLIENT_REPORT_SAMPLES)
+        {
+            if (ol_spsc_ring_push(worker->rtt_buf, &rtt) != 0)
+            {
+                printf("client: failed to print rtt value\n");
+                return OL_POLL_RC_FAIL;
+            }
+        }
+        else
+        {
+            ol_hist_record(&conn->rtt_hist, rtt);
+        }
     }
 
+    if (conn->poll_rx_only && conn->tx_head == conn->tx_tail)
+        ol_client_conn_done(conn);
+
     return OL_POLL_RC_OK;
 }
 
 static bool
-ol_client_must_stop(ol_client_data *state)
+ol_client_must_stop(const ol_client_opts *opts, ol_client_conn *conn,
+                    time_t start_time)
 {
-    if (state->bytes_to_send != OL_CLIENT_LIM_UNSPEC &&
-        state->sent >= state->bytes_to_send)
+    if (opts->bytes_to_send != OL_CLIENT_LIM_UNSPEC &&
+        conn->sent >= opts->bytes_to_send)
     {
         return true;
     }
-    else if (state->time_to_run != OL_CLIENT_LIM_UNSPEC &&
-             time(NULL) >= state->client_start_time + state->time_to_run)
+    else if (opts->time_to_run != OL_CLIENT_LIM_UNSPEC &&
+             time(NULL) >= start_time + opts->time_to_run)
     {
         return true;
     }
@@ -159,72 +298,136 @@ ol_client_must_stop(ol_client_data *state)
     }
 }
 
-static int
-ol_client_send(ol_app_state *state, int s)
+/** Compute when the next chunk has to be sent in open-loop mode. */
+static void
+ol_client_schedule_next(ol_client_conn *conn)
 {
-    ol_client_data *client_state;
-    size_t          data_len = 0;
-    int             rc = 0;
-    unsigned int    chunk_sent = 0;
-    ol_sample_entry sample;
+    const ol_client_opts   *opts = conn->worker->client->opts;
+    double                  interval = 1000000000.0 / opts->rate;
 
-    assert(state != NULL);
-    client_state = state->internal_data;
+    if (opts->arrival == OL_CLIENT_ARRIVAL_POISSON)
+        interval *= -log(1.0 - erand48(conn->worker->rand_state));
+
+    conn->next_send += (uint64_t)interval;
+}
 
-    chunk_sent = client_state->sent % client_state->chunk_size;
-    data_len = client_state->chunk_size - chunk_sent;
+static int
+ol_client_send(ol_client_conn *conn, int s)
+{
+    ol_client_worker       *worker = conn->worker;
+    const ol_client_opts   *opts = worker->client->opts;
+    size_t                  data_len = 0;
+    int                     rc = 0;
+    unsigned int            chunk_sent = 0;
+    ol_sample_entry         sample;
+
+    chunk_sent = conn->sent % opts->chunk_size;
+    data_len = opts->chunk_size - chunk_sent;
     if (chunk_sent == 0)
     {
-        sample.id = client_state->n_sent;
-        sample.ts = ol_time_get_usec();
-
-        if (ol_ringbuf_push(client_state->tx_ts_buf, &sample) != 0)
+        if (conn->tx_tail - conn->tx_head == RTT_BUF_SIZE)
         {
-            printf("client: failed to print rtt value\n");
+            printf("client: too many chunks in flight\n");
+            errno = ENOBUFS;
             return -1;
         }
-        client_state->n_sent++;
+
+        sample.id = conn->n_sent;
+        sample.ts = ol_time_get_nsec();
+        sample.intended = opts->rate != 0 ? conn->next_send : sample.ts;
     }
 
-    if (client_state->bytes_to_send != OL_CLIENT_LIM_UNSPEC &&
-        data_len > client_state->bytes_to_send - client_state->sent)
+    if (opts->bytes_to_send != OL_CLIENT_LIM_UNSPEC &&
+        data_len > opts->bytes_to_send - conn->sent)
     {
-        data_len = client_state->bytes_to_send - client_state->sent;
+        data_len = opts->bytes_to_send - conn->sent;
     }
 
-    if (data_len > state->bufsize)
-        data_len = state->bufsize;
+    if (data_len > worker->bufsize)
+        data_len = worker->bufsize;
 
-    if (client_state->use_pattern)
+    if (opts->use_pattern)
     {
-        ol_pattern_fill_buff_with_sequence(state->buf, data_len,
-                                           client_state->sent);
+        ol_pattern_fill_buff_with_sequence(worker->buf, data_len,
+                                           conn->sent);
     }
 
-    rc = send(s, state->buf, data_len, MSG_DONTWAIT);
+    /*
+     * Do not die of SIGPIPE if the server closes the connection, report
+     * the error instead.
+     */
+    rc = send(s, worker->buf, data_len, MSG_DONTWAIT | MSG_NOSIGNAL);
 
     if (rc > 0)
-        client_state->sent += rc;
+    {
+        /*
+         * Store the chunk timestamp only when the first byte is really
+         * sent, otherwise the send is retried with a new timestamp.
+         */
+        if (chunk_sent == 0)
+        {
+            conn->tx_ts[conn->tx_tail % RTT_BUF_SIZE] = sample;
+            conn->tx_tail++;
+            conn->n_sent++;
+            if (opts->rate != 0)
+                ol_client_schedule_next(conn);
+        }
+
+        conn->sent += rc;
+    }
 
     return rc;
 }
 
+/**
+ * Check whether a connection has to stop sending. If current chunk is sent
+ * fully, stop sending and wait for server response. A chunk truncated by
+ * bytes limit is never answered.
+ *
+ * @return @c true if the connection does not send anymore.
+ */
+static bool
+ol_client_check_stop(ol_client_conn *conn)
+{
+    ol_client_data *client = conn->worker->client;
+
+    if (conn->poll_rx_only)
+        return true;
+
+    if (!ol_client_must_stop(client->opts, conn, client->client_start_time) ||
+        (conn->sent % client->opts->chunk_size != 0 &&
+         client->opts->bytes_to_send == OL_CLIENT_LIM_UNSPEC))
+    {
+        return false;
+    }
+
+    if (conn->sent % client->opts->chunk_size != 0)
+        conn->tx_tail--;
+
+    conn->poll_rx_only = true;
+    if (conn->tx_head == conn->tx_tail)
+        ol_client_conn_done(conn);
+
+    return true;
+}
+
 static int
 ol_client_pollout_func(int s, void *user_data)
 {
-    int             rc;
-    ol_client_data *state;
+    ol_client_conn         *conn = user_data;
+    int                     rc;
 
     assert(user_data != NULL);
 
-    state = ((ol_app_state *)user_data)->internal_data;
+    if (ol_client_check_stop(conn))
+        return conn->done ? OL_POLL_RC_OK : OL_POLL_RC_AGAIN;
 
-    if (state->poll_rx_only)
-        return OL_POLL_RC_OK;
-
-    rc = ol_client_send(user_data, s);
+    rc = ol_client_send(conn, s);
     if (rc < 0)
     {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return OL_POLL_RC_AGAIN;
+
         printf("client: send(): %s\n", strerror(errno));
         return OL_POLL_RC_FAIL;
     }
@@ -232,65 +435,243 @@ ol_client_pollout_func(int s, void *user_data)
     return OL_POLL_RC_OK;
 }
 
-int
-ol_rtt_client(ol_app_state *state, const char *host, int time_to_run,
-              int bytes_to_send, int chunk_size, bool use_pattern)
+static int ol_client_pollout_func_ol(int s, void *user_data);
+
+/**
+ * Send chunks which are due in open-loop mode, until the socket would
+ * block. In the latter case wait for POLLOUT event.
+ */
+static int
+ol_client_send_due(ol_client_conn *conn)
 {
-    int             s = -1;
-    int             rc = 0;
-    pthread_attr_t  tattr;
-    ol_client_data *client_state;
+    int chunk_size = conn->worker->client->opts->chunk_size;
+    int rc;
 
-    printf("Client is running\n");
-    assert(host != NULL);
-    assert(state != NULL);
+    while (!conn->blocked && !ol_client_check_stop(conn) &&
+           (conn->sent % chunk_size != 0 ||
+            ol_time_get_nsec() >= conn->next_send))
+    {
+        rc = ol_client_send(conn, conn->s);
+        if (rc >= 0)
+            continue;
 
-    client_state = malloc(sizeof(ol_client_data));
-    if (client_state == NULL)
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            printf("client: send(): %s\n", strerror(errno));
+            return OL_POLL_RC_FAIL;
+        }
+
+        conn->blocked = true;
+        if (ol_poll_modfd(conn->s, ol_client_pollin_func,
+                          ol_client_pollout_func_ol) != 0)
+        {
+            return OL_POLL_RC_FAIL;
+        }
+    }
+
+    return OL_POLL_RC_OK;
+}
+
+/** POLLOUT callback in open-loop mode, it is set if sending would block. */
+static int
+ol_client_pollout_func_ol(int s, void *user_data)
+{
+    ol_client_conn *conn = user_data;
+
+    assert(user_data != NULL);
+
+    conn->blocked = false;
+    if (ol_poll_modfd(s, ol_client_pollin_func, NULL) != 0)
+        return OL_POLL_RC_FAIL;
+
+    return ol_client_send_due(conn);
+}
+
+/**
+ * Send chunks which are due over all connections of a thread in open-loop
+ * mode, and get how long the thread may wait for events.
+ */
+static int
+ol_client_worker_send_due(ol_client_worker *worker, int *timeout_ms)
+{
+    ol_client_data *client = worker->client;
+    ol_client_conn *conn;
+    int64_t         wait_nsec = -1;
+    int64_t         left;
+    int             rc;
+    int             i;
+
+    for (i = worker->idx; i < client->n_conns; i += client->n_workers)
     {
-        printf("client: malloc: %s\n", strerror(errno));
-        return -1;
+        conn = &client->conns[i];
+        if (conn->done)
+            continue;
+
+        rc = ol_client_send_due(conn);
+        if (rc != OL_POLL_RC_OK)
+            return rc;
+
+        if (conn->blocked || conn->poll_rx_only)
+            continue;
+
+        left = conn->next_send - ol_time_get_nsec();
+        if (wait_nsec < 0 || left < wait_nsec)
+            wait_nsec = left < 0 ? 0 : left;
     }
-    state->internal_data = client_state;
 
-    client_state->sent = 0;
-    client_state->n_sent = 0;
-    client_state->bytes_to_send = bytes_to_send;
-    client_state->time_to_run = time_to_run;
-    client_state->chunk_size = chunk_size;
-    client_state->use_pattern = use_pattern;
-    client_state->poll_rx_only = false;
-    client_state->rx_ts_buf = ol_ringbuf_new(sizeof(ol_sample_entry),
-                                             RTT_BUF_SIZE);
-    if (client_state->rx_ts_buf == NULL)
-    {
-        printf("client: Rx timestamps queue init failed\n");
-        return -1;
+    /*
+     * Timeout of poll() is in milliseconds, so spin checking for events
+     * during the last millisecond before the next chunk is due.
+     */
+    *timeout_ms = wait_nsec < 0 ? -1 : (int)(wait_nsec / 1000000);
+
+    return OL_POLL_RC_OK;
+}
+
+static void *
+ol_client_worker_th(void *arg)
+{
+    ol_client_worker   *worker = arg;
+    ol_client_data     *client = worker->client;
+    ol_client_conn     *conn;
+    bool                open_loop = client->opts->rate != 0;
+    int                 timeout_ms = -1;
+    int                 rc = OL_POLL_RC_OK;
+    int                 i;
+
+    for (i = worker->idx; i < client->n_conns; i += client->n_workers)
+    {
+        conn = &client->conns[i];
+        conn->next_send = ol_time_get_nsec();
+
+        /*
+         * In open-loop mode chunks are sent on schedule, POLLOUT is waited
+         * for only if sending would block.
+         */
+        if (ol_poll_addfd_et(conn->s, ol_client_pollin_func,
+                             open_loop ? NULL : ol_client_pollout_func,
+                             conn) != 0)
+        {
+            rc = OL_POLL_RC_FAIL;
+            break;
+        }
+        worker->n_active++;
     }
-    client_state->tx_ts_buf = ol_ringbuf_new(sizeof(ol_sample_entry),
-                                             RTT_BUF_SIZE);
-    if (client_state->tx_ts_buf == NULL)
+
+    while (rc == OL_POLL_RC_OK && worker->n_active > 0 &&
+           !__atomic_load_n(&client->stop, __ATOMIC_RELAXED))
     {
-        printf("client: Tx timestamps queue init failed\n");
-        return -1;
+        if (open_loop)
+        {
+            rc = ol_client_worker_send_due(worker, &timeout_ms);
+            if (rc != OL_POLL_RC_OK || worker->n_active == 0)
+                break;
+        }
+
+        if (timeout_ms < 0 || timeout_ms > OL_CLIENT_STOP_CHECK_MSEC)
+            timeout_ms = OL_CLIENT_STOP_CHECK_MSEC;
+
+        rc = ol_poll_process_timeout(NULL, timeout_ms);
     }
 
-    if (client_state->bytes_to_send != OL_CLIENT_LIM_UNSPEC &&
-        client_state->time_to_run != OL_CLIENT_LIM_UNSPEC)
+    if (rc == OL_POLL_RC_FAIL)
+        __atomic_store_n(&client->stop, true, __ATOMIC_RELAXED);
+
+    ol_poll_fini();
+    worker->rc = rc;
+
+    return NULL;
+}
+
+/** Print RTT values passed by a thread, return number of printed values. */
+static size_t
+ol_client_print_rtt(ol_client_worker *worker)
+{
+    uint64_t    rtt[RTT_BATCH_SIZE];
+    size_t      n;
+    size_t      i;
+
+    if (worker->rtt_buf == NULL)
+        return 0;
+
+    n = ol_spsc_ring_pop_batch(worker->rtt_buf, rtt, RTT_BATCH_SIZE);
+    for (i = 0; i < n; ++i)
+        printf("%lu\n", rtt[i]);
+
+    return n;
+}
+
+/**
+ * Wait for termination of all threads, printing RTT values in samples
+ * mode. A failed thread sets the stop flag, so that other threads stop
+ * too.
+ */
+static int
+ol_client_wait_workers(ol_client_data *client)
+{
+    ol_client_worker   *worker;
+    int                 n_running = 0;
+    int                 rc = OL_POLL_RC_OK;
+    bool                idle;
+    int                 i;
+
+    for (i = 0; i < client->n_workers; ++i)
+        n_running += client->workers[i].running;
+
+    while (n_running > 0)
     {
-        printf("client: incompatible parameters: both --bytes-to-send and "
-               "--time-to-run are specified\n");
-        return -1;
+        idle = true;
+
+        for (i = 0; i < client->n_workers; ++i)
+        {
+            worker = &client->workers[i];
+
+            if (ol_client_print_rtt(worker) > 0)
+                idle = false;
+
+            if (!worker->running ||
+                pthread_tryjoin_np(worker->thread_id, NULL) == EBUSY)
+            {
+                continue;
+            }
+
+            worker->running = false;
+            --n_running;
+            idle = false;
+
+            if (worker->rc == OL_POLL_RC_FAIL && rc != OL_POLL_RC_FAIL)
+            {
+                printf("client: thread %d error\n", i);
+                rc = OL_POLL_RC_FAIL;
+            }
+            else if (worker->rc == OL_POLL_RC_STOP && rc == OL_POLL_RC_OK)
+            {
+                rc = OL_POLL_RC_STOP;
+            }
+        }
+
+        if (idle)
+            usleep(RTT_PRINT_SLEEP_USEC);
     }
 
-    s = ol_create_and_connect_socket(OL_CONNECT_ACTIVE, SOCK_STREAM,
-                                     SERVER_PORT, host, "client");
-    if (s < 0)
+    for (i = 0; i < client->n_workers; ++i)
     {
-        printf("client: connection to the server failed\n");
-        return -1;
+        while (ol_client_print_rtt(&client->workers[i]) > 0)
+            ;
     }
 
+    return rc;
+}
+
+static int
+ol_client_start_workers(ol_client_data *client)
+{
+    ol_client_worker   *worker;
+    pthread_attr_t      tattr;
+    cpu_set_t           cpuset;
+    int                 rc = 0;
+    int                 i;
+
     rc = pthread_attr_init(&tattr);
     if (rc != 0)
     {
@@ -298,61 +679,340 @@ ol_rtt_client(ol_app_state *state, const char *host, int time_to_run,
         return -1;
     }
 
-    rc = pthread_create(&client_state->thread_id, &tattr,
-                        ol_client_print_rtt_th, client_state);
-    if (rc != 0)
+    for (i = 0; i < client->n_workers; ++i)
     {
-        printf("client: pthread_create error %s\n", strerror(rc));
-        return -1;
+        worker = &client->workers[i];
+
+        if (worker->cpu >= 0)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(worker->cpu, &cpuset);
+            rc = pthread_attr_setaffinity_np(&tattr, sizeof(cpuset),
+                                             &cpuset);
+            if (rc != 0)
+            {
+                printf("client: pthread_attr_setaffinity_np error %s\n",
+                       strerror(rc));
+                break;
+            }
+        }
+
+        rc = pthread_create(&worker->thread_id, &tattr,
+                            ol_client_worker_th, worker);
+        if (rc != 0)
+        {
+            printf("client: pthread_create error %s\n", strerror(rc));
+            break;
+        }
+        worker->running = true;
     }
 
-    ol_poll_addfd(s, ol_client_pollin_func, ol_client_pollout_func);
+    pthread_attr_destroy(&tattr);
 
-    ol_time_init();
+    return rc == 0 ? 0 : -1;
+}
 
-    client_state->client_start_time = time(NULL);
+/**
+ * Merge a histogram of all connections and print its summary, and buckets
+ * if @p hist_prefix is not @c NULL.
+ *
+ * @param client        Client data.
+ * @param hist_offset   Offset of the histogram in @ref ol_client_conn.
+ * @param prefix        Summary line prefix.
+ * @param hist_prefix   Bucket lines prefix.
+ */
+static void
+ol_client_print_total(ol_client_data *client, size_t hist_offset,
+                      const char *prefix, const char *hist_prefix)
+{
+    ol_hist total;
+    int     i;
 
-    do {
-        rc = ol_poll_process(state);
+    if (ol_hist_init(&total, OL_HIST_PRECISION_DEF) != 0)
+        return;
 
-        /*
-         * Check that printing thread is still alive. If it terminates,
-         * then some error occured.
-         */
-        if (pthread_tryjoin_np(client_state->thread_id, NULL) != EBUSY)
+    for (i = 0; i < client->n_conns; ++i)
+    {
+        ol_hist_merge(&total, (ol_hist *)((char *)&client->conns[i] +
+                                          hist_offset));
+    }
+
+    ol_hist_print_summary(&total, prefix);
+    if (hist_prefix != NULL)
+        ol_hist_print_buckets(&total, hist_prefix);
+
+    ol_hist_free(&total);
+}
+
+static void
+ol_client_report_rtt(ol_client_data *client)
+{
+    const ol_client_opts   *opts = client->opts;
+    char                    prefix[64];
+    int                     i;
+
+    if (opts->report == OL_CLIENT_REPORT_SAMPLES)
+        return;
+
+    ol_client_print_total(client, offsetof(ol_client_conn, rtt_hist),
+                          OL_CLIENT_RTT_SUMMARY_PREFIX,
+                          opts->report == OL_CLIENT_REPORT_HIST ?
+                              OL_CLIENT_RTT_HIST_PREFIX : NULL);
+
+    if (opts->rate != 0)
+    {
+        ol_client_print_total(client, offsetof(ol_client_conn, raw_hist),
+                              OL_CLIENT_RTT_UNCORRECTED_SUMMARY_PREFIX,
+                              NULL);
+        ol_client_print_total(client, offsetof(ol_client_conn, lag_hist),
+                              OL_CLIENT_SEND_LAG_SUMMARY_PREFIX, NULL);
+    }
+
+    if (client->n_conns > 1)
+    {
+        for (i = 0; i < client->n_conns; ++i)
         {
-            printf("client: thread error\n");
-            rc = OL_POLL_RC_FAIL;
-            break;
+            snprintf(prefix, sizeof(prefix), "%s%d",
+                     OL_CLIENT_RTT_CONN_SUMMARY_PREFIX, i);
+            ol_hist_print_summary(&client->conns[i].rtt_hist, prefix);
+        }
+    }
+}
+
+/**
+ * Warn if timestamps may be inaccurate: RTT is computed from timestamps
+ * taken by a thread which may migrate between CPUs unless it is pinned.
+ */
+static void
+ol_client_check_clock(ol_client_data *client)
+{
+    uint64_t drift;
+
+    if (!ol_time_tsc_is_invariant())
+    {
+        printf("client: warning: TSC is not invariant, RTT values may be "
+               "inaccurate\n");
+    }
+
+    if (client->cpus != NULL)
+        return;
+
+    if (ol_time_check_cpu_drift(&drift) != 0)
+        return;
+
+    printf("client: TSC drift between CPUs - %lu(ns)\n", drift);
+    if (drift > OL_CLIENT_TSC_DRIFT_MAX)
+    {
+        printf("client: warning: TSC drift between CPUs is too big, use "
+               "--cpus to pin threads\n");
+    }
+}
+
+static void
+ol_client_free(ol_client_data *client)
+{
+    int i;
+
+    if (client->conns != NULL)
+    {
+        for (i = 0; i < client->n_conns; ++i)
+        {
+            if (client->conns[i].s >= 0)
+                close(client->conns[i].s);
+            ol_hist_free(&client->conns[i].rtt_hist);
+            ol_hist_free(&client->conns[i].raw_hist);
+            ol_hist_free(&client->conns[i].lag_hist);
+        }
+        free(client->conns);
+    }
+
+    if (client->workers != NULL)
+    {
+        for (i = 0; i < client->n_workers; ++i)
+        {
+            free(client->workers[i].buf);
+            if (client->workers[i].rtt_buf != NULL)
+                ol_spsc_ring_free(client->workers[i].rtt_buf);
+        }
+        free(client->workers);
+    }
+
+    free(client->cpus);
+    free(client);
+}
+
+static int
+ol_client_init(ol_client_data *client, size_t bufsize)
+{
+    const ol_client_opts   *opts = client->opts;
+    ol_client_worker       *worker;
+    int                     i;
+
+    if (opts->cpus != NULL &&
+        ol_parse_cpu_list(opts->cpus, &client->cpus, &client->n_cpus) != 0)
+    {
+        return -1;
+    }
+
+    client->n_conns = opts->connections;
+    client->conns = calloc(client->n_conns, sizeof(*client->conns));
+    if (client->conns == NULL)
+    {
+        printf("client: calloc: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < client->n_conns; ++i)
+    {
+        client->conns[i].s = -1;
+        client->conns[i].idx = i;
+        if (ol_hist_init(&client->conns[i].rtt_hist,
+                         OL_HIST_PRECISION_DEF) != 0 ||
+            (opts->rate != 0 &&
+             (ol_hist_init(&client->conns[i].raw_hist,
+                           OL_HIST_PRECISION_DEF) != 0 ||
+              ol_hist_init(&client->conns[i].lag_hist,
+                           OL_HIST_PRECISION_DEF) != 0)))
+        {
+            printf("client: RTT histogram init failed\n");
+            return -1;
         }
+    }
 
-        if (ol_client_must_stop(client_state))
+    client->n_workers = opts->threads;
+    if (client->n_workers > client->n_conns)
+        client->n_workers = client->n_conns;
+    client->workers = calloc(client->n_workers, sizeof(*client->workers));
+    if (client->workers == NULL)
+    {
+        printf("client: calloc: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < client->n_workers; ++i)
+    {
+        worker = &client->workers[i];
+        worker->client = client;
+        worker->idx = i;
+        worker->cpu = client->cpus != NULL ?
+                      client->cpus[i % client->n_cpus] : -1;
+        worker->rand_state[0] = i;
+        worker->rand_state[1] = getpid();
+        worker->rand_state[2] = time(NULL);
+
+        /* Threads fill their buffers with the pattern independently. */
+        worker->bufsize = bufsize;
+        worker->buf = calloc(1, bufsize);
+        if (worker->buf == NULL)
         {
-            /* Make sure we handled all the timestamps. */
-            if (is_empty(client_state->rx_ts_buf) &&
-                is_empty(client_state->tx_ts_buf))
+            printf("client: calloc: %s\n", strerror(errno));
+            return -1;
+        }
+
+        if (opts->report == OL_CLIENT_REPORT_SAMPLES)
+        {
+            worker->rtt_buf = ol_spsc_ring_new(sizeof(uint64_t),
+                                               RTT_BUF_SIZE);
+            if (worker->rtt_buf == NULL)
             {
-                break;
+                printf("client: RTT values queue init failed\n");
+                return -1;
             }
-
-            /* If current chunk is sent fully, stop sending and wait for
-               server response. */
-            if ((client_state->sent % client_state->chunk_size) == 0)
-                client_state->poll_rx_only = true;
         }
+    }
+
+    for (i = 0; i < client->n_conns; ++i)
+        client->conns[i].worker = &client->workers[i % client->n_workers];
+
+    return 0;
+}
+
+int
+ol_rtt_client(ol_app_state *state, const ol_client_opts *opts)
+{
+    int             rc = 0;
+    int            *socks = NULL;
+    ol_client_data *client_state;
+    uint64_t        total_sent = 0;
+    int             i;
+
+    printf("Client is running\n");
+    assert(opts != NULL);
+    assert(opts->host != NULL);
+    assert(state != NULL);
+
+    if (opts->bytes_to_send != OL_CLIENT_LIM_UNSPEC &&
+        opts->time_to_run != OL_CLIENT_LIM_UNSPEC)
+    {
+        printf("client: incompatible parameters: both --bytes-to-send and "
+               "--time-to-run are specified\n");
+        return -1;
+    }
+
+    if (opts->chunk_size <= 0 || opts->connections <= 0 ||
+        opts->threads <= 0)
+    {
+        printf("client: invalid chunk size, number of connections or "
+               "threads\n");
+        return -1;
+    }
+
+    client_state = calloc(1, sizeof(ol_client_data));
+    if (client_state == NULL)
+    {
+        printf("client: calloc: %s\n", strerror(errno));
+        return -1;
+    }
+    state->internal_data = client_state;
+    client_state->opts = opts;
+
+    if (ol_client_init(client_state, state->bufsize) != 0)
+    {
+        ol_client_free(client_state);
+        return -1;
+    }
+
+    socks = calloc(client_state->n_conns, sizeof(*socks));
+    if (socks == NULL ||
+        ol_create_and_connect_sockets(OL_CONNECT_ACTIVE, SOCK_STREAM,
+                                      SERVER_PORT, opts->host, socks,
+                                      client_state->n_conns,
+                                      "client") != 0)
+    {
+        printf("client: connection to the server failed\n");
+        free(socks);
+        ol_client_free(client_state);
+        return -1;
+    }
+    for (i = 0; i < client_state->n_conns; ++i)
+        client_state->conns[i].s = socks[i];
+    free(socks);
+
+    ol_time_init();
+    ol_client_check_clock(client_state);
+
+    client_state->client_start_time = time(NULL);
+
+    if (ol_client_start_workers(client_state) != 0)
+    {
+        __atomic_store_n(&client_state->stop, true, __ATOMIC_RELAXED);
+        ol_client_wait_workers(client_state);
+        ol_client_free(client_state);
+        return -1;
+    }
+
+    rc = ol_client_wait_workers(client_state);
 
-    } while (rc == OL_POLL_RC_OK);
+    ol_client_report_rtt(client_state);
 
-    pthread_cancel(client_state->thread_id);
+    for (i = 0; i < client_state->n_conns; ++i)
+        total_sent += client_state->conns[i].sent;
 
-    printf("client: total sent - %d(bytes)\n", client_state->sent);
+    printf("client: total sent - %lu(bytes)\n", total_sent);
     printf("client: total time elapsed - %ld(s)\n",
            time(NULL) - client_state->client_start_time);
 
-    close(s);
-    ol_ringbuf_free(client_state->rx_ts_buf);
-    ol_ringbuf_free(client_state->tx_ts_buf);
-    free(client_state);
+    ol_client_free(client_state);
 
     return rc == OL_POLL_RC_FAIL ? -1 : 0;
 }
@@ -7,30 +7,138 @@
 #ifndef __OL_CLIENT_H__
 #define __OL_CLIENT_H__
 
+#include <stdbool.h>
+
 #include "ol_apprtt.h"
 
 #define OL_CLIENT_LIM_UNSPEC 0
 
+/** How the client reports RTT values. */
+typedef enum ol_client_report {
+    OL_CLIENT_REPORT_SAMPLES,   /**< Print every RTT value on a separate
+                                     line. */
+    OL_CLIENT_REPORT_SUMMARY,   /**< Keep RTT values in a histogram and
+                                     print its summary at the end. */
+    OL_CLIENT_REPORT_HIST,      /**< The same as summary, and print
+                                     non-empty histogram buckets. */
+    OL_CLIENT_REPORT_UNKNOWN,   /**< Invalid report type name. */
+} ol_client_report;
+
+/** Distribution of chunk send times in open-loop mode. */
+typedef enum ol_client_arrival {
+    OL_CLIENT_ARRIVAL_FIXED,    /**< Chunks are sent at fixed intervals. */
+    OL_CLIENT_ARRIVAL_POISSON,  /**< Intervals between chunks are
+                                     exponentially distributed (Poisson
+                                     process). */
+    OL_CLIENT_ARRIVAL_UNKNOWN,  /**< Invalid arrival type name. */
+} ol_client_arrival;
+
+/** Prefix of RTT histogram summary line. */
+#define OL_CLIENT_RTT_SUMMARY_PREFIX "rtt-summary"
+
+/** Prefix of RTT histogram bucket lines. */
+#define OL_CLIENT_RTT_HIST_PREFIX "rtt-hist"
+
+/**
+ * Get report type by its name.
+ *
+ * @param name      Report name: "samples", "summary" or "hist". @c NULL
+ *                  means "samples".
+ *
+ * @return Report type, or @c OL_CLIENT_REPORT_UNKNOWN if the name is
+ *         invalid.
+ */
+ol_client_report
+ol_client_report_by_name(const char *name);
+
+/**
+ * Get arrival type by its name.
+ *
+ * @param name      Arrival name: "fixed" or "poisson". @c NULL means
+ *                  "fixed".
+ *
+ * @return Arrival type, or @c OL_CLIENT_ARRIVAL_UNKNOWN if the name is
+ *         invalid.
+ */
+ol_client_arrival
+ol_client_arrival_by_name(const char *name);
+
+/**
+ * Prefix of histogram summary line of RTT measured from the actual send
+ * time in open-loop mode.
+ */
+#define OL_CLIENT_RTT_UNCORRECTED_SUMMARY_PREFIX "rtt-uncorrected-summary"
+
+/**
+ * Prefix of histogram summary line of delays between intended and actual
+ * send time in open-loop mode.
+ */
+#define OL_CLIENT_SEND_LAG_SUMMARY_PREFIX "send-lag-summary"
+
+/** Prefix of per-connection RTT histogram summary lines. */
+#define OL_CLIENT_RTT_CONN_SUMMARY_PREFIX "rtt-summary-conn"
+
+/** Client options. */
+typedef struct ol_client_opts
+{
+    const char         *host;           /**< String containing an address to
+                                             connect. */
+    int                 time_to_run;    /**< Time to run, in seconds.
+                                             Applicable if @p bytes_to_send
+                                             is not specified. */
+    int                 bytes_to_send;  /**< Number of bytes to send over
+                                             every connection. Applicable if
+                                             @p time_to_run is not
+                                             specified. */
+    int                 chunk_size;     /**< Size of sent data for RTT
+                                             measuring. */
+    bool                use_pattern;    /**< Send data according to the
+                                             pattern. */
+    ol_client_report    report;         /**< How to report RTT values. */
+    int                 connections;    /**< Number of connections. */
+    int                 threads;        /**< Number of threads serving the
+                                             connections. */
+    const char         *cpus;           /**< List of CPUs to pin threads to,
+                                             e.g. "0,2,4-7", or @c NULL. */
+    int                 rate;           /**< Chunks per second to send over
+                                             every connection in open-loop
+                                             mode, @c 0 means closed-loop
+                                             mode. */
+    ol_client_arrival   arrival;        /**< Distribution of chunk send
+                                             times in open-loop mode. */
+} ol_client_opts;
+
 /**
  * Main client application function.
  * If neither @p time_to_run or @p bytes_to_send are specified, the client
  * runs infinitely.
  *
+ * The client opens @p connections connections to the server and serves
+ * them with @p threads threads, connection @c N is served by thread
+ * @c N % @p threads. Thread @c T is pinned to CPU @c T % (number of CPUs)
+ * of @p cpus list. RTT values of all the connections are reported together;
+ * in summary and hist modes summaries of every connection are printed too
+ * if there are several connections. RTT values are in nanoseconds.
+ *
+ * In closed-loop mode (@p rate is @c 0) the client sends data as fast as
+ * the connection allows, and RTT is measured from the moment the first
+ * byte of a chunk is sent. If the stack stalls, sending is delayed too and
+ * the delay is not seen in RTT values (coordinated omission).
+ *
+ * In open-loop mode chunks are scheduled at @p rate per second regardless
+ * of answers and of the socket being writable. RTT is measured from the
+ * intended send time, so it includes the time a chunk waited to be sent.
+ * In summary and hist modes RTT measured from the actual send time and
+ * delays between intended and actual send time are summarized too.
+ *
  * @param state         Application state handle.
- * @param host          String containing an address to connect.
- * @param time_to_run   Time to run, in seconds. Applicable if
- *                      @p bytes_to_send is not specified.
- * @param bytes_to_send Number of bytes to send. Applicable if
- *                      @p time_to_run is not specified.
- * @param chunk_size    Size of sent data for RTT measuring.
- * @param use_pattern   Client should send data according to the pattern.
+ * @param opts          Client options.
  *
  * @return Status code
  * @retval 0    No errors.
  * @retval -1   An error occured.
  */
 int
-ol_rtt_client(ol_app_state *state, const char *host, int time_to_run,
-              int bytes_to_send, int chunk_size, bool use_pattern);
+ol_rtt_client(ol_app_state *state, const ol_client_opts *opts);
 
 #endif /* __OL_CLIENT_H__ */
@@ -21,34 +21,55 @@
 #include "ol_helpers.h"
 #include "ol_pattern.h"
 
+/**
+ * Connection data.
+ */
+typedef struct ol_server_conn
+{
+    int                     s;              /**< Connected socket. */
+    struct ol_server_data  *server;         /**< Server data. */
+    size_t                  received;       /**< Amount of received data not
+                                                 "acked" yet. */
+    size_t                  total_received; /**< Total amount of received
+                                                 data. */
+    unsigned char           n_ack;          /**< The "ack" byte number. */
+} ol_server_conn;
+
 /**
  * Server internal data structure.
  */
 typedef struct ol_server_data
 {
+    ol_app_state   *app_state;      /**< Application state. */
     int             chunk_size;     /**< Size of data after which the server
                                          sends back "ack" byte. */
-    size_t          received;       /**< Total amount of received data. */
-    unsigned char   n_ack;          /**< The "ack" byte number. */
     bool            data_check;     /**< Check received data with pattern. */
+    ol_server_conn *conns;          /**< Connections. */
+    int             n_conns;        /**< Number of connections. */
+    int             n_active;       /**< Number of connections not closed
+                                         by peer. */
 } ol_server_data;
 
 static char         compare_buf[APP_BUF_SIZE];
-static size_t       total_received = 0;
 
 static int
 ol_server_pollin_func(int s, void *user_data)
 {
-    ol_app_state           *app_state = user_data;
+    ol_server_conn         *conn = user_data;
     ol_server_data         *server_state = NULL;
+    ol_app_state           *app_state = NULL;
     int                     rc;
 
-    assert(app_state != NULL);
-    server_state = app_state->internal_data;
+    assert(conn != NULL);
+    server_state = conn->server;
+    app_state = server_state->app_state;
 
     rc = recv(s, app_state->buf, app_state->bufsize, MSG_DONTWAIT);
     if (rc < 0)
     {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return OL_POLL_RC_AGAIN;
+
         printf("server: recv(): %s\n", strerror(errno));
         return OL_POLL_RC_FAIL;
     }
@@ -56,12 +77,17 @@ ol_server_pollin_func(int s, void *user_data)
     if (rc == 0)
     {
         printf("server: peer closed the connection\n");
-        return OL_POLL_RC_STOP;
+        if (--server_state->n_active == 0)
+            return OL_POLL_RC_STOP;
+
+        ol_poll_delfd(s);
+        return OL_POLL_RC_OK;
     }
 
     if (server_state->data_check)
     {
-        ol_pattern_fill_buff_with_sequence(compare_buf, rc, total_received);
+        ol_pattern_fill_buff_with_sequence(compare_buf, rc,
+                                           conn->total_received);
 
         if (memcmp(app_state->buf, compare_buf, rc) != 0)
         {
@@ -70,73 +96,110 @@ ol_server_pollin_func(int s, void *user_data)
         }
     }
 
-    server_state->received += rc;
-    total_received += rc;
+    conn->received += rc;
+    conn->total_received += rc;
 
-    while (server_state->received >= server_state->chunk_size)
+    while (conn->received >= server_state->chunk_size)
     {
-        if (send(s, &server_state->n_ack, sizeof(server_state->n_ack), 0) < 0)
+        if (send(s, &conn->n_ack, sizeof(conn->n_ack), 0) < 0)
         {
             printf("server: send(): %s\n", strerror(errno));
             return OL_POLL_RC_FAIL;
         }
 
-        ++server_state->n_ack;
-        server_state->received -= server_state->chunk_size;
+        ++conn->n_ack;
+        conn->received -= server_state->chunk_size;
     }
 
     return OL_POLL_RC_OK;
 }
 
 int
-ol_rtt_server(ol_app_state *state, int chunk_size, bool data_check)
+ol_rtt_server(ol_app_state *state, int chunk_size, bool data_check,
+              int connections)
 {
-    int             s = -1;
+    int            *socks = NULL;
     int             rc = 0;
+    int             i;
     ol_server_data *server_state = NULL;
 
     printf("Server is running\n");
     printf("chunk size = %d\n", chunk_size);
     assert(state != NULL);
 
-    server_state = malloc(sizeof(ol_server_data));
-    if (server_state == NULL)
+    if (chunk_size == 0)
     {
-        printf("client: malloc: %s\n", strerror(errno));
+        printf("server: invalid chunk size\n");
         return -1;
     }
-    state->internal_data = server_state;
 
-    if (chunk_size == 0)
+    if (connections <= 0)
     {
-        printf("server: invalid chunk size\n");
+        printf("server: invalid number of connections\n");
+        return -1;
+    }
+
+    server_state = calloc(1, sizeof(ol_server_data));
+    if (server_state == NULL)
+    {
+        printf("server: calloc: %s\n", strerror(errno));
         return -1;
     }
+    state->internal_data = server_state;
+
+    server_state->app_state = state;
     server_state->chunk_size = chunk_size;
-    server_state->received = 0;
-    server_state->n_ack = 0;
     server_state->data_check = data_check;
 
-    s = ol_create_and_connect_socket(OL_CONNECT_PASSIVE, SOCK_STREAM,
-                                     SERVER_PORT, NULL, "server");
-    if (s < 0)
+    server_state->conns = calloc(connections, sizeof(ol_server_conn));
+    socks = calloc(connections, sizeof(int));
+    if (server_state->conns == NULL || socks == NULL)
+    {
+        printf("server: calloc: %s\n", strerror(errno));
+        rc = OL_POLL_RC_FAIL;
+        goto cleanup;
+    }
+
+    if (ol_create_and_connect_sockets(OL_CONNECT_PASSIVE, SOCK_STREAM,
+                                      SERVER_PORT, NULL, socks, connections,
+                                      "server") != 0)
     {
         printf("server: connection failed\n");
-        return -1;
+        rc = OL_POLL_RC_FAIL;
+        goto cleanup;
     }
+    server_state->n_conns = connections;
+    server_state->n_active = connections;
 
     printf("server: switching off Nagle Algorithm\n");
-    if (ol_enable_tcp_no_delay_opt(s, "server") < 0)
-        return -1;
+    for (i = 0; i < connections; ++i)
+    {
+        ol_server_conn *conn = &server_state->conns[i];
 
-    ol_poll_addfd(s, ol_server_pollin_func, NULL);
+        conn->s = socks[i];
+        conn->server = server_state;
+
+        if (ol_enable_tcp_no_delay_opt(conn->s, "server") < 0 ||
+            ol_poll_addfd_et(conn->s, ol_server_pollin_func, NULL,
+                             conn) != 0)
+        {
+            rc = OL_POLL_RC_FAIL;
+            goto cleanup;
+        }
+    }
 
     do {
         rc = ol_poll_process(state);
     } while (rc == OL_POLL_RC_OK);
 
-    close(s);
+cleanup:
+    ol_poll_fini();
+
+    for (i = 0; i < server_state->n_conns; ++i)
+        close(server_state->conns[i].s);
+    free(server_state->conns);
     free(server_state);
+    free(socks);
 
     return rc == OL_POLL_RC_FAIL ? -1 : 0;
 }
@@ -17,12 +17,16 @@
  * @param state         Application state handle.
  * @param chunk_size    Size of data chunk. When server receives the size,
  *                      it answers with a byte.
+ * @param data_check    Check received data with pattern.
+ * @param connections   Number of connections to accept. The server stops
+ *                      when all of them are closed by the peer.
  *
  * @return Status code
  * @retval 0    No errors.
  * @retval -1   An error occured.
  */
 int
-ol_rtt_server(ol_app_state *state, int chunk_size, bool data_check);
+ol_rtt_server(ol_app_state *state, int chunk_size, bool data_check,
+              int connections);
 
 #endif /* __OL_SERVER_H__ */
@@ -5,23 +5,37 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <libgen.h>
 #include <stdint.h>
 
 #include "ol_cmdline.h"
+#include "ol_poll.h"
 #include "ol_ceph_receiver.h"
 #include "ol_ceph_generator.h"
+#include "ol_ceph_protocol.h"
 #include "ol_ceph.h"
 
-/* Send/receive buffer for both generator and receiver. */
-static uint8_t buf[1024 * 512];
+/* Size of a receive buffer of a connection. */
+#define OL_CEPH_RX_BUF_SIZE (1024 * 512)
 
 static bool     print_help = false;
 static char    *srv_addr = NULL;
 static int      srv_port = OL_CEPH_APP_PORT;
 static int      time_to_run = OL_CEPH_GENERATOR_LIM_UNSPEC;
 static char    *iface = NULL;
+static char    *poll_engine = NULL;
+static int      spin_usec = OL_POLL_SPIN_USEC_DEF;
+static int      batch = OL_CEPH_GENERATOR_BATCH_DEF;
+static int      connections = 1;
+static int      threads = 1;
+static char    *cpus = NULL;
+static int      rate = 0;
+static char    *arrival = NULL;
+static int      msg_size = OL_CEPH_MAX_DATA_LEN;
+static int      msg_size_max = 0;
 
 static ol_cmdline_opt opts[] =
 {
@@ -36,6 +50,32 @@ static ol_cmdline_opt opts[] =
                     "omitted, application runs in receiver mode."},
     {"iface", OL_OPT_STR, &iface, "Name of the interface via which data will "
                                   "flow."},
+    {"poll-engine", OL_OPT_STR, &poll_engine, "Event engine: poll "
+                    "(default), epoll or busy."},
+    {"spin-usec", OL_OPT_INT, &spin_usec, "How long busy engine spins "
+                  "before blocking, in microseconds (negative means "
+                  "forever)."},
+    {"connections", OL_OPT_INT, &connections, "Number of connections "
+                    "(default 1). The receiver stops when all of them "
+                    "are closed."},
+    {"batch", OL_OPT_INT, &batch, "Generator: maximum number of messages "
+              "sent with one sendmsg() call (default "
+              OL_MAKE_STR(OL_CEPH_GENERATOR_BATCH_DEF) ")."},
+    {"threads", OL_OPT_INT, &threads, "Generator: number of threads "
+                "serving the connections (default 1)."},
+    {"cpus", OL_OPT_STR, &cpus, "Generator: CPUs to pin threads to, "
+             "e.g. 0,2-3. Thread i is pinned to i-th CPU of the list "
+             "modulo its length."},
+    {"rate", OL_OPT_INT, &rate, "Generator: messages per second per "
+             "connection. Omitting the option means no limit."},
+    {"arrival", OL_OPT_STR, &arrival, "Generator: distribution of message "
+                "send times with --rate: fixed (default) or poisson."},
+    {"msg-size", OL_OPT_INT, &msg_size, "Generator: message payload length "
+                 "(default " OL_MAKE_STR(OL_CEPH_MAX_DATA_LEN) "), or "
+                 "minimum length with --msg-size-max."},
+    {"msg-size-max", OL_OPT_INT, &msg_size_max, "Generator: maximum "
+                     "message payload length, payload length is uniformly "
+                     "distributed from --msg-size to it."},
     {"help", OL_OPT_FLAG, &print_help, "Print help."},
 };
 #define OPTS_NUM (sizeof(opts) / sizeof(opts[0]))
@@ -59,6 +99,15 @@ usage(const char *prog_name)
     printf("  %s --time-to-run 5\n"
            "    Run CEPH generator that waits for incoming TCP connections, "
            "and, when connected, sends traffic for 5 seconds\n\n", prog_name);
+    printf("  %s --time-to-run 10 --srv-addr 1.2.3.4 --connections 8 "
+           "--threads 4 --cpus 2-5 --rate 10000 --msg-size 512 "
+           "--msg-size-max 8192\n"
+           "    Run CEPH generator with 8 connections served by 4 threads "
+           "pinned to CPUs 2-5, each connection sends 10000 messages per "
+           "second with payload from 512 to 8192 bytes\n\n", prog_name);
+    printf("  %s --srv-addr 1.2.3.4 --connections 8\n"
+           "    Run CEPH receiver that opens 8 connections to 1.2.3.4 "
+           "address\n\n", prog_name);
     printf("  %s --srv_addr 1.2.3.4\n"
            "    Run CEPH receiver that connects actively to 1.2.3.4 "
            "address\n\n", prog_name);
@@ -80,16 +129,52 @@ main(int argc, char **argv)
         return ret;
     }
 
-    app.buf = buf;
-    app.bufsize = sizeof(buf);
+    if (ol_poll_init(ol_poll_engine_by_name(poll_engine), spin_usec) != 0)
+    {
+        usage(basename(argv[0]));
+        return -1;
+    }
+
+    if (batch <= 0 || connections <= 0 || threads <= 0 || rate < 0 ||
+        msg_size <= 0 || (msg_size_max != 0 && msg_size_max < msg_size) ||
+        (arrival != NULL && strcmp(arrival, "fixed") != 0 &&
+         strcmp(arrival, "poisson") != 0))
+    {
+        fprintf(stderr, "Invalid option value\n");
+        usage(basename(argv[0]));
+        return -1;
+    }
+
+    app.bufsize = OL_CEPH_RX_BUF_SIZE;
 
     if (time_to_run != OL_CEPH_GENERATOR_LIM_UNSPEC)
-        ret = ol_ceph_generator(&app, srv_addr, srv_port, time_to_run);
+    {
+        ol_ceph_generator_opts gen_opts = {
+            .host = srv_addr,
+            .port = srv_port,
+            .time_to_run = time_to_run,
+            .batch = batch,
+            .connections = connections,
+            .threads = threads,
+            .cpus = cpus,
+            .rate = rate,
+            .poisson = arrival != NULL && strcmp(arrival, "poisson") == 0,
+            .msg_size = msg_size,
+            .msg_size_max = msg_size_max != 0 ? msg_size_max : msg_size,
+        };
+
+        ret = ol_ceph_generator(&gen_opts);
+    }
     else
-        ret = ol_ceph_receiver(&app, srv_addr, srv_port, iface);
+    {
+        ret = ol_ceph_receiver(&app, srv_addr, srv_port, iface, connections);
+    }
 
     free(srv_addr);
     free(iface);
+    free(poll_engine);
+    free(cpus);
+    free(arrival);
 
     return ret;
 }
@@ -12,8 +12,8 @@
  */
 typedef struct ol_ceph_state
 {
-    void       *buf;        /**< Pointer to a buffer to read/write to. */
-    size_t      bufsize;    /**< Size of the buffer. */
+    size_t      bufsize;    /**< Size of a receive buffer of
+                                 a connection. */
 } ol_ceph_state;
 
 #define _OL_MAKE_STR(_x) #_x
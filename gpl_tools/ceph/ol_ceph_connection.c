@@ -308,40 +308,81 @@ ol_efvi_fetch_fpga_data(ol_ceph_connection *conn,
 #endif /* HAVE_ZC */
 
 /**
- * Read @p len bytes via @p conn and write it to @p ptr. If @p use_zc
- * is @c true, and Onload libraries are available and initialized, then
- * zero-zopy API is used, otherwise @b read() syscall is used. If offloading
- * is used, data is transmitted from remote buffer to the host memory.
+ * Read up to @p len bytes via @p conn and write it to @p ptr. If Onload
+ * libraries are available and initialized, then @b onload_zc_hlrx_recv_copy()
+ * is used, otherwise @b recv() syscall is used.
  *
  * @param conn      Connection handle.
  * @param ptr       Pointer to write received data to.
- * @param len       Length of data to receive.
- * @param use_zc    If @c true, use zero-copy.
+ * @param len       Maximum length of data to receive.
  *
  * @return number of read bytes, or zero if a peer closes connection,
  *         or a negative error value in case of failure.
  */
 static ssize_t
-ol_ceph_recv_chunk(ol_ceph_connection *conn, void *ptr, size_t len, bool use_zc)
+ol_ceph_recv_chunk(ol_ceph_connection *conn, void *ptr, size_t len)
 {
     ssize_t rc;
 
 #if HAVE_ZC
     if (conn->hlrx != NULL)
     {
-        if (use_zc)
+        EXP_NON_NEG(rc = onload_zc_hlrx_recv_copy(
+                            conn->hlrx,
+                            &(struct msghdr) {
+                                .msg_iov = &(struct iovec){.iov_base = ptr,
+                                                           .iov_len = len},
+                                .msg_iovlen = 1
+                            },
+                            0));
+        return rc;
+    }
+#endif /* HAVE_ZC */
+    CHECK_SYSCALL(rc = recv(conn->socket, ptr, len, 0));
+    return rc;
+}
+
+#if HAVE_ZC
+/**
+ * Read @p len bytes via @p conn using zero-copy Onload API and pass them
+ * to @p cb in place. If offloading is used, data are transmitted from remote
+ * buffers to the host memory first.
+ *
+ * @param conn          Connection handle.
+ * @param len           How much bytes to read.
+ * @param cb            Callback to pass the data to, may be @c NULL.
+ * @param user_data     User data to pass to @p cb.
+ *
+ * @return number of read bytes, or zero if a peer closes connection,
+ *         or a negative error value in case of failure.
+ */
+static ssize_t
+ol_ceph_recv_data_zc(ol_ceph_connection *conn, size_t len,
+                     ol_ceph_conn_data_cb cb, void *user_data)
+{
+    struct onload_zc_iovec iov[OL_CEPH_ZC_IOV_MAX];
+    size_t data_left = len;
+
+    while (data_left > 0)
+    {
+        struct onload_zc_msg zc_msg = {
+            .iov = iov,
+            .msghdr.msg_iovlen = OL_CEPH_ZC_IOV_MAX,
+        };
+        ssize_t fetch_rc = 0;
+        ssize_t rc;
+        int i;
+
+        EXP_NON_NEG(rc = onload_zc_hlrx_recv_zc(conn->hlrx, &zc_msg,
+                                                data_left, 0));
+        if (rc == 0)
         {
-            struct onload_zc_iovec iov = {{0}};
-            struct onload_zc_msg zc_msg = {
-                .iov = &iov,
-                .msghdr.msg_iovlen = 1,
-            };
-
-            EXP_NON_NEG(rc = onload_zc_hlrx_recv_zc(conn->hlrx, &zc_msg, len,
-                                                    0));
-            if (rc == 0)
-                return rc;
+            printf("receiver: peer closed the connection\n");
+            return rc;
+        }
 
+        for (i = 0; i < zc_msg.msghdr.msg_iovlen; i++)
+        {
             /*
              * If TCP/Ceph offloading is used, we get a remote buffer, which is
              * located in NIC internal memory. To read it we have to transfer
@@ -349,73 +390,122 @@ ol_ceph_recv_chunk(ol_ceph_connection *conn, void *ptr, size_t len, bool use_zc)
              */
             if (conn->ceph_offload_support)
             {
-                rc = ol_efvi_fetch_fpga_data(conn, &iov);
+                ssize_t fetched = ol_efvi_fetch_fpga_data(conn, &iov[i]);
 
-                if (rc < 0)
+                if (fetched < 0)
                 {
                     /*
-                    * In case of error do not exit right now because we need to
-                    * release the buffer first.
-                    */
+                     * In case of error do not exit right now because we need
+                     * to release the buffers first.
+                     */
                     fprintf(stderr, "Fetching data from FPGA failed\n");
+                    fetch_rc = fetched;
+                }
+                else if (cb != NULL)
+                {
+                    cb(conn->ef_vi.dma_mem, iov[i].iov_len, user_data);
                 }
-
-                memcpy(ptr, conn->ef_vi.dma_mem, iov.iov_len);
             }
-            else
+            else if (cb != NULL)
             {
-                memcpy(ptr, iov.iov_base, iov.iov_len);
+                cb(iov[i].iov_base, iov[i].iov_len, user_data);
             }
 
-            EXP_NON_NEG(onload_zc_hlrx_buffer_release(conn->socket, iov.buf));
-            return rc;
-        }
-        else
-        {
-            EXP_NON_NEG(rc = onload_zc_hlrx_recv_copy(
-                                conn->hlrx,
-                                &(struct msghdr) {
-                                    .msg_iov = &(struct iovec){.iov_base = ptr,
-                                                               .iov_len = len},
-                                    .msg_iovlen = 1
-                                },
-                                0));
-            return rc;
+            EXP_NON_NEG(onload_zc_hlrx_buffer_release(conn->socket,
+                                                      iov[i].buf));
         }
+
+        if (fetch_rc < 0)
+            return fetch_rc;
+
+        data_left -= rc;
     }
-#endif /* HAVE_ZC */
-    CHECK_SYSCALL(rc = recv(conn->socket, ptr, len, 0));
-    return rc;
+
+    return len;
 }
+#endif /* HAVE_ZC */
 
-static ssize_t
-ol_ceph_recv_gen(ol_ceph_connection *conn, size_t len_to_read, bool append,
-                 bool use_zc)
+/**
+ * Make room for @p len bytes after the current message in the receive
+ * buffer. The current message is moved to the buffer beginning if it does
+ * not fit in the rest of the buffer.
+ *
+ * @param conn      Connection handle.
+ * @param len       Number of bytes to add to the current message.
+ *
+ * @return zero on success, or a negative error value in case of failure.
+ */
+static int
+ol_ceph_rx_make_room(ol_ceph_connection *conn, size_t len)
 {
-    size_t data_left = len_to_read;
-
-    if (!append)
-        conn->offs = 0;
-
-    if (len_to_read + conn->offs > conn->buflen)
+    if (conn->offs + len > conn->buflen)
     {
         fprintf(stderr, "receiver: buffer length is too small (len_to_read=%lu,"
                 "offs=%lu,buflen=%lu)\n",
-                len_to_read, conn->offs, conn->buflen);
+                len, conn->offs, conn->buflen);
         return -ENOBUFS;
     }
 
+    if (conn->rx_start + conn->offs + len > conn->buflen)
+    {
+        memmove(conn->buf, ol_ceph_rx_msg(conn),
+                conn->rx_end - conn->rx_start);
+        conn->rx_end -= conn->rx_start;
+        conn->rx_start = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Consume the current received message. The buffer is rewound if there
+ * are no more received data.
+ *
+ * @param conn      Connection handle.
+ */
+static void
+ol_ceph_rx_consume(ol_ceph_connection *conn)
+{
+    conn->rx_start += conn->offs;
+    conn->offs = 0;
+
+    if (conn->rx_start == conn->rx_end)
+        conn->rx_start = conn->rx_end = 0;
+}
+
+/**
+ * Read data to the receive buffer.
+ *
+ * @param conn      Connection handle.
+ * @param len       Minimum number of bytes to read. Data are read ahead
+ *                  up to the buffer end unless Onload API is used: in this
+ *                  case data following the current message may have to be
+ *                  read with zero-copy API.
+ *
+ * @return number of read bytes, or zero if a peer closes connection,
+ *         or a negative error value in case of failure.
+ */
+static ssize_t
+ol_ceph_rx_fill(ol_ceph_connection *conn, size_t len)
+{
+    size_t data_left = len;
+
     while (data_left > 0)
     {
-        void *buf_ptr = (void *)((uintptr_t)conn->buf + conn->offs);
+        size_t max_len = conn->buflen - conn->rx_end;
         ssize_t rc = 0;
 
-        rc = ol_ceph_recv_chunk(conn, buf_ptr, data_left, use_zc);
+#if HAVE_ZC
+        if (conn->hlrx != NULL)
+            max_len = data_left;
+#endif /* HAVE_ZC */
 
+        rc = ol_ceph_recv_chunk(conn, (uint8_t *)conn->buf + conn->rx_end,
+                                max_len);
         if (rc > 0)
         {
-            conn->offs += rc;
-            data_left -= rc;
+            conn->rx_end += rc;
+            data_left -= rc < data_left ? rc : data_left;
         }
         else if (rc == 0)
         {
@@ -429,7 +519,7 @@ ol_ceph_recv_gen(ol_ceph_connection *conn, size_t len_to_read, bool append,
         }
     }
 
-    return len_to_read;
+    return len;
 }
 
 static void
@@ -454,6 +544,10 @@ ol_ceph_conn_init(ol_ceph_connection *conn, int s, const char *iface, void *buf,
     conn->buflen = buflen;
     conn->socket = s;
     conn->offs = 0;
+    conn->rx_start = 0;
+    conn->rx_end = 0;
+    conn->tx_iovcnt = 0;
+    conn->tx_len = 0;
 
     if (use_zc)
     {
@@ -512,39 +606,153 @@ ol_ceph_conn_close(ol_ceph_connection *conn)
 ssize_t
 ol_ceph_recv(ol_ceph_connection *conn, size_t len_to_read, bool append)
 {
-    return ol_ceph_recv_gen(conn, len_to_read, append, false);
+    size_t received;
+    ssize_t rc;
+
+    if (!append)
+        ol_ceph_rx_consume(conn);
+
+    rc = ol_ceph_rx_make_room(conn, len_to_read);
+    if (rc < 0)
+        return rc;
+
+    received = conn->rx_end - conn->rx_start - conn->offs;
+    if (received < len_to_read)
+    {
+        rc = ol_ceph_rx_fill(conn, len_to_read - received);
+        if (rc <= 0)
+            return rc;
+    }
+
+    conn->offs += len_to_read;
+    return len_to_read;
 }
 
 ssize_t
-ol_ceph_recv_zc(ol_ceph_connection *conn, size_t len_to_read, bool append)
+ol_ceph_recv_data(ol_ceph_connection *conn, size_t len,
+                  ol_ceph_conn_data_cb cb, void *user_data)
+{
+    size_t data_left = len;
+
+    ol_ceph_rx_consume(conn);
+
+#if HAVE_ZC
+    if (conn->hlrx != NULL)
+    {
+        /* Nothing is read ahead if Onload API is used. */
+        assert(conn->rx_end == 0);
+        return ol_ceph_recv_data_zc(conn, len, cb, user_data);
+    }
+#endif /* HAVE_ZC */
+
+    while (data_left > 0)
+    {
+        size_t chunk;
+
+        if (conn->rx_end == 0)
+        {
+            ssize_t rc = ol_ceph_rx_fill(conn, 1);
+
+            if (rc <= 0)
+                return rc;
+        }
+
+        chunk = conn->rx_end - conn->rx_start;
+        if (chunk > data_left)
+            chunk = data_left;
+
+        if (cb != NULL)
+            cb(ol_ceph_rx_msg(conn), chunk, user_data);
+
+        conn->offs = chunk;
+        ol_ceph_rx_consume(conn);
+        data_left -= chunk;
+    }
+
+    return len;
+}
+
+void *
+ol_ceph_tx_reserve(ol_ceph_connection *conn, size_t len)
 {
-    return ol_ceph_recv_gen(conn, len_to_read, append, true);
+    void *buf_ptr = (void *)((uintptr_t)conn->buf + conn->offs);
+    struct iovec *last = conn->tx_iovcnt > 0 ?
+                         &conn->tx_iov[conn->tx_iovcnt - 1] : NULL;
+
+    if (conn->offs + len > conn->buflen)
+        return NULL;
+
+    /* Extend the last iovec if it ends right at the free part of the pool. */
+    if (last != NULL && (uint8_t *)last->iov_base + last->iov_len == buf_ptr)
+    {
+        last->iov_len += len;
+    }
+    else
+    {
+        if (conn->tx_iovcnt == OL_CEPH_TX_IOV_MAX)
+            return NULL;
+
+        conn->tx_iov[conn->tx_iovcnt].iov_base = buf_ptr;
+        conn->tx_iov[conn->tx_iovcnt].iov_len = len;
+        conn->tx_iovcnt++;
+    }
+
+    conn->offs += len;
+    conn->tx_len += len;
+    return buf_ptr;
 }
 
 ssize_t
 ol_ceph_send(ol_ceph_connection *conn)
 {
-    size_t len = conn->offs;
-    ssize_t sent;
+    struct iovec *iov = conn->tx_iov;
+    int iovcnt = conn->tx_iovcnt;
+    size_t len = conn->tx_len;
+    size_t sent = 0;
 
-    CHECK_SYSCALL(sent = send(conn->socket, conn->buf, len, 0));
-
-    if (sent != len)
+    while (sent < len)
     {
-        fprintf(stderr, "Failed to send full data - %ld instead of %lu\n",
-                sent, len);
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = iovcnt,
+        };
+        ssize_t rc;
+
+        CHECK_SYSCALL(rc = sendmsg(conn->socket, &msg, 0));
+        if (rc == 0)
+        {
+            fprintf(stderr, "Failed to send full data - %lu instead of %lu\n",
+                    sent, len);
+            break;
+        }
+        sent += rc;
+
+        /* Skip fully sent iovecs and adjust a partially sent one. */
+        while (iovcnt > 0 && (size_t)rc >= iov->iov_len)
+        {
+            rc -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (rc > 0)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + rc;
+            iov->iov_len -= rc;
+        }
     }
 
     conn->offs = 0;
+    conn->tx_iovcnt = 0;
+    conn->tx_len = 0;
     return sent;
 }
 
 int
 ol_ceph_append(ol_ceph_connection *conn, const void *data, size_t len)
 {
-    void *buf_ptr = (void *)((uintptr_t)conn->buf + conn->offs);
+    void *buf_ptr = ol_ceph_tx_reserve(conn, len);
 
-    if (conn->offs + len > conn->buflen)
+    if (buf_ptr == NULL)
         return -ENOBUFS;
 
     if (data == NULL)
@@ -552,6 +760,18 @@ ol_ceph_append(ol_ceph_connection *conn, const void *data, size_t len)
     else
         memcpy(buf_ptr, data, len);
 
-    conn->offs += len;
+    return 0;
+}
+
+int
+ol_ceph_append_ref(ol_ceph_connection *conn, const void *data, size_t len)
+{
+    if (conn->tx_iovcnt == OL_CEPH_TX_IOV_MAX)
+        return -ENOBUFS;
+
+    conn->tx_iov[conn->tx_iovcnt].iov_base = (void *)data;
+    conn->tx_iov[conn->tx_iovcnt].iov_len = len;
+    conn->tx_iovcnt++;
+    conn->tx_len += len;
     return 0;
 }
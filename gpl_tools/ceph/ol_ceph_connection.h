@@ -8,6 +8,20 @@
 #define __OL_CEPH_CONNECTION_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * Maximum number of iovecs in a transmit batch flushed with one sendmsg()
+ * call. It must not exceed @c IOV_MAX.
+ */
+#define OL_CEPH_TX_IOV_MAX 256
+
+/**
+ * Maximum number of zero-copy buffers got with one
+ * @b onload_zc_hlrx_recv_zc() call.
+ */
+#define OL_CEPH_ZC_IOV_MAX 16
 
 #if HAVE_ZC
 #include "onload/extensions_zc.h"
@@ -57,12 +71,33 @@ typedef struct ol_ef_vi_t
 } ol_ef_vi_t;
 #endif /* HAVE_ZC */
 
+/**
+ * Connection handle.
+ *
+ * The buffer passed to @ref ol_ceph_conn_init() is used either for
+ * receiving or for sending, depending on the connection side.
+ *
+ * On receiving it holds data read from the socket in advance: messages
+ * are parsed in place, and only a tail of a partially received message
+ * is moved to the buffer beginning when the buffer end is reached.
+ *
+ * On sending it is a pool which small parts of messages are built in.
+ * A message is queued as a list of iovecs pointing to the pool or to user
+ * memory, and the whole batch is sent with a single sendmsg() call by
+ * @ref ol_ceph_send. The pool is reused after that.
+ */
 typedef struct ol_ceph_connection
 {
     int socket;
     void *buf;
-    size_t offs;
     size_t buflen;
+    size_t offs;        /**< Length of the current received message, or
+                             used part of the transmit pool. */
+    size_t rx_start;    /**< Offset of the current received message. */
+    size_t rx_end;      /**< End of received data in the buffer. */
+    struct iovec tx_iov[OL_CEPH_TX_IOV_MAX]; /**< Queued data. */
+    int tx_iovcnt;      /**< Number of queued iovecs. */
+    size_t tx_len;      /**< Number of queued bytes. */
 #if HAVE_ZC
     struct onload_zc_hlrx* hlrx;
     bool ceph_offload_support;
@@ -110,12 +145,24 @@ int ol_ceph_conn_init(ol_ceph_connection *conn, int s, const char *iface,
 int ol_ceph_conn_close(ol_ceph_connection *conn);
 
 /**
- * Read @p len_to_read bytes via @p conn.
+ * User callback type for consuming received data in place.
+ *
+ * @param buf       Received data. It is valid only within the call.
+ * @param len       Length of the data.
+ * @param user_data User specific data.
+ */
+typedef void (*ol_ceph_conn_data_cb)(const void *buf, size_t len,
+                                     void *user_data);
+
+/**
+ * Read @p len_to_read bytes via @p conn. Received data are available
+ * contiguously with @ref ol_ceph_rx_msg().
  *
  * @param conn          TCP connection.
  * @param len_to_read   How much bytes to read.
- * @param append        If @c true, append new data to existing data in the
- *                      connection buffer.
+ * @param append        If @c true, append new data to the current message,
+ *                      otherwise the current message is consumed and the new
+ *                      data start the next one.
  *
  * @return Number of read bytes, or zero if peer closed the connection,
  *         or a negative error value in case of failure.
@@ -123,18 +170,78 @@ int ol_ceph_conn_close(ol_ceph_connection *conn);
 ssize_t ol_ceph_recv(ol_ceph_connection *conn, size_t len_to_read, bool append);
 
 /**
- * Read @p len_to_read bytes via @p conn using zero-copy Onload API.
+ * Read @p len bytes via @p conn and pass them to @p cb in place, chunk by
+ * chunk, without copying them to the connection buffer. The current message
+ * is consumed. Buffers got with Onload zero-copy API are used if it is
+ * initialized, otherwise data are read ahead to the connection buffer.
  *
  * @param conn          TCP connection.
- * @param len_to_read   How much bytes to read.
- * @param append        If @c true, append new data to existing data in the
- *                      connection buffer.
+ * @param len           How much bytes to read.
+ * @param cb            Callback to pass the data to or @c NULL to drop them.
+ * @param user_data     User data to pass to @p cb.
  *
  * @return Number of read bytes, or zero if peer closed the connection,
  *         or a negative error value in case of failure.
  */
-ssize_t ol_ceph_recv_zc(ol_ceph_connection *conn, size_t len_to_read,
-                        bool append);
+ssize_t ol_ceph_recv_data(ol_ceph_connection *conn, size_t len,
+                          ol_ceph_conn_data_cb cb, void *user_data);
+
+/**
+ * Get the current received message.
+ *
+ * @param conn  Connection handle.
+ *
+ * @return Pointer to the message, it is valid until the next
+ *         @ref ol_ceph_recv call.
+ */
+static inline void *
+ol_ceph_rx_msg(const ol_ceph_connection *conn)
+{
+    return (uint8_t *)conn->buf + conn->rx_start;
+}
+
+/**
+ * Check whether data which follow the current message are already read
+ * to the connection buffer.
+ *
+ * @param conn  Connection handle.
+ *
+ * @return @c true if there are pending data.
+ */
+static inline bool
+ol_ceph_rx_pending(const ol_ceph_connection *conn)
+{
+    return conn->rx_end > conn->rx_start + conn->offs;
+}
+
+/**
+ * Allocate @p len bytes in the transmit pool and queue them to send
+ * with @ref ol_ceph_send. A caller fills the data in place.
+ *
+ * @param conn  Connection handle.
+ * @param len   Length of data.
+ *
+ * @return Pointer to the data, or @c NULL if the pool or the iovec array
+ *         is exhausted.
+ */
+void *ol_ceph_tx_reserve(ol_ceph_connection *conn, size_t len);
+
+/**
+ * Check whether @p n_iov iovecs and @p len bytes of the transmit pool
+ * can be queued.
+ *
+ * @param conn  Connection handle.
+ * @param n_iov Number of iovecs.
+ * @param len   Number of bytes allocated in the pool.
+ *
+ * @return @c true if there is enough room.
+ */
+static inline bool
+ol_ceph_tx_room(const ol_ceph_connection *conn, int n_iov, size_t len)
+{
+    return conn->tx_iovcnt + n_iov <= OL_CEPH_TX_IOV_MAX &&
+           conn->offs + len <= conn->buflen;
+}
 
 /**
  * Push user data to the connection buffer to send it later
@@ -149,7 +256,20 @@ ssize_t ol_ceph_recv_zc(ol_ceph_connection *conn, size_t len_to_read,
 int ol_ceph_append(ol_ceph_connection *conn, const void *data, size_t len);
 
 /**
- * Send all data from the internal connection buffer.
+ * Queue user data to send them with @ref ol_ceph_send without copying.
+ *
+ * @param conn  Connection handle.
+ * @param data  User data, it must not be changed until the data are sent.
+ * @param len   Length of data.
+ *
+ * @return zero on success, or a negative error value in case of failure.
+ */
+int ol_ceph_append_ref(ol_ceph_connection *conn, const void *data,
+                       size_t len);
+
+/**
+ * Send all queued data with as few sendmsg() calls as possible, and
+ * release the transmit pool.
  *
  * @param conn  Connection handle.
  *
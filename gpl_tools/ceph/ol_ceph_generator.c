@@ -4,29 +4,95 @@
  * @author Sergey Nikitin <Sergey.Nikitin@oktetlabs.ru>
  */
 
+/* for pthread_attr_setaffinity_np() */
+#define _GNU_SOURCE
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <errno.h>
 #include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
 #include <netinet/in.h>
 
 #include "ol_poll.h"
+#include "ol_time.h"
+#include "ol_hist.h"
 #include "ol_ceph.h"
 #include "ol_ceph_generator.h"
 #include "ol_ceph_protocol.h"
 #include "ol_helpers.h"
 #include "ol_pattern.h"
 
+struct ol_ceph_generator_worker;
+struct ol_ceph_generator_data;
+
+/**
+ * Generator connection data.
+ */
+typedef struct ol_ceph_generator_conn
+{
+    int         idx;            /**< Connection index. */
+    struct ol_ceph_generator_worker *worker; /**< Thread serving the
+                                                  connection. */
+    ol_ceph_proto_handle ceph_gn_hdl; /**< Ceph protocol handle. */
+    void       *buf;            /**< Transmit buffer. */
+    size_t      bufsize;        /**< Size of the transmit buffer. */
+    size_t      data_sent;      /**< Total amount of Ceph payload sent
+                                     data. */
+    uint64_t    n_msgs;         /**< Number of sent messages. */
+    unsigned int n_built;       /**< Number of messages generated in the
+                                     current batch. */
+    uint64_t   *due;            /**< When messages of the current batch are
+                                     due, nanoseconds. */
+    uint64_t    next_send;      /**< When the next message is due with
+                                     limited rate, nanoseconds. */
+    ol_hist     lat_hist;       /**< Message latency histogram. */
+    bool        done;           /**< The connection stopped sending. */
+} ol_ceph_generator_conn;
+
+/**
+ * Generator thread data.
+ */
+typedef struct ol_ceph_generator_worker
+{
+    struct ol_ceph_generator_data *gen; /**< Generator data. */
+    int             idx;            /**< Thread index. */
+    pthread_t       thread_id;      /**< Thread ID. */
+    bool            running;        /**< The thread is started and not
+                                         joined yet. */
+    int             cpu;            /**< CPU to pin the thread to, or
+                                         @c -1. */
+    int             n_active;       /**< Number of connections which are
+                                         still sending. */
+    unsigned short  rand_state[3];  /**< State of random intervals
+                                         generator. */
+    int             rc;             /**< Thread status code. */
+} ol_ceph_generator_worker;
+
 /**
  * Generator internal data structure.
  */
 typedef struct ol_ceph_generator_data
 {
-    int time_to_run;    /**< How much time the generator has to run, seconds */
-    time_t start_time;  /**< Generator execution start time */
-    size_t data_sent;   /**< Total amount of Ceph payload sent data. */
-    ol_ceph_proto_handle ceph_gn_hdl; /**< Ceph protocol handle. */
+    const ol_ceph_generator_opts *opts; /**< Generator options. */
+    uint64_t    start_time;     /**< Generator execution start time, ns. */
+    uint64_t    stop_time;      /**< When the generator has to stop, ns. */
+    bool        stop;           /**< Set by a failed thread to stop other
+                                     threads. */
+    ol_ceph_generator_conn   *conns;     /**< Connections. */
+    int                       n_conns;   /**< Number of connections. */
+    ol_ceph_generator_worker *workers;   /**< Threads. */
+    int                       n_workers; /**< Number of threads. */
+    int        *cpus;           /**< CPUs to pin threads to. */
+    int         n_cpus;         /**< Number of CPUs in @p cpus. */
 } ol_ceph_generator_data;
 
 /**
@@ -35,92 +101,546 @@ typedef struct ol_ceph_generator_data
  * @return @c true if application needs to stop, @c false otherwise.
  */
 static inline bool
-ol_ceph_generator_must_stop(ol_ceph_generator_data *state)
+ol_ceph_generator_must_stop(ol_ceph_generator_data *gen)
 {
-    return time(NULL) >= state->start_time + state->time_to_run ? true : false;
+    return __atomic_load_n(&gen->stop, __ATOMIC_RELAXED) ||
+           ol_time_get_nsec() >= gen->stop_time;
 }
 
 /**
  * Callback that is called by ceph generator to construct ceph payload.
- * See @ref ol_ceph_opread_wr_callback documentation.
+ * See @ref ol_ceph_opread_wr_callback documentation. Every message has
+ * a single payload.
  */
 static void
 ol_ceph_generator_callback(void *data, size_t len, void *user_data)
 {
-    ol_ceph_generator_data *state = user_data;
+    ol_ceph_generator_conn *conn = user_data;
+
+    ol_pattern_fill_buff_with_sequence(data, len, conn->data_sent);
+    conn->data_sent += len;
+    conn->n_built++;
+}
+
+/** Stop sending via a connection. */
+static void
+ol_ceph_generator_conn_done(ol_ceph_generator_conn *conn)
+{
+    if (conn->worker->gen->opts->rate == 0)
+        ol_poll_delfd(conn->ceph_gn_hdl.conn.socket);
+
+    conn->done = true;
+    conn->worker->n_active--;
+}
+
+/**
+ * Send @p n_msgs messages which are due at times stored in @p conn->due,
+ * and account their latency.
+ *
+ * @return Status code according to the types declared in ol_poll.h.
+ */
+static int
+ol_ceph_generator_send(ol_ceph_generator_conn *conn, unsigned int n_msgs)
+{
+    ol_ceph_proto_rc    rc;
+    uint64_t            now;
+    unsigned int        i;
+
+    conn->n_built = 0;
+    rc = ol_ceph_generator_state_proc(&conn->ceph_gn_hdl, n_msgs);
+    if (rc != OL_CEPH_OK)
+        return proto_rc2poll_rc(rc);
 
-    ol_pattern_fill_buff_with_sequence(data, len, state->data_sent);
-    state->data_sent += len;
+    now = ol_time_get_nsec();
+    for (i = 0; i < conn->n_built; ++i)
+    {
+        ol_hist_record(&conn->lat_hist,
+                       now > conn->due[i] ? now - conn->due[i] : 0);
+    }
+    conn->n_msgs += conn->n_built;
+
+    return OL_POLL_RC_OK;
 }
 
 /**
- * Callback for @c POLLOUT event.
+ * Callback for @c POLLOUT event, it is used if the rate is not limited.
  *
  * @param s             Socket on which @c POLLOUT event occured.
- * @param user_data     Pointer to @ref ol_ceph_state handle.
+ * @param user_data     Pointer to @ref ol_ceph_generator_conn.
  *
  * @return Status code according to the types declared in ol_poll.h.
  */
 static int
 ol_ceph_generator_pollout_func(int s, void *user_data)
 {
-    ol_ceph_generator_data *state = user_data;
+    ol_ceph_generator_conn *conn = user_data;
+    ol_ceph_generator_data *gen = conn->worker->gen;
+    uint64_t                now;
+    unsigned int            i;
+
+    if (ol_ceph_generator_must_stop(gen))
+    {
+        ol_ceph_generator_conn_done(conn);
+        return conn->worker->n_active == 0 ? OL_POLL_RC_STOP : OL_POLL_RC_OK;
+    }
+
+    now = ol_time_get_nsec();
+    for (i = 0; i < gen->opts->batch; ++i)
+        conn->due[i] = now;
+
+    return ol_ceph_generator_send(conn, gen->opts->batch);
+}
+
+/** Compute when the next message is due with limited rate. */
+static void
+ol_ceph_generator_schedule_next(ol_ceph_generator_conn *conn)
+{
+    const ol_ceph_generator_opts   *opts = conn->worker->gen->opts;
+    double                          interval = 1000000000.0 / opts->rate;
+
+    if (opts->poisson)
+        interval *= -log(1.0 - erand48(conn->worker->rand_state));
+
+    conn->next_send += (uint64_t)interval;
+}
+
+/**
+ * Send messages which are due via all connections of a thread.
+ *
+ * @param worker        The thread.
+ * @param wait_nsec     Where to save time until the next message is due.
+ *
+ * @return Status code according to the types declared in ol_poll.h.
+ */
+static int
+ol_ceph_generator_send_due(ol_ceph_generator_worker *worker,
+                           int64_t *wait_nsec)
+{
+    ol_ceph_generator_data *gen = worker->gen;
+    ol_ceph_generator_conn *conn;
+    unsigned int            n;
+    uint64_t                now;
+    int64_t                 left;
+    int                     rc;
+    int                     i;
+
+    *wait_nsec = -1;
+
+    for (i = worker->idx; i < gen->n_conns; i += gen->n_workers)
+    {
+        conn = &gen->conns[i];
+        if (conn->done)
+            continue;
+
+        if (ol_ceph_generator_must_stop(gen))
+        {
+            ol_ceph_generator_conn_done(conn);
+            continue;
+        }
+
+        now = ol_time_get_nsec();
+        for (n = 0; n < gen->opts->batch && conn->next_send <= now; ++n)
+        {
+            conn->due[n] = conn->next_send;
+            ol_ceph_generator_schedule_next(conn);
+        }
+
+        if (n > 0)
+        {
+            rc = ol_ceph_generator_send(conn, n);
+            if (rc != OL_POLL_RC_OK)
+                return rc;
+        }
+
+        left = (int64_t)(conn->next_send - ol_time_get_nsec());
+        if (*wait_nsec < 0 || left < *wait_nsec)
+            *wait_nsec = left < 0 ? 0 : left;
+    }
+
+    return OL_POLL_RC_OK;
+}
+
+static void *
+ol_ceph_generator_worker_th(void *arg)
+{
+    ol_ceph_generator_worker   *worker = arg;
+    ol_ceph_generator_data     *gen = worker->gen;
+    ol_ceph_generator_conn     *conn;
+    bool                        limited = gen->opts->rate != 0;
+    int64_t                     wait_nsec;
+    int                         rc = OL_POLL_RC_OK;
+    int                         i;
+
+    for (i = worker->idx; i < gen->n_conns && rc == OL_POLL_RC_OK;
+         i += gen->n_workers)
+    {
+        conn = &gen->conns[i];
+
+        /* Send banner and connect-reply. */
+        while (rc == OL_POLL_RC_OK &&
+               conn->ceph_gn_hdl.state != OL_CEPH_STATE_SEND_MSG)
+        {
+            rc = proto_rc2poll_rc(ol_ceph_generator_state_proc(
+                                      &conn->ceph_gn_hdl, 0));
+        }
+
+        conn->next_send = ol_time_get_nsec();
+        if (!limited &&
+            ol_poll_addfd_data(conn->ceph_gn_hdl.conn.socket, NULL,
+                               ol_ceph_generator_pollout_func, conn) != 0)
+        {
+            rc = OL_POLL_RC_FAIL;
+        }
+        worker->n_active++;
+    }
+
+    while (rc == OL_POLL_RC_OK && worker->n_active > 0)
+    {
+        if (limited)
+        {
+            rc = ol_ceph_generator_send_due(worker, &wait_nsec);
+            if (rc == OL_POLL_RC_OK && wait_nsec > 0)
+            {
+                struct timespec ts = {
+                    .tv_sec = wait_nsec / 1000000000,
+                    .tv_nsec = wait_nsec % 1000000000,
+                };
+
+                nanosleep(&ts, NULL);
+            }
+        }
+        else
+        {
+            rc = ol_poll_process(NULL);
+        }
+    }
+
+    if (rc == OL_POLL_RC_FAIL)
+        __atomic_store_n(&gen->stop, true, __ATOMIC_RELAXED);
+
+    ol_poll_fini();
+    worker->rc = rc;
+
+    return NULL;
+}
+
+static int
+ol_ceph_generator_start_workers(ol_ceph_generator_data *gen)
+{
+    ol_ceph_generator_worker   *worker;
+    pthread_attr_t              tattr;
+    cpu_set_t                   cpuset;
+    int                         rc = 0;
+    int                         i;
+
+    rc = pthread_attr_init(&tattr);
+    if (rc != 0)
+    {
+        printf("generator: pthread_attr_init error %s\n", strerror(rc));
+        return -1;
+    }
+
+    for (i = 0; i < gen->n_workers; ++i)
+    {
+        worker = &gen->workers[i];
+
+        if (worker->cpu >= 0)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(worker->cpu, &cpuset);
+            rc = pthread_attr_setaffinity_np(&tattr, sizeof(cpuset),
+                                             &cpuset);
+            if (rc != 0)
+            {
+                printf("generator: pthread_attr_setaffinity_np error %s\n",
+                       strerror(rc));
+                break;
+            }
+        }
+
+        rc = pthread_create(&worker->thread_id, &tattr,
+                            ol_ceph_generator_worker_th, worker);
+        if (rc != 0)
+        {
+            printf("generator: pthread_create error %s\n", strerror(rc));
+            break;
+        }
+        worker->running = true;
+    }
+
+    pthread_attr_destroy(&tattr);
+
+    return rc == 0 ? 0 : -1;
+}
+
+/** Wait for termination of all threads. */
+static int
+ol_ceph_generator_wait_workers(ol_ceph_generator_data *gen)
+{
+    ol_ceph_generator_worker   *worker;
+    int                         rc = 0;
+    int                         i;
+
+    for (i = 0; i < gen->n_workers; ++i)
+    {
+        worker = &gen->workers[i];
+        if (!worker->running)
+            continue;
+
+        pthread_join(worker->thread_id, NULL);
+        worker->running = false;
+
+        if (worker->rc == OL_POLL_RC_FAIL)
+        {
+            printf("generator: thread %d error\n", i);
+            rc = -1;
+        }
+    }
+
+    return rc;
+}
+
+/** Print throughput and message latency of every connection and in total. */
+static void
+ol_ceph_generator_report(ol_ceph_generator_data *gen, uint64_t elapsed)
+{
+    ol_ceph_generator_conn *conn;
+    ol_hist                 total;
+    size_t                  total_sent = 0;
+    uint64_t                total_msgs = 0;
+    double                  sec = elapsed / 1000000000.0;
+    char                    prefix[64];
+    int                     i;
+
+    if (sec <= 0)
+        sec = 1e-9;
+
+    if (ol_hist_init(&total, OL_HIST_PRECISION_DEF) != 0)
+        printf("generator: latency histogram init failed\n");
+
+    for (i = 0; i < gen->n_conns; ++i)
+    {
+        conn = &gen->conns[i];
+        total_sent += conn->data_sent;
+        total_msgs += conn->n_msgs;
+        if (total.counts != NULL)
+            ol_hist_merge(&total, &conn->lat_hist);
+
+        if (gen->n_conns == 1)
+            continue;
+
+        printf("generator: conn %d: sent %lu bytes, %lu messages, "
+               "%.2f MB/s, %.0f msg/s\n", i, conn->data_sent, conn->n_msgs,
+               conn->data_sent / sec / 1000000, conn->n_msgs / sec);
+        snprintf(prefix, sizeof(prefix), "%s%d",
+                 OL_CEPH_GENERATOR_LATENCY_CONN_PREFIX, i);
+        ol_hist_print_summary(&conn->lat_hist, prefix);
+    }
+
+    printf("generator: total ceph payload sent - %lu bytes\n", total_sent);
+    printf("generator: total messages sent - %lu\n", total_msgs);
+    printf("generator: throughput - %.2f MB/s, %.0f msg/s\n",
+           total_sent / sec / 1000000, total_msgs / sec);
+    if (total.counts != NULL)
+    {
+        ol_hist_print_summary(&total,
+                              OL_CEPH_GENERATOR_LATENCY_SUMMARY_PREFIX);
+        ol_hist_free(&total);
+    }
+    printf("generator: total time elapsed - %ld(s)\n",
+           (long)(elapsed / 1000000000));
+}
+
+static void
+ol_ceph_generator_free(ol_ceph_generator_data *gen)
+{
+    ol_ceph_generator_conn *conn;
+    int                     i;
 
-    if (ol_ceph_generator_must_stop(state))
-        return OL_POLL_RC_STOP;
+    if (gen->conns != NULL)
+    {
+        for (i = 0; i < gen->n_conns; ++i)
+        {
+            conn = &gen->conns[i];
+            if (conn->ceph_gn_hdl.conn.socket >= 0)
+                close(conn->ceph_gn_hdl.conn.socket);
+            free(conn->buf);
+            free(conn->due);
+            ol_hist_free(&conn->lat_hist);
+        }
+        free(gen->conns);
+    }
 
-    return proto_rc2poll_rc(ol_ceph_generator_state_proc(&state->ceph_gn_hdl));
+    free(gen->workers);
+    free(gen->cpus);
+    free(gen);
+}
+
+static int
+ol_ceph_generator_init(ol_ceph_generator_data *gen)
+{
+    const ol_ceph_generator_opts   *opts = gen->opts;
+    ol_ceph_generator_conn         *conn;
+    ol_ceph_generator_worker       *worker;
+    int                             i;
+
+    if (opts->cpus != NULL &&
+        ol_parse_cpu_list(opts->cpus, &gen->cpus, &gen->n_cpus) != 0)
+    {
+        return -1;
+    }
+
+    gen->n_conns = opts->connections;
+    gen->conns = calloc(gen->n_conns, sizeof(*gen->conns));
+    if (gen->conns == NULL)
+    {
+        printf("generator: calloc: %s\n", strerror(errno));
+        return -1;
+    }
+
+    gen->n_workers = opts->threads;
+    if (gen->n_workers > gen->n_conns)
+        gen->n_workers = gen->n_conns;
+    gen->workers = calloc(gen->n_workers, sizeof(*gen->workers));
+    if (gen->workers == NULL)
+    {
+        printf("generator: calloc: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < gen->n_workers; ++i)
+    {
+        worker = &gen->workers[i];
+        worker->gen = gen;
+        worker->idx = i;
+        worker->cpu = gen->cpus != NULL ? gen->cpus[i % gen->n_cpus] : -1;
+        worker->rand_state[0] = i;
+        worker->rand_state[1] = getpid();
+        worker->rand_state[2] = time(NULL);
+    }
+
+    for (i = 0; i < gen->n_conns; ++i)
+    {
+        conn = &gen->conns[i];
+        conn->idx = i;
+        conn->worker = &gen->workers[i % gen->n_workers];
+        conn->ceph_gn_hdl.conn.socket = -1;
+        conn->bufsize = ol_ceph_proto_msg_buf_len(opts->msg_size_max,
+                                                  opts->batch);
+        conn->buf = malloc(conn->bufsize);
+        conn->due = calloc(opts->batch, sizeof(*conn->due));
+        if (conn->buf == NULL || conn->due == NULL)
+        {
+            printf("generator: malloc: %s\n", strerror(errno));
+            return -1;
+        }
+
+        if (ol_hist_init(&conn->lat_hist, OL_HIST_PRECISION_DEF) != 0)
+        {
+            printf("generator: latency histogram init failed\n");
+            return -1;
+        }
+    }
+
+    return 0;
 }
 
 int
-ol_ceph_generator(ol_ceph_state *state, const char *host, int port,
-                  int time_to_run)
+ol_ceph_generator(const ol_ceph_generator_opts *opts)
 {
-    int s = -1;
-    int rc = 0;
-    ol_ceph_generator_data generator_state;
-    ol_connection_type conn_type = host == NULL ? OL_CONNECT_PASSIVE
-                                                : OL_CONNECT_ACTIVE;
+    int                     rc = 0;
+    int                    *socks = NULL;
+    ol_ceph_generator_data *gen;
+    ol_ceph_generator_conn *conn;
+    ol_connection_type      conn_type = opts->host == NULL ?
+                                        OL_CONNECT_PASSIVE :
+                                        OL_CONNECT_ACTIVE;
+    int                     i;
 
     printf("Generator is running\n");
-    assert(state != NULL);
+    assert(opts != NULL);
 
-    generator_state.data_sent = 0;
-    generator_state.time_to_run = time_to_run;
-
-    if (generator_state.time_to_run == OL_CEPH_GENERATOR_LIM_UNSPEC)
+    if (opts->time_to_run == OL_CEPH_GENERATOR_LIM_UNSPEC)
     {
         fprintf(stderr, "generator: incompatible parameters: --time-to-run "
                 "isn't specified\n");
         return -1;
     }
 
-    s = ol_create_and_connect_socket(conn_type, SOCK_STREAM, port,
-                                     host, "generator");
-    if (s < 0)
+    if (opts->connections <= 0 || opts->threads <= 0 || opts->batch == 0 ||
+        opts->msg_size == 0 || opts->msg_size_max < opts->msg_size)
+    {
+        fprintf(stderr, "generator: invalid number of connections, threads, "
+                "batch size or message size\n");
+        return -1;
+    }
+
+    gen = calloc(1, sizeof(*gen));
+    if (gen == NULL)
+    {
+        printf("generator: calloc: %s\n", strerror(errno));
+        return -1;
+    }
+    gen->opts = opts;
+
+    if (ol_ceph_generator_init(gen) != 0)
+    {
+        ol_ceph_generator_free(gen);
+        return -1;
+    }
+
+    socks = calloc(gen->n_conns, sizeof(*socks));
+    if (socks == NULL ||
+        ol_create_and_connect_sockets(conn_type, SOCK_STREAM, opts->port,
+                                      opts->host, socks, gen->n_conns,
+                                      "generator") != 0)
     {
         fprintf(stderr, "generator: connection establishment failed\n");
+        free(socks);
+        ol_ceph_generator_free(gen);
         return -1;
     }
 
-    ol_ceph_proto_generator_init(&generator_state.ceph_gn_hdl, s, state->buf,
-                                 state->bufsize, ol_ceph_generator_callback,
-                                 &generator_state);
+    for (i = 0; i < gen->n_conns; ++i)
+    {
+        conn = &gen->conns[i];
+        if (ol_ceph_proto_generator_init(&conn->ceph_gn_hdl, socks[i],
+                                         conn->buf, conn->bufsize,
+                                         ol_ceph_generator_callback,
+                                         conn) != 0 ||
+            ol_ceph_proto_set_data_len(&conn->ceph_gn_hdl, opts->msg_size,
+                                       opts->msg_size_max) != 0)
+        {
+            fprintf(stderr, "generator: protocol initialization failed\n");
+            rc = -1;
+        }
+        conn->ceph_gn_hdl.conn.socket = socks[i];
+    }
+    free(socks);
+
+    if (rc != 0)
+    {
+        ol_ceph_generator_free(gen);
+        return -1;
+    }
 
-    ol_poll_addfd(s, NULL, ol_ceph_generator_pollout_func);
+    ol_time_init();
+    gen->start_time = ol_time_get_nsec();
+    gen->stop_time = gen->start_time +
+                     (uint64_t)opts->time_to_run * 1000000000;
 
-    generator_state.start_time = time(NULL);
+    if (ol_ceph_generator_start_workers(gen) != 0)
+    {
+        __atomic_store_n(&gen->stop, true, __ATOMIC_RELAXED);
+        rc = -1;
+    }
 
-    do {
-        rc = ol_poll_process(&generator_state);
-    } while (rc == OL_POLL_RC_OK);
+    if (ol_ceph_generator_wait_workers(gen) != 0)
+        rc = -1;
 
-    printf("generator: total ceph payload sent - %lu bytes\n",
-           generator_state.data_sent);
-    printf("generator: total time elapsed - %ld(s)\n",
-           time(NULL) - generator_state.start_time);
+    ol_ceph_generator_report(gen, ol_time_get_nsec() - gen->start_time);
 
-    close(s);
+    ol_ceph_generator_free(gen);
 
-    return rc == OL_POLL_RC_FAIL ? -1 : 0;
+    return rc;
 }
@@ -7,26 +7,69 @@
 #ifndef __OL_CEPH_GENERATOR_H__
 #define __OL_CEPH_GENERATOR_H__
 
-#include "ol_ceph.h"
+#include <stdbool.h>
+#include <stddef.h>
 
 #define OL_CEPH_GENERATOR_LIM_UNSPEC 0
 
+/** Default number of messages the generator sends with one sendmsg(). */
+#define OL_CEPH_GENERATOR_BATCH_DEF 32
+
+/** Prefix of message latency histogram summary line. */
+#define OL_CEPH_GENERATOR_LATENCY_SUMMARY_PREFIX "msg-latency-summary"
+
+/** Prefix of per-connection message latency histogram summary lines. */
+#define OL_CEPH_GENERATOR_LATENCY_CONN_PREFIX "msg-latency-conn"
+
+/**
+ * Generator options.
+ *
+ * The generator opens @a connections connections served by @a threads
+ * threads, connection @c i is served by thread @c i % @a threads. Every
+ * connection sends @c OSD_OPREPLY messages with payload length uniformly
+ * distributed from @a msg_size to @a msg_size_max.
+ *
+ * If @a rate is zero, messages are sent in batches of @a batch messages
+ * as fast as possible. Otherwise every connection sends @a rate messages
+ * per second on schedule, and messages which are due are sent together,
+ * but not more than @a batch at once.
+ *
+ * Message latency is the time from the moment a message is due (or
+ * generated, if @a rate is zero) to the end of sendmsg() call which sends
+ * it, in nanoseconds.
+ */
+typedef struct ol_ceph_generator_opts
+{
+    const char     *host;           /**< Address to connect, or @c NULL for
+                                         passive connection opening. */
+    int             port;           /**< Port in host byte order. */
+    int             time_to_run;    /**< Time to run, in seconds. */
+    unsigned int    batch;          /**< Maximum number of messages sent
+                                         with one sendmsg() call. */
+    int             connections;    /**< Number of connections. */
+    int             threads;        /**< Number of threads. */
+    const char     *cpus;           /**< CPUs to pin threads to, e.g.
+                                         "0,2-3", or @c NULL. */
+    unsigned int    rate;           /**< Messages per second per connection,
+                                         zero means no limit. */
+    bool            poisson;        /**< If @c true, intervals between
+                                         messages are exponentially
+                                         distributed, otherwise they are
+                                         fixed. */
+    size_t          msg_size;       /**< Minimum payload length. */
+    size_t          msg_size_max;   /**< Maximum payload length. */
+} ol_ceph_generator_opts;
+
 /**
  * Main generator application function.
  *
- * @param state         Application state handle.
- * @param host          String containing an address to connect or @c NULL
- *                      for passive connection opening.
- * @param port          Port number in host byte order, to bind in passive
- *                      case, or connect in active.
- * @param time_to_run   Time to run, in seconds.
+ * @param opts          Generator options.
  *
  * @return Status code
  * @retval 0    No errors.
  * @retval -1   An error occured.
  */
 int
-ol_ceph_generator(ol_ceph_state *state, const char *host, int port,
-                  int time_to_run);
+ol_ceph_generator(const ol_ceph_generator_opts *opts);
 
 #endif /* __OL_CEPH_GENERATOR_H__ */
@@ -5,9 +5,11 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 #include "ol_ceph_protocol_types.h"
 #include "ol_ceph_protocol.h"
@@ -18,6 +20,12 @@
 /* Length of the banner excluding terminating null */
 #define OL_CEPH_BANNER_LEN (sizeof(CEPH_BANNER) - 1)
 
+/* Number of operations in a generated message */
+#define OL_CEPH_MSG_N_OPS 1
+
+/* Footer of generated messages */
+static const ol_ceph_msg_footer ol_ceph_footer;
+
 /**
  * Call @ref ol_ceph_recv with the corresponding parameters and exit if
  * an error occurs.
@@ -113,7 +121,7 @@ ol_ceph_send_banner(ol_ceph_proto_handle *h)
 static ol_ceph_proto_rc
 ol_ceph_send_conn_reply(ol_ceph_proto_handle *h, uint8_t tag)
 {
-    ol_ceph_msg_connect_reply *msg = (ol_ceph_msg_connect_reply *)h->conn.buf;
+    ol_ceph_msg_connect_reply *msg;
 
     if (!is_connect_reply_tag(tag))
     {
@@ -121,7 +129,11 @@ ol_ceph_send_conn_reply(ol_ceph_proto_handle *h, uint8_t tag)
         return OL_CEPH_SEND_ERROR;
     }
 
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(*msg)));
+    msg = ol_ceph_tx_reserve(&h->conn, sizeof(*msg));
+    if (msg == NULL)
+        return OL_CEPH_SEND_ERROR;
+    memset(msg, 0, sizeof(*msg));
+
     if (tag == CEPH_MSGR_TAG_SEQ)
         OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(uint64_t)));
 
@@ -159,9 +171,24 @@ ol_ceph_front_len(int n_ops)
 }
 
 /**
- * Generate @c OSD_OPREPLY message with @p n_ops data messages of @c OSD_OP_READ
- * type, and write it to connection buffer. A user callback passed to
- * @ref ol_ceph_proto_generator_init is called on every data message generating.
+ * Write @p len bytes of @p data, or zeros if @p data is @c NULL, to @p *pos
+ * and move @p *pos forward.
+ */
+static void
+ol_ceph_put(uint8_t **pos, const void *data, size_t len)
+{
+    if (data == NULL)
+        memset(*pos, 0, len);
+    else
+        memcpy(*pos, data, len);
+
+    *pos += len;
+}
+
+/**
+ * Build the constant part of @c OSD_OPREPLY messages with @p n_ops data
+ * messages of @c OSD_OP_READ type: tag, header and front. It is sent by
+ * reference with every generated message.
  *
  * @param h         Protocol handle.
  * @param n_ops     Number of operations to encode.
@@ -169,14 +196,25 @@ ol_ceph_front_len(int n_ops)
  * @return ceph protocol status code.
  */
 static ol_ceph_proto_rc
-ol_ceph_generate_msg(ol_ceph_proto_handle *h, int n_ops)
+ol_ceph_build_msg_head(ol_ceph_proto_handle *h, int n_ops)
 {
+    uint8_t tag = CEPH_MSGR_TAG_MSG;
     ol_ceph_msg_header msg_hdr;
-    ol_ceph_msg_footer footer = {0};
     int i;
     ol_ceph_string oid;
     ol_ceph_request_redirect_t req_redirect = {0};
+    uint8_t *pos = h->msg_head;
+
+    if (sizeof(tag) + sizeof(msg_hdr) + ol_ceph_front_len(n_ops) >
+        sizeof(h->msg_head))
+    {
+        fprintf(stderr, "Message with %d operations is too long\n", n_ops);
+        return OL_CEPH_HANDLE_ERROR;
+    }
 
+    ol_ceph_put(&pos, &tag, sizeof(tag));
+
+    memset(&msg_hdr, 0, sizeof(msg_hdr));
     msg_hdr.src.type = CEPH_ENTITY_TYPE_OSD;
     msg_hdr.src.num = 0;
     msg_hdr.version = 8;
@@ -184,84 +222,175 @@ ol_ceph_generate_msg(ol_ceph_proto_handle *h, int n_ops)
     msg_hdr.type = CEPH_MSG_OSD_OPREPLY;
     msg_hdr.front_len = ol_ceph_front_len(n_ops);
     msg_hdr.middle_len = 0;
-    msg_hdr.data_len = OL_CEPH_MAX_DATA_LEN;
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &msg_hdr, sizeof(msg_hdr)));
+    msg_hdr.data_len = h->data_len_min * n_ops;
+    ol_ceph_put(&pos, &msg_hdr, sizeof(msg_hdr));
 
     /* FRONT */
     /* oid */
     oid.len = sizeof(oid.str);
     memset(oid.str, 'a', oid.len);
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &oid, sizeof(oid)));
+    ol_ceph_put(&pos, &oid, sizeof(oid));
     /* pgid */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(ol_ceph_pg_t)));
+    ol_ceph_put(&pos, NULL, sizeof(ol_ceph_pg_t));
     /* flags */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(uint64_t)));
+    ol_ceph_put(&pos, NULL, sizeof(uint64_t));
     /* result */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(uint32_t)));
+    ol_ceph_put(&pos, NULL, sizeof(uint32_t));
     /* bad_replay_version */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL,
-                                         sizeof(ol_ceph_eversion_t)));
+    ol_ceph_put(&pos, NULL, sizeof(ol_ceph_eversion_t));
     /* osdmap_epoch */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(uint32_t)));
+    ol_ceph_put(&pos, NULL, sizeof(uint32_t));
     /* num_ops */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &n_ops, sizeof(n_ops)));
+    ol_ceph_put(&pos, &n_ops, sizeof(n_ops));
     /* ops[num_ops] */
+    h->msg_op_offs = pos - h->msg_head;
     for (i = 0; i < n_ops; i++)
     {
         ol_ceph_osd_op op_hdr;
 
+        memset(&op_hdr, 0, sizeof(op_hdr));
         op_hdr.op = CEPH_OSD_OP_READ;
         op_hdr.flags = 0;
         op_hdr.extent.offset = 0;
-        op_hdr.extent.length = msg_hdr.data_len;
+        op_hdr.extent.length = h->data_len_min;
         op_hdr.extent.truncate_seq = 0;
         op_hdr.extent.truncate_size = 0;
-        op_hdr.payload_len = msg_hdr.data_len;
-        OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &op_hdr,
-                                             sizeof(op_hdr)));
+        op_hdr.payload_len = h->data_len_min;
+        ol_ceph_put(&pos, &op_hdr, sizeof(op_hdr));
     }
     /* retry_attempt */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(uint32_t)));
+    ol_ceph_put(&pos, NULL, sizeof(uint32_t));
     /* rval[num_ops] */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL,
-                                         sizeof(uint32_t) * n_ops));
+    ol_ceph_put(&pos, NULL, sizeof(uint32_t) * n_ops);
     /* replay_version */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL,
-                                         sizeof(ol_ceph_eversion_t)));
+    ol_ceph_put(&pos, NULL, sizeof(ol_ceph_eversion_t));
     /* user_version */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, sizeof(uint64_t)));
+    ol_ceph_put(&pos, NULL, sizeof(uint64_t));
     /* request_redirect */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &req_redirect,
-                                         sizeof(req_redirect)));
+    ol_ceph_put(&pos, &req_redirect, sizeof(req_redirect));
+
+    h->msg_head_len = pos - h->msg_head;
+    return OL_CEPH_OK;
+}
+
+/**
+ * Queue the head of a message with @p data_len bytes of payload per
+ * operation. The head built by @ref ol_ceph_build_msg_head is queued by
+ * reference if the length is fixed, otherwise it is copied to the transmit
+ * pool and the length fields are updated.
+ *
+ * @param h         Protocol handle.
+ * @param data_len  Payload length of an operation.
+ *
+ * @return ceph protocol status code.
+ */
+static ol_ceph_proto_rc
+ol_ceph_queue_msg_head(ol_ceph_proto_handle *h, size_t data_len)
+{
+    uint8_t *head;
+    ol_ceph_msg_header *msg_hdr;
+    ol_ceph_osd_op *op_hdr;
+    int i;
+
+    if (data_len == h->data_len_min)
+    {
+        OL_CEPH_CONN_CHECK_RC(ol_ceph_append_ref(&h->conn, h->msg_head,
+                                                 h->msg_head_len));
+        return OL_CEPH_OK;
+    }
+
+    head = ol_ceph_tx_reserve(&h->conn, h->msg_head_len);
+    if (head == NULL)
+        return OL_CEPH_SEND_ERROR;
+    memcpy(head, h->msg_head, h->msg_head_len);
+
+    /* The header follows the tag. */
+    msg_hdr = (ol_ceph_msg_header *)(head + sizeof(uint8_t));
+    msg_hdr->data_len = data_len * OL_CEPH_MSG_N_OPS;
+
+    op_hdr = (ol_ceph_osd_op *)(head + h->msg_op_offs);
+    for (i = 0; i < OL_CEPH_MSG_N_OPS; i++, op_hdr++)
+    {
+        op_hdr->extent.length = data_len;
+        op_hdr->payload_len = data_len;
+    }
+
+    return OL_CEPH_OK;
+}
+
+/**
+ * Queue @c OSD_OPREPLY message with @ref OL_CEPH_MSG_N_OPS data messages of
+ * @c OSD_OP_READ type to send. The message head and the footer are queued
+ * by reference where possible, the payload is generated in place in the
+ * transmit pool by a user callback passed to
+ * @ref ol_ceph_proto_generator_init.
+ *
+ * @param h         Protocol handle.
+ *
+ * @return ceph protocol status code.
+ */
+static ol_ceph_proto_rc
+ol_ceph_generate_msg(ol_ceph_proto_handle *h)
+{
+    size_t data_len = h->data_len_min;
+    int i;
+
+    if (h->data_len_max > h->data_len_min)
+    {
+        data_len += nrand48(h->rand_state) %
+                    (h->data_len_max - h->data_len_min + 1);
+    }
+
+    OL_CEPH_CHECK_RC(ol_ceph_queue_msg_head(h, data_len));
 
     /* DATA */
-    for (i = 0; i < n_ops; i++)
+    for (i = 0; i < OL_CEPH_MSG_N_OPS; i++)
     {
         if (h->user_data_cb.callback != NULL)
         {
-            char user_data[OL_CEPH_MAX_DATA_LEN];
             ol_ceph_opread_wr_callback callback = h->user_data_cb.callback;
+            void *user_data = ol_ceph_tx_reserve(&h->conn, data_len);
+
+            if (user_data == NULL)
+                return OL_CEPH_SEND_ERROR;
 
-            callback(user_data, sizeof(user_data), h->user_data_cb.user_data);
-            OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, user_data,
-                                                 sizeof(user_data)));
+            callback(user_data, data_len, h->user_data_cb.user_data);
         }
         else
         {
-            OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL,
-                                                 OL_CEPH_MAX_DATA_LEN));
+            OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, NULL, data_len));
         }
     }
 
     /* FOOTER */
-    OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &footer, sizeof(footer)));
+    OL_CEPH_CONN_CHECK_RC(ol_ceph_append_ref(&h->conn, &ol_ceph_footer,
+                                             sizeof(ol_ceph_footer)));
 
     return OL_CEPH_OK;
 }
 
+/**
+ * Check whether one more generated message may be queued.
+ *
+ * @param h         Protocol handle.
+ *
+ * @return @c true if there is enough room in the transmit pool.
+ */
+static bool
+ol_ceph_msg_room(const ol_ceph_proto_handle *h)
+{
+    size_t head_len = h->data_len_max > h->data_len_min ? h->msg_head_len : 0;
+
+    return ol_ceph_tx_room(&h->conn, 2 + OL_CEPH_MSG_N_OPS,
+                           head_len + OL_CEPH_MSG_N_OPS * h->data_len_max);
+}
+
 static ol_ceph_proto_rc
-ol_ceph_send_msg(ol_ceph_proto_handle *h, uint8_t tag)
+ol_ceph_queue_msg(ol_ceph_proto_handle *h, uint8_t tag)
 {
+    if (tag == CEPH_MSGR_TAG_MSG)
+        return ol_ceph_generate_msg(h);
+
     OL_CEPH_CONN_CHECK_RC(ol_ceph_append(&h->conn, &tag, sizeof(tag)));
 
     switch (tag)
@@ -277,14 +406,37 @@ ol_ceph_send_msg(ol_ceph_proto_handle *h, uint8_t tag)
                                                  sizeof(ol_ceph_timespec)));
             break;
 
-        case CEPH_MSGR_TAG_MSG:
-            OL_CEPH_CHECK_RC(ol_ceph_generate_msg(h, 1));
-            break;
-
         default:
             break;
     }
 
+    return OL_CEPH_OK;
+}
+
+/**
+ * Send a batch of messages with the same tag. The batch is limited by
+ * the transmit pool size.
+ *
+ * @param h         Protocol handle.
+ * @param tag       Messages tag.
+ * @param n_msgs    Number of messages to send.
+ *
+ * @return ceph protocol status code.
+ */
+static ol_ceph_proto_rc
+ol_ceph_send_msgs(ol_ceph_proto_handle *h, uint8_t tag, unsigned int n_msgs)
+{
+    unsigned int i;
+
+    for (i = 0; i < n_msgs && ol_ceph_msg_room(h); i++)
+        OL_CEPH_CHECK_RC(ol_ceph_queue_msg(h, tag));
+
+    if (i == 0)
+    {
+        fprintf(stderr, "Transmit buffer is too small for a message\n");
+        return OL_CEPH_SEND_ERROR;
+    }
+
     OL_CEPH_CONN_CHECK_RC(ol_ceph_send(&h->conn));
 
     return OL_CEPH_OK;
@@ -299,10 +451,10 @@ ol_ceph_handle_banner(ol_ceph_proto_handle *h)
         return OL_CEPH_HANDLE_ERROR;
     }
 
-    if (memcmp(h->conn.buf, CEPH_BANNER, OL_CEPH_BANNER_LEN) != 0)
+    if (memcmp(ol_ceph_rx_msg(&h->conn), CEPH_BANNER, OL_CEPH_BANNER_LEN) != 0)
     {
         fprintf(stderr, "Wrong banner\n");
-        ol_hex_diff_dump((uint8_t *)CEPH_BANNER, h->conn.buf,
+        ol_hex_diff_dump((uint8_t *)CEPH_BANNER, ol_ceph_rx_msg(&h->conn),
                          OL_CEPH_BANNER_LEN);
         return OL_CEPH_HANDLE_ERROR;
     }
@@ -324,7 +476,7 @@ ol_ceph_read_banner(ol_ceph_proto_handle *h)
 static ol_ceph_proto_rc
 ol_ceph_handle_connect_reply(ol_ceph_proto_handle *h)
 {
-    ol_ceph_msg_connect_reply *msg = h->conn.buf;
+    ol_ceph_msg_connect_reply *msg = ol_ceph_rx_msg(&h->conn);
 
     if (h->state != OL_CEPH_STATE_OPENED)
     {
@@ -352,10 +504,14 @@ ol_ceph_read_connect_reply(ol_ceph_proto_handle *h)
     printf("Reading connect-reply\n");
     OL_CEPH_RECV(&h->conn, sizeof(ol_ceph_msg_connect_reply), false);
 
-    msg = (ol_ceph_msg_connect_reply *)h->conn.buf;
+    msg = ol_ceph_rx_msg(&h->conn);
     printf("Reading auth %d bytes\n", msg->authorizer_len);
     if (msg->authorizer_len > 0)
+    {
         OL_CEPH_RECV(&h->conn, msg->authorizer_len, true);
+        /* The message may be moved in the buffer on reading. */
+        msg = ol_ceph_rx_msg(&h->conn);
+    }
 
     if (msg->tag == CEPH_MSGR_TAG_SEQ)
     {
@@ -366,18 +522,6 @@ ol_ceph_read_connect_reply(ol_ceph_proto_handle *h)
     return ol_ceph_handle_connect_reply(h);
 }
 
-static ol_ceph_proto_rc
-ol_ceph_handle_msg(ol_ceph_proto_handle *h)
-{
-    if (h->user_data_cb.callback != NULL)
-    {
-        ol_ceph_opread_rd_callback callback = h->user_data_cb.callback;
-        callback(h->conn.buf, h->conn.offs, h->user_data_cb.user_data);
-    }
-
-    return OL_CEPH_OK;
-}
-
 static ol_ceph_proto_rc
 ol_ceph_read_footer(ol_ceph_proto_handle *h)
 {
@@ -392,7 +536,7 @@ ol_ceph_read_msg(ol_ceph_proto_handle *h)
 
     OL_CEPH_RECV(&h->conn, sizeof(tag), false);
 
-    tag = *((uint8_t *)h->conn.buf);
+    tag = *((uint8_t *)ol_ceph_rx_msg(&h->conn));
 
     if (tag == CEPH_MSGR_TAG_MSG)
     {
@@ -403,7 +547,7 @@ ol_ceph_read_msg(ol_ceph_proto_handle *h)
 
         OL_CEPH_RECV(&h->conn, sizeof(ol_ceph_msg_header), false);
 
-        hdr = h->conn.buf;
+        hdr = ol_ceph_rx_msg(&h->conn);
         front_len = hdr->front_len;
         middle_len = hdr->middle_len;
         data_len = hdr->data_len;
@@ -416,14 +560,14 @@ ol_ceph_read_msg(ol_ceph_proto_handle *h)
 
         if (data_len > 0)
         {
-            int rc = ol_ceph_recv_zc(&h->conn, data_len, false);
+            ssize_t rc = ol_ceph_recv_data(&h->conn, data_len,
+                                           h->user_data_cb.callback,
+                                           h->user_data_cb.user_data);
 
             if (rc < 0)
                 return OL_CEPH_RECV_ERROR;
             else if (rc == 0)
                 return OL_CEPH_RECV_ZERO;
-
-            OL_CEPH_CHECK_RC(ol_ceph_handle_msg(h));
         }
 
         return ol_ceph_read_footer(h);
@@ -477,9 +621,41 @@ ol_ceph_proto_generator_init(ol_ceph_proto_handle *h, int s, void *buf,
     h->state = OL_CEPH_STATE_CLOSED;
     h->user_data_cb.callback = callback;
     h->user_data_cb.user_data = user_data;
+    h->rand_state[0] = s;
+    h->rand_state[1] = getpid();
+    h->rand_state[2] = time(NULL);
+
+    if (ol_ceph_proto_set_data_len(h, OL_CEPH_MAX_DATA_LEN,
+                                   OL_CEPH_MAX_DATA_LEN) != 0)
+    {
+        return -1;
+    }
+
     return ol_ceph_conn_init(&h->conn, s, NULL, buf, len, false);
 }
 
+int
+ol_ceph_proto_set_data_len(ol_ceph_proto_handle *h, size_t min, size_t max)
+{
+    if (min == 0 || max < min || max > UINT32_MAX / OL_CEPH_MSG_N_OPS)
+    {
+        fprintf(stderr, "Invalid payload length range %zu..%zu\n", min, max);
+        return -1;
+    }
+
+    h->data_len_min = min;
+    h->data_len_max = max;
+
+    return ol_ceph_build_msg_head(h, OL_CEPH_MSG_N_OPS) == OL_CEPH_OK ? 0 : -1;
+}
+
+size_t
+ol_ceph_proto_msg_buf_len(size_t data_len_max, unsigned int n_msgs)
+{
+    return (OL_CEPH_MAX_MSG_HEAD_LEN + OL_CEPH_MSG_N_OPS * data_len_max) *
+           n_msgs;
+}
+
 ol_ceph_proto_rc
 ol_ceph_recv_state_proc(ol_ceph_proto_handle *h)
 {
@@ -508,7 +684,7 @@ ol_ceph_recv_state_proc(ol_ceph_proto_handle *h)
 }
 
 ol_ceph_proto_rc
-ol_ceph_generator_state_proc(ol_ceph_proto_handle *h)
+ol_ceph_generator_state_proc(ol_ceph_proto_handle *h, unsigned int n_msgs)
 {
     ol_ceph_proto_rc rc = OL_CEPH_OK;
 
@@ -523,7 +699,7 @@ ol_ceph_generator_state_proc(ol_ceph_proto_handle *h)
             break;
 
         case OL_CEPH_STATE_SEND_MSG:
-            rc = ol_ceph_send_msg(h, CEPH_MSGR_TAG_MSG);
+            rc = ol_ceph_send_msgs(h, CEPH_MSGR_TAG_MSG, n_msgs);
             break;
 
         default:
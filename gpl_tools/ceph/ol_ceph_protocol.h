@@ -23,6 +23,12 @@
 #define OL_CEPH_MAX_MIDDLE_LEN 1024
 #define OL_CEPH_MAX_DATA_LEN 1024
 
+/**
+ * Maximum length of the constant part of a generated message: tag, header
+ * and front.
+ */
+#define OL_CEPH_MAX_MSG_HEAD_LEN (OL_CEPH_MAX_FRONT_LEN + 128)
+
 /**
  * Ceph connection state handle.
  */
@@ -53,6 +59,15 @@ typedef struct ol_ceph_proto_handle {
     ol_ceph_conn_state state;
     ol_ceph_connection conn;
     ol_ceph_opread_data_user_cb user_data_cb;
+    uint8_t msg_head[OL_CEPH_MAX_MSG_HEAD_LEN]; /**< Constant part of
+                                                     generated messages. */
+    size_t msg_head_len;    /**< Length of @p msg_head. */
+    size_t msg_op_offs;     /**< Offset of the operation in @p msg_head. */
+    size_t data_len_min;    /**< Minimum payload length of generated
+                                 messages. */
+    size_t data_len_max;    /**< Maximum payload length of generated
+                                 messages. */
+    unsigned short rand_state[3]; /**< State of payload length generator. */
 } ol_ceph_proto_handle;
 
 /**
@@ -109,19 +124,48 @@ extern int ol_ceph_proto_client_init(ol_ceph_proto_handle *h, int s,
  *
  * @param h         The handle.
  * @param s         The socket.
- * @param buf       Buffer to fill the generated data.
+ * @param buf       Buffer to fill the generated data. It must fit payload
+ *                  of the messages sent at once, see
+ *                  @ref ol_ceph_proto_msg_buf_len.
  * @param len       Size of the buffer.
  * @param callback  User callback function which is called on generating
  *                  new ceph payload, or @c NULL to generate random data.
  * @param user_data Pointer to user data to pass to the callback.
  *
- * @return zero
+ * @return zero on success, or -1 in case of error.
  */
 extern int ol_ceph_proto_generator_init(ol_ceph_proto_handle *h, int s,
                                         void *buf, size_t len,
                                         ol_ceph_opread_wr_callback callback,
                                         void *user_data);
 
+/**
+ * Set payload length of messages generated by ceph generator. Every
+ * message gets a length uniformly distributed in the range. By default
+ * the length is @ref OL_CEPH_MAX_DATA_LEN.
+ *
+ * @param h         The handle initialized with
+ *                  @ref ol_ceph_proto_generator_init.
+ * @param min       Minimum length.
+ * @param max       Maximum length, not less than @p min.
+ *
+ * @return zero on success, or -1 in case of error.
+ */
+extern int ol_ceph_proto_set_data_len(ol_ceph_proto_handle *h, size_t min,
+                                      size_t max);
+
+/**
+ * Get size of generator buffer needed to send messages with payload up to
+ * @p data_len_max bytes in batches of @p n_msgs messages.
+ *
+ * @param data_len_max  Maximum payload length.
+ * @param n_msgs        Number of messages sent at once.
+ *
+ * @return Size in bytes.
+ */
+extern size_t ol_ceph_proto_msg_buf_len(size_t data_len_max,
+                                        unsigned int n_msgs);
+
 /**
  * Process Ceph client (receiver) state. States are following:
  * read banner message
@@ -131,7 +175,8 @@ extern int ol_ceph_proto_generator_init(ol_ceph_proto_handle *h, int s,
  *   |
  *   V
  * read OSD_OPREPLY messages and pass received payload to user callback, passed
- * to @ref ol_ceph_proto_client_init.
+ * to @ref ol_ceph_proto_client_init. Payload is passed in place, possibly in
+ * several chunks.
  *
  * On every call the function performs current state steps and moves to the
  * next one. The last state is looped, so on the 3d call and further the
@@ -151,21 +196,25 @@ extern ol_ceph_proto_rc ol_ceph_recv_state_proc(ol_ceph_proto_handle *h);
  * send connect-reply message
  *   |
  *   V
- * send OSD_OPREPLY message containing one OSD_OP_READ request with user
- * data as a payload. Payload is generated by a user callback passed to
- * @ref ol_ceph_proto_generator_init.
+ * send a batch of OSD_OPREPLY messages each containing one OSD_OP_READ request
+ * with user data as a payload. Payload is generated in place by a user
+ * callback passed to @ref ol_ceph_proto_generator_init. The constant part of
+ * the messages is built once and shared by all of them.
  *
  * On every call the function performs current state steps and moves to the
  * next one. The last state is looped, so on the 3d call and further the
- * function does the same - sends new message.
+ * function does the same - sends new messages.
  *
  * The messages and their contents are specified in TCP/Ceph plugin
  * documentation.
  *
- * @param h     Ceph protocol handle.
+ * @param h         Ceph protocol handle.
+ * @param n_msgs    Number of messages sent with one sendmsg() call in the
+ *                  last state. It is limited by the buffer size.
  *
  * @return Status code.
  */
-extern ol_ceph_proto_rc ol_ceph_generator_state_proc(ol_ceph_proto_handle *h);
+extern ol_ceph_proto_rc ol_ceph_generator_state_proc(ol_ceph_proto_handle *h,
+                                                     unsigned int n_msgs);
 
 #endif /* __OL_CEPH_PROTOCOL_H__ */
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <unistd.h>
 
 #include "ol_ceph_receiver.h"
 #include "ol_poll.h"
@@ -21,7 +22,7 @@
 #include "ol_ceph_offload.h"
 
 /**
- * Receiver internal data structure.
+ * Receiver connection data.
  */
 typedef struct ol_ceph_receiver_data
 {
@@ -29,6 +30,9 @@ typedef struct ol_ceph_receiver_data
     size_t n_recv_chunks;
     bool invalid_data;
     ol_ceph_proto_handle ceph_proto_handle;
+    void *buf;          /**< Receive buffer. */
+    int *n_active;      /**< Number of connections which are not closed
+                             by peers. */
 } ol_ceph_receiver_data;
 
 static bool
@@ -64,11 +68,9 @@ ol_ceph_receiver_callback(const void *buf, size_t len, void *user_data)
 {
     ol_ceph_receiver_data *state = user_data;
 
-    state->invalid_data = !ol_ceph_receiver_validate(
-                                buf, len, state->total_ceph_data_read);
-
-    if (state->invalid_data)
+    if (!ol_ceph_receiver_validate(buf, len, state->total_ceph_data_read))
     {
+        state->invalid_data = true;
         fprintf(stderr, "Last chunk (%lu:%lu) is not validated\n",
                 state->n_recv_chunks, len);
     }
@@ -78,10 +80,12 @@ ol_ceph_receiver_callback(const void *buf, size_t len, void *user_data)
 }
 
 /**
- * Callback for @c POLLIN event.
+ * Callback for @c POLLIN event. It processes all messages which are already
+ * read to the connection buffer, since they are not reported by poll.
  *
  * @param s             Socket on which @c POLLIN event occured.
- * @param user_data     Pointer to @ref ol_ceph_state handle.
+ * @param user_data     Pointer to @ref ol_ceph_receiver_data of the
+ *                      connection.
  *
  * @return Status code according to the types declared in ol_poll.h.
  */
@@ -91,63 +95,195 @@ ol_ceph_receiver_pollin_func(int s, void *user_data)
     ol_ceph_proto_rc rc;
     ol_ceph_receiver_data *receiver_data = user_data;
 
-    rc = ol_ceph_recv_state_proc(&receiver_data->ceph_proto_handle);
+    do {
+        rc = ol_ceph_recv_state_proc(&receiver_data->ceph_proto_handle);
+    } while (rc == OL_CEPH_OK && !receiver_data->invalid_data &&
+             ol_ceph_rx_pending(&receiver_data->ceph_proto_handle.conn));
 
     if (receiver_data->invalid_data)
         return OL_POLL_RC_FAIL;
 
+    /* Wait until all the peers close their connections. */
+    if (rc == OL_CEPH_RECV_ZERO && --*receiver_data->n_active > 0)
+    {
+        ol_poll_delfd(s);
+        return OL_POLL_RC_OK;
+    }
+
     return proto_rc2poll_rc(rc);
 }
 
+/**
+ * Create a socket with TCP/Ceph offloading enabled.
+ *
+ * @return the socket, or -1 in case of error.
+ */
+static int
+ol_ceph_receiver_socket(void)
+{
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (s < 0)
+    {
+        fprintf(stderr, "receiver: socket(): %s\n", strerror(errno));
+        return -1;
+    }
+
+    ol_ceph_offload_enable(s);
+
+    return s;
+}
+
+/**
+ * Establish @p num connections with TCP/Ceph offloading enabled. All
+ * passive connections are accepted on one listening socket.
+ *
+ * @return zero on success, or -1 in case of error.
+ */
+static int
+ol_ceph_receiver_connect(ol_connection_type conn_type, int port,
+                         const char *host, int *socks, int num)
+{
+    int s;
+    int i;
+
+    if (conn_type == OL_CONNECT_PASSIVE)
+    {
+        s = ol_ceph_receiver_socket();
+        if (s < 0)
+            return -1;
+
+        return ol_accept_sockets(s, port, socks, num, "receiver");
+    }
+
+    for (i = 0; i < num; ++i)
+    {
+        s = ol_ceph_receiver_socket();
+        if (s < 0)
+            break;
+
+        socks[i] = ol_connect_socket(s, conn_type, port, host, "receiver");
+        if (socks[i] < 0)
+        {
+            close(s);
+            break;
+        }
+    }
+
+    if (i == num)
+        return 0;
+
+    while (i-- > 0)
+        close(socks[i]);
+
+    return -1;
+}
+
 int
 ol_ceph_receiver(ol_ceph_state *state, const char *host, int port,
-                 const char *iface)
+                 const char *iface, int connections)
 {
-    int s = -1;
     int rc = 0;
-    ol_ceph_receiver_data receiver_state;
+    int n_active = connections;
+    int *socks = NULL;
+    ol_ceph_receiver_data *conns = NULL;
+    ol_ceph_receiver_data *conn;
+    size_t total_read = 0;
     ol_connection_type conn_type = host == NULL ? OL_CONNECT_PASSIVE
                                                 : OL_CONNECT_ACTIVE;
+    int i;
 
     printf("Receiver is running\n");
     assert(state != NULL);
 
-    s = socket(AF_INET, SOCK_STREAM, 0);
-    if (s < 0)
+    if (connections <= 0)
     {
-        fprintf(stderr, "receiver: socket(): %s\n", strerror(errno));
+        fprintf(stderr, "receiver: invalid number of connections\n");
         return -1;
     }
 
-    ol_ceph_offload_enable(s);
-
-    receiver_state.total_ceph_data_read = 0;
-    receiver_state.invalid_data = false;
-    receiver_state.n_recv_chunks = 0;
+    socks = calloc(connections, sizeof(*socks));
+    conns = calloc(connections, sizeof(*conns));
+    if (socks == NULL || conns == NULL)
+    {
+        fprintf(stderr, "receiver: calloc: %s\n", strerror(errno));
+        free(socks);
+        free(conns);
+        return -1;
+    }
 
-    s = ol_connect_socket(s, conn_type, port, host, "receiver");
-    if (s < 0)
+    if (ol_ceph_receiver_connect(conn_type, port, host, socks,
+                                 connections) != 0)
     {
         fprintf(stderr, "receiver: connection failed\n");
+        free(socks);
+        free(conns);
         return -1;
     }
 
-    rc = ol_ceph_proto_client_init(&receiver_state.ceph_proto_handle, s, iface,
-                                   state->buf, state->bufsize,
-                                   ol_ceph_receiver_callback, &receiver_state);
-    if (rc < 0)
-        printf("Some Onload features are not supported\n");
+    for (i = 0; i < connections && rc == 0; ++i)
+    {
+        conn = &conns[i];
+        conn->total_ceph_data_read = 0;
+        conn->invalid_data = false;
+        conn->n_recv_chunks = 0;
+        conn->n_active = &n_active;
+        conn->buf = malloc(state->bufsize);
+        if (conn->buf == NULL)
+        {
+            fprintf(stderr, "receiver: malloc: %s\n", strerror(errno));
+            rc = -1;
+            break;
+        }
 
-    ol_poll_addfd(s, ol_ceph_receiver_pollin_func, NULL);
+        if (ol_ceph_proto_client_init(&conn->ceph_proto_handle, socks[i],
+                                      iface, conn->buf, state->bufsize,
+                                      ol_ceph_receiver_callback, conn) < 0)
+        {
+            printf("Some Onload features are not supported\n");
+        }
 
-    do {
-        rc = ol_poll_process(&receiver_state);
-    } while (rc == OL_POLL_RC_OK);
+        if (ol_poll_addfd_data(socks[i], ol_ceph_receiver_pollin_func, NULL,
+                               conn) != 0)
+        {
+            rc = -1;
+        }
+    }
+
+    if (rc == 0)
+    {
+        do {
+            rc = ol_poll_process(NULL);
+        } while (rc == OL_POLL_RC_OK);
+    }
+    else
+    {
+        rc = OL_POLL_RC_FAIL;
+    }
+
+    for (i = 0; i < connections; ++i)
+    {
+        conn = &conns[i];
+        total_read += conn->total_ceph_data_read;
+
+        if (connections > 1)
+        {
+            printf("receiver: conn %d: received - %lu bytes\n", i,
+                   conn->total_ceph_data_read);
+        }
+
+        if (conn->buf != NULL)
+            ol_ceph_conn_close(&conn->ceph_proto_handle.conn);
+        else
+            close(socks[i]);
+        free(conn->buf);
+    }
 
-    printf("receiver: total received - %lu bytes\n",
-           receiver_state.total_ceph_data_read);
+    printf("receiver: total received - %lu bytes\n", total_read);
 
-    ol_ceph_conn_close(&receiver_state.ceph_proto_handle.conn);
+    ol_poll_fini();
+    free(socks);
+    free(conns);
 
     return rc == OL_POLL_RC_FAIL ? -1 : 0;
 }
@@ -18,6 +18,8 @@
  * @param port          Port number in host byte order, to bind in passive
  *                      case, or connect in active.
  * @param iface         Name of interface, via which data will flow.
+ * @param connections   Number of connections. The receiver stops when
+ *                      peers close all of them.
  *
  * @return Status code
  * @retval 0    No errors.
@@ -25,6 +27,6 @@
  */
 int
 ol_ceph_receiver(ol_ceph_state *state, const char *host, int port,
-                 const char *iface);
+                 const char *iface, int connections);
 
 #endif /* __OL_CEPH_RECEIVER_H__ */
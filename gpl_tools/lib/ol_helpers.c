@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <string.h>
@@ -187,6 +188,138 @@ ol_create_and_connect_socket(ol_connection_type conn_type, int sock_type,
     return ol_connect_socket(s, conn_type, port, host, app_name);
 }
 
+int
+ol_accept_sockets(int s, int port, int *socks, int num, const char* app_name)
+{
+    int i = 0;
+
+    if (ol_bind_port(s, AF_INET, port) < 0)
+    {
+        printf("%s: bind(): %s\n", app_name, strerror(errno));
+        goto fail;
+    }
+
+    if (listen(s, num) < 0)
+    {
+        printf("%s: listen(): %s\n", app_name, strerror(errno));
+        goto fail;
+    }
+
+    printf("%s: waiting for %d peer connection(s)...\n", app_name, num);
+
+    for (i = 0; i < num; ++i)
+    {
+        socks[i] = accept(s, NULL, NULL);
+        if (socks[i] < 0)
+        {
+            printf("%s: accept(): %s\n", app_name, strerror(errno));
+            goto fail;
+        }
+    }
+
+    printf("%s: the peer connected\n", app_name);
+
+    close(s);
+
+    return 0;
+
+fail:
+    while (i-- > 0)
+        close(socks[i]);
+    close(s);
+
+    return -1;
+}
+
+int
+ol_create_and_connect_sockets(ol_connection_type conn_type, int sock_type,
+                              int port, const char* host, int *socks,
+                              int num, const char* app_name)
+{
+    int s = -1;
+    int i;
+
+    if (conn_type == OL_CONNECT_ACTIVE)
+    {
+        for (i = 0; i < num; ++i)
+        {
+            socks[i] = ol_create_and_connect_socket(conn_type, sock_type,
+                                                    port, host, app_name);
+            if (socks[i] < 0)
+            {
+                while (i-- > 0)
+                    close(socks[i]);
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    s = socket(AF_INET, sock_type, 0);
+    if (s < 0)
+    {
+        printf("%s: socket(): %s\n", app_name, strerror(errno));
+        return -1;
+    }
+
+    return ol_accept_sockets(s, port, socks, num, app_name);
+}
+
+int
+ol_parse_cpu_list(const char *str, int **cpus, int *num)
+{
+    const char *p = str;
+    char       *end;
+    long        first;
+    long        last;
+    int        *arr = NULL;
+    int        *tmp;
+    int         n = 0;
+
+    while (*p != '\0')
+    {
+        first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+            goto fail;
+
+        last = first;
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                goto fail;
+        }
+
+        tmp = realloc(arr, (n + last - first + 1) * sizeof(*arr));
+        if (tmp == NULL)
+            goto fail;
+        arr = tmp;
+
+        for (; first <= last; ++first)
+            arr[n++] = first;
+
+        if (*end == ',')
+            ++end;
+        else if (*end != '\0')
+            goto fail;
+        p = end;
+    }
+
+    if (n == 0)
+        goto fail;
+
+    *cpus = arr;
+    *num = n;
+    return 0;
+
+fail:
+    printf("invalid CPU list \"%s\"\n", str);
+    free(arr);
+    return -1;
+}
+
 void
 ol_hex_diff_dump(const uint8_t  *ex_pkt, const uint8_t *rx_pkt, size_t size)
 {
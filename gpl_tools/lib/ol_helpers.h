@@ -64,6 +64,60 @@ int ol_create_and_connect_socket(ol_connection_type conn_type,
                                  const char* host,
                                  const char* app_name);
 
+/**
+ * Bind the socket @p s to @p port and accept @p num connections on it.
+ * The socket is closed after that.
+ *
+ * @param s             The socket.
+ * @param port          Port number in host byte order to bind.
+ * @param socks         Where to save @p num accepted socket descriptors.
+ * @param num           Number of connections.
+ * @param app_name      Application name (for logging purpose).
+ *
+ * @return @c 0, or @c -1 in case of error (sockets accepted so far are
+ *         closed).
+ */
+int ol_accept_sockets(int s, int port, int *socks, int num,
+                      const char* app_name);
+
+/**
+ * Create @p num connections of a type @p conn_type to the same peer.
+ * In passive case a single listening socket accepts all the connections.
+ *
+ * @param conn_type     Type of connection (active/passive).
+ * @param sock_type     Socket type, corresponding to @b type argument of
+ *                      @b socket() system call.
+ * @param port          Port number in host byte order to bind/connect in
+ *                      passive/active case accordingly.
+ * @param host          String containing IP address to connect (ignored in
+ *                      case of passive connection opening).
+ * @param socks         Where to save @p num connected socket descriptors.
+ * @param num           Number of connections.
+ * @param app_name      Application name (for logging purpose).
+ *
+ * @return @c 0, or @c -1 in case of error (sockets connected so far are
+ *         closed).
+ */
+int ol_create_and_connect_sockets(ol_connection_type conn_type,
+                                  int sock_type,
+                                  int port,
+                                  const char* host,
+                                  int *socks,
+                                  int num,
+                                  const char* app_name);
+
+/**
+ * Parse a list of CPUs, e.g. "0,2,4-7".
+ *
+ * @param str       The list.
+ * @param cpus      Where to save pointer to allocated array of CPU numbers.
+ *                  It must be freed by the caller.
+ * @param num       Where to save number of CPUs in @p cpus.
+ *
+ * @return @c 0, or @c -1 in case of error.
+ */
+int ol_parse_cpu_list(const char *str, int **cpus, int *num);
+
 /**
  * Print to stdout a diff of two buffers.
  *
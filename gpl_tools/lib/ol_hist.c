@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Log-linear (HDR-style) histogram of 64-bit values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ol_hist.h"
+
+int
+ol_hist_init(ol_hist *hist, unsigned int precision)
+{
+    memset(hist, 0, sizeof(*hist));
+
+    if (precision < 1 || precision > 16)
+    {
+        printf("%s(): invalid precision %u\n", __FUNCTION__, precision);
+        return -1;
+    }
+
+    hist->precision = precision;
+    hist->n_buckets = (size_t)(64 - precision + 2) << (precision - 1);
+    hist->counts = calloc(hist->n_buckets, sizeof(*hist->counts));
+    if (hist->counts == NULL)
+    {
+        printf("%s(): calloc(): %s\n", __FUNCTION__, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+void
+ol_hist_free(ol_hist *hist)
+{
+    free(hist->counts);
+    hist->counts = NULL;
+}
+
+int
+ol_hist_merge(ol_hist *dst, const ol_hist *src)
+{
+    size_t i;
+
+    if (dst->precision != src->precision)
+    {
+        printf("%s(): precision mismatch\n", __FUNCTION__);
+        return -1;
+    }
+
+    if (src->count == 0)
+        return 0;
+
+    for (i = 0; i < dst->n_buckets; ++i)
+        dst->counts[i] += src->counts[i];
+
+    if (dst->count == 0 || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+
+    dst->count += src->count;
+    dst->sum += src->sum;
+
+    return 0;
+}
+
+uint64_t
+ol_hist_bucket_value(const ol_hist *hist, size_t idx)
+{
+    unsigned int shift;
+
+    if (idx < (1ULL << hist->precision))
+        return idx;
+
+    shift = (idx >> (hist->precision - 1)) - 1;
+
+    return (uint64_t)(idx - ((size_t)shift << (hist->precision - 1))) << shift;
+}
+
+/** Get the highest value counted by a bucket. */
+static uint64_t
+ol_hist_bucket_max_value(const ol_hist *hist, size_t idx)
+{
+    if (idx < (1ULL << hist->precision))
+        return idx;
+
+    return ol_hist_bucket_value(hist, idx) +
+           (1ULL << ((idx >> (hist->precision - 1)) - 1)) - 1;
+}
+
+uint64_t
+ol_hist_percentile(const ol_hist *hist, double percentile)
+{
+    uint64_t    rank;
+    uint64_t    total = 0;
+    uint64_t    value;
+    size_t      i;
+
+    if (hist->count == 0)
+        return 0;
+
+    rank = (uint64_t)(percentile / 100.0 * hist->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > hist->count)
+        rank = hist->count;
+
+    for (i = 0; i < hist->n_buckets; ++i)
+    {
+        total += hist->counts[i];
+        if (total >= rank)
+            break;
+    }
+
+    value = ol_hist_bucket_max_value(hist, i);
+    if (value > hist->max)
+        value = hist->max;
+    if (value < hist->min)
+        value = hist->min;
+
+    return value;
+}
+
+void
+ol_hist_print_summary(const ol_hist *hist, const char *prefix)
+{
+    printf("%s: count=%lu min=%lu p50=%lu p90=%lu p99=%lu p99.9=%lu "
+           "p99.99=%lu max=%lu mean=%lu\n", prefix, hist->count,
+           hist->count == 0 ? 0 : hist->min,
+           ol_hist_percentile(hist, 50), ol_hist_percentile(hist, 90),
+           ol_hist_percentile(hist, 99), ol_hist_percentile(hist, 99.9),
+           ol_hist_percentile(hist, 99.99), hist->max,
+           hist->count == 0 ? 0 : hist->sum / hist->count);
+}
+
+void
+ol_hist_print_buckets(const ol_hist *hist, const char *prefix)
+{
+    size_t i;
+
+    for (i = 0; i < hist->n_buckets; ++i)
+    {
+        if (hist->counts[i] != 0)
+        {
+            printf("%s: %lu %lu\n", prefix, ol_hist_bucket_value(hist, i),
+                   hist->counts[i]);
+        }
+    }
+}
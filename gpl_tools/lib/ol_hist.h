@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Log-linear (HDR-style) histogram of 64-bit values.
+ *
+ * Values below 2^precision are counted exactly. Every next power-of-two
+ * range is split into 2^(precision - 1) equal buckets, so the relative
+ * error of a reported value is below 2^-(precision - 1). Memory does not
+ * depend on the number of samples.
+ */
+
+#ifndef __OL_HIST_H__
+#define __OL_HIST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Default precision: relative error is below 1%. */
+#define OL_HIST_PRECISION_DEF 8
+
+/** Histogram handle. */
+typedef struct ol_hist
+{
+    unsigned int    precision;  /**< Number of bits of a value counted
+                                     exactly. */
+    size_t          n_buckets;  /**< Number of buckets. */
+    uint64_t       *counts;     /**< Buckets. */
+    uint64_t        count;      /**< Total number of values. */
+    uint64_t        min;        /**< Minimum value. */
+    uint64_t        max;        /**< Maximum value. */
+    uint64_t        sum;        /**< Sum of values (wraps on overflow). */
+} ol_hist;
+
+/**
+ * Initialize a histogram.
+ *
+ * @param hist          The histogram.
+ * @param precision     Number of bits of a value counted exactly,
+ *                      from @c 1 to @c 16.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Error
+ */
+int
+ol_hist_init(ol_hist *hist, unsigned int precision);
+
+/**
+ * Release histogram internal data.
+ *
+ * @param hist  The histogram.
+ */
+void
+ol_hist_free(ol_hist *hist);
+
+/**
+ * Get index of a bucket which counts the value.
+ *
+ * @param hist  The histogram.
+ * @param value The value.
+ *
+ * @return Bucket index.
+ */
+static inline size_t
+ol_hist_bucket(const ol_hist *hist, uint64_t value)
+{
+    unsigned int shift;
+
+    if (value < (1ULL << hist->precision))
+        return value;
+
+    /* Keep the "precision" most significant bits of the value. */
+    shift = 63 - __builtin_clzll(value) - (hist->precision - 1);
+
+    return ((size_t)shift << (hist->precision - 1)) + (value >> shift);
+}
+
+/**
+ * Add a value to the histogram.
+ *
+ * @param hist  The histogram.
+ * @param value The value.
+ */
+static inline void
+ol_hist_record(ol_hist *hist, uint64_t value)
+{
+    hist->counts[ol_hist_bucket(hist, value)]++;
+
+    if (hist->count == 0 || value < hist->min)
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+
+    hist->count++;
+    hist->sum += value;
+}
+
+/**
+ * Add all values of a histogram to another one.
+ *
+ * @param dst   Histogram to add values to.
+ * @param src   Histogram to add values from, it must have the same
+ *              precision as @p dst.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Histograms have different precision
+ */
+int
+ol_hist_merge(ol_hist *dst, const ol_hist *src);
+
+/**
+ * Get the lowest value counted by a bucket.
+ *
+ * @param hist  The histogram.
+ * @param idx   Bucket index.
+ *
+ * @return The value.
+ */
+uint64_t
+ol_hist_bucket_value(const ol_hist *hist, size_t idx);
+
+/**
+ * Get value at a percentile: a value which is not less than @p percentile
+ * percents of the recorded values. The highest value counted by the found
+ * bucket is returned, but not more than maximum recorded value.
+ *
+ * @param hist          The histogram.
+ * @param percentile    The percentile, from @c 0 to @c 100.
+ *
+ * @return The value, or @c 0 if the histogram is empty.
+ */
+uint64_t
+ol_hist_percentile(const ol_hist *hist, double percentile);
+
+/**
+ * Print one line summary of the histogram to stdout:
+ * @code
+ * <prefix>: count=N min=V p50=V p90=V p99=V p99.9=V p99.99=V max=V mean=V
+ * @endcode
+ *
+ * @param hist      The histogram.
+ * @param prefix    Line prefix.
+ */
+void
+ol_hist_print_summary(const ol_hist *hist, const char *prefix);
+
+/**
+ * Print non-empty buckets of the histogram to stdout, one per line:
+ * @code
+ * <prefix>: <lowest bucket value> <count>
+ * @endcode
+ *
+ * @param hist      The histogram.
+ * @param prefix    Line prefix.
+ */
+void
+ol_hist_print_buckets(const ol_hist *hist, const char *prefix);
+
+#endif /* __OL_HIST_H__ */
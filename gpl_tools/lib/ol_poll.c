@@ -5,36 +5,258 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <time.h>
 #include <poll.h>
+#include <sys/epoll.h>
 
 #include "ol_poll.h"
 
-/** Number of simultaneously polled sockets. */
-#define MAX_POLLFDS 1024
+/** Initial number of descriptors a poll set can hold. */
+#define OL_POLL_SET_INIT_SIZE 16
 
-/** Socket event callbacks type. */
-typedef struct ol_pollfd_callbacks
+/** Polled descriptor with its event callbacks. */
+typedef struct ol_pollfd_entry
 {
+    int               fd;               /**< The descriptor. */
     ol_poll_callback  pollin_callback;  /**< In event callback. */
     ol_poll_callback  pollout_callback; /**< Out event callback. */
-} ol_pollfd_callbacks;
+    void             *data;             /**< User data of the descriptor,
+                                             if not @c NULL. */
+    bool              edge;             /**< Events are edge-triggered,
+                                             callbacks drain the
+                                             descriptor (epoll engines). */
+    bool              in_ready;         /**< In event is not handled yet
+                                             (epoll engines). */
+    bool              out_ready;        /**< Out event is not handled yet
+                                             (epoll engines). */
+    bool              queued;           /**< The entry is in the ready
+                                             list. */
+} ol_pollfd_entry;
 
-/** Array of polled sockets event callbacks. */
-static ol_pollfd_callbacks pfds_cbs[MAX_POLLFDS];
+/** Per-thread poll set. */
+typedef struct ol_poll_set
+{
+    ol_poll_engine      engine;     /**< Event engine. */
+    ol_pollfd_entry    *entries;    /**< Polled descriptors. */
+    size_t              num;        /**< Number of polled descriptors. */
+    size_t              size;       /**< Allocated size of arrays. */
+    struct pollfd      *pfds;       /**< Array for poll() engine. */
+    int                 epfd;       /**< epoll descriptor. */
+    struct epoll_event *evts;       /**< Array for epoll_wait(). */
+    size_t             *ready;      /**< Indexes of entries having
+                                         unhandled events. */
+    size_t              ready_num;  /**< Number of elements in @p ready. */
+    size_t             *free_slots; /**< Indexes of removed entries which
+                                         may be reused. */
+    size_t              free_num;   /**< Number of elements in
+                                         @p free_slots. */
+} ol_poll_set;
 
-/** Array of poll structures. */
-static struct pollfd pfds[MAX_POLLFDS];
+/** Engine to use for new poll sets. */
+static ol_poll_engine poll_engine = OL_POLL_ENGINE_POLL;
 
-/** Number of sockets to poll. */
-static size_t pfds_num = 0;
+/** Spin budget of the busy-poll engine, in microseconds. */
+static int poll_spin_usec = OL_POLL_SPIN_USEC_DEF;
 
-void
-ol_poll_addfd(int fd, ol_poll_callback pollin_callback,
-              ol_poll_callback pollout_callback)
+/** Poll set of the current thread. */
+static __thread ol_poll_set *poll_set = NULL;
+
+static uint64_t
+ol_poll_now_usec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+ol_poll_engine
+ol_poll_engine_by_name(const char *name)
+{
+    if (name == NULL || strcmp(name, "poll") == 0)
+        return OL_POLL_ENGINE_POLL;
+    else if (strcmp(name, "epoll") == 0)
+        return OL_POLL_ENGINE_EPOLL;
+    else if (strcmp(name, "busy") == 0)
+        return OL_POLL_ENGINE_BUSY;
+
+    return OL_POLL_ENGINE_UNKNOWN;
+}
+
+int
+ol_poll_init(ol_poll_engine engine, int spin_usec)
+{
+    if (engine == OL_POLL_ENGINE_UNKNOWN)
+    {
+        printf("poll: unknown event engine\n");
+        return -1;
+    }
+
+    poll_engine = engine;
+    poll_spin_usec = spin_usec;
+
+    return 0;
+}
+
+static int
+ol_poll_set_grow(ol_poll_set *set)
+{
+    size_t              size = set->size == 0 ? OL_POLL_SET_INIT_SIZE
+                                              : set->size * 2;
+    ol_pollfd_entry    *entries;
+    struct pollfd      *pfds;
+    struct epoll_event *evts;
+    size_t             *ready;
+    size_t             *free_slots;
+
+    entries = realloc(set->entries, size * sizeof(*entries));
+    if (entries == NULL)
+        return -1;
+    set->entries = entries;
+
+    pfds = realloc(set->pfds, size * sizeof(*pfds));
+    if (pfds == NULL)
+        return -1;
+    set->pfds = pfds;
+
+    evts = realloc(set->evts, size * sizeof(*evts));
+    if (evts == NULL)
+        return -1;
+    set->evts = evts;
+
+    ready = realloc(set->ready, size * sizeof(*ready));
+    if (ready == NULL)
+        return -1;
+    set->ready = ready;
+
+    free_slots = realloc(set->free_slots, size * sizeof(*free_slots));
+    if (free_slots == NULL)
+        return -1;
+    set->free_slots = free_slots;
+
+    set->size = size;
+    return 0;
+}
+
+/** Release a poll set and its arrays. */
+static void
+ol_poll_set_free(ol_poll_set *set)
+{
+    if (set->epfd >= 0)
+        close(set->epfd);
+
+    free(set->entries);
+    free(set->pfds);
+    free(set->evts);
+    free(set->ready);
+    free(set->free_slots);
+    free(set);
+}
+
+static ol_poll_set *
+ol_poll_set_get(void)
+{
+    ol_poll_set *set = poll_set;
+
+    if (set != NULL)
+        return set;
+
+    set = calloc(1, sizeof(*set));
+    if (set == NULL)
+    {
+        printf("poll: calloc(): %s\n", strerror(errno));
+        return NULL;
+    }
+
+    set->engine = poll_engine;
+    set->epfd = -1;
+
+    /*
+     * Allocate arrays at once: epoll_wait() needs room for at least one
+     * event even if no descriptor is added yet.
+     */
+    if (ol_poll_set_grow(set) != 0)
+    {
+        printf("poll: failed to allocate poll set: %s\n", strerror(errno));
+        ol_poll_set_free(set);
+        return NULL;
+    }
+
+    if (set->engine != OL_POLL_ENGINE_POLL)
+    {
+        set->epfd = epoll_create1(0);
+        if (set->epfd < 0)
+        {
+            printf("poll: epoll_create1(): %s\n", strerror(errno));
+            ol_poll_set_free(set);
+            return NULL;
+        }
+    }
+
+    poll_set = set;
+    return set;
+}
+
+/** Get epoll events to wait for on a descriptor. */
+static uint32_t
+ol_poll_epoll_events(const ol_pollfd_entry *entry)
+{
+    uint32_t events = 0;
+
+    if (entry->pollin_callback != NULL)
+        events |= EPOLLIN;
+    if (entry->pollout_callback != NULL)
+        events |= EPOLLOUT;
+    if (entry->edge)
+        events |= EPOLLET;
+
+    return events;
+}
+
+/** Add a descriptor to poll set of the calling thread. */
+static int
+ol_poll_addfd_gen(int fd, ol_poll_callback pollin_callback,
+                  ol_poll_callback pollout_callback, void *fd_data,
+                  bool edge)
 {
-    short int evts = 0;
+    ol_poll_set        *set = ol_poll_set_get();
+    ol_pollfd_entry    *entry;
+    short int           evts = 0;
+    size_t              idx;
+
+    if (set == NULL)
+        return -1;
+
+    if (set->free_num > 0)
+    {
+        idx = set->free_slots[set->free_num - 1];
+    }
+    else
+    {
+        if (set->num == set->size && ol_poll_set_grow(set) != 0)
+        {
+            printf("poll: failed to grow poll set: %s\n", strerror(errno));
+            return -1;
+        }
+        idx = set->num;
+    }
+
+    entry = &set->entries[idx];
+    entry->fd = fd;
+    entry->pollin_callback = pollin_callback;
+    entry->pollout_callback = pollout_callback;
+    entry->data = fd_data;
+    entry->edge = edge;
+    entry->in_ready = false;
+    entry->out_ready = false;
+    entry->queued = false;
 
     if (pollin_callback != NULL)
         evts |= POLLIN;
@@ -42,59 +264,394 @@ ol_poll_addfd(int fd, ol_poll_callback pollin_callback,
     if (pollout_callback != NULL)
         evts |= POLLOUT;
 
-    pfds[pfds_num].fd = fd;
-    pfds[pfds_num].events = evts;
-    pfds[pfds_num].revents = 0;
+    if (set->engine == OL_POLL_ENGINE_POLL)
+    {
+        set->pfds[idx].fd = fd;
+        set->pfds[idx].events = evts;
+        set->pfds[idx].revents = 0;
+    }
+    else
+    {
+        struct epoll_event ev = {0};
+
+        ev.events = ol_poll_epoll_events(entry);
+        ev.data.u64 = idx;
 
-    pfds_cbs[pfds_num].pollin_callback = pollin_callback;
-    pfds_cbs[pfds_num].pollout_callback = pollout_callback;
+        if (epoll_ctl(set->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            printf("poll: epoll_ctl(): %s\n", strerror(errno));
+            entry->fd = -1;
+            return -1;
+        }
+    }
 
-    ++pfds_num;
+    if (idx == set->num)
+        ++set->num;
+    else
+        --set->free_num;
+
+    return 0;
 }
 
 int
-ol_poll_process(void *user_data)
+ol_poll_addfd_data(int fd, ol_poll_callback pollin_callback,
+                   ol_poll_callback pollout_callback, void *fd_data)
+{
+    return ol_poll_addfd_gen(fd, pollin_callback, pollout_callback, fd_data,
+                             false);
+}
+
+int
+ol_poll_addfd_et(int fd, ol_poll_callback pollin_callback,
+                 ol_poll_callback pollout_callback, void *fd_data)
+{
+    return ol_poll_addfd_gen(fd, pollin_callback, pollout_callback, fd_data,
+                             true);
+}
+
+int
+ol_poll_addfd(int fd, ol_poll_callback pollin_callback,
+              ol_poll_callback pollout_callback)
+{
+    return ol_poll_addfd_data(fd, pollin_callback, pollout_callback, NULL);
+}
+
+/** Find index of a descriptor in a poll set, or return @c -1. */
+static ssize_t
+ol_poll_find(ol_poll_set *set, int fd)
+{
+    size_t i;
+
+    if (set == NULL || fd < 0)
+        return -1;
+
+    for (i = 0; i < set->num; ++i)
+    {
+        if (set->entries[i].fd == fd)
+            return i;
+    }
+
+    return -1;
+}
+
+int
+ol_poll_modfd(int fd, ol_poll_callback pollin_callback,
+              ol_poll_callback pollout_callback)
+{
+    ol_poll_set        *set = poll_set;
+    ol_pollfd_entry    *entry;
+    ssize_t             i = ol_poll_find(set, fd);
+
+    if (i < 0)
+        return -1;
+
+    entry = &set->entries[i];
+    entry->pollin_callback = pollin_callback;
+    entry->pollout_callback = pollout_callback;
+    if (pollin_callback == NULL)
+        entry->in_ready = false;
+    if (pollout_callback == NULL)
+        entry->out_ready = false;
+
+    if (set->engine == OL_POLL_ENGINE_POLL)
+    {
+        set->pfds[i].events = (pollin_callback != NULL ? POLLIN : 0) |
+                              (pollout_callback != NULL ? POLLOUT : 0);
+    }
+    else
+    {
+        struct epoll_event ev = {0};
+
+        /* Modification re-arms the edge-triggered events. */
+        ev.events = ol_poll_epoll_events(entry);
+        ev.data.u64 = i;
+
+        if (epoll_ctl(set->epfd, EPOLL_CTL_MOD, fd, &ev) != 0)
+        {
+            printf("poll: epoll_ctl(): %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int
+ol_poll_delfd(int fd)
+{
+    ol_poll_set        *set = poll_set;
+    ol_pollfd_entry    *entry;
+    ssize_t             i = ol_poll_find(set, fd);
+
+    if (i < 0)
+        return -1;
+
+    /*
+     * poll() ignores negative descriptors, and a removed entry has no
+     * pending events. If the entry is in the ready list, the slot is
+     * reused only after it is dropped from there.
+     */
+    entry = &set->entries[i];
+    entry->fd = -1;
+    entry->in_ready = false;
+    entry->out_ready = false;
+    if (!entry->queued)
+        set->free_slots[set->free_num++] = i;
+
+    if (set->engine == OL_POLL_ENGINE_POLL)
+    {
+        set->pfds[i].fd = -1;
+        set->pfds[i].revents = 0;
+    }
+    else if (epoll_ctl(set->epfd, EPOLL_CTL_DEL, fd, NULL) != 0)
+    {
+        printf("poll: epoll_ctl(): %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/** Get user data to pass to callbacks of a descriptor. */
+static inline void *
+ol_poll_entry_data(const ol_pollfd_entry *entry, void *user_data)
+{
+    return entry->data != NULL ? entry->data : user_data;
+}
+
+static int
+ol_poll_process_poll(ol_poll_set *set, void *user_data, int timeout_ms)
 {
     int n_evts;
     int i;
     int rc;
 
-    n_evts = poll(pfds, pfds_num, -1);
+    n_evts = poll(set->pfds, set->num, timeout_ms);
     if (n_evts < 0)
     {
         printf("poll(): %s\n", strerror(errno));
         return OL_POLL_RC_FAIL;
     }
 
-    for (i = 0; i < n_evts; ++i)
+    /*
+     * Callbacks may add descriptors, so that the arrays are reallocated,
+     * or remove them, so that a slot is reused: do not keep pointers to
+     * the arrays across callbacks. Added and removed entries have zero
+     * revents.
+     */
+    for (i = 0; i < set->num && n_evts > 0; ++i)
     {
-        if ((pfds[i].revents & POLLHUP) != 0)
+        struct pollfd   *pfd = &set->pfds[i];
+        ol_pollfd_entry *entry = &set->entries[i];
+
+        if (pfd->revents == 0)
+            continue;
+        --n_evts;
+
+        if ((pfd->revents & POLLHUP) != 0)
         {
             printf("poll: peer closed the channel\n");
             return OL_POLL_RC_STOP;
         }
-        else if ((pfds[i].revents & POLLERR) != 0)
+        else if ((pfd->revents & POLLERR) != 0)
         {
             printf("poll: error occured\n");
             return OL_POLL_RC_FAIL;
         }
-        else
+
+        if ((pfd->revents & POLLIN) != 0 && entry->pollin_callback != NULL)
         {
-            if ((pfds[i].revents & POLLIN) != 0)
-            {
-                rc = pfds_cbs[i].pollin_callback(pfds[i].fd, user_data);
-                if (rc != OL_POLL_RC_OK)
-                    return rc;
-            }
+            rc = entry->pollin_callback(pfd->fd,
+                                        ol_poll_entry_data(entry, user_data));
+            if (rc != OL_POLL_RC_OK && rc != OL_POLL_RC_AGAIN)
+                return rc;
 
-            if ((pfds[i].revents & POLLOUT) != 0)
-            {
-                rc = pfds_cbs[i].pollout_callback(pfds[i].fd, user_data);
-                if (rc != OL_POLL_RC_OK)
-                    return rc;
-            }
+            pfd = &set->pfds[i];
+            entry = &set->entries[i];
+        }
+
+        if ((pfd->revents & POLLOUT) != 0 &&
+            entry->pollout_callback != NULL)
+        {
+            rc = entry->pollout_callback(pfd->fd,
+                                         ol_poll_entry_data(entry, user_data));
+            if (rc != OL_POLL_RC_OK && rc != OL_POLL_RC_AGAIN)
+                return rc;
         }
     }
 
     return OL_POLL_RC_OK;
 }
+
+/**
+ * Wait for epoll events. If some descriptors still have unhandled events,
+ * do not block. The busy-poll engine spins with zero timeout until an
+ * event arrives, the spin budget is exhausted or the timeout expires.
+ */
+static int
+ol_poll_epoll_wait(ol_poll_set *set, int timeout_ms)
+{
+    uint64_t start;
+    uint64_t elapsed = 0;
+    int      n_evts;
+
+    if (set->ready_num > 0)
+        return epoll_wait(set->epfd, set->evts, set->size, 0);
+
+    if (set->engine == OL_POLL_ENGINE_BUSY)
+    {
+        start = ol_poll_now_usec();
+        do {
+            n_evts = epoll_wait(set->epfd, set->evts, set->size, 0);
+            if (n_evts != 0)
+                return n_evts;
+            elapsed = ol_poll_now_usec() - start;
+        } while ((poll_spin_usec < 0 || elapsed < (uint64_t)poll_spin_usec) &&
+                 (timeout_ms < 0 || elapsed < (uint64_t)timeout_ms * 1000));
+
+        if (timeout_ms >= 0)
+        {
+            if (elapsed >= (uint64_t)timeout_ms * 1000)
+                return 0;
+            timeout_ms -= elapsed / 1000;
+        }
+    }
+
+    return epoll_wait(set->epfd, set->evts, set->size, timeout_ms);
+}
+
+static int
+ol_poll_process_epoll(ol_poll_set *set, void *user_data, int timeout_ms)
+{
+    int     n_evts;
+    int     i;
+    int     rc;
+    size_t  j;
+    size_t  k;
+
+    n_evts = ol_poll_epoll_wait(set, timeout_ms);
+    if (n_evts < 0)
+    {
+        printf("epoll_wait(): %s\n", strerror(errno));
+        return OL_POLL_RC_FAIL;
+    }
+
+    for (i = 0; i < n_evts; ++i)
+    {
+        uint32_t         evts = set->evts[i].events;
+        size_t           idx = set->evts[i].data.u64;
+        ol_pollfd_entry *entry = &set->entries[idx];
+
+        if ((evts & EPOLLHUP) != 0)
+        {
+            printf("poll: peer closed the channel\n");
+            return OL_POLL_RC_STOP;
+        }
+        else if ((evts & EPOLLERR) != 0)
+        {
+            printf("poll: error occured\n");
+            return OL_POLL_RC_FAIL;
+        }
+
+        if ((evts & EPOLLIN) != 0)
+            entry->in_ready = true;
+        if ((evts & EPOLLOUT) != 0)
+            entry->out_ready = true;
+
+        if (!entry->queued)
+        {
+            entry->queued = true;
+            set->ready[set->ready_num++] = idx;
+        }
+    }
+
+    /*
+     * Edge-triggered events are reported once, so keep such a descriptor
+     * in the ready list until its callbacks report EAGAIN. Level-triggered
+     * descriptors are reported again while they are ready, their
+     * callbacks are called once per event as with poll().
+     */
+    rc = OL_POLL_RC_OK;
+    for (j = 0, k = 0; j < set->ready_num && rc == OL_POLL_RC_OK; ++j)
+    {
+        size_t           idx = set->ready[j];
+        ol_pollfd_entry *entry = &set->entries[idx];
+
+        if (entry->in_ready)
+        {
+            rc = entry->pollin_callback(entry->fd,
+                                        ol_poll_entry_data(entry, user_data));
+            /*
+             * The callback may add a descriptor and so reallocate the
+             * entries. The slot itself is not reused while it is queued.
+             */
+            entry = &set->entries[idx];
+            if (rc == OL_POLL_RC_AGAIN || !entry->edge)
+                entry->in_ready = false;
+            if (rc == OL_POLL_RC_AGAIN)
+                rc = OL_POLL_RC_OK;
+        }
+
+        if (entry->out_ready && rc == OL_POLL_RC_OK)
+        {
+            rc = entry->pollout_callback(entry->fd,
+                                         ol_poll_entry_data(entry, user_data));
+            entry = &set->entries[idx];
+            if (rc == OL_POLL_RC_AGAIN || !entry->edge)
+                entry->out_ready = false;
+            if (rc == OL_POLL_RC_AGAIN)
+                rc = OL_POLL_RC_OK;
+        }
+
+        if (entry->in_ready || entry->out_ready)
+        {
+            set->ready[k++] = idx;
+        }
+        else
+        {
+            entry->queued = false;
+            /* Now the slot of a removed descriptor may be reused. */
+            if (entry->fd < 0)
+                set->free_slots[set->free_num++] = idx;
+        }
+    }
+
+    /* Keep entries which were not processed due to an error. */
+    for (; j < set->ready_num; ++j)
+        set->ready[k++] = set->ready[j];
+    set->ready_num = k;
+
+    return rc;
+}
+
+int
+ol_poll_process_timeout(void *user_data, int timeout_ms)
+{
+    ol_poll_set *set = ol_poll_set_get();
+
+    if (set == NULL)
+        return OL_POLL_RC_FAIL;
+
+    if (set->engine == OL_POLL_ENGINE_POLL)
+        return ol_poll_process_poll(set, user_data, timeout_ms);
+
+    return ol_poll_process_epoll(set, user_data, timeout_ms);
+}
+
+int
+ol_poll_process(void *user_data)
+{
+    return ol_poll_process_timeout(user_data, -1);
+}
+
+void
+ol_poll_fini(void)
+{
+    ol_poll_set *set = poll_set;
+
+    if (set == NULL)
+        return;
+
+    ol_poll_set_free(set);
+    poll_set = NULL;
+}
@@ -7,13 +7,43 @@
 #ifndef __OL_POLL_H__
 #define __OL_POLL_H__
 
-#define OL_POLL_RC_OK   0
-#define OL_POLL_RC_FAIL -1
-#define OL_POLL_RC_STOP 1
+#define OL_POLL_RC_OK    0
+#define OL_POLL_RC_FAIL  -1
+#define OL_POLL_RC_STOP  1
+#define OL_POLL_RC_AGAIN 2
+
+/** Default spin budget of @ref OL_POLL_ENGINE_BUSY, in microseconds. */
+#define OL_POLL_SPIN_USEC_DEF 100
+
+/**
+ * Event engine used to wait for events on the polled descriptors.
+ *
+ * Each thread has its own poll set, so worker threads may poll their own
+ * descriptors independently. The engine is chosen process-wide with
+ * @ref ol_poll_init(); a poll set is created on the first
+ * @ref ol_poll_addfd() call in a thread.
+ */
+typedef enum ol_poll_engine {
+    OL_POLL_ENGINE_POLL,    /**< Level-triggered poll(), the default. */
+    OL_POLL_ENGINE_EPOLL,   /**< epoll, edge-triggered for descriptors
+                                 added with @ref ol_poll_addfd_et(). */
+    OL_POLL_ENGINE_BUSY,    /**< The same as @c OL_POLL_ENGINE_EPOLL, but
+                                 spins with zero timeout for a configured
+                                 budget before blocking. */
+    OL_POLL_ENGINE_UNKNOWN, /**< Invalid engine name. */
+} ol_poll_engine;
 
 /**
  * User callback function type
  *
+ * Callbacks of a descriptor added with @ref ol_poll_addfd_et() are
+ * edge-triggered with epoll engines: the descriptor is considered ready
+ * until its callback returns @c OL_POLL_RC_AGAIN, i.e. the callback is
+ * invoked on every @ref ol_poll_process() call until it reports that the
+ * descriptor is drained. Other descriptors are level-triggered, their
+ * callbacks are invoked once per event and may handle only a part of
+ * available data.
+ *
  * @param fd            Descriptor on which an event occurs.
  * @param user_data     Pointer to user data.
  *
@@ -21,24 +51,133 @@
  * @retval OL_POLL_RC_OK    Everything is OK
  * @retval OL_POLL_RC_FAIL  Error occured
  * @retval OL_POLL_RC_STOP  No errors occured, polling has to be stopped.
+ * @retval OL_POLL_RC_AGAIN No errors occured, the operation would block
+ *                          (@c EAGAIN).
  */
 typedef int (*ol_poll_callback)(int fd, void *user_data);
 
 /**
- * Add a descriptor to poll set.
+ * Get an event engine by its name.
+ *
+ * @param name      Engine name: "poll", "epoll" or "busy". @c NULL means
+ *                  the default engine.
+ *
+ * @return The engine, or @c OL_POLL_ENGINE_UNKNOWN if the name is invalid.
+ */
+ol_poll_engine
+ol_poll_engine_by_name(const char *name);
+
+/**
+ * Choose the event engine. Must be called before any descriptor is added
+ * to a poll set, otherwise the poll() engine is used.
+ *
+ * @param engine        The engine.
+ * @param spin_usec     How long @c OL_POLL_ENGINE_BUSY spins before going
+ *                      to blocking wait, in microseconds. A negative value
+ *                      means spinning forever. Ignored by other engines.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Invalid engine
+ */
+int
+ol_poll_init(ol_poll_engine engine, int spin_usec);
+
+/**
+ * Add a descriptor to poll set of the calling thread. It may be called
+ * from a callback, e.g. to poll an accepted connection.
  *
  * @param fd                The descriptor
  * @param pollin_callback   Callback function which is called on POLLIN event.
  *                          If @c NULL, the event is not handled.
  * @param pollout_callback  Callback function which is called on POLLOUT event.
  *                          If @c NULL, the event is not handled.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Error
  */
-void
+int
 ol_poll_addfd(int fd, ol_poll_callback pollin_callback,
               ol_poll_callback pollout_callback);
 
 /**
- * Process poll() call. Callback functions are called if an event occurs.
+ * Add a descriptor to poll set of the calling thread with its own user
+ * data. Callbacks of the descriptor get @p fd_data instead of user data
+ * passed to @ref ol_poll_process().
+ *
+ * @param fd                The descriptor
+ * @param pollin_callback   Callback function which is called on POLLIN event.
+ *                          If @c NULL, the event is not handled.
+ * @param pollout_callback  Callback function which is called on POLLOUT event.
+ *                          If @c NULL, the event is not handled.
+ * @param fd_data           User data of the descriptor.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Error
+ */
+int
+ol_poll_addfd_data(int fd, ol_poll_callback pollin_callback,
+                   ol_poll_callback pollout_callback, void *fd_data);
+
+/**
+ * The same as @ref ol_poll_addfd_data(), but events of the descriptor are
+ * edge-triggered with epoll engines. Callbacks must be non-blocking and
+ * return @c OL_POLL_RC_AGAIN once the operation would block, otherwise
+ * they are called on every @ref ol_poll_process() call.
+ *
+ * @param fd                The descriptor
+ * @param pollin_callback   Callback function which is called on POLLIN event.
+ *                          If @c NULL, the event is not handled.
+ * @param pollout_callback  Callback function which is called on POLLOUT event.
+ *                          If @c NULL, the event is not handled.
+ * @param fd_data           User data of the descriptor.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Error
+ */
+int
+ol_poll_addfd_et(int fd, ol_poll_callback pollin_callback,
+                 ol_poll_callback pollout_callback, void *fd_data);
+
+/**
+ * Change callbacks of a descriptor in poll set of the calling thread,
+ * e.g. to stop or resume waiting for POLLOUT event. It may be called from
+ * a callback.
+ *
+ * @param fd                The descriptor
+ * @param pollin_callback   Callback function which is called on POLLIN event.
+ *                          If @c NULL, the event is not handled.
+ * @param pollout_callback  Callback function which is called on POLLOUT event.
+ *                          If @c NULL, the event is not handled.
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   Error
+ */
+int
+ol_poll_modfd(int fd, ol_poll_callback pollin_callback,
+              ol_poll_callback pollout_callback);
+
+/**
+ * Remove a descriptor from poll set of the calling thread. It may be called
+ * from a callback, including a callback of the removed descriptor, and the
+ * descriptor may be closed right after that.
+ *
+ * @param fd    The descriptor
+ *
+ * @return Status code
+ * @retval 0    Success
+ * @retval -1   The descriptor is not in the poll set
+ */
+int
+ol_poll_delfd(int fd);
+
+/**
+ * Wait for events on the poll set of the calling thread. Callback functions
+ * are called if an event occurs.
  *
  * @param user_data  User data passed to a callback.
  *
@@ -50,4 +189,25 @@ ol_poll_addfd(int fd, ol_poll_callback pollin_callback,
 int
 ol_poll_process(void *user_data);
 
+/**
+ * The same as @ref ol_poll_process(), but do not wait for events longer
+ * than @p timeout_ms.
+ *
+ * @param user_data     User data passed to a callback.
+ * @param timeout_ms    Timeout in milliseconds, @c 0 means checking for
+ *                      events without blocking, a negative value means
+ *                      infinite timeout.
+ *
+ * @return Status code, @c OL_POLL_RC_OK if the timeout expired.
+ */
+int
+ol_poll_process_timeout(void *user_data, int timeout_ms);
+
+/**
+ * Release the poll set of the calling thread. Polled descriptors are not
+ * closed.
+ */
+void
+ol_poll_fini(void);
+
 #endif /* __OL_POLL_H__ */
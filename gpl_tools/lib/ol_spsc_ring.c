@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Lock-free single-producer/single-consumer ring buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ol_spsc_ring.h"
+
+ol_spsc_ring *
+ol_spsc_ring_new(size_t entry_size, size_t capacity)
+{
+    ol_spsc_ring   *ring = NULL;
+    size_t          size = 1;
+    int             rc;
+
+    while (size < capacity)
+        size <<= 1;
+
+    rc = posix_memalign((void **)&ring, OL_CACHE_LINE_SIZE, sizeof(*ring));
+    if (rc != 0)
+    {
+        printf("%s(): posix_memalign(): %s\n", __FUNCTION__, strerror(rc));
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+
+    ring->entries = calloc(size, entry_size);
+    if (ring->entries == NULL)
+    {
+        printf("%s(): calloc(): %s\n", __FUNCTION__, strerror(errno));
+        free(ring);
+        return NULL;
+    }
+
+    ring->entry_size = entry_size;
+    ring->mask = size - 1;
+
+    return ring;
+}
+
+void
+ol_spsc_ring_free(ol_spsc_ring *ring)
+{
+    if (ring == NULL)
+        return;
+
+    free(ring->entries);
+    free(ring);
+}
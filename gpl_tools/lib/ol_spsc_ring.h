@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * Exactly one thread may push entries and exactly one (other) thread may
+ * pop them. Push and pop are inline and take no locks: the producer owns
+ * @c tail, the consumer owns @c head, and each side publishes its index
+ * with a release store which the other side reads with an acquire load.
+ * The indices live in separate cache lines to avoid false sharing.
+ */
+
+#ifndef __OL_SPSC_RING_H__
+#define __OL_SPSC_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/** Cache line size used to separate producer and consumer data. */
+#define OL_CACHE_LINE_SIZE 64
+
+/** Align a structure member to a cache line. */
+#define OL_CACHE_ALIGNED __attribute__((aligned(OL_CACHE_LINE_SIZE)))
+
+/** SPSC ring buffer handle. */
+typedef struct ol_spsc_ring
+{
+    /* Read-only after creation */
+    void   *entries;        /**< Buffer for storing entries. */
+    size_t  entry_size;     /**< An entry size. */
+    size_t  mask;           /**< Capacity minus one, capacity is a power
+                                 of two. */
+
+    /* Consumer data */
+    size_t  head OL_CACHE_ALIGNED; /**< Number of popped entries. */
+    size_t  tail_cache;     /**< Consumer copy of @c tail. */
+
+    /* Producer data */
+    size_t  tail OL_CACHE_ALIGNED; /**< Number of pushed entries. */
+    size_t  head_cache;     /**< Producer copy of @c head. */
+} ol_spsc_ring;
+
+/**
+ * Create new SPSC ring buffer.
+ *
+ * @param entry_size    Size of an element to store.
+ * @param capacity      Minimum capacity of the buffer. It is rounded up
+ *                      to a power of two.
+ *
+ * @return Pointer to a buffer handle, or @c NULL in case of error.
+ */
+ol_spsc_ring *
+ol_spsc_ring_new(size_t entry_size, size_t capacity);
+
+/**
+ * Release the buffer.
+ *
+ * @param ring  The buffer handle.
+ */
+void
+ol_spsc_ring_free(ol_spsc_ring *ring);
+
+/**
+ * Get capacity of the buffer.
+ *
+ * @param ring  The buffer handle.
+ *
+ * @return Maximum number of entries.
+ */
+static inline size_t
+ol_spsc_ring_capacity(const ol_spsc_ring *ring)
+{
+    return ring->mask + 1;
+}
+
+/**
+ * Determine whether the buffer is empty. May be called from any thread,
+ * the result is a snapshot.
+ *
+ * @param ring  The buffer handle.
+ *
+ * @return @c true if the buffer is empty, @c false otherwise.
+ */
+static inline bool
+ol_spsc_ring_is_empty(ol_spsc_ring *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) ==
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Write an entry pointed by @p e to the end of the buffer. Must be called
+ * by the producer thread only.
+ *
+ * @param ring  The buffer handle.
+ * @param e     Pointer to an entry data.
+ *
+ * @return Status code
+ * @retval 0  Success
+ * @retval -1 Error (the buffer is full)
+ */
+static inline int
+ol_spsc_ring_push(ol_spsc_ring *ring, const void *e)
+{
+    size_t tail = ring->tail;
+
+    if (tail - ring->head_cache > ring->mask)
+    {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - ring->head_cache > ring->mask)
+            return -1;
+    }
+
+    memcpy((char *)ring->entries + (tail & ring->mask) * ring->entry_size,
+           e, ring->entry_size);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * Get up to @p max_num entries from the head of the buffer. Must be called
+ * by the consumer thread only.
+ *
+ * @param ring      The buffer handle.
+ * @param es        Array of at least @p max_num entries where to write
+ *                  entries data.
+ * @param max_num   Maximum number of entries to get.
+ *
+ * @return Number of entries written to @p es, zero if the buffer is empty.
+ */
+static inline size_t
+ol_spsc_ring_pop_batch(ol_spsc_ring *ring, void *es, size_t max_num)
+{
+    size_t head = ring->head;
+    size_t num;
+    size_t first;
+    size_t size = ring->mask + 1;
+
+    if (ring->tail_cache - head < max_num)
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    num = ring->tail_cache - head;
+    if (num > max_num)
+        num = max_num;
+    if (num == 0)
+        return 0;
+
+    /* Copy in two parts if the entries wrap around the buffer end. */
+    first = size - (head & ring->mask);
+    if (first > num)
+        first = num;
+
+    memcpy(es, (char *)ring->entries + (head & ring->mask) * ring->entry_size,
+           first * ring->entry_size);
+    if (num > first)
+    {
+        memcpy((char *)es + first * ring->entry_size, ring->entries,
+               (num - first) * ring->entry_size);
+    }
+
+    __atomic_store_n(&ring->head, head + num, __ATOMIC_RELEASE);
+
+    return num;
+}
+
+/**
+ * Get an entry from the head of the buffer. Must be called by the consumer
+ * thread only.
+ *
+ * @param ring  The buffer handle.
+ * @param e     Pointer where to write the entry data.
+ *
+ * @return Status code
+ * @retval 0  Success
+ * @retval -1 Error (the buffer is empty)
+ */
+static inline int
+ol_spsc_ring_pop(ol_spsc_ring *ring, void *e)
+{
+    return ol_spsc_ring_pop_batch(ring, e, 1) == 1 ? 0 : -1;
+}
+
+#endif /* __OL_SPSC_RING_H__ */
@@ -4,14 +4,32 @@
  * @author Sergey Nikitin <Sergey.Nikitin@oktetlabs.ru>
  */
 
+/* for sched_setaffinity() and CPU_* macros */
+#define _GNU_SOURCE
+
+#include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <assert.h>
 #include <time.h>
+#include <sched.h>
+#ifdef __x86_64__
+#include <cpuid.h>
+#endif
+
+#include "ol_time.h"
+
+/** Number of attempts to read a CPU clock offset. */
+#define OL_TIME_OFFSET_ATTEMPTS 20
 
 struct ol_time_tsc_params
 {
     uint64_t  hz;
     uint64_t  tsc_cost;
+    uint64_t  ns_mult;  /**< Nanoseconds per cycle multiplied
+                             by 2^32. */
 };
 
 struct ol_time_tsc_measure
@@ -122,21 +140,146 @@ measure_hz(int interval_usec)
     return measure_end(&measure, interval_usec);
 }
 
-static int64_t
-ol_time_tsc_usec(const struct ol_time_tsc_params* params, int64_t tsc)
+uint64_t
+ol_time_get_cycles(void)
+{
+    uint64_t t;
+    ol_time_tsc(&t);
+    return t;
+}
+
+uint64_t
+ol_time_get_hz(void)
 {
-    return tsc * 1000000 / params->hz;
+    return tsc.hz;
 }
 
+uint64_t
+ol_time_cycles2nsec(uint64_t cycles)
+{
+    /* 128-bit product does not overflow however long the uptime is. */
+    return ((unsigned __int128)cycles * tsc.ns_mult) >> 32;
+}
 
-uint64_t ol_time_get_usec()
+uint64_t
+ol_time_nsec2cycles(uint64_t nsec)
+{
+    return (unsigned __int128)nsec * tsc.hz / 1000000000;
+}
+
+uint64_t
+ol_time_get_nsec(void)
 {
     uint64_t t;
     ol_time_tsc(&t);
-    return ol_time_tsc_usec(&tsc, t);
+    return ol_time_cycles2nsec(t);
+}
+
+uint64_t ol_time_get_usec()
+{
+    return ol_time_get_nsec() / 1000;
+}
+
+bool
+ol_time_tsc_is_invariant(void)
+{
+#ifdef __x86_64__
+    unsigned int eax, ebx, ecx, edx;
+
+    /* CPUID.80000007H:EDX[8] is "Invariant TSC". */
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+        return false;
+
+    return (edx & (1 << 8)) != 0;
+#else
+    /* ARMv8 generic timer runs at a fixed frequency. */
+    return true;
+#endif
+}
+
+/**
+ * Get offset between the timestamp counter and CLOCK_MONOTONIC on the
+ * current CPU, taking the reading with the lowest latency.
+ */
+static int64_t
+ol_time_cpu_offset(void)
+{
+    uint64_t    tsc_s, tsc_e, t;
+    uint64_t    min_cost = UINT64_MAX;
+    int64_t     offset = 0;
+    int         n;
+
+    for (n = 0; n < OL_TIME_OFFSET_ATTEMPTS; ++n)
+    {
+        ol_time_tsc(&tsc_s);
+        t = monotonic_clock();
+        ol_time_tsc(&tsc_e);
+
+        if (tsc_e - tsc_s < min_cost)
+        {
+            min_cost = tsc_e - tsc_s;
+            offset = ol_time_cycles2nsec(tsc_s + (tsc_e - tsc_s) / 2) - t;
+        }
+    }
+
+    return offset;
+}
+
+int
+ol_time_check_cpu_drift(uint64_t *max_drift_ns)
+{
+    cpu_set_t   orig;
+    cpu_set_t   set;
+    int64_t     offset;
+    int64_t     min_offset = INT64_MAX;
+    int64_t     max_offset = INT64_MIN;
+    int         cpu;
+    int         rc = 0;
+
+    if (sched_getaffinity(0, sizeof(orig), &orig) != 0)
+    {
+        printf("%s(): sched_getaffinity(): %s\n", __FUNCTION__,
+               strerror(errno));
+        return -1;
+    }
+
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &orig))
+            continue;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+            printf("%s(): sched_setaffinity(): %s\n", __FUNCTION__,
+                   strerror(errno));
+            rc = -1;
+            break;
+        }
+
+        offset = ol_time_cpu_offset();
+        if (offset < min_offset)
+            min_offset = offset;
+        if (offset > max_offset)
+            max_offset = offset;
+    }
+
+    if (sched_setaffinity(0, sizeof(orig), &orig) != 0)
+    {
+        printf("%s(): sched_setaffinity(): %s\n", __FUNCTION__,
+               strerror(errno));
+        rc = -1;
+    }
+
+    if (rc == 0)
+        *max_drift_ns = max_offset - min_offset;
+
+    return rc;
 }
 
 void ol_time_init()
 {
     tsc.hz = measure_hz(100000);
+    tsc.ns_mult = ((unsigned __int128)1000000000 << 32) / tsc.hz;
 }
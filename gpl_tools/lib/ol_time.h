@@ -8,6 +8,47 @@
 #define __OL_TIME_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Get current value of the CPU timestamp counter (TSC on x86, virtual
+ * counter on ARM64).
+ *
+ * @return number of cycles since CPU reset.
+ */
+uint64_t ol_time_get_cycles(void);
+
+/**
+ * Get frequency of the timestamp counter measured by @ref ol_time_init().
+ *
+ * @return number of cycles per second.
+ */
+uint64_t ol_time_get_hz(void);
+
+/**
+ * Convert a number of timestamp counter cycles to nanoseconds.
+ *
+ * @param cycles    Number of cycles.
+ *
+ * @return number of nanoseconds.
+ */
+uint64_t ol_time_cycles2nsec(uint64_t cycles);
+
+/**
+ * Convert nanoseconds to a number of timestamp counter cycles.
+ *
+ * @param nsec      Number of nanoseconds.
+ *
+ * @return number of cycles.
+ */
+uint64_t ol_time_nsec2cycles(uint64_t nsec);
+
+/**
+ * Get current timestamp in nanoseconds.
+ *
+ * @return number of nanoseconds since CPU reset.
+ */
+uint64_t ol_time_get_nsec(void);
 
 /**
  * Get current timestamp in useconds.
@@ -16,6 +57,28 @@
  */
 uint64_t ol_time_get_usec();
 
+/**
+ * Check that the timestamp counter is invariant, i.e. it runs at constant
+ * rate regardless of CPU frequency changes and sleep states.
+ *
+ * @return @c true if the counter is invariant.
+ */
+bool ol_time_tsc_is_invariant(void);
+
+/**
+ * Measure offsets between the timestamp counter and @c CLOCK_MONOTONIC
+ * on every CPU the process may run on, and get the maximum difference of
+ * the offsets. Timestamps taken on different CPUs may be compared only if
+ * the difference is small. The calling thread is moved to every CPU in
+ * turn, its CPU affinity is restored at the end.
+ *
+ * @param max_drift_ns  Where to save the maximum difference, in
+ *                      nanoseconds.
+ *
+ * @return @c 0, or @c -1 in case of error.
+ */
+int ol_time_check_cpu_drift(uint64_t *max_drift_ns);
+
 /**
  * Initialize timing subsystem internal data.
  */
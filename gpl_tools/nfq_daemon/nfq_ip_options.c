@@ -3,13 +3,21 @@
 /**
  * Socket API Test Suite
  *
- * Program to mangle packets from NFQUEUE queue 0
+ * Program to mangle packets from NFQUEUE queues. By default queue 0 is
+ * served, with --queue-balance a range of queues is served by one thread
+ * per queue.
  *
  * @author Vasilij Ivanov <Vasilij.Ivanov@oktetlabs.ru>
  */
+/* for pthread_attr_setaffinity_np() */
+#define _GNU_SOURCE
+
 #include <asm/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -34,6 +42,8 @@
 #include <libnetfilter_queue/libnetfilter_queue_tcp.h>
 #include <libnetfilter_queue/libnetfilter_queue_udp.h>
 
+#include "ol_helpers.h"
+
 /**
  * We need a buffer to fit a huge IP packet into it.
  * The packet's size is not limited by MTU because of TCP Segmentation Offload
@@ -49,6 +59,27 @@
 
 #define MAX_PID_LENGTH 10
 
+/** Size of a buffer to read route netlink messages. */
+#define NETLINK_BUF_SIZE 0x10000
+
+/** Default maximum number of packets accepted with one verdict. */
+#define DEFAULT_VERDICT_BATCH 32
+
+/** First queue to serve. */
+static unsigned int queue_first = 0;
+/** Last queue to serve. */
+static unsigned int queue_last = 0;
+/** Maximum number of unchanged packets accepted with one verdict. */
+static unsigned int verdict_batch = DEFAULT_VERDICT_BATCH;
+/** Kernel queue length, zero means the kernel default. */
+static unsigned int queue_maxlen = 0;
+/** Pass GSO packets to the daemon without segmentation. */
+static bool queue_gso = false;
+/** Accept packets instead of dropping them if a queue is full. */
+static bool queue_fail_open = false;
+/** CPUs to pin queue threads to, or @c NULL. */
+static char *queue_cpus = NULL;
+
 void
 print_log(int ret, const char *log_message, bool standart_log,
           const char *func, int line,
@@ -90,75 +121,116 @@ print_log(int ret, const char *log_message, bool standart_log,
                   __func__, __LINE__, format, ##__VA_ARGS__)
 
 
-typedef struct if_mtu_list {
-    int ifi_index;
-    int mtu;
-    struct if_mtu_list *next;
-} if_mtu_list;
+/** Initial number of entries in the interfaces MTU table. */
+#define IF_MTU_TABLE_MIN_SIZE 64
 
-if_mtu_list *head;
-if_mtu_list *last_used;
+/** Interfaces with greater index are not cached, default MTU is used. */
+#define IF_MTU_TABLE_MAX_SIZE 0x100000
 
-if_mtu_list* if_mtu_list_init(int ifi_index)
-{
-    head = (if_mtu_list *)malloc(sizeof(if_mtu_list));
-    head->ifi_index = ifi_index;
-    head->mtu = DEFAULT_ETH_MTU;
-    head->next = NULL;
-    last_used = head;
+/**
+ * Interfaces MTU indexed by interface index, zero MTU means unknown
+ * interface. Queue threads read it without locks, the only writer is
+ * the netlink thread.
+ */
+typedef struct if_mtu_table {
+    unsigned int size;  /**< Number of entries. */
+    int          mtu[]; /**< MTU of interfaces. */
+} if_mtu_table;
 
-    return head;
-}
+/**
+ * Current MTU table. When the table grows, it is copied and the pointer
+ * is replaced. Replaced tables are never freed since readers do not
+ * announce when they stop using them; the table size is doubled, so they
+ * take no more memory than the current one.
+ */
+static if_mtu_table *if_mtu_tbl = NULL;
 
-if_mtu_list* if_mtu_list_add(int ifi_index, int mtu)
+/**
+ * Get MTU of an interface. It never blocks.
+ *
+ * @param ifi_index     Interface index.
+ *
+ * @return MTU, or @ref DEFAULT_ETH_MTU if the interface is unknown.
+ */
+static int
+if_mtu_get(unsigned int ifi_index)
 {
-    if_mtu_list *current_head = head;
-    if_mtu_list *new_head = NULL;
-
-    if (current_head == NULL)
-        return if_mtu_list_init(ifi_index);
+    if_mtu_table *tbl = __atomic_load_n(&if_mtu_tbl, __ATOMIC_ACQUIRE);
+    int           mtu = 0;
 
-    new_head = (if_mtu_list *) malloc(sizeof(if_mtu_list));
+    if (tbl != NULL && ifi_index < tbl->size)
+        mtu = __atomic_load_n(&tbl->mtu[ifi_index], __ATOMIC_RELAXED);
 
-    new_head->ifi_index = ifi_index;
-    if (mtu != -1)
-    {
-        new_head->mtu = mtu;
-    }
-    else
-    {
-        new_head->mtu = DEFAULT_ETH_MTU;
-    }
-    new_head->next = current_head;
-
-    head = new_head;
-
-    return new_head;
+    return mtu != 0 ? mtu : DEFAULT_ETH_MTU;
 }
 
-if_mtu_list* if_mtu_list_find(int ifi_index)
+/**
+ * Set MTU of an interface. It must be called from the netlink thread
+ * only (or before queue threads are started).
+ *
+ * @param ifi_index     Interface index.
+ * @param mtu           MTU, or @c 0 if the interface is removed.
+ */
+static void
+if_mtu_set(unsigned int ifi_index, int mtu)
 {
-    if_mtu_list *current = head;
-    if_mtu_list *finded = NULL;
+    if_mtu_table *tbl = if_mtu_tbl;
+    if_mtu_table *new_tbl;
+    unsigned int  size;
+    int           old_mtu;
 
-    if (last_used != NULL && last_used->ifi_index == ifi_index)
-        return last_used;
+    if (ifi_index >= IF_MTU_TABLE_MAX_SIZE)
+        return;
 
-    while (current != NULL)
+    if (tbl == NULL || ifi_index >= tbl->size)
     {
-        if (current->ifi_index == ifi_index)
+        if (mtu == 0)
+            return;
+
+        size = tbl == NULL ? IF_MTU_TABLE_MIN_SIZE : tbl->size;
+        while (size <= ifi_index)
+            size *= 2;
+
+        new_tbl = calloc(1, sizeof(*new_tbl) +
+                            size * sizeof(new_tbl->mtu[0]));
+        if (new_tbl == NULL)
         {
-            finded = current;
-            break;
+            PRINT_LOG(-1, NULL, true, NULL);
+            return;
         }
-        current = current->next;
+
+        new_tbl->size = size;
+        if (tbl != NULL)
+            memcpy(new_tbl->mtu, tbl->mtu, tbl->size * sizeof(tbl->mtu[0]));
+
+        __atomic_store_n(&if_mtu_tbl, new_tbl, __ATOMIC_RELEASE);
+        tbl = new_tbl;
     }
 
-    return finded;
+    old_mtu = tbl->mtu[ifi_index];
+    if (old_mtu == mtu)
+        return;
+
+    __atomic_store_n(&tbl->mtu[ifi_index], mtu, __ATOMIC_RELAXED);
+
+    if (old_mtu != 0 && mtu != 0)
+    {
+        PRINT_LOG(0, NULL, false, "nfq_daemon: [interface %u] MTU changed "
+                  "from %d to %d\n", ifi_index, old_mtu, mtu);
+    }
 }
 
-void
-process_netlink_message(char *buf, int answer_size, if_mtu_list *if_mtu_list_entry)
+/**
+ * Update the MTU table from route netlink messages.
+ *
+ * @param buf           Buffer with messages.
+ * @param answer_size   Length of the messages.
+ *
+ * @return @c true if the end of a dump or an error is received,
+ *         @c false otherwise.
+ */
+static bool
+process_netlink_message(char *buf, int answer_size)
 {
     struct nlmsghdr     *nl_msg_ptr;
     struct ifinfomsg    *inf_msg_ptr;
@@ -166,7 +238,6 @@ process_netlink_message(char *buf, int answer_size, if_mtu_list *if_mtu_list_ent
     int                  attr_len;
     int                  tmp_len;
     int                  mtu;
-    int                  old_mtu;
 
     for (nl_msg_ptr = (struct nlmsghdr *)buf;
          answer_size > (int)sizeof(*nl_msg_ptr);)
@@ -176,43 +247,31 @@ process_netlink_message(char *buf, int answer_size, if_mtu_list *if_mtu_list_ent
         if (nl_msg_ptr->nlmsg_type == NLMSG_ERROR)
         {
             PRINT_LOG(0, NULL, true, NULL);
-            return;
-        }
-        if (!NLMSG_OK(nl_msg_ptr, (unsigned int)answer_size) ||
-            (nl_msg_ptr->nlmsg_type == NLMSG_DONE))
-        {
-            return;
+            return true;
         }
+        if (!NLMSG_OK(nl_msg_ptr, (unsigned int)answer_size))
+            return false;
+        if (nl_msg_ptr->nlmsg_type == NLMSG_DONE)
+            return true;
 
         inf_msg_ptr = (struct ifinfomsg *)NLMSG_DATA(nl_msg_ptr);
-        rta_ptr = (struct rtattr *)IFLA_RTA(inf_msg_ptr);
-
-        attr_len = IFLA_PAYLOAD(nl_msg_ptr);
 
-        for (; RTA_OK(rta_ptr, attr_len); rta_ptr = RTA_NEXT(rta_ptr, attr_len))
+        if (nl_msg_ptr->nlmsg_type == RTM_DELLINK)
         {
-            if (rta_ptr->rta_type == IFLA_MTU)
-            {
-                if (if_mtu_list_entry == NULL)
-                    if_mtu_list_entry = if_mtu_list_find(inf_msg_ptr->ifi_index);
-
-                if (if_mtu_list_entry == NULL)
-                    continue;
+            if_mtu_set(inf_msg_ptr->ifi_index, 0);
+        }
+        else if (nl_msg_ptr->nlmsg_type == RTM_NEWLINK)
+        {
+            rta_ptr = (struct rtattr *)IFLA_RTA(inf_msg_ptr);
+            attr_len = IFLA_PAYLOAD(nl_msg_ptr);
 
-                if (if_mtu_list_entry->ifi_index == inf_msg_ptr->ifi_index)
+            for (; RTA_OK(rta_ptr, attr_len);
+                 rta_ptr = RTA_NEXT(rta_ptr, attr_len))
+            {
+                if (rta_ptr->rta_type == IFLA_MTU)
                 {
                     memcpy(&mtu, RTA_DATA(rta_ptr), 4);
-
-                    old_mtu = if_mtu_list_entry->mtu;
-
-                    if (mtu != old_mtu)
-                    {
-                        if_mtu_list_entry->mtu = mtu;
-                        PRINT_LOG(0, NULL, false, "nfq_daemon: [interface %d] MTU changed "
-                                  "from %d to %d\n",
-                                  if_mtu_list_entry->ifi_index,
-                                  old_mtu, mtu);
-                    }
+                    if_mtu_set(inf_msg_ptr->ifi_index, mtu);
                 }
             }
         }
@@ -220,10 +279,16 @@ process_netlink_message(char *buf, int answer_size, if_mtu_list *if_mtu_list_ent
         answer_size -= NLMSG_ALIGN(tmp_len);
         nl_msg_ptr = (struct nlmsghdr *)((char *)nl_msg_ptr + NLMSG_ALIGN(tmp_len));
     }
+
+    return false;
 }
 
+/**
+ * Fill the MTU table with all existing interfaces. Interfaces created
+ * later are added by the netlink thread.
+ */
 void
-set_starting_mtu(if_mtu_list *if_mtu_list_entry)
+if_mtu_table_fill(void)
 {
     struct {
         struct nlmsghdr nl_msg;
@@ -232,7 +297,7 @@ set_starting_mtu(if_mtu_list *if_mtu_list_entry)
 
     int     sock;
     int     rv;
-    char    buf[4096];
+    char    buf[NETLINK_BUF_SIZE] __attribute__ ((aligned));
 
     memset(&standart_request, 0, sizeof(standart_request));
 
@@ -244,13 +309,11 @@ set_starting_mtu(if_mtu_list *if_mtu_list_entry)
 
     standart_request.nl_msg.nlmsg_len =
                      NLMSG_LENGTH(sizeof(struct ifinfomsg));
-    standart_request.nl_msg.nlmsg_flags = NLM_F_REQUEST | NLM_F_MATCH;
+    standart_request.nl_msg.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
     standart_request.nl_msg.nlmsg_type = RTM_GETLINK;
     standart_request.nl_msg.nlmsg_seq = 1;
 
-    standart_request.if_inform_msg.ifi_index = if_mtu_list_entry->ifi_index;
     standart_request.if_inform_msg.ifi_family = AF_UNSPEC;
-    standart_request.if_inform_msg.ifi_change = 0xffffffff;
 
     if ((rv = send(sock, &standart_request,
            standart_request.nl_msg.nlmsg_len, 0)) < 0)
@@ -259,28 +322,17 @@ set_starting_mtu(if_mtu_list *if_mtu_list_entry)
         exit(EXIT_FAILURE);
     }
 
-    if ((rv = recv(sock, buf, sizeof(buf), 0)) < 0)
-    {
-        PRINT_LOG(rv, NULL, true, NULL);
-        exit(EXIT_FAILURE);
-    }
-    else
-    {
-        process_netlink_message(buf, rv, if_mtu_list_entry);
-    }
+    do {
+        if ((rv = recv(sock, buf, sizeof(buf), 0)) < 0)
+        {
+            PRINT_LOG(rv, NULL, true, NULL);
+            exit(EXIT_FAILURE);
+        }
+    } while (rv > 0 && !process_netlink_message(buf, rv));
 
     close(sock);
 }
 
-if_mtu_list* if_mtu_list_real_add(int ifi_index)
-{
-    if_mtu_list* added = if_mtu_list_add(ifi_index, -1);
-
-    set_starting_mtu(added);
-
-    return added;
-}
-
 /**
  * Macros to check errno return value.
  *
@@ -305,11 +357,67 @@ if_mtu_list* if_mtu_list_real_add(int ifi_index)
         nfq_ip_set_checksum(ip_hdr);                                    \
     } while (0)
 
-/*
- * NFQUEUE handler
+/**
+ * NFQUEUE queue served by a thread.
+ */
+typedef struct nfq_worker {
+    unsigned int         queue_num;  /**< Queue number. */
+    struct nfq_handle   *h;          /**< NFQUEUE handler. */
+    struct nfq_q_handle *qh;         /**< Queue handler. */
+    char                *buf;        /**< Buffer to read packets to. */
+    int                  cpu;        /**< CPU to pin the thread to,
+                                          or @c -1. */
+    pthread_t            thread;     /**< Thread serving the queue. */
+    uint32_t             pending_id; /**< Highest ID of unchanged packets
+                                          waiting for a verdict. */
+    unsigned int         n_pending;  /**< Number of unchanged packets
+                                          waiting for a verdict. */
+} nfq_worker;
+
+/** Served queues. */
+static nfq_worker *workers = NULL;
+/** Number of served queues. */
+static unsigned int n_workers = 0;
+
+/**
+ * Accept all unchanged packets waiting for a verdict with a single
+ * batch verdict.
+ *
+ * @param w     Queue.
+ *
+ * @return Result of nfq_set_verdict_batch(), or @c 0 if there are no
+ *         such packets.
+ */
+static int
+verdict_flush(nfq_worker *w)
+{
+    if (w->n_pending == 0)
+        return 0;
+
+    w->n_pending = 0;
+    return nfq_set_verdict_batch(w->qh, w->pending_id, NF_ACCEPT);
+}
+
+/**
+ * Accept an unchanged packet. The verdict is deferred until
+ * @ref verdict_batch packets are collected, the end of the read batch,
+ * or the next changed packet, so the packets order is kept.
+ *
+ * @param w     Queue.
+ * @param id    Packet ID.
+ *
+ * @return Result of @ref verdict_flush, or @c 0 if the verdict is
+ *         deferred.
  */
-struct nfq_handle    *nfqueue_handle;
-struct nfq_q_handle  *qh;
+static int
+verdict_accept(nfq_worker *w, uint32_t id)
+{
+    w->pending_id = id;
+    if (++w->n_pending >= verdict_batch)
+        return verdict_flush(w);
+
+    return 0;
+}
 
 /**
  * Insert 4 IP options (NOP NOP NOP EOP) after @p fin
@@ -347,7 +455,7 @@ bytes_insert(uint8_t *packet_iterator, uint8_t *fin)
  * @param qh             Pointer to nfqueue queue handler
  * @param nfa            Pointer to data from nfqueue
  * @param nfmsg          Unused variable
- * @param data           Unused variable
+ * @param data           Pointer to @ref nfq_worker of the queue
  *
  * @return               Verdict on a packet
  */
@@ -355,6 +463,7 @@ static int
 packet_mangling(struct nfq_q_handle *qh, struct nfgenmsg *nfmsg,
                 struct nfq_data *nfa, void *data)
 {
+    nfq_worker         *w = data;
     struct nfqnl_msg_packet_hdr *ph = NULL;
     uint32_t            id = 0;
 
@@ -365,27 +474,24 @@ packet_mangling(struct nfq_q_handle *qh, struct nfgenmsg *nfmsg,
     uint8_t            *packet_iterator = NULL;
     uint8_t            *fin = NULL;
     int                 len = nfq_get_payload(nfa, &pkt_data);
-    struct pkt_buff    *pkBuff = pktb_alloc(AF_INET, pkt_data, len, 4);
+    struct pkt_buff    *pkBuff = NULL;
     int                 rc = 0;
     /* outdev - real interface where packet would be passed */
     uint32_t            ifi_index = nfq_get_outdev(nfa);
-    struct if_mtu_list *if_mtu_list_entry = if_mtu_list_find(ifi_index);
-
-    if (if_mtu_list_entry == NULL)
-        if_mtu_list_entry = if_mtu_list_real_add(ifi_index);
 
     ph = nfq_get_msg_packet_hdr(nfa);
     id = ntohl(ph->packet_id);
 
-    if (pkBuff == NULL)
-        return nfq_set_verdict(qh, id, NF_ACCEPT, 0, NULL);
+    /*
+     * We must not exceed MTU size when adding options. GSO packets
+     * passed with --gso are longer than MTU, so they are not changed.
+     */
+    if (len + IP_OPTIONS_LEN > if_mtu_get(ifi_index))
+        return verdict_accept(w, id);
 
-    /* We must not exceed MTU size when adding options. */
-    if (len + IP_OPTIONS_LEN > if_mtu_list_entry->mtu)
-    {
-        pktb_free(pkBuff);
-        return nfq_set_verdict(qh, id, NF_ACCEPT, 0, NULL);
-    }
+    pkBuff = pktb_alloc(AF_INET, pkt_data, len, 4);
+    if (pkBuff == NULL)
+        return verdict_accept(w, id);
 
     ip_hdr = nfq_ip_get_hdr(pkBuff);
     if (ip_hdr != NULL)
@@ -404,8 +510,13 @@ packet_mangling(struct nfq_q_handle *qh, struct nfgenmsg *nfmsg,
             {
                 fin = (uint8_t *)hdr + IP_OPTIONS_LEN;
                 add_ip_options(ip_hdr, packet_iterator, fin);
-                rc = nfq_set_verdict(qh, id, NF_ACCEPT, len + IP_OPTIONS_LEN,
-                                     pktb_data(pkBuff));
+                rc = verdict_flush(w);
+                if (rc >= 0)
+                {
+                    rc = nfq_set_verdict(qh, id, NF_ACCEPT,
+                                         len + IP_OPTIONS_LEN,
+                                         pktb_data(pkBuff));
+                }
                 pktb_free(pkBuff);
                 return rc;
             }
@@ -413,7 +524,260 @@ packet_mangling(struct nfq_q_handle *qh, struct nfgenmsg *nfmsg,
     }
 
     pktb_free(pkBuff);
-    return nfq_set_verdict(qh, id, NF_ACCEPT, 0, NULL);
+    return verdict_accept(w, id);
+}
+
+int
+set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    flags = flags | O_NONBLOCK;
+    return fcntl(fd, F_SETFL, flags);
+}
+
+/**
+ * Close NFQUEUE handler of a queue.
+ *
+ * @param w     Queue.
+ */
+static void
+queue_close(nfq_worker *w)
+{
+    if (w->qh != NULL)
+        nfq_destroy_queue(w->qh);
+    if (w->h != NULL)
+        nfq_close(w->h);
+    free(w->buf);
+
+    w->qh = NULL;
+    w->h = NULL;
+    w->buf = NULL;
+}
+
+/**
+ * Open NFQUEUE handler and bind it to a queue. Every queue has its own
+ * handler, so threads do not share netlink sockets.
+ *
+ * @param w         Queue.
+ * @param bind_pf   Whether to (re)bind the handler to @c AF_INET.
+ *
+ * @return @c 0 on success, @c -1 otherwise.
+ */
+static int
+queue_open(nfq_worker *w, bool bind_pf)
+{
+    uint32_t flags = 0;
+    int      ret;
+
+    w->h = nfq_open();
+    if (w->h == NULL)
+    {
+        PRINT_LOG(0, "nfq_daemon: nfq_open() returned "
+                  "unexpeced result: NULL\n", false, NULL);
+        return -1;
+    }
+
+    if (bind_pf)
+    {
+        if ((ret = nfq_unbind_pf(w->h, AF_INET)) < 0 ||
+            (ret = nfq_bind_pf(w->h, AF_INET)) < 0)
+        {
+            PRINT_LOG(ret, NULL, true, NULL);
+            goto fail;
+        }
+    }
+
+    w->qh = nfq_create_queue(w->h, w->queue_num, &packet_mangling, w);
+    if (w->qh == NULL)
+    {
+        PRINT_LOG(0, NULL, false, "nfq_daemon: nfq_create_queue(%u) "
+                  "returned unexpeced result: NULL\n", w->queue_num);
+        goto fail;
+    }
+
+    /* The whole packet is needed since the verdict replaces it. */
+    if ((ret = nfq_set_mode(w->qh, NFQNL_COPY_PACKET, MAX_PACKET_SIZE)) < 0)
+    {
+        PRINT_LOG(ret, NULL, true, NULL);
+        goto fail;
+    }
+
+    if (queue_gso)
+        flags |= NFQA_CFG_F_GSO;
+    if (queue_fail_open)
+        flags |= NFQA_CFG_F_FAIL_OPEN;
+    if (flags != 0 && (ret = nfq_set_queue_flags(w->qh, flags, flags)) < 0)
+    {
+        PRINT_LOG(ret, NULL, true, NULL);
+        goto fail;
+    }
+
+    if (queue_maxlen != 0 &&
+        (ret = nfq_set_queue_maxlen(w->qh, queue_maxlen)) < 0)
+    {
+        PRINT_LOG(ret, NULL, true, NULL);
+        goto fail;
+    }
+
+    if ((ret = nfnl_rcvbufsiz(nfq_nfnlh(w->h), MAX_PACKET_SIZE)) < 0)
+    {
+        PRINT_LOG(ret, NULL, true, NULL);
+        goto fail;
+    }
+
+    if ((ret = set_nonblock(nfq_fd(w->h))) < 0)
+    {
+        PRINT_LOG(ret, NULL, true, NULL);
+        goto fail;
+    }
+
+    w->buf = malloc(MAX_PACKET_SIZE);
+    if (w->buf == NULL)
+    {
+        PRINT_LOG(-1, NULL, true, NULL);
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    queue_close(w);
+    return -1;
+}
+
+/**
+ * Open NFQUEUE handlers of all queues from @ref queue_first to
+ * @ref queue_last.
+ *
+ * @return @c 0 on success, @c -1 otherwise.
+ */
+static int
+queues_open(void)
+{
+    int         *cpus = NULL;
+    int          n_cpus = 0;
+    unsigned int i;
+
+    if (queue_cpus != NULL &&
+        ol_parse_cpu_list(queue_cpus, &cpus, &n_cpus) != 0)
+    {
+        PRINT_LOG(0, NULL, false, "nfq_daemon: invalid CPU list %s\n",
+                  queue_cpus);
+        return -1;
+    }
+
+    n_workers = queue_last - queue_first + 1;
+    workers = calloc(n_workers, sizeof(*workers));
+    if (workers == NULL)
+    {
+        PRINT_LOG(-1, NULL, true, NULL);
+        free(cpus);
+        return -1;
+    }
+
+    for (i = 0; i < n_workers; i++)
+    {
+        workers[i].queue_num = queue_first + i;
+        workers[i].cpu = cpus != NULL ? cpus[i % n_cpus] : -1;
+
+        if (queue_open(&workers[i], i == 0) != 0)
+        {
+            while (i-- > 0)
+                queue_close(&workers[i]);
+            free(workers);
+            free(cpus);
+            return -1;
+        }
+    }
+
+    free(cpus);
+    return 0;
+}
+
+/**
+ * Thread serving a queue: read all available packets, handle them and
+ * accept the unchanged ones with one verdict.
+ *
+ * @param arg   Pointer to @ref nfq_worker.
+ *
+ * @return @c NULL, the process exits on error.
+ */
+static void *
+queue_thread(void *arg)
+{
+    nfq_worker    *w = arg;
+    struct pollfd  pfd;
+    int            rv;
+
+    pfd.fd = nfq_fd(w->h);
+    pfd.events = POLLIN;
+
+    while ((rv = poll(&pfd, 1, -1)) > 0 ||
+           (rv < 0 && errno == EINTR))
+    {
+        if (!(pfd.revents & POLLIN))
+            continue;
+
+        while ((rv = read(pfd.fd, w->buf, MAX_PACKET_SIZE)) > 0)
+            nfq_handle_packet(w->h, w->buf, rv);
+
+        if ((rv = verdict_flush(w)) < 0)
+            PRINT_LOG(rv, NULL, true, NULL);
+    }
+
+    PRINT_LOG(rv, NULL, false,
+              "nfq_daemon: queue %u failed after unexpected poll error "
+              "poll return: %d, errno: %s\n",
+              w->queue_num, rv, strerror(errno));
+
+    exit(EXIT_FAILURE);
+    return NULL;
+}
+
+/**
+ * Start a thread per queue, pinned to a CPU if it is specified.
+ *
+ * @return @c 0 on success, @c -1 otherwise.
+ */
+static int
+queue_threads_start(void)
+{
+    pthread_attr_t attr;
+    cpu_set_t      cpuset;
+    unsigned int   i;
+    int            rc;
+
+    if ((rc = pthread_attr_init(&attr)) != 0)
+    {
+        PRINT_LOG(rc, NULL, true, NULL);
+        return -1;
+    }
+
+    for (i = 0; i < n_workers; i++)
+    {
+        if (workers[i].cpu >= 0)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(workers[i].cpu, &cpuset);
+            if ((rc = pthread_attr_setaffinity_np(&attr, sizeof(cpuset),
+                                                  &cpuset)) != 0)
+            {
+                PRINT_LOG(rc, NULL, true, NULL);
+                break;
+            }
+        }
+
+        if ((rc = pthread_create(&workers[i].thread, &attr, queue_thread,
+                                 &workers[i])) != 0)
+        {
+            PRINT_LOG(rc, NULL, true, NULL);
+            break;
+        }
+    }
+
+    pthread_attr_destroy(&attr);
+
+    return rc == 0 ? 0 : -1;
 }
 
 /**
@@ -444,57 +808,9 @@ daemonize(void)
     {
         pid = getpid();
 
-        nfqueue_handle = nfq_open();
-        if (nfqueue_handle == NULL)
-        {
-            PRINT_LOG(0, "nfq_daemon: nfq_open() returned "
-                      "unexpeced result: NULL\n", false, NULL);
-            pid = -1;
-            goto cleanup;
-        }
-
-        if ((ret = nfq_unbind_pf(nfqueue_handle, AF_INET)) < 0)
-        {
-            PRINT_LOG(ret, NULL, true, NULL);
-            nfq_close(nfqueue_handle);
-            pid = -1;
-            goto cleanup;
-        }
-
-        if ((ret = nfq_bind_pf(nfqueue_handle, AF_INET)) < 0)
-        {
-            PRINT_LOG(ret, NULL, true, NULL);
-            nfq_close(nfqueue_handle);
-            pid = -1;
-            goto cleanup;
-        }
-
-        qh = nfq_create_queue(nfqueue_handle, 0, &packet_mangling, NULL);
-        if (qh == NULL)
-        {
-            PRINT_LOG(0, "nfq_daemon: nfq_create_queue() returned "
-                      "unexpeced result: NULL\n", false, NULL);
-            pid = -1;
-            goto cleanup;
-        }
-
-        if ((ret = nfq_set_mode(qh, NFQNL_COPY_PACKET, MAX_PACKET_SIZE)) < 0)
-        {
-            PRINT_LOG(ret, NULL, true, NULL);
-            nfq_destroy_queue(qh);
-            nfq_close(nfqueue_handle);
-            pid = -1;
-            goto cleanup;
-        }
-        if ((ret = nfnl_rcvbufsiz(nfq_nfnlh(nfqueue_handle), MAX_PACKET_SIZE)) < 0)
-        {
-            PRINT_LOG(ret, NULL, true, NULL);
-            nfq_destroy_queue(qh);
-            nfq_close(nfqueue_handle);
+        if (queues_open() != 0)
             pid = -1;
-        }
 
-cleanup:
         if ((ret = snprintf(out, sizeof(out), "%d", pid)) <= 0)
         {
             PRINT_LOG(ret, NULL, true, NULL);
@@ -558,31 +874,159 @@ get_netlink_socket()
     return sock;
 }
 
-int
-set_nonblock(int fd)
+/**
+ * Netlink thread: update the MTU table when interfaces are created,
+ * changed or removed.
+ *
+ * @param arg   Pointer to the netlink socket subscribed to link events.
+ *
+ * @return @c NULL, the process exits on error.
+ */
+static void *
+if_mtu_thread(void *arg)
 {
-    int flags = fcntl(fd, F_GETFL, 0);
-    flags = flags | O_NONBLOCK;
-    return fcntl(fd, F_SETFL, flags);
+    char          buf[NETLINK_BUF_SIZE] __attribute__ ((aligned));
+    struct pollfd pfd;
+    int           rv;
+
+    pfd.fd = *(int *)arg;
+    pfd.events = POLLIN;
+
+    while ((rv = poll(&pfd, 1, -1)) > 0 || (rv < 0 && errno == EINTR))
+    {
+        if (pfd.revents & POLLIN)
+        {
+            while ((rv = read(pfd.fd, buf, sizeof(buf))) > 0)
+                process_netlink_message(buf, rv);
+        }
+    }
+
+    PRINT_LOG(rv, NULL, false,
+              "nfq_daemon: failed after unexpected poll error "
+              "poll return: %d, errno: %s\n",
+              rv, strerror(errno));
+
+    exit(EXIT_FAILURE);
+    return NULL;
 }
 
 /**
- * Start a daemon that will open nfqueue hangler which binds to queue 0.
- * Set a @b packet_mangling as a callback function for every packet in this queue.
+ * Print usage to stderr.
  *
- * @return EXIT_SUCCESS If all packets from queue 0 was sent to callback function
- *                      and after that queue was successfully destroed.
- *         EXIT_FAILURE Otherwise.
+ * @param prog_name     Program name.
+ */
+static void
+usage(const char *prog_name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --queue-num N          serve queue N (default 0)\n"
+            "  --queue-balance N:M    serve queues N to M, one thread per "
+            "queue\n"
+            "  --cpus LIST            pin the thread of i-th queue to i-th "
+            "CPU of LIST, e.g. 0,2-3\n"
+            "  --batch N              accept up to N unchanged packets with "
+            "one verdict (default %d)\n"
+            "  --queue-maxlen N       kernel queue length\n"
+            "  --gso                  do not segment GSO packets before "
+            "queueing, they are passed unchanged\n"
+            "  --fail-open            accept packets if a queue is full\n",
+            prog_name, DEFAULT_VERDICT_BATCH);
+}
+
+/**
+ * Parse command line options.
+ *
+ * @return @c 0 on success, @c -1 otherwise.
+ */
+static int
+parse_opts(int argc, char **argv)
+{
+    static const struct option long_opts[] = {
+        { "queue-num", required_argument, NULL, 'q' },
+        { "queue-balance", required_argument, NULL, 'Q' },
+        { "cpus", required_argument, NULL, 'c' },
+        { "batch", required_argument, NULL, 'b' },
+        { "queue-maxlen", required_argument, NULL, 'l' },
+        { "gso", no_argument, NULL, 'g' },
+        { "fail-open", no_argument, NULL, 'f' },
+        { NULL, 0, NULL, 0 },
+    };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'q':
+                if (sscanf(optarg, "%u", &queue_first) != 1)
+                    return -1;
+                queue_last = queue_first;
+                break;
+
+            case 'Q':
+                if (sscanf(optarg, "%u:%u", &queue_first, &queue_last) != 2 ||
+                    queue_last < queue_first)
+                {
+                    return -1;
+                }
+                break;
+
+            case 'c':
+                queue_cpus = optarg;
+                break;
+
+            case 'b':
+                if (sscanf(optarg, "%u", &verdict_batch) != 1 ||
+                    verdict_batch == 0)
+                {
+                    return -1;
+                }
+                break;
+
+            case 'l':
+                if (sscanf(optarg, "%u", &queue_maxlen) != 1)
+                    return -1;
+                break;
+
+            case 'g':
+                queue_gso = true;
+                break;
+
+            case 'f':
+                queue_fail_open = true;
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    return optind == argc ? 0 : -1;
+}
+
+/**
+ * Start a daemon that will open nfqueue handlers which bind to queues
+ * specified by command line options (queue 0 by default). Set
+ * a @b packet_mangling as a callback function for every packet in these
+ * queues. Every queue is served by its own thread, interfaces MTU is
+ * tracked by a dedicated netlink thread.
+ *
+ * @return EXIT_FAILURE on error, otherwise the daemon runs until it is
+ *         killed.
  */
 int
-main(void)
+main(int argc, char **argv)
 {
-    int                   nfqueue_fd;
     int                   netlink_fd;
-    char                  buf[MAX_PACKET_SIZE] __attribute__ ((aligned));
     int                   rv = 0;
-    int                   nfds = 2;
-    struct pollfd         pfds[nfds];
+    pthread_t             netlink_thread;
+
+    if (parse_opts(argc, argv) != 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
 
     PRINT_LOG(0, "nfq_daemon: starting\n", false, NULL);
 
@@ -590,7 +1034,6 @@ main(void)
 
     PRINT_LOG(0, "nfq_daemon: successfully started\n", false, NULL);
 
-    nfqueue_fd = nfq_fd(nfqueue_handle);
     netlink_fd = get_netlink_socket();
     if (netlink_fd < 0)
     {
@@ -598,38 +1041,20 @@ main(void)
         return EXIT_FAILURE;
     }
 
-    pfds[0].fd = netlink_fd;
-    pfds[0].events = POLLIN;
+    if_mtu_table_fill();
 
-    if ((rv = set_nonblock(nfqueue_fd)) < 0)
+    if ((rv = pthread_create(&netlink_thread, NULL, if_mtu_thread,
+                             &netlink_fd)) != 0)
     {
         PRINT_LOG(rv, NULL, true, NULL);
         return EXIT_FAILURE;
     }
-    pfds[1].fd = nfqueue_fd;
-    pfds[1].events = POLLIN;
 
-    while ((rv = poll(pfds, nfds, -1)) > 0)
-    {
-        if (pfds[0].revents & POLLIN)
-        {
-            while ((rv = read(pfds[0].fd, buf, sizeof(buf))) > 0)
-                process_netlink_message(buf, rv, NULL);
-        }
-        if (pfds[1].revents & POLLIN)
-        {
-            while ((rv = read(pfds[1].fd, buf, sizeof(buf))) > 0)
-                nfq_handle_packet(nfqueue_handle, buf, rv);
-        }
-    }
-
-    PRINT_LOG(rv, NULL, false,
-              "nfq_daemon: failed after unexpected poll error "
-              "poll return: %d, errno: %s\n",
-              rv, strerror(errno));
+    if (queue_threads_start() != 0)
+        return EXIT_FAILURE;
 
-    CHECK_ERRNO_RET(nfq_destroy_queue(qh));
-    CHECK_ERRNO_RET(nfq_close(nfqueue_handle));
+    /* Threads exit the process on error. */
+    pthread_join(netlink_thread, NULL);
 
-    return EXIT_SUCCESS;
+    return EXIT_FAILURE;
 }
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Micro-benchmark of ring buffers used to pass timestamps between threads.
+ *
+ * A producer thread pushes @c --count entries of the apprtt sample size
+ * and a consumer thread pops them. The average cost of one push/pop pair
+ * is reported in nanoseconds for the lock-free SPSC ring (single and
+ * batch pop) and for the mutex-protected ol_ringbuffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "ol_cmdline.h"
+#include "ol_ringbuf.h"
+#include "ol_spsc_ring.h"
+
+/** Entry of the same size as apprtt timestamp sample. */
+typedef struct ringbench_entry
+{
+    unsigned char   id;
+    uint64_t        ts;
+} ringbench_entry;
+
+/** Maximum batch size of consumer. */
+#define RINGBENCH_MAX_BATCH 1024
+
+/** Ring buffer implementation under test. */
+typedef enum ringbench_kind {
+    RINGBENCH_SPSC,     /**< ol_spsc_ring */
+    RINGBENCH_MUTEX,    /**< ol_ringbuffer */
+} ringbench_kind;
+
+/** Benchmark context shared by producer and consumer. */
+typedef struct ringbench_ctx
+{
+    ringbench_kind  kind;       /**< Ring implementation. */
+    ol_spsc_ring   *spsc;       /**< SPSC ring. */
+    ol_ringbuffer  *mutex;      /**< Mutex-protected ring. */
+    uint64_t        count;      /**< Number of entries to pass. */
+    size_t          batch;      /**< Consumer batch size. */
+    bool            failed;     /**< Consumer got unexpected entry. */
+} ringbench_ctx;
+
+static bool print_help = false;
+static int  count = 10000000;
+static int  capacity = 4096;
+static int  batch = 64;
+
+static ol_cmdline_opt opts[] =
+{
+    {"count", OL_OPT_INT, &count, "Number of entries to pass"},
+    {"capacity", OL_OPT_INT, &capacity, "Ring buffer capacity"},
+    {"batch", OL_OPT_INT, &batch, "Maximum number of entries popped at once"},
+    {"help", OL_OPT_FLAG, &print_help, "Print help"},
+};
+#define OPTS_NUM (sizeof(opts) / sizeof(opts[0]))
+
+static uint64_t
+ringbench_now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void *
+ringbench_consumer(void *arg)
+{
+    ringbench_ctx      *ctx = arg;
+    ringbench_entry     es[RINGBENCH_MAX_BATCH];
+    uint64_t            expected = 0;
+    size_t              n;
+    size_t              i;
+
+    while (expected < ctx->count)
+    {
+        if (ctx->kind == RINGBENCH_SPSC)
+        {
+            n = ol_spsc_ring_pop_batch(ctx->spsc, es, ctx->batch);
+        }
+        else
+        {
+            n = 0;
+            while (n < ctx->batch && !is_empty(ctx->mutex) &&
+                   ol_ringbuf_pop(ctx->mutex, &es[n]) == 0)
+            {
+                ++n;
+            }
+        }
+
+        /* Let the producer run if both threads share a CPU. */
+        if (n == 0)
+            sched_yield();
+
+        for (i = 0; i < n; ++i, ++expected)
+        {
+            if (es[i].ts != expected)
+            {
+                printf("ringbench: got entry %lu instead of %lu\n",
+                       es[i].ts, expected);
+                __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+                return NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int
+ringbench_run(ringbench_ctx *ctx, const char *name)
+{
+    pthread_t       consumer;
+    ringbench_entry e = {0};
+    uint64_t        start;
+    uint64_t        elapsed;
+    uint64_t        i;
+    int             rc;
+
+    ctx->failed = false;
+
+    rc = pthread_create(&consumer, NULL, ringbench_consumer, ctx);
+    if (rc != 0)
+    {
+        printf("ringbench: pthread_create error %s\n", strerror(rc));
+        return -1;
+    }
+
+    start = ringbench_now_ns();
+    for (i = 0; i < ctx->count; ++i)
+    {
+        e.id = i;
+        e.ts = i;
+
+        if (ctx->kind == RINGBENCH_SPSC)
+        {
+            while (ol_spsc_ring_push(ctx->spsc, &e) != 0)
+            {
+                if (__atomic_load_n(&ctx->failed, __ATOMIC_RELAXED))
+                    break;
+                sched_yield();
+            }
+        }
+        else
+        {
+            /* Avoid error message printed on full buffer. */
+            while (__atomic_load_n(&ctx->mutex->length, __ATOMIC_ACQUIRE) ==
+                   ctx->mutex->capacity)
+            {
+                if (__atomic_load_n(&ctx->failed, __ATOMIC_RELAXED))
+                    break;
+                sched_yield();
+            }
+            if (!__atomic_load_n(&ctx->failed, __ATOMIC_RELAXED))
+                ol_ringbuf_push(ctx->mutex, &e);
+        }
+
+        /* The consumer has stopped, nobody will drain the ring. */
+        if (__atomic_load_n(&ctx->failed, __ATOMIC_RELAXED))
+            break;
+    }
+
+    pthread_join(consumer, NULL);
+    elapsed = ringbench_now_ns() - start;
+
+    if (ctx->failed)
+        return -1;
+
+    printf("%-16s %10lu entries %10.2f ns/entry %12.0f entries/s\n", name,
+           ctx->count, (double)elapsed / ctx->count,
+           ctx->count * 1e9 / elapsed);
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    ringbench_ctx   ctx = {0};
+    int             ret;
+    int             i;
+
+    ret = ol_cmdline_getopt(argc, argv, opts, OPTS_NUM);
+    if (ret != 0 || print_help || count <= 0 || capacity <= 0 ||
+        batch <= 0 || batch > RINGBENCH_MAX_BATCH)
+    {
+        printf("\nUsage: %s [options]\n\noptions:\n", basename(argv[0]));
+        for (i = 0; i < OPTS_NUM; ++i)
+            printf("    --%-20s -- %s\n", opts[i].name, opts[i].usage);
+        return print_help ? 0 : -1;
+    }
+
+    ctx.count = count;
+    ctx.spsc = ol_spsc_ring_new(sizeof(ringbench_entry), capacity);
+    ctx.mutex = ol_ringbuf_new(sizeof(ringbench_entry), capacity);
+    if (ctx.spsc == NULL || ctx.mutex == NULL)
+    {
+        printf("ringbench: failed to create ring buffers\n");
+        return -1;
+    }
+
+    ctx.kind = RINGBENCH_SPSC;
+    ctx.batch = 1;
+    ret = ringbench_run(&ctx, "spsc");
+
+    ctx.batch = batch;
+    if (ret == 0)
+        ret = ringbench_run(&ctx, "spsc-batch");
+
+    ctx.kind = RINGBENCH_MUTEX;
+    if (ret == 0)
+        ret = ringbench_run(&ctx, "mutex");
+
+    ol_spsc_ring_free(ctx.spsc);
+    ol_ringbuf_free(ctx.mutex);
+
+    return ret;
+}
@@ -64,6 +64,9 @@ Options:
                             appropriate actions. For now: do not clear kmemleak
                             on debugging kernels.
   --logs-history=<link>     Link to logs history
+  --perf-baseline=<dir>     Directory with performance baseline, performance
+                            tests fail on significant regression against it
+  --perf-baseline-update    Save results of performance tests as new baseline
 EOF
     call_if_defined grab_cfg_print_help
 
@@ -214,6 +217,12 @@ while test -n "$1" ; do
             # Link to logs history
             export TE_NIGHT_LOGS_HISTORY=${1#--logs-history=}
             ;;
+        --perf-baseline=*)
+            export SOCKTS_PERF_BASELINE_DIR="$(realpath -m "${1#--perf-baseline=}")"
+            ;;
+        --perf-baseline-update)
+            export SOCKTS_PERF_BASELINE_UPDATE=yes
+            ;;
         --build-only)
             export TE_TS_BUILD_ONLY="yes"
             ;;&
@@ -288,6 +297,10 @@ if [[ "$TE_TS_BUILD_ONLY" != "yes" ]] ; then
     AUX_REQS=$(${RUNDIR}/scripts/ool_fix_reqs.py --ools="$OOL_SET" --iut_drv="$iut_drv")
     RUN_OPTS="${RUN_OPTS} ${AUX_REQS}"
 
+    # Performance baseline is kept per configuration and set of ools
+    export SOCKTS_PERF_CFG="${cfg}"
+    export SOCKTS_PERF_OOL="$(echo $OOL_SET | tr ' ' '\n' | sort -u | paste -sd, -)"
+
     RUN_OPTS="$RUN_OPTS $OOL_PROFILE"
     for i in $OOL_SET ; do
         if [[ "$i" == "hwport2" ]] ; then
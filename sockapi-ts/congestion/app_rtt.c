@@ -53,6 +53,12 @@
  *                          - @c 1
  *                          - @c 10
  *                          - @c 20
+ * @param flows             Number of TCP connections of ol-apprtt which
+ *                          share the bottleneck, every connection is
+ *                          served by its own client thread:
+ *                          - @c 1
+ *                          - @c 4
+ *                          - @c 8
  *
  * @par Scenario:
  *
@@ -130,6 +136,10 @@ typedef struct sockts_ct_stats {
     int mean;
     /**< Median value. */
     int median;
+    /**< 99th percentile. */
+    int p99;
+    /**< Standard deviation. */
+    double stddev;
     /**< Percent of values that are out of the acceptable range. */
     double out_of_range;
     /**< Number of TCP retransmissons. */
@@ -165,6 +175,10 @@ static const sockts_ct_stats acc_vals_map[] =
     [CT_NORMAL_BUF_ID] = {
         /* Don't check median value */
         .median         = CT_DONT_CHECK_STAT,
+        /* Maximum acceptable 99th percentile of RTT values in us, it is
+         * not checked until values for the lab are known
+         */
+        .p99            = CT_DONT_CHECK_STAT,
         /* Maximum acceptable difference between mean and median values
          * in percent
          */
@@ -179,18 +193,21 @@ static const sockts_ct_stats acc_vals_map[] =
     },
     [CT_SMALL_BUF_ID] = {
         .median         = CT_DONT_CHECK_STAT,
+        .p99            = CT_DONT_CHECK_STAT,
         .mean           = 20,
         .out_of_range   = 50,
         .retrans_num    = 1050
     },
     [CT_SLOW_START_ID] = {
         .median         = CT_DONT_CHECK_STAT,
+        .p99            = CT_DONT_CHECK_STAT,
         .mean           = 20,
         .out_of_range   = 50,
         .retrans_num    = 50
     },
     [CT_SLOW_START_NOSACK_ID] = {
         .median         = CT_DONT_CHECK_STAT,
+        .p99            = CT_DONT_CHECK_STAT,
         .mean           = 50,
         /*
          * Deltas of RTT values are too big at slow start phase without SACK.
@@ -202,6 +219,7 @@ static const sockts_ct_stats acc_vals_map[] =
     },
     [CT_HIGH_RATE_ID] = {
         .median         = CT_DONT_CHECK_STAT,
+        .p99            = CT_DONT_CHECK_STAT,
         .mean           = 10,
         .out_of_range   = 25,
         .retrans_num    = 375
@@ -274,12 +292,18 @@ sockts_ct_add_sniffer(rcf_rpc_server *pco_tst, const struct if_nameindex *tst_if
 
 /**
  * Get TCP retransmissions for chunks from pcap file for one direction of
- * connection.
+ * all the connections to @p ns_addr. Chunks of every connection are
+ * numbered from its start, retransmissions in chunks with the same
+ * number are summed.
  *
  * @param[in]   sniff           Sniffer handler.
- * @param[in]   ns_addr         Destination address to choose TCP connection and
- *                              direction.
+ * @param[in]   ns_addr         Destination address to choose TCP connections
+ *                              and direction.
  * @param[in]   chunk_size      Chunk size.
+ * @param[in]   skip_chunks     Number of the first chunks of every
+ *                              connection which are not counted in
+ *                              @p retrans_num.
+ * @param[out]  retrans_num     Total number of TCP retransmissions.
  * @param[out]  retrans         Pointer to array with TCP retansmissions.
  * @param[out]  retrans_size    Pointer to @p retrans size.
  *
@@ -292,11 +316,19 @@ static te_errno
 sockts_ct_get_retrans_from_pcap(tapi_sniffer_id *sniff,
                                 struct sockaddr *ns_addr,
                                 unsigned int chunk_size,
+                                unsigned int skip_chunks,
+                                int *retrans_num,
                                 int **retrans,
                                 unsigned int *retrans_size)
 {
     char *caps_path = getenv("TE_SNIFF_LOG_DIR");
     char pcap_file[1024];
+    char filter[1024];
+    sockts_pcap_tcp_opts opts;
+    sockts_pcap_tcp_flow *flow;
+    te_vec flows;
+    unsigned int size = 0;
+    unsigned int i;
     te_errno rc;
 
     if (caps_path == NULL || strlen(caps_path) == 0)
@@ -309,8 +341,47 @@ sockts_ct_get_retrans_from_pcap(tapi_sniffer_id *sniff,
          sniff->ifname, sniff->ssn, sniff->snifname);
     snprintf(pcap_file, sizeof(pcap_file), "%s/%s_%s_%d_%s.pcap", caps_path,
              sniff->ta, sniff->ifname, sniff->ssn, sniff->snifname);
-    return sockts_pcap_get_retrans(pcap_file, ns_addr, chunk_size, retrans,
-                                   retrans_size);
+    snprintf(filter, sizeof(filter), "dst %s",
+             te_sockaddr_get_ipstr(ns_addr));
+
+    memset(&opts, 0, sizeof(opts));
+    opts.filter = filter;
+    opts.chunk_size = chunk_size;
+
+    rc = sockts_pcap_tcp_flows_get(pcap_file, &opts, &flows);
+    if (rc != 0)
+        return rc;
+
+    sockts_pcap_tcp_flows_log(&flows);
+
+    TE_VEC_FOREACH(&flows, flow)
+        size = MAX(size, te_vec_size(&flow->chunk_retrans));
+
+    if (size == 0)
+    {
+        ERROR("No TCP data packets are found in the capture");
+        sockts_pcap_tcp_flows_free(&flows);
+        return TE_ENODATA;
+    }
+
+    *retrans = TE_ALLOC(size * sizeof(int));
+    *retrans_size = size;
+    *retrans_num = 0;
+
+    TE_VEC_FOREACH(&flows, flow)
+    {
+        for (i = 0; i < te_vec_size(&flow->chunk_retrans); i++)
+        {
+            int val = *(int *)te_vec_get(&flow->chunk_retrans, i);
+
+            (*retrans)[i] += val;
+            if (i >= skip_chunks)
+                *retrans_num += val;
+        }
+    }
+
+    sockts_pcap_tcp_flows_free(&flows);
+    return 0;
 }
 
 /**
@@ -319,8 +390,8 @@ sockts_ct_get_retrans_from_pcap(tapi_sniffer_id *sniff,
  *
  * @param[in]   rtt_vals        Vector with app level RTT values.
  * @param[in]   retrans_num     Number of TCP retransmissons.
- * @param[in]   acceptable_vals Acceptable values but median value should be
- *                              the difference between it and mean value in
+ * @param[in]   acceptable_vals Acceptable values but mean value should be
+ *                              the difference between it and median value in
  *                              percentage (@c CT_DONT_CHECK_STAT can be set to
  *                              don't check the statistic).
  * @param[out]  vals            Calculated statistic values.
@@ -337,16 +408,40 @@ sockts_ct_get_and_process_stats(te_vec *rtt_vals,
 {
     te_errno rc = 0;
     sockts_stats_int rtt_stats;
+    sockts_stats_u64 rtt_tail;
     double mean_diff;
+    double mean_ci;
     unsigned int out_range_num;
     double out_range_percent;
+    int p99;
+    int *rtt_val;
 
     rc = sockts_stats_int_get(rtt_vals, &rtt_stats);
     if (rc != 0)
         TEST_FAIL("Failed to get app level RTT statistics");
 
+    rc = sockts_stats_u64_init(&rtt_tail, SOCKTS_STATS_PRECISION_DEF);
+    if (rc != 0)
+        TEST_FAIL("Failed to initialize app level RTT statistics");
+    TE_VEC_FOREACH(rtt_vals, rtt_val)
+        sockts_stats_u64_add(&rtt_tail, *rtt_val);
+
     TEST_ARTIFACT("Median app level RTT = %d us", rtt_stats.median);
 
+    p99 = sockts_stats_u64_pct(&rtt_tail, 99);
+    TEST_ARTIFACT("99th percentile of app level RTT = %d us, 99.9th "
+                  "percentile = %llu us", p99,
+                  (unsigned long long)sockts_stats_u64_pct(&rtt_tail, 99.9));
+    RING("Maximum acceptable 99th percentile of app level RTT is %d",
+         acceptable_vals->p99);
+
+    if (sockts_stats_u64_mean_ci(&rtt_tail, 95, &mean_ci) == 0)
+    {
+        RING("App level RTT: mean %.1f us +- %.1f us (95%% confidence), "
+             "standard deviation %.1f us", rtt_tail.mean, mean_ci,
+             sockts_stats_u64_stddev(&rtt_tail));
+    }
+
     mean_diff = 100 * (((rtt_stats.median > rtt_stats.mean) ?
                   (rtt_stats.median - rtt_stats.mean) :
                   (rtt_stats.mean - rtt_stats.median)) / (double)rtt_stats.median);
@@ -377,6 +472,13 @@ sockts_ct_get_and_process_stats(te_vec *rtt_vals,
         ERROR_VERDICT("The median of app level RTT values is more than "
                       "acceptable.");
     }
+    if (acceptable_vals->p99 != CT_DONT_CHECK_STAT &&
+        p99 > acceptable_vals->p99)
+    {
+        *test_failed = TRUE;
+        ERROR_VERDICT("The 99th percentile of app level RTT values is more "
+                      "than acceptable.");
+    }
     if (acceptable_vals->mean != CT_DONT_CHECK_STAT &&
         mean_diff > acceptable_vals->mean)
     {
@@ -403,10 +505,13 @@ sockts_ct_get_and_process_stats(te_vec *rtt_vals,
     {
         vals->mean = rtt_stats.mean;
         vals->median = rtt_stats.median;
+        vals->p99 = p99;
+        vals->stddev = sockts_stats_u64_stddev(&rtt_tail);
         vals->out_of_range = out_range_percent;
         vals->retrans_num = retrans_num;
     }
 
+    sockts_stats_u64_free(&rtt_tail);
     return 0;
 }
 
@@ -454,6 +559,7 @@ main(int argc, char *argv[])
     int                *retrans = NULL;
     unsigned int        retrans_size;
     int timeout_s;
+    int flows;
 
     TEST_START;
     TEST_GET_PCO(pco_iut);
@@ -469,6 +575,7 @@ main(int argc, char *argv[])
     TEST_GET_CT_STIMULUS_PARAM(stimulus);
     TEST_GET_INT_PARAM(stimulus_param);
     TEST_GET_INT_PARAM(rate);
+    TEST_GET_INT_PARAM(flows);
 
     TEST_STEP("Set TCP options");
     TEST_SUBSTEP("Set \"tcp_timestamps\" option according to @p set_ts");
@@ -513,6 +620,13 @@ main(int argc, char *argv[])
         client_opts.prefix = NULL;
     client_opts.srv_addr = ns_addr;
     client_opts.chunk_size = server_opts.chunk_size = chunk_size;
+    /* RTT values order is needed to skip slow start and draw a graph. */
+    client_opts.report = SOCKTS_APPRTT_REPORT_SAMPLES;
+    client_opts.connections = server_opts.connections = flows;
+    client_opts.threads = flows;
+    client_opts.cpus = NULL;
+    client_opts.rate = 0;
+    client_opts.poisson = FALSE;
     server_opts.prefix = NULL;
     /* Test duration is @c CT_APPRTT_DURATION_SEC seconds but if @p stimulus
      * slow start is tested, the duration is @CT_SLOW_START_TIMEOUT seconds.
@@ -622,6 +736,14 @@ main(int argc, char *argv[])
     if (CT_AGGRESSIVE_STIMULUS)
         acceptable_vals.mean = CT_AGGR_STIM_MEAN;
 
+    /*
+     * Acceptable numbers of retransmissions are known for a single
+     * connection only, with several flows sharing the bottleneck they are
+     * just reported.
+     */
+    if (flows > 1)
+        acceptable_vals.retrans_num = CT_DONT_CHECK_STAT;
+
     if (!slow_start_stim)
     {
         rc = sockts_stats_int_get(&rtt_values, &rtt_stats);
@@ -631,6 +753,8 @@ main(int argc, char *argv[])
          * N = (5 * throughput_bytes_per_sec * app_rtt_in_us) / 1000000 / chunk_size,
          * where 5 is the coefficient from experiments with Linux CUBIC algorithm and
          * app_rtt_in_us - the median of all app level RTT values of TCP connection.
+         * With several flows every flow gets its share of throughput, but RTT
+         * values of all flows are interleaved, so N is the same.
          */
         slow_start_in_chunks = (5ull * CT_BTLNCK_TBF_DEFAULT_RATE * rtt_stats.median) /
                                chunk_size / 1000000;
@@ -655,6 +779,8 @@ main(int argc, char *argv[])
               "captured pcap file (don't get into account slow start state "
               "if @p stimulus isn't slow start).");
     TEST_SUBSTEP("Calculate the median app level RTT value.");
+    TEST_SUBSTEP("Calculate the 99th and 99.9th percentiles of app level RTT "
+                 "values.");
     TEST_SUBSTEP("Calculate the mean app level RTT value and the percentage "
                  "by how much the mean is greater or lower than the median.");
     TEST_SUBSTEP("Calculate the percent of values that are out of the [A, B] "
@@ -662,13 +788,13 @@ main(int argc, char *argv[])
                  "and B = median + @c CT_VALID_RANGE_WIDTH percent.");
     TEST_SUBSTEP("Calculate the number of TCP retransmissions.");
     TEST_STEP("Check that statistics are acceptable.");
-    CHECK_RC(sockts_ct_get_retrans_from_pcap(sniff, ns_addr, chunk_size,
-                                             &retrans, &retrans_size));
-    /* Skip the first @p slow_start_in_chunks chunks in total sum of TCP
-     * retransmissions.
+    /* Skip the first @p slow_start_in_chunks chunks of every connection in
+     * total sum of TCP retransmissions.
      */
-    for (i = slow_start_in_chunks; i < retrans_size; i++)
-        retrans_num += retrans[i];
+    CHECK_RC(sockts_ct_get_retrans_from_pcap(sniff, ns_addr, chunk_size,
+                                             slow_start_in_chunks,
+                                             &retrans_num, &retrans,
+                                             &retrans_size));
     rc = sockts_ct_get_and_process_stats(&rtt_values_for_stats, retrans_num,
                                          &acceptable_vals, &stats, &test_failed);
     if (rc != 0)
@@ -682,6 +808,10 @@ main(int argc, char *argv[])
     CHECK_RC(te_mi_log_meas("ol-apprtt",
         TE_MI_MEAS_V(TE_MI_MEAS(RTT, "App level RTT", MEDIAN, stats.median, MICRO),
                      TE_MI_MEAS(RTT, "App level RTT", MEAN, stats.mean, MICRO),
+                     TE_MI_MEAS(RTT, "App level RTT", PERCENTILE, stats.p99,
+                                MICRO),
+                     TE_MI_MEAS(RTT, "App level RTT", STDEV, stats.stddev,
+                                MICRO),
                      TE_MI_MEAS(RTT, "App level RTT", OUT_OF_RANGE,
                                 stats.out_of_range, PLAIN),
                      TE_MI_MEAS(RETRANS, "Number of TCP retransmissions",
@@ -58,6 +58,55 @@
  */
 #define LOOP_DURATION 5000
 
+/**
+ * Print histograms of deviation of iomux wait time from the timeout.
+ *
+ * @param iomux       Iomux function.
+ * @param stats       Wait time statistics.
+ * @param late        Histogram of overshoot.
+ * @param early       Histogram of undershoot.
+ */
+static void
+print_timeout_hist(iomux_call_type iomux,
+                   const tarpc_sockts_iomux_timeout_stats *stats,
+                   const uint64_t *late, const uint64_t *early)
+{
+    te_string   str = TE_STRING_INIT;
+    int         i;
+
+    te_string_append(&str, "%s() wait time over %llu calls, ns: "
+                     "min %llu, p50 %llu, p99 %llu, p99.9 %llu, "
+                     "max %llu\n", iomux_call_en2str(iomux),
+                     (unsigned long long)stats->calls,
+                     (unsigned long long)stats->wait_min,
+                     (unsigned long long)stats->wait_p50,
+                     (unsigned long long)stats->wait_p99,
+                     (unsigned long long)stats->wait_p999,
+                     (unsigned long long)stats->wait_max);
+    te_string_append(&str, "%20s%15s%15s\n", "DEVIATION (us)",
+                     "LATE", "EARLY");
+
+    for (i = 0; i < SOCKTS_IOMUX_TIMEOUT_HIST_SIZE; i++)
+    {
+        if (late[i] == 0 && early[i] == 0)
+            continue;
+
+        if (i == 0)
+            te_string_append(&str, "%20s", "< 1");
+        else if (i == SOCKTS_IOMUX_TIMEOUT_HIST_SIZE - 1)
+            te_string_append(&str, "%19s%u", ">= ", 1u << (i - 1));
+        else
+            te_string_append(&str, "%12u - %5u", 1u << (i - 1), 1u << i);
+
+        te_string_append(&str, "%15llu%15llu\n",
+                         (unsigned long long)late[i],
+                         (unsigned long long)early[i]);
+    }
+
+    RING("%s", str.ptr);
+    te_string_free(&str);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -81,6 +130,10 @@ main(int argc, char *argv[])
     uint64_t expected;
     int timeout;
 
+    tarpc_sockts_iomux_timeout_stats stats;
+    uint64_t late[SOCKTS_IOMUX_TIMEOUT_HIST_SIZE];
+    uint64_t early[SOCKTS_IOMUX_TIMEOUT_HIST_SIZE];
+
     /* Preambule */
     TEST_START;
 
@@ -130,16 +183,21 @@ main(int argc, char *argv[])
               "zero events terminating due to @p timeout, and returned "
               "events fields were cleared by each @b iomux call (for "
               "@b select() and @b poll() calls).");
+    TEST_SUBSTEP("Measure wait time of every @p iomux call and print "
+                 "histograms of its deviation from @p timeout.");
 
     RPC_AWAIT_ERROR(pco_iut);
-    rc = rpc_sockts_iomux_timeout_loop(pco_iut, iomux, fds, TST_CONNECTIONS,
-                                       timeout, n_calls);
+    rc = rpc_sockts_iomux_timeout_loop_gen(pco_iut, iomux, fds,
+                                           TST_CONNECTIONS, timeout,
+                                           n_calls, &stats, late, early);
     if (rc < 0)
     {
         TEST_VERDICT("rpc_sockts_iomux_timeout_loop() failed unexpectedly "
                      "with error " RPC_ERROR_FMT, RPC_ERROR_ARGS(pco_iut));
     }
 
+    print_timeout_hist(iomux, &stats, late, early);
+
     TEST_STEP("Check that the time it took to call "
               "@b rpc_sockts_iomux_timeout_loop() matches @p timeout "
               "multiplied by the number of times @p iomux was called.");
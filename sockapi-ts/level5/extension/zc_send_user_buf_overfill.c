@@ -125,6 +125,7 @@ main(int argc, char *argv[])
     rpc_ptr buf_ptr = RPC_NULL;
     rpc_onload_zc_handle buf_handle = RPC_NULL;
     rpc_ptr compl_queue = RPC_NULL;
+    tarpc_sockts_zc_compl_stats compl_stats;
 
     struct rpc_onload_zc_mmsg mmsg;
     rpc_iovec iovs[MAX_IOVS];
@@ -315,6 +316,38 @@ main(int argc, char *argv[])
                      "the end");
     }
 
+    TEST_STEP("Get statistics of the completion queue, check that no "
+              "ZC buffers are left waiting for completion or dropped "
+              "and log completion latency.");
+    rpc_sockts_zc_compl_queue_stats(pco_iut, compl_queue, FALSE,
+                                    &compl_stats);
+    RING("ZC buffers: %" TE_PRINTF_64 "u completed, %" TE_PRINTF_64 "u "
+         "dropped, at most %u in flight; completion latency over the "
+         "last %u buffers: min %" TE_PRINTF_64 "u ns, p50 %"
+         TE_PRINTF_64 "u ns, p99 %" TE_PRINTF_64 "u ns, max %"
+         TE_PRINTF_64 "u ns", compl_stats.completed, compl_stats.dropped,
+         compl_stats.max_in_flight, compl_stats.lat_num,
+         compl_stats.lat_min, compl_stats.lat_p50, compl_stats.lat_p99,
+         compl_stats.lat_max);
+    if (compl_stats.in_flight != 0)
+    {
+        ERROR_VERDICT("Completion queue statistics report ZC buffers "
+                      "waiting for completion");
+        failed = TRUE;
+    }
+    if (compl_stats.dropped != 0)
+    {
+        ERROR_VERDICT("Some ZC buffers were removed from completion queue "
+                      "without completion message");
+        failed = TRUE;
+    }
+    if (compl_stats.completed == 0)
+    {
+        ERROR_VERDICT("Completion queue statistics report no completed "
+                      "ZC buffers");
+        failed = TRUE;
+    }
+
     if (failed)
         TEST_STOP;
 
@@ -8,6 +8,8 @@
  * @author Sergey Nikitin <Sergey.Nikitin@oktetlabs.ru>
  */
 
+#include <inttypes.h>
+
 #include "sockapi-ts_apprtt.h"
 #include "tapi_job_opt.h"
 #include "tapi_job_factory_rpc.h"
@@ -18,6 +20,41 @@
 /** Timeout for receiving data from channel. in milliseconds. */
 #define APPRTT_WAIT_TIMEOUT     1000
 
+/** Prefix of RTT histogram summary line printed by ol-apprtt client. */
+#define APPRTT_SUMMARY_PREFIX   "rtt-summary: "
+
+/** Prefix of RTT histogram bucket lines printed by ol-apprtt client. */
+#define APPRTT_HIST_PREFIX      "rtt-hist: "
+
+/**
+ * Convert RTT reported by ol-apprtt in nanoseconds to microseconds
+ * returned by sockts_apprtt_getrtt().
+ */
+#define APPRTT_NS2US(_ns)       ((int)(((_ns) + 500) / 1000))
+
+/**
+ * Get ol-apprtt client command line argument for a report type.
+ *
+ * @param report    Report type.
+ *
+ * @return The argument, or empty string for the default report type.
+ */
+static const char *
+apprtt_report2arg(sockts_apprtt_report report)
+{
+    switch (report)
+    {
+        case SOCKTS_APPRTT_REPORT_SUMMARY:
+            return "--report=summary";
+
+        case SOCKTS_APPRTT_REPORT_HIST:
+            return "--report=hist";
+
+        default:
+            return "";
+    }
+}
+
 /**
  * Generic function to initialize agent job for server or client.
  *
@@ -64,10 +101,11 @@ apprtt_init_job(rcf_rpc_server *rpcs, apprtt_instance_handle *h)
 
     /*
      * Print all messages which are not APP-RTT values (i.e. starting with a
-     * digit). RTT values are noisy and are processed by a specific TAPI Job
-     * filter.
+     * digit) or RTT histogram lines. They are noisy and are processed by
+     * specific TAPI Job filters.
      */
-    if ((rc = tapi_job_filter_add_regexp(result, "^(?![0-9]).+", 0)) != 0)
+    if ((rc = tapi_job_filter_add_regexp(result, "^(?![0-9]|rtt-hist).+",
+                                         0)) != 0)
         ERROR("%s(): failed to add regexp for the filter", __FUNCTION__);
 
     return rc;
@@ -97,6 +135,16 @@ apprtt_init_client_job(rcf_rpc_server *rpcs, apprtt_instance_handle *h,
                           sockts_apprtt_client_options, time_to_run),
         TAPI_JOB_OPT_UINT("--chunk-size", FALSE, NULL,
                           sockts_apprtt_client_options, chunk_size),
+        TAPI_JOB_OPT_DUMMY(apprtt_report2arg(opts->report)),
+        TAPI_JOB_OPT_UINT("--connections", FALSE, NULL,
+                          sockts_apprtt_client_options, connections),
+        TAPI_JOB_OPT_UINT("--threads", FALSE, NULL,
+                          sockts_apprtt_client_options, threads),
+        TAPI_JOB_OPT_STRING("--cpus", FALSE,
+                            sockts_apprtt_client_options, cpus),
+        TAPI_JOB_OPT_UINT("--rate", FALSE, NULL,
+                          sockts_apprtt_client_options, rate),
+        TAPI_JOB_OPT_DUMMY(opts->poisson ? "--arrival=poisson" : ""),
         TAPI_JOB_OPT_DUMMY("--data-check")
     );
 
@@ -135,6 +183,8 @@ apprtt_init_server_job(rcf_rpc_server *rpcs, apprtt_instance_handle *h,
         TAPI_JOB_OPT_DUMMY((opts->prefix != NULL) ? SOCKTS_APPRTT_PATH : ""),
         TAPI_JOB_OPT_UINT("--chunk-size", FALSE, NULL,
                           sockts_apprtt_server_options, chunk_size),
+        TAPI_JOB_OPT_UINT("--connections", FALSE, NULL,
+                          sockts_apprtt_server_options, connections),
         TAPI_JOB_OPT_DUMMY("--data-check")
     );
 
@@ -221,6 +271,30 @@ sockts_apprtt_create(rcf_rpc_server *client_pco,
     if (rc != 0)
         return rc;
 
+    apprtt_handle->report = client_opts->report;
+
+    rc = tapi_job_attach_filter(
+                TAPI_JOB_CHANNEL_SET(apprtt_handle->client.out_channels[0]),
+                "rtt-summary", TRUE, 0, &apprtt_handle->summary_filter);
+    if (rc != 0)
+        return rc;
+
+    rc = tapi_job_filter_add_regexp(apprtt_handle->summary_filter,
+                                    "^" APPRTT_SUMMARY_PREFIX "(.*)$", 1);
+    if (rc != 0)
+        return rc;
+
+    rc = tapi_job_attach_filter(
+                TAPI_JOB_CHANNEL_SET(apprtt_handle->client.out_channels[0]),
+                "rtt-hist", TRUE, 0, &apprtt_handle->hist_filter);
+    if (rc != 0)
+        return rc;
+
+    rc = tapi_job_filter_add_regexp(apprtt_handle->hist_filter,
+                                    "^" APPRTT_HIST_PREFIX "(.*)$", 1);
+    if (rc != 0)
+        return rc;
+
     rc = tapi_job_attach_filter(
                 TAPI_JOB_CHANNEL_SET(apprtt_handle->client.out_channels[0]),
                 "rtt", TRUE, 0, &apprtt_handle->rtt_filter);
@@ -281,6 +355,67 @@ sockts_apprtt_wait(sockts_apprtt_handle *app, int timeout_ms)
     return apprtt_instance_wait(app->server.job, "server", timeout_ms);
 }
 
+/**
+ * Receive all data caught by a filter until the end of stream.
+ *
+ * @param filter    The filter.
+ * @param buf       Buffer to append the data to.
+ *
+ * @return Status code.
+ */
+static te_errno
+apprtt_receive_all(tapi_job_channel_t *filter, tapi_job_buffer_t *buf)
+{
+    te_errno rc = 0;
+
+    while (!buf->eos && rc == 0)
+    {
+        rc = tapi_job_receive(TAPI_JOB_CHANNEL_SET(filter),
+                              APPRTT_WAIT_TIMEOUT, buf);
+        if (TE_RC_GET_ERROR(rc) == TE_ETIMEDOUT)
+        {
+            rc = 0;
+            break;
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Parse RTT histogram buckets printed by ol-apprtt client, one
+ * "<value> <count>" pair per line.
+ *
+ * @param data      Received data.
+ * @param len       Length of @p data.
+ * @param buckets   Vector to append buckets to.
+ *
+ * @return Status code.
+ */
+static te_errno
+apprtt_parse_hist(const char *data, size_t len, te_vec *buckets)
+{
+    const char *ptr = data;
+
+    while ((size_t)(ptr - data) < len)
+    {
+        sockts_apprtt_hist_bucket bucket;
+
+        if (sscanf(ptr, "%" SCNu64 " %" SCNu64, &bucket.value,
+                   &bucket.count) != 2)
+        {
+            ERROR("%s(): failed to parse RTT histogram bucket", __FUNCTION__);
+            return TE_RC(TE_TAPI, TE_EFAIL);
+        }
+
+        TE_VEC_APPEND(buckets, bucket);
+
+        while ((size_t)(ptr - data) < len && *ptr++ != '\n');
+    }
+
+    return 0;
+}
+
 /** See definition in sockapi-ts_apprtt.h */
 te_errno
 sockts_apprtt_getrtt(sockts_apprtt_handle *app, te_vec *rtt_values)
@@ -290,30 +425,31 @@ sockts_apprtt_getrtt(sockts_apprtt_handle *app, te_vec *rtt_values)
     te_vec            rtts = TE_VEC_INIT(int);
     const char       *ptr = NULL;
 
-    while (!buf.eos && rc == 0)
+    if (app->report == SOCKTS_APPRTT_REPORT_SUMMARY ||
+        app->report == SOCKTS_APPRTT_REPORT_HIST)
     {
-        rc = tapi_job_receive(TAPI_JOB_CHANNEL_SET(app->rtt_filter),
-                              APPRTT_WAIT_TIMEOUT, &buf);
-        if (TE_RC_GET_ERROR(rc) == TE_ETIMEDOUT)
-        {
-            rc = 0;
-            break;
-        }
+        ERROR("%s(): ol-apprtt reports only RTT histogram, use "
+              "sockts_apprtt_get_summary()", __FUNCTION__);
+        return TE_RC(TE_TAPI, TE_ENODATA);
     }
 
+    rc = apprtt_receive_all(app->rtt_filter, &buf);
+
     ptr = buf.data.ptr;
 
     while ((size_t)(ptr - buf.data.ptr) < buf.data.len)
     {
-        int rtt = 0;
+        uint64_t rtt_ns = 0;
+        int      rtt;
 
-        if (sscanf(ptr, "%d\n", &rtt) != 1)
+        if (sscanf(ptr, "%" SCNu64 "\n", &rtt_ns) != 1)
         {
             ERROR("%s(): failed to obtain RTT value", __FUNCTION__);
             te_vec_free(&rtts);
             return TE_RC(TE_TAPI, TE_EFAIL);
         }
 
+        rtt = APPRTT_NS2US(rtt_ns);
         TE_VEC_APPEND(&rtts, rtt);
 
         while (*ptr++ != '\n');
@@ -324,6 +460,68 @@ sockts_apprtt_getrtt(sockts_apprtt_handle *app, te_vec *rtt_values)
     return rc;
 }
 
+/** See definition in sockapi-ts_apprtt.h */
+te_errno
+sockts_apprtt_get_summary(sockts_apprtt_handle *app,
+                          sockts_apprtt_summary *summary)
+{
+    tapi_job_buffer_t   buf = TAPI_JOB_BUFFER_INIT;
+    te_errno            rc;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->buckets = TE_VEC_INIT(sockts_apprtt_hist_bucket);
+
+    if (app->report == SOCKTS_APPRTT_REPORT_SAMPLES)
+    {
+        ERROR("%s(): ol-apprtt does not report RTT summary", __FUNCTION__);
+        return TE_RC(TE_TAPI, TE_ENODATA);
+    }
+
+    rc = apprtt_receive_all(app->summary_filter, &buf);
+    if (rc != 0)
+        goto out;
+
+    if (buf.data.len == 0 ||
+        sscanf(buf.data.ptr, "count=%" SCNu64 " min=%" SCNu64
+               " p50=%" SCNu64 " p90=%" SCNu64 " p99=%" SCNu64
+               " p99.9=%" SCNu64 " p99.99=%" SCNu64 " max=%" SCNu64
+               " mean=%" SCNu64, &summary->count, &summary->min,
+               &summary->p50, &summary->p90, &summary->p99, &summary->p99_9,
+               &summary->p99_99, &summary->max, &summary->mean) != 9)
+    {
+        ERROR("%s(): failed to obtain RTT summary", __FUNCTION__);
+        rc = TE_RC(TE_TAPI, TE_EFAIL);
+        goto out;
+    }
+
+    if (app->report == SOCKTS_APPRTT_REPORT_HIST)
+    {
+        te_string_reset(&buf.data);
+        buf.eos = FALSE;
+
+        rc = apprtt_receive_all(app->hist_filter, &buf);
+        if (rc == 0)
+        {
+            rc = apprtt_parse_hist(buf.data.ptr, buf.data.len,
+                                   &summary->buckets);
+        }
+    }
+
+out:
+    te_string_free(&buf.data);
+    if (rc != 0)
+        sockts_apprtt_summary_free(summary);
+
+    return rc;
+}
+
+/** See definition in sockapi-ts_apprtt.h */
+void
+sockts_apprtt_summary_free(sockts_apprtt_summary *summary)
+{
+    te_vec_free(&summary->buckets);
+}
+
 /** See definition in sockapi-ts_apprtt.h */
 te_errno
 sockts_apprtt_getrtt_silent(sockts_apprtt_handle *app,
@@ -416,3 +614,61 @@ sockts_apprtt_mi_report_rtt(te_vec *rtt_values)
     te_mi_logger_destroy(logger);
     return 0;
 }
+
+te_errno
+sockts_apprtt_mi_report_summary(const sockts_apprtt_summary *summary)
+{
+    te_mi_logger               *logger;
+    te_errno                    rc;
+    sockts_apprtt_hist_bucket  *bucket;
+
+    rc = te_mi_logger_meas_create("ol-apprtt", &logger);
+    if (rc != 0)
+        return rc;
+
+    te_mi_logger_add_meas_vec(logger, NULL, TE_MI_MEAS_V(
+        TE_MI_MEAS(RTT, "App-level RTT", MIN, summary->min, NANO),
+        TE_MI_MEAS(RTT, "App-level RTT", MEDIAN, summary->p50, NANO),
+        TE_MI_MEAS(RTT, "App-level RTT", MEAN, summary->mean, NANO),
+        TE_MI_MEAS(RTT, "App-level RTT", MAX, summary->max, NANO),
+        TE_MI_MEAS(RTT, "App-level RTT p90", SINGLE, summary->p90, NANO),
+        TE_MI_MEAS(RTT, "App-level RTT p99", SINGLE, summary->p99, NANO),
+        TE_MI_MEAS(RTT, "App-level RTT p99.9", SINGLE, summary->p99_9,
+                   NANO),
+        TE_MI_MEAS(RTT, "App-level RTT p99.99", SINGLE, summary->p99_99,
+                   NANO)));
+
+    te_mi_logger_add_meas_key(logger, NULL, "Samples", "%" PRIu64,
+                              summary->count);
+
+    if (te_vec_size(&summary->buckets) > 0)
+    {
+        TE_VEC_FOREACH(&summary->buckets, bucket)
+        {
+            te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_RTT,
+                                  "App-level RTT bucket",
+                                  TE_MI_MEAS_AGGR_SINGLE, bucket->value,
+                                  TE_MI_MEAS_MULTIPLIER_NANO);
+            te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_RTT,
+                                  "App-level RTT bucket hits",
+                                  TE_MI_MEAS_AGGR_SINGLE, bucket->count,
+                                  TE_MI_MEAS_MULTIPLIER_PLAIN);
+        }
+
+        te_mi_logger_add_meas_view(logger, NULL, TE_MI_MEAS_VIEW_LINE_GRAPH,
+                                   "", "App-level RTT histogram");
+        te_mi_logger_meas_graph_axis_add_name(
+                                      logger, NULL,
+                                      TE_MI_MEAS_VIEW_LINE_GRAPH, "",
+                                      TE_MI_GRAPH_AXIS_X,
+                                      "App-level RTT bucket");
+        te_mi_logger_meas_graph_axis_add_name(
+                                      logger, NULL,
+                                      TE_MI_MEAS_VIEW_LINE_GRAPH, "",
+                                      TE_MI_GRAPH_AXIS_Y,
+                                      "App-level RTT bucket hits");
+    }
+
+    te_mi_logger_destroy(logger);
+    return 0;
+}
@@ -16,6 +16,11 @@
  *
  * client_opts.srv_addr = tst_addr;
  * client_opts.time_to_run = TIME2RUN;
+ * client_opts.connections = server_opts.connections = 1;
+ * client_opts.threads = 1;
+ * client_opts.cpus = NULL;
+ * client_opts.rate = 0;
+ * client_opts.poisson = FALSE;
  * server_opts.chunk_size = 1000000;
  *
  * CHECK_RC(sockts_apprtt_create(pco_iut, &client_opts,
@@ -32,6 +37,37 @@
  *
  * @endcode
  *
+ * Instead of printing every RTT value, ol-apprtt client can keep them in
+ * a histogram and print only its summary (and buckets) at the end, which
+ * scales to millions of samples:
+ * @code{.c}
+ * sockts_apprtt_summary summary;
+ *
+ * client_opts.report = SOCKTS_APPRTT_REPORT_SUMMARY;
+ * ...
+ * CHECK_RC(sockts_apprtt_get_summary(ol_app_rtt, &summary));
+ * CHECK_RC(sockts_apprtt_mi_report_summary(&summary));
+ * sockts_apprtt_summary_free(&summary);
+ * @endcode
+ *
+ * The client may open several connections to the server and serve them
+ * with several threads pinned to CPUs. RTT values of all connections are
+ * reported together:
+ * @code{.c}
+ * client_opts.connections = server_opts.connections = 8;
+ * client_opts.threads = 2;
+ * client_opts.cpus = "2,3";
+ * @endcode
+ *
+ * By default the client sends data as fast as it can (closed-loop), so
+ * stalls of sending are not seen in RTT values. In open-loop mode chunks
+ * are sent at a given rate and RTT is measured from the time when a chunk
+ * had to be sent, i.e. it is corrected for coordinated omission:
+ * @code{.c}
+ * client_opts.rate = 10000;
+ * client_opts.poisson = TRUE;
+ * @endcode
+ *
  * @author Sergey Nikitin <Sergey.Nikitin@oktetlabs.ru>
  */
 
@@ -46,6 +82,14 @@
 /** Number of output channels for ol-apprtt: for stdout and stderr. */
 #define APPRTT_OUT_CHANNELS_NUM 2
 
+/** How ol-apprtt client reports RTT values. */
+typedef enum sockts_apprtt_report {
+    SOCKTS_APPRTT_REPORT_SAMPLES = 0,   /**< Every RTT value. */
+    SOCKTS_APPRTT_REPORT_SUMMARY,       /**< Histogram summary only. */
+    SOCKTS_APPRTT_REPORT_HIST,          /**< Histogram summary and
+                                             buckets. */
+} sockts_apprtt_report;
+
 /** Client command line options. */
 typedef struct sockts_apprtt_client_options
 {
@@ -54,14 +98,62 @@ typedef struct sockts_apprtt_client_options
     unsigned int            time_to_run;    /**< Time to run in seconds. */
     unsigned int            chunk_size;     /**< Size of a data chunk for
                                                  RTT measuring. */
+    sockts_apprtt_report    report;         /**< How to report RTT
+                                                 values. */
+    unsigned int            connections;    /**< Number of connections,
+                                                 at least @c 1. It must be
+                                                 the same as server
+                                                 @b connections. */
+    unsigned int            threads;        /**< Number of client threads
+                                                 serving the connections,
+                                                 at least @c 1. */
+    const char             *cpus;           /**< CPUs to pin the client
+                                                 threads to, e.g.
+                                                 "0,2,4-7", or @c NULL. */
+    unsigned int            rate;           /**< Chunks per second to send
+                                                 over every connection in
+                                                 open-loop mode, @c 0 means
+                                                 closed-loop mode. */
+    te_bool                 poisson;        /**< Send chunks at Poisson
+                                                 distributed times in
+                                                 open-loop mode, otherwise
+                                                 at fixed intervals. */
 } sockts_apprtt_client_options;
 
+/** Bucket of RTT histogram reported by ol-apprtt. */
+typedef struct sockts_apprtt_hist_bucket
+{
+    uint64_t    value;  /**< The lowest RTT value counted by the bucket,
+                             in nanoseconds. */
+    uint64_t    count;  /**< Number of RTT values in the bucket. */
+} sockts_apprtt_hist_bucket;
+
+/** RTT histogram summary reported by ol-apprtt, values in nanoseconds. */
+typedef struct sockts_apprtt_summary
+{
+    uint64_t    count;      /**< Number of RTT values. */
+    uint64_t    min;        /**< Minimum value. */
+    uint64_t    p50;        /**< 50th percentile (median). */
+    uint64_t    p90;        /**< 90th percentile. */
+    uint64_t    p99;        /**< 99th percentile. */
+    uint64_t    p99_9;      /**< 99.9th percentile. */
+    uint64_t    p99_99;     /**< 99.99th percentile. */
+    uint64_t    max;        /**< Maximum value. */
+    uint64_t    mean;       /**< Mean value. */
+    te_vec      buckets;    /**< Non-empty histogram buckets
+                                 (@ref sockts_apprtt_hist_bucket) in
+                                 ascending order, filled in
+                                 @c SOCKTS_APPRTT_REPORT_HIST mode only. */
+} sockts_apprtt_summary;
+
 /** Server command line options. */
 typedef struct sockts_apprtt_server_options
 {
     const char     *prefix;         /**< Prefix before ol-apprtt. */
     unsigned int    chunk_size;     /**< Size of a data chunk that a
                                          server "acks". */
+    unsigned int    connections;    /**< Number of connections to accept,
+                                         at least @c 1. */
 } sockts_apprtt_server_options;
 
 /**
@@ -86,6 +178,12 @@ typedef struct sockts_apprtt_handle
     apprtt_instance_handle  client;     /**< Client instance handle. */
     apprtt_instance_handle  server;     /**< Server instance handle. */
     tapi_job_channel_t     *rtt_filter; /**< Filter to obtain RTT values. */
+    tapi_job_channel_t     *summary_filter; /**< Filter to obtain RTT
+                                                 histogram summary. */
+    tapi_job_channel_t     *hist_filter;    /**< Filter to obtain RTT
+                                                 histogram buckets. */
+    sockts_apprtt_report    report;     /**< How the client reports RTT
+                                             values. */
 } sockts_apprtt_handle;
 
 /**
@@ -129,6 +227,12 @@ sockts_apprtt_wait(sockts_apprtt_handle *app, int timeout_ms);
 
 /**
  * Get result of running the client "ol-apprtt" application.
+ * The tool reports RTT in nanoseconds, the values are rounded to
+ * microseconds.
+ *
+ * @c SOCKTS_APPRTT_REPORT_SUMMARY and @c SOCKTS_APPRTT_REPORT_HIST modes
+ * provide no values, use sockts_apprtt_get_summary() to get the summary
+ * and histogram buckets instead.
  *
  * @param[in]  app          The application handle.
  * @param[out] rtt_values   Vector to store the RTT values array. The vector
@@ -161,6 +265,26 @@ sockts_apprtt_getrtt_silent(sockts_apprtt_handle *app,
                             rcf_rpc_server *client_pco,
                             rcf_rpc_server *server_pco);
 
+/**
+ * Get RTT histogram summary reported by the client "ol-apprtt" application
+ * in @c SOCKTS_APPRTT_REPORT_SUMMARY or @c SOCKTS_APPRTT_REPORT_HIST mode.
+ *
+ * @param[in]  app          The application handle.
+ * @param[out] summary      Where to store the summary. It must be released
+ *                          with sockts_apprtt_summary_free().
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_apprtt_get_summary(sockts_apprtt_handle *app,
+                                          sockts_apprtt_summary *summary);
+
+/**
+ * Release resources allocated for RTT histogram summary.
+ *
+ * @param summary   The summary.
+ */
+extern void sockts_apprtt_summary_free(sockts_apprtt_summary *summary);
+
 /**
  * Destroy "ol-apprtt" application and free all internal data.
  *
@@ -181,4 +305,15 @@ sockts_apprtt_destroy(sockts_apprtt_handle *app);
  */
 extern te_errno sockts_apprtt_mi_report_rtt(te_vec *rtt_values);
 
+/**
+ * Output application level RTT histogram summary via MI logger. If the
+ * summary has histogram buckets, they are reported as a graph.
+ *
+ * @param[in] summary       The summary.
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_apprtt_mi_report_summary(
+                                    const sockts_apprtt_summary *summary);
+
 #endif /* __SOCKAPI_TS_APPRTT_H__ */
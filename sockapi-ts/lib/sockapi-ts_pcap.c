@@ -18,20 +18,59 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/ip6.h>
 #include <netinet/tcp.h>
 #include <net/ethernet.h>
 
+/** Minimum IPv4 header length */
+#define SOCKTS_PCAP_IP4_HDR_LEN 20
+
+/** IPv6 header length */
+#define SOCKTS_PCAP_IP6_HDR_LEN 40
+
+/** Minimum TCP header length */
+#define SOCKTS_PCAP_TCP_HDR_LEN 20
+
+/** Length of Linux cooked capture header */
+#define SOCKTS_PCAP_SLL_HDR_LEN 16
+
+/** Initial number of buckets in the flows hash table */
+#define SOCKTS_PCAP_HASH_MIN_SIZE 256
+
+/** Maximum number of data segments waiting for ACK to measure RTT */
+#define SOCKTS_PCAP_RTT_SEGS 64
+
+/**
+ * A hole in sequence space filled within this time (in microseconds)
+ * after the last new data is considered to be out of order segment
+ * rather than retransmission, if RTT is not known yet.
+ */
+#define SOCKTS_PCAP_OOO_TIME 3000
+
+/**
+ * Maximum number of chunks for which retransmissions are counted,
+ * it protects from huge vectors if a capture has a bogus SEQ jump.
+ */
+#define SOCKTS_PCAP_MAX_CHUNKS (1 << 20)
+
+/** Compare sequence numbers, given that they can overflow */
+#define SEQ_LT(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+#define SEQ_LE(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) <= 0)
+#define SEQ_GT(a, b) SEQ_LT(b, a)
+
 /**
  * Get EtherType value from Ethernet header and offset to the next header.
  * Offset points to the header after VLAN headers if they are.
  *
  * @param[in]  pkt              Pointer to the packet
+ * @param[in]  caplen           Captured length of the packet
  * @param[out] nexthdr_offset   Offset to the next header
  *
- * @return EtherType
+ * @return EtherType, or @c 0 if the packet is truncated.
  */
 static uint16_t
-sockts_pcap_get_ethertype(const uint8_t *pkt, uint8_t *nexthdr_offset)
+sockts_pcap_get_ethertype(const uint8_t *pkt, uint32_t caplen,
+                          uint32_t *nexthdr_offset)
 {
     /*
      * Declare this structure inside the function because it does
@@ -44,7 +83,10 @@ sockts_pcap_get_ethertype(const uint8_t *pkt, uint8_t *nexthdr_offset)
 
     struct ethhdr *eth = (struct ethhdr *)pkt;
     uint16_t eth_type = 0;
-    uint8_t offset = 0;
+    uint32_t offset = 0;
+
+    if (caplen < sizeof(*eth))
+        return 0;
 
     offset += sizeof(*eth);
     eth_type = eth->h_proto;
@@ -54,6 +96,9 @@ sockts_pcap_get_ethertype(const uint8_t *pkt, uint8_t *nexthdr_offset)
     {
         vlanhdr *vlan_hdr = (vlanhdr *)(pkt + offset);
 
+        if (caplen < offset + sizeof(*vlan_hdr))
+            return 0;
+
         offset += sizeof(*vlan_hdr);
         eth_type = vlan_hdr->h_vlan_ethertype;
     }
@@ -62,101 +107,824 @@ sockts_pcap_get_ethertype(const uint8_t *pkt, uint8_t *nexthdr_offset)
     return ntohs(eth_type);
 }
 
-/** Structure with user data to pass to callback function */
-typedef struct sockts_pcap_user_data {
-    /**< Highest sequence number that was in TCP connection. */
-    uint32_t seq;
-    /**< @c TRUE if something went wrong in callback. */
-    te_bool is_failed;
-    /**< First sequence number in TCP connection */
-    uint32_t first_seq;
-    /**< Array with TCP retransmissions for chunks */
-    int *retrans;
-    /**< Size of the array with TCP retransmissions */
-    unsigned int retrans_size;
-    /**< Last index in the array with retransmissions */
-    unsigned int retrans_index;
-    /**< Chunk size */
-    unsigned int chunk_size;
-} sockts_pcap_user_data;
-
-/**
- * Callback function to count number of IPv4/TCP retransimssions.
- *
- * @param args      User data
- * @param header    PCAP packet header
- * @param packet    Pointer to the packet
- */
-static void sockts_pcap_retrans_number_handler(u_char *args,
-                                               const struct pcap_pkthdr *header,
-                                               const u_char *packet)
-{
-    uint8_t *pkt = (uint8_t *)packet;
-    uint16_t ethertype = 0;
-    uint8_t offset = 0;
-    uint32_t seq;
-    uint16_t ip_tot_len;
-    uint16_t payload_len = 0;
-    struct tcphdr *tcph = NULL;
-    struct iphdr *iph = NULL;
-    sockts_pcap_user_data *data = (sockts_pcap_user_data *)args;
-
-    ethertype = sockts_pcap_get_ethertype(pkt, &offset);
-    if (ethertype != ETH_P_IP)
-    {
-        ERROR("Unexpected Ethertype: %u", ethertype);
-        data->is_failed = TRUE;
+/** Key identifying one direction of a TCP connection */
+typedef struct sockts_pcap_flow_key {
+    uint8_t     src[16];    /**< Source address */
+    uint8_t     dst[16];    /**< Destination address */
+    uint16_t    sport;      /**< Source port (network byte order) */
+    uint16_t    dport;      /**< Destination port (network byte order) */
+    uint16_t    family;     /**< Address family */
+} sockts_pcap_flow_key;
+
+/** Data segment waiting for ACK to measure RTT */
+typedef struct sockts_pcap_rtt_seg {
+    uint32_t end_seq;   /**< SEQ after the last byte of the segment */
+    uint64_t ts;        /**< Time when the segment was sent (us) */
+} sockts_pcap_rtt_seg;
+
+/** Internal state of a TCP flow */
+typedef struct sockts_pcap_flow_state {
+    sockts_pcap_flow_key key;   /**< Flow key */
+    int         hash_next;      /**< Next flow in the hash bucket or
+                                     @c -1 */
+    int         rev;            /**< Reverse flow or @c -1 if it is not
+                                     known yet */
+
+    te_bool     seq_init;       /**< @c TRUE if SEQ was seen */
+    uint32_t    isn;            /**< SEQ of the first packet */
+    uint32_t    next_seq;       /**< Highest SEQ sent plus one */
+    uint64_t    next_off;       /**< Offset of @p next_seq from @p isn,
+                                     not wrapped */
+    uint64_t    adv_ts;         /**< Time when @p next_seq was advanced
+                                     last time (us) */
+
+    te_bool     ack_init;       /**< @c TRUE if ACK was seen */
+    uint32_t    last_ack;       /**< Last ACK sent */
+    uint16_t    last_win;       /**< Last window sent */
+
+    sockts_pcap_rtt_seg rtt_segs[SOCKTS_PCAP_RTT_SEGS]; /**< Ring of
+                                                             segments
+                                                             waiting for
+                                                             ACK */
+    unsigned int rtt_head;      /**< The oldest segment in the ring */
+    unsigned int rtt_num;       /**< Number of segments in the ring */
+} sockts_pcap_flow_state;
+
+/** Context of TCP flows analysis */
+typedef struct sockts_pcap_tcp_ctx {
+    const sockts_pcap_tcp_opts *opts;   /**< Analysis parameters */
+    pcap_t         *handle;     /**< PCAP handle */
+    int             linktype;   /**< Link-layer header type */
+
+    te_vec         *flows;      /**< Flows statistics */
+    te_vec          states;     /**< Flows states (with the same indexes
+                                     as in @p flows) */
+    int            *hash;       /**< Hash table of flows */
+    unsigned int    hash_size;  /**< Number of buckets in @p hash */
+
+    te_bool         started;    /**< @c TRUE if a packet was seen */
+    uint64_t        start_ts;   /**< Time of the first packet (us) */
+    te_errno        rc;         /**< Status of processing */
+} sockts_pcap_tcp_ctx;
+
+/** Parsed TCP packet */
+typedef struct sockts_pcap_tcp_pkt {
+    sockts_pcap_flow_key key;   /**< Flow key */
+    const struct tcphdr *tcph;  /**< TCP header */
+    uint32_t             len;   /**< Payload length */
+} sockts_pcap_tcp_pkt;
+
+/**
+ * Parse IPv4/IPv6 and TCP headers of a packet.
+ *
+ * @param ip        Pointer to IP header.
+ * @param caplen    Captured length starting from @p ip.
+ * @param pkt       Where to save parsed packet.
+ *
+ * @return @c TRUE if it is a TCP packet, @c FALSE otherwise.
+ */
+static te_bool
+sockts_pcap_parse_ip(const uint8_t *ip, uint32_t caplen,
+                     sockts_pcap_tcp_pkt *pkt)
+{
+    uint32_t    hdr_len;
+    uint32_t    ip_len;
+    uint8_t     proto;
+
+    memset(&pkt->key, 0, sizeof(pkt->key));
+
+    if (caplen < 1)
+        return FALSE;
+
+    if ((ip[0] >> 4) == 4)
+    {
+        const struct iphdr *iph = (const struct iphdr *)ip;
+
+        if (caplen < SOCKTS_PCAP_IP4_HDR_LEN)
+            return FALSE;
+
+        hdr_len = iph->ihl * 4;
+        ip_len = ntohs(iph->tot_len);
+        proto = iph->protocol;
+
+        /* Only the first fragment contains TCP header */
+        if ((ntohs(iph->frag_off) & IP_OFFMASK) != 0)
+            return FALSE;
+
+        pkt->key.family = AF_INET;
+        memcpy(pkt->key.src, &iph->saddr, sizeof(iph->saddr));
+        memcpy(pkt->key.dst, &iph->daddr, sizeof(iph->daddr));
+    }
+    else if ((ip[0] >> 4) == 6)
+    {
+        const struct ip6_hdr *ip6h = (const struct ip6_hdr *)ip;
+
+        if (caplen < SOCKTS_PCAP_IP6_HDR_LEN)
+            return FALSE;
+
+        hdr_len = SOCKTS_PCAP_IP6_HDR_LEN;
+        ip_len = SOCKTS_PCAP_IP6_HDR_LEN + ntohs(ip6h->ip6_plen);
+        proto = ip6h->ip6_nxt;
+
+        while (proto == IPPROTO_HOPOPTS || proto == IPPROTO_ROUTING ||
+               proto == IPPROTO_DSTOPTS)
+        {
+            if (caplen < hdr_len + 2)
+                return FALSE;
+
+            proto = ip[hdr_len];
+            hdr_len += (ip[hdr_len + 1] + 1) * 8;
+        }
+
+        pkt->key.family = AF_INET6;
+        memcpy(pkt->key.src, &ip6h->ip6_src, sizeof(ip6h->ip6_src));
+        memcpy(pkt->key.dst, &ip6h->ip6_dst, sizeof(ip6h->ip6_dst));
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    if (proto != IPPROTO_TCP ||
+        caplen < hdr_len + SOCKTS_PCAP_TCP_HDR_LEN)
+        return FALSE;
+
+    pkt->tcph = (const struct tcphdr *)(ip + hdr_len);
+    if (ip_len < hdr_len + pkt->tcph->doff * 4)
+        return FALSE;
+
+    pkt->len = ip_len - hdr_len - pkt->tcph->doff * 4;
+    pkt->key.sport = pkt->tcph->source;
+    pkt->key.dport = pkt->tcph->dest;
+
+    return TRUE;
+}
+
+/**
+ * Parse link-layer header and find TCP packet.
+ *
+ * @param linktype  Link-layer header type.
+ * @param data      Packet data.
+ * @param caplen    Captured length.
+ * @param pkt       Where to save parsed packet.
+ *
+ * @return @c TRUE if it is a TCP packet, @c FALSE otherwise.
+ */
+static te_bool
+sockts_pcap_parse_pkt(int linktype, const uint8_t *data, uint32_t caplen,
+                      sockts_pcap_tcp_pkt *pkt)
+{
+    uint32_t offset = 0;
+    uint16_t ethertype;
+
+    switch (linktype)
+    {
+        case DLT_EN10MB:
+            ethertype = sockts_pcap_get_ethertype(data, caplen, &offset);
+            if (ethertype != ETH_P_IP && ethertype != ETH_P_IPV6)
+                return FALSE;
+            break;
+
+        case DLT_LINUX_SLL:
+            if (caplen < SOCKTS_PCAP_SLL_HDR_LEN)
+                return FALSE;
+            offset = SOCKTS_PCAP_SLL_HDR_LEN;
+            break;
+
+        case DLT_RAW:
+            break;
+
+        default:
+            return FALSE;
+    }
+
+    return sockts_pcap_parse_ip(data + offset, caplen - offset, pkt);
+}
+
+/**
+ * Compute hash of a flow key.
+ *
+ * @param key       Flow key.
+ *
+ * @return Hash value.
+ */
+static unsigned int
+sockts_pcap_flow_hash(const sockts_pcap_flow_key *key)
+{
+    const uint8_t  *p = (const uint8_t *)key;
+    unsigned int    hash = 2166136261u;
+    size_t          i;
+
+    for (i = 0; i < sizeof(*key); i++)
+        hash = (hash ^ p[i]) * 16777619u;
+
+    return hash;
+}
+
+/**
+ * Get state of a flow by its index.
+ *
+ * @param ctx       Analysis context.
+ * @param idx       Flow index.
+ *
+ * @return Flow state.
+ */
+static inline sockts_pcap_flow_state *
+sockts_pcap_state(sockts_pcap_tcp_ctx *ctx, int idx)
+{
+    return (sockts_pcap_flow_state *)te_vec_get(&ctx->states, idx);
+}
+
+/**
+ * Get statistics of a flow by its index.
+ *
+ * @param ctx       Analysis context.
+ * @param idx       Flow index.
+ *
+ * @return Flow statistics.
+ */
+static inline sockts_pcap_tcp_flow *
+sockts_pcap_flow(sockts_pcap_tcp_ctx *ctx, int idx)
+{
+    return (sockts_pcap_tcp_flow *)te_vec_get(ctx->flows, idx);
+}
+
+/**
+ * Find a flow in the hash table.
+ *
+ * @param ctx       Analysis context.
+ * @param key       Flow key.
+ *
+ * @return Flow index or @c -1 if it is not found.
+ */
+static int
+sockts_pcap_flow_find(sockts_pcap_tcp_ctx *ctx,
+                      const sockts_pcap_flow_key *key)
+{
+    int idx;
+
+    idx = ctx->hash[sockts_pcap_flow_hash(key) & (ctx->hash_size - 1)];
+    while (idx >= 0)
+    {
+        sockts_pcap_flow_state *st = sockts_pcap_state(ctx, idx);
+
+        if (memcmp(&st->key, key, sizeof(*key)) == 0)
+            return idx;
+
+        idx = st->hash_next;
+    }
+
+    return -1;
+}
+
+/**
+ * Double the size of the flows hash table.
+ *
+ * @param ctx       Analysis context.
+ *
+ * @return Status code.
+ */
+static te_errno
+sockts_pcap_hash_grow(sockts_pcap_tcp_ctx *ctx)
+{
+    unsigned int    size = ctx->hash_size * 2;
+    int            *hash;
+    unsigned int    bucket;
+    size_t          i;
+
+    hash = TE_ALLOC(size * sizeof(*hash));
+    if (hash == NULL)
+        return TE_RC(TE_TAPI, TE_ENOMEM);
+
+    for (i = 0; i < size; i++)
+        hash[i] = -1;
+
+    for (i = 0; i < te_vec_size(&ctx->states); i++)
+    {
+        sockts_pcap_flow_state *st = sockts_pcap_state(ctx, i);
+
+        bucket = sockts_pcap_flow_hash(&st->key) & (size - 1);
+        st->hash_next = hash[bucket];
+        hash[bucket] = i;
+    }
+
+    free(ctx->hash);
+    ctx->hash = hash;
+    ctx->hash_size = size;
+
+    return 0;
+}
+
+/**
+ * Fill socket address from a flow key.
+ *
+ * @param family    Address family.
+ * @param addr      Network address.
+ * @param port      Port (network byte order).
+ * @param sa        Where to save the address.
+ */
+static void
+sockts_pcap_key2sa(uint16_t family, const uint8_t *addr, uint16_t port,
+                   struct sockaddr_storage *sa)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->ss_family = family;
+    te_sockaddr_set_netaddr(SA(sa), addr);
+    te_sockaddr_set_port(SA(sa), port);
+}
+
+/**
+ * Add a new flow.
+ *
+ * @param ctx       Analysis context.
+ * @param key       Flow key.
+ * @param idx       Where to save index of the new flow.
+ *
+ * @return Status code.
+ */
+static te_errno
+sockts_pcap_flow_add(sockts_pcap_tcp_ctx *ctx,
+                     const sockts_pcap_flow_key *key, int *idx)
+{
+    sockts_pcap_flow_state  st;
+    sockts_pcap_tcp_flow    flow;
+    sockts_pcap_flow_key    rev_key;
+    te_vec                  goodput = TE_VEC_INIT(uint64_t);
+    te_vec                  chunk_retrans = TE_VEC_INIT(int);
+    unsigned int            bucket;
+    te_errno                rc;
+
+    if (te_vec_size(&ctx->states) >= ctx->hash_size)
+    {
+        rc = sockts_pcap_hash_grow(ctx);
+        if (rc != 0)
+            return rc;
+    }
+
+    memset(&flow, 0, sizeof(flow));
+    sockts_pcap_key2sa(key->family, key->src, key->sport, &flow.src);
+    sockts_pcap_key2sa(key->family, key->dst, key->dport, &flow.dst);
+    flow.goodput = goodput;
+    flow.chunk_retrans = chunk_retrans;
+
+    memset(&st, 0, sizeof(st));
+    st.key = *key;
+
+    memset(&rev_key, 0, sizeof(rev_key));
+    rev_key.family = key->family;
+    memcpy(rev_key.src, key->dst, sizeof(rev_key.src));
+    memcpy(rev_key.dst, key->src, sizeof(rev_key.dst));
+    rev_key.sport = key->dport;
+    rev_key.dport = key->sport;
+
+    *idx = te_vec_size(&ctx->states);
+    st.rev = sockts_pcap_flow_find(ctx, &rev_key);
+    if (st.rev >= 0)
+        sockts_pcap_state(ctx, st.rev)->rev = *idx;
+
+    bucket = sockts_pcap_flow_hash(key) & (ctx->hash_size - 1);
+    st.hash_next = ctx->hash[bucket];
+
+    rc = TE_VEC_APPEND(ctx->flows, flow);
+    if (rc == 0)
+        rc = TE_VEC_APPEND(&ctx->states, st);
+    if (rc != 0)
+        return rc;
+
+    ctx->hash[bucket] = *idx;
+    return 0;
+}
+
+/**
+ * Add a value to an element of a vector, append zero elements to the
+ * vector if it is too short.
+ *
+ * @param vec       Vector.
+ * @param idx       Element index.
+ * @param val       Value to add.
+ *
+ * @return Status code.
+ */
+#define SOCKTS_PCAP_VEC_ADD(_type, _vec, _idx, _val) \
+    ({                                                                  \
+        _type       __zero = 0;                                         \
+        te_errno    __rc = 0;                                           \
+                                                                        \
+        while (__rc == 0 && te_vec_size(_vec) <= (size_t)(_idx))        \
+            __rc = TE_VEC_APPEND(_vec, __zero);                         \
+        if (__rc == 0)                                                  \
+            *(_type *)te_vec_get(_vec, _idx) += (_val);                 \
+        __rc;                                                           \
+    })
+
+/**
+ * Process SEQ and payload of a TCP packet.
+ *
+ * @param ctx       Analysis context.
+ * @param flow      Flow statistics.
+ * @param st        Flow state.
+ * @param pkt       Parsed packet.
+ * @param ts        Packet timestamp (us).
+ *
+ * @return Status code.
+ */
+static te_errno
+sockts_pcap_tcp_seq(sockts_pcap_tcp_ctx *ctx, sockts_pcap_tcp_flow *flow,
+                    sockts_pcap_flow_state *st,
+                    const sockts_pcap_tcp_pkt *pkt, uint64_t ts)
+{
+    const struct tcphdr *tcph = pkt->tcph;
+    uint32_t    seq = ntohl(tcph->seq);
+    uint32_t    seg_len = pkt->len + tcph->syn + tcph->fin;
+    uint32_t    end = seq + seg_len;
+    uint64_t    off = 0;
+    te_bool     off_valid = TRUE;
+    uint32_t    new_len = 0;
+    uint64_t    ooo_time;
+    te_bool     retrans = FALSE;
+    te_errno    rc = 0;
+
+    if (!st->seq_init)
+    {
+        st->seq_init = TRUE;
+        st->isn = seq;
+        st->next_seq = seq;
+        st->adv_ts = ts;
+    }
+
+    if (seg_len == 0)
+        return 0;
+
+    if (!SEQ_LT(seq, st->next_seq))
+    {
+        off = st->next_off + (uint32_t)(seq - st->next_seq);
+    }
+    else if ((uint32_t)(st->next_seq - seq) <= st->next_off)
+    {
+        off = st->next_off - (uint32_t)(st->next_seq - seq);
+    }
+    else
+    {
+        /*
+         * The segment starts before the first captured one (e.g. the
+         * capture started in the middle of a connection), there is
+         * no chunk to account it in.
+         */
+        off_valid = FALSE;
+    }
+
+    if (!SEQ_LT(seq, st->next_seq))
+    {
+        /*
+         * If there is a hole before the segment, its data was sent
+         * but not captured (or it is reordered), count it as new here.
+         */
+        new_len = end - st->next_seq;
+    }
+    else if (SEQ_GT(end, st->next_seq))
+    {
+        new_len = end - st->next_seq;
+        retrans = TRUE;
+    }
+    else
+    {
+        /*
+         * A hole is filled soon after the segments following it were
+         * sent: the segment was reordered rather than retransmitted.
+         */
+        ooo_time = (flow->rtt_num > 0 ? flow->rtt_min :
+                                        SOCKTS_PCAP_OOO_TIME);
+        if (ts - st->adv_ts < ooo_time)
+            flow->out_of_order++;
+        else
+            retrans = TRUE;
+    }
+
+    if (retrans)
+    {
+        flow->retrans++;
+        flow->retrans_bytes += MIN(pkt->len, seg_len - new_len);
+        /* Karn's algorithm: do not measure RTT for retransmitted data */
+        st->rtt_num = 0;
+    }
+
+    if (new_len > 0)
+    {
+        st->next_off += new_len;
+        st->next_seq = end;
+        st->adv_ts = ts;
+
+        if (!retrans && st->rtt_num < SOCKTS_PCAP_RTT_SEGS)
+        {
+            sockts_pcap_rtt_seg *seg;
+
+            seg = &st->rtt_segs[(st->rtt_head + st->rtt_num) %
+                                SOCKTS_PCAP_RTT_SEGS];
+            seg->end_seq = end;
+            seg->ts = ts;
+            st->rtt_num++;
+        }
+    }
+
+    /* SYN and FIN occupy sequence space but are not payload */
+    new_len -= MIN(new_len, seg_len - pkt->len);
+    flow->bytes += new_len;
+
+    if (ctx->opts->interval_us > 0 && new_len > 0)
+    {
+        rc = SOCKTS_PCAP_VEC_ADD(uint64_t, &flow->goodput,
+                                 (ts - ctx->start_ts) /
+                                                ctx->opts->interval_us,
+                                 new_len);
+    }
+
+    if (rc == 0 && pkt->len > 0 && ctx->opts->chunk_size > 0 &&
+        off_valid && off / ctx->opts->chunk_size < SOCKTS_PCAP_MAX_CHUNKS)
+    {
+        rc = SOCKTS_PCAP_VEC_ADD(int, &flow->chunk_retrans,
+                                 off / ctx->opts->chunk_size,
+                                 retrans ? 1 : 0);
+    }
+
+    return rc;
+}
+
+/**
+ * Process ACK of a TCP packet: count duplicate ACKs and measure RTT
+ * of the reverse flow.
+ *
+ * @param ctx       Analysis context.
+ * @param flow      Flow statistics.
+ * @param st        Flow state.
+ * @param pkt       Parsed packet.
+ * @param ts        Packet timestamp (us).
+ */
+static void
+sockts_pcap_tcp_ack(sockts_pcap_tcp_ctx *ctx, sockts_pcap_tcp_flow *flow,
+                    sockts_pcap_flow_state *st,
+                    const sockts_pcap_tcp_pkt *pkt, uint64_t ts)
+{
+    const struct tcphdr    *tcph = pkt->tcph;
+    uint32_t                ack = ntohl(tcph->ack_seq);
+    uint16_t                win = ntohs(tcph->window);
+    sockts_pcap_flow_state *rev_st = NULL;
+    sockts_pcap_tcp_flow   *rev_flow;
+    sockts_pcap_rtt_seg    *seg;
+    uint64_t                rtt = 0;
+    te_bool                 acked = FALSE;
+
+    if (!tcph->ack)
         return;
+
+    if (st->rev >= 0)
+        rev_st = sockts_pcap_state(ctx, st->rev);
+
+    if (st->ack_init && pkt->len == 0 &&
+        !tcph->syn && !tcph->fin && !tcph->rst &&
+        ack == st->last_ack && win == st->last_win &&
+        rev_st != NULL && SEQ_LT(ack, rev_st->next_seq))
+    {
+        flow->dup_acks++;
     }
 
-    iph = (struct iphdr *)(pkt + offset);
-    ip_tot_len = ntohs(iph->tot_len);
-    if (iph->protocol != IPPROTO_TCP)
+    if (st->ack_init && !SEQ_GT(ack, st->last_ack))
     {
-        ERROR("Unexpected IP protocol: %u", iph->protocol);
-        data->is_failed = TRUE;
+        st->last_win = win;
         return;
     }
 
-    tcph = (struct tcphdr *)((uint8_t *)iph + iph->ihl * 4);
-    payload_len = ip_tot_len - (iph->ihl * 4 + tcph->doff * 4);
+    st->ack_init = TRUE;
+    st->last_ack = ack;
+    st->last_win = win;
 
-    seq = ntohl(tcph->seq);
-    if (data->first_seq == 0)
-    {
-        data->first_seq = seq;
-        data->seq = seq;
+    if (rev_st == NULL)
         return;
+
+    while (rev_st->rtt_num > 0)
+    {
+        seg = &rev_st->rtt_segs[rev_st->rtt_head];
+        if (!SEQ_LE(seg->end_seq, ack))
+            break;
+
+        rtt = ts - seg->ts;
+        acked = TRUE;
+        rev_st->rtt_head = (rev_st->rtt_head + 1) % SOCKTS_PCAP_RTT_SEGS;
+        rev_st->rtt_num--;
     }
 
-    /* Don't process packets without payload. They don't increase SEQ and will
-     * not be counted as retransmissions.
-     */
-    if (payload_len == 0)
+    /* Only the last segment acked by this ACK gives RTT sample */
+    if (acked)
+    {
+        rev_flow = sockts_pcap_flow(ctx, st->rev);
+        if (rev_flow->rtt_num == 0 || rtt < rev_flow->rtt_min)
+            rev_flow->rtt_min = rtt;
+        rev_flow->rtt_max = MAX(rev_flow->rtt_max, rtt);
+        rev_flow->rtt_sum += rtt;
+        rev_flow->rtt_num++;
+    }
+}
+
+/**
+ * Callback function to process a packet in TCP flows analysis.
+ *
+ * @param args      Analysis context.
+ * @param header    PCAP packet header.
+ * @param packet    Pointer to the packet.
+ */
+static void
+sockts_pcap_tcp_handler(u_char *args, const struct pcap_pkthdr *header,
+                        const u_char *packet)
+{
+    sockts_pcap_tcp_ctx    *ctx = (sockts_pcap_tcp_ctx *)args;
+    sockts_pcap_tcp_pkt     pkt;
+    sockts_pcap_tcp_flow   *flow;
+    sockts_pcap_flow_state *st;
+    uint64_t                ts;
+    int                     idx;
+    te_errno                rc;
+
+    ts = (uint64_t)header->ts.tv_sec * 1000000 + header->ts.tv_usec;
+    if (!ctx->started)
+    {
+        ctx->started = TRUE;
+        ctx->start_ts = ts;
+    }
+    /* Do not let reordered timestamps produce huge intervals */
+    ts = MAX(ts, ctx->start_ts);
+
+    if (!sockts_pcap_parse_pkt(ctx->linktype, packet, header->caplen,
+                               &pkt))
         return;
 
-    data->retrans_index = (seq - data->first_seq) / data->chunk_size;
-    if (data->retrans_index >= data->retrans_size)
+    idx = sockts_pcap_flow_find(ctx, &pkt.key);
+    if (idx < 0)
+    {
+        rc = sockts_pcap_flow_add(ctx, &pkt.key, &idx);
+        if (rc != 0)
+        {
+            ERROR("Failed to add TCP flow: %r", rc);
+            ctx->rc = rc;
+            pcap_breakloop(ctx->handle);
+            return;
+        }
+    }
+
+    flow = sockts_pcap_flow(ctx, idx);
+    st = sockts_pcap_state(ctx, idx);
+
+    flow->packets++;
+    if (pkt.len > 0)
+        flow->data_packets++;
+
+    rc = sockts_pcap_tcp_seq(ctx, flow, st, &pkt, ts);
+    if (rc != 0)
     {
-        ERROR("Index of the chunk (%u) is more than the size of buffer with TCP "
-              "retransmissions (%u).", data->retrans_index, data->retrans_size);
-        data->is_failed = TRUE;
+        ERROR("Failed to process TCP packet: %r", rc);
+        ctx->rc = rc;
+        pcap_breakloop(ctx->handle);
         return;
     }
 
-    /* Compare sequence numbers, given that they can overflow */
-#define SEQ_LESS(a, b) (((int32_t)(a - b)) < 0)
-    if (SEQ_LESS(data->seq, seq))
-        data->seq = seq;
-    else
-        data->retrans[data->retrans_index]++;
-#undef SEQ_LESS
+    sockts_pcap_tcp_ack(ctx, flow, st, &pkt, ts);
+}
+
+/** See definition in sockapi-ts_pcap.h */
+void
+sockts_pcap_tcp_flows_free(te_vec *flows)
+{
+    sockts_pcap_tcp_flow *flow;
+
+    TE_VEC_FOREACH(flows, flow)
+    {
+        te_vec_free(&flow->goodput);
+        te_vec_free(&flow->chunk_retrans);
+    }
+
+    te_vec_free(flows);
+}
+
+/** See definition in sockapi-ts_pcap.h */
+te_errno
+sockts_pcap_tcp_flows_get(const char *pcap_file,
+                          const sockts_pcap_tcp_opts *opts, te_vec *flows)
+{
+    char                    error_buffer[PCAP_ERRBUF_SIZE];
+    struct bpf_program      filter_handle;
+    sockts_pcap_tcp_ctx     ctx;
+    te_vec                  states = TE_VEC_INIT(sockts_pcap_flow_state);
+    te_vec                  res = TE_VEC_INIT(sockts_pcap_tcp_flow);
+    unsigned int            i;
+    int                     ret;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.opts = opts;
+    ctx.flows = &res;
+    ctx.states = states;
+
+    ctx.handle = pcap_open_offline(pcap_file, error_buffer);
+    if (ctx.handle == NULL)
+    {
+        ERROR("Failed to open %s: %s", pcap_file, error_buffer);
+        return TE_RC(TE_TAPI, TE_ENOENT);
+    }
+
+    if (opts->filter != NULL)
+    {
+        if (pcap_compile(ctx.handle, &filter_handle, opts->filter, 1,
+                         PCAP_NETMASK_UNKNOWN) == -1)
+        {
+            ERROR("Failed to compile filter: %s", pcap_geterr(ctx.handle));
+            pcap_close(ctx.handle);
+            return TE_RC(TE_TAPI, TE_EINVAL);
+        }
+
+        ret = pcap_setfilter(ctx.handle, &filter_handle);
+        pcap_freecode(&filter_handle);
+        if (ret == -1)
+        {
+            ERROR("Failed to set filter: %s", pcap_geterr(ctx.handle));
+            pcap_close(ctx.handle);
+            return TE_RC(TE_TAPI, TE_EINVAL);
+        }
+    }
+
+    ctx.linktype = pcap_datalink(ctx.handle);
+    if (ctx.linktype != DLT_EN10MB && ctx.linktype != DLT_LINUX_SLL &&
+        ctx.linktype != DLT_RAW)
+    {
+        ERROR("Unsupported link-layer header type %d", ctx.linktype);
+        pcap_close(ctx.handle);
+        return TE_RC(TE_TAPI, TE_EOPNOTSUPP);
+    }
 
-    return;
+    ctx.hash_size = SOCKTS_PCAP_HASH_MIN_SIZE;
+    ctx.hash = TE_ALLOC(ctx.hash_size * sizeof(*ctx.hash));
+    if (ctx.hash == NULL)
+    {
+        pcap_close(ctx.handle);
+        return TE_RC(TE_TAPI, TE_ENOMEM);
+    }
+    for (i = 0; i < ctx.hash_size; i++)
+        ctx.hash[i] = -1;
+
+    ret = pcap_loop(ctx.handle, 0, sockts_pcap_tcp_handler,
+                    (u_char *)&ctx);
+    if (ret == -1 && ctx.rc == 0)
+    {
+        ERROR("Failed to read %s: %s", pcap_file, pcap_geterr(ctx.handle));
+        ctx.rc = TE_RC(TE_TAPI, TE_EIO);
+    }
+
+    pcap_close(ctx.handle);
+    free(ctx.hash);
+    te_vec_free(&ctx.states);
+
+    if (ctx.rc != 0)
+    {
+        sockts_pcap_tcp_flows_free(&res);
+        return ctx.rc;
+    }
+
+    *flows = res;
+    return 0;
 }
 
-/** Size of buffer for TCP retransmissions */
-#define SOCKTS_PCAP_RETRANS_BUF_SIZE 10000
+/** See definition in sockapi-ts_pcap.h */
+void
+sockts_pcap_tcp_flows_log(te_vec *flows)
+{
+    sockts_pcap_tcp_flow   *flow;
+    te_string               str = TE_STRING_INIT;
+
+    te_string_append(&str, "%-50s%12s%15s%10s%10s%10s%12s%12s%12s\n",
+                     "FLOW", "PACKETS", "BYTES", "RETRANS", "OOO",
+                     "DUP ACKS", "RTT MIN", "RTT AVG", "RTT MAX");
+
+    TE_VEC_FOREACH(flows, flow)
+    {
+        te_string   name = TE_STRING_INIT;
+
+        te_string_append(&name, "%s -> ", te_sockaddr2str(SA(&flow->src)));
+        te_string_append(&name, "%s", te_sockaddr2str(SA(&flow->dst)));
+
+        te_string_append(&str,
+                         "%-50s%12llu%15llu%10llu%10llu%10llu"
+                         "%12llu%12llu%12llu\n", name.ptr,
+                         (unsigned long long)flow->packets,
+                         (unsigned long long)flow->bytes,
+                         (unsigned long long)flow->retrans,
+                         (unsigned long long)flow->out_of_order,
+                         (unsigned long long)flow->dup_acks,
+                         (unsigned long long)flow->rtt_min,
+                         (unsigned long long)(flow->rtt_num == 0 ? 0 :
+                                        flow->rtt_sum / flow->rtt_num),
+                         (unsigned long long)flow->rtt_max);
+        te_string_free(&name);
+    }
+
+    RING("TCP flows (RTT in microseconds):\n%s", str.ptr);
+    te_string_free(&str);
+}
 
 /** See definition in sockapi-ts_pcap.h */
 te_errno
@@ -166,59 +934,51 @@ sockts_pcap_get_retrans(const char *pcap_file,
                         int **retrans,
                         unsigned int *retrans_size)
 {
-    char error_buffer[PCAP_ERRBUF_SIZE];
-    char filter[1024];
-    pcap_t *handle;
-    sockts_pcap_user_data data = {0};
-    struct bpf_program filter_handle;
-    int retrans_buf[SOCKTS_PCAP_RETRANS_BUF_SIZE] = {0};
-    unsigned int i;
-    te_errno rc = 0;
-
-    handle = pcap_open_offline(pcap_file, error_buffer);
+    char                    filter[1024];
+    sockts_pcap_tcp_opts    opts;
+    te_vec                  flows;
+    sockts_pcap_tcp_flow   *flow;
+    sockts_pcap_tcp_flow   *best = NULL;
+    te_errno                rc;
 
     snprintf(filter, sizeof(filter), "dst %s",
              te_sockaddr_get_ipstr(dst_addr));
-    if (pcap_compile(handle, &filter_handle, filter, 1,
-                     PCAP_NETMASK_UNKNOWN) == -1)
-    {
-        ERROR("Failed to compile filter: %s", pcap_geterr(handle));
-        pcap_close(handle);
-        return TE_EINVAL;
-    }
 
-    if (pcap_setfilter(handle, &filter_handle) == -1)
-    {
-        ERROR("Failed to set filter: %s", pcap_geterr(handle));
-        pcap_close(handle);
-        return TE_EINVAL;
-    }
+    memset(&opts, 0, sizeof(opts));
+    opts.filter = filter;
+    opts.chunk_size = chunk_size;
 
-    data.is_failed = FALSE;
-    data.chunk_size = chunk_size;
-    data.retrans = retrans_buf;
-    data.retrans_size = SOCKTS_PCAP_RETRANS_BUF_SIZE;
-    pcap_loop(handle, 0, sockts_pcap_retrans_number_handler, (u_char *)&data);
+    rc = sockts_pcap_tcp_flows_get(pcap_file, &opts, &flows);
+    if (rc != 0)
+        return rc;
 
-    pcap_close(handle);
+    TE_VEC_FOREACH(&flows, flow)
+    {
+        if (best == NULL || flow->data_packets > best->data_packets)
+            best = flow;
+    }
 
-    if (!data.is_failed)
+    if (best == NULL || te_vec_size(&best->chunk_retrans) == 0)
     {
-        *retrans_size = data.retrans_index + 1;
-        *retrans = TE_ALLOC(*retrans_size * sizeof(int));
-        if (*retrans == NULL)
-        {
-            ERROR("Failed to allocate array with TCP retransmissions");
-            return TE_ENOMEM;
-        }
-        memcpy(*retrans, data.retrans, *retrans_size * sizeof(int));
+        ERROR("No TCP data packets to %s are found in %s",
+              te_sockaddr_get_ipstr(dst_addr), pcap_file);
+        sockts_pcap_tcp_flows_free(&flows);
+        return TE_RC(TE_TAPI, TE_ENODATA);
     }
-    else
+
+    *retrans_size = te_vec_size(&best->chunk_retrans);
+    *retrans = TE_ALLOC(*retrans_size * sizeof(int));
+    if (*retrans == NULL)
     {
-        rc = TE_EFAIL;
+        ERROR("Failed to allocate array with TCP retransmissions");
+        sockts_pcap_tcp_flows_free(&flows);
+        return TE_RC(TE_TAPI, TE_ENOMEM);
     }
+    memcpy(*retrans, te_vec_get(&best->chunk_retrans, 0),
+           *retrans_size * sizeof(int));
 
-    return rc;
+    sockts_pcap_tcp_flows_free(&flows);
+    return 0;
 }
 
 /** See definition in sockapi-ts_pcap.h */
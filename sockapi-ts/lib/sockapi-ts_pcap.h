@@ -12,10 +12,93 @@
 #define __SOCKAPI_TS_PCAP_H__
 
 #include "sockapi-test.h"
+#include "te_vector.h"
 
 /**
- * Get TCP retransmissions for chunks from PCAP file with IPv4/TCP connection.
+ * Statistics of one direction of a TCP connection found in PCAP file.
+ * Flows are identified by 4-tuple, SEQ/ACK pairs of both directions
+ * are matched to compute RTT.
+ */
+typedef struct sockts_pcap_tcp_flow {
+    struct sockaddr_storage src;    /**< Sender address and port */
+    struct sockaddr_storage dst;    /**< Receiver address and port */
+
+    uint64_t packets;       /**< Number of TCP packets */
+    uint64_t data_packets;  /**< Number of packets with payload */
+    uint64_t bytes;         /**< Number of new (not retransmitted)
+                                 payload bytes */
+    uint64_t retrans;       /**< Number of retransmitted segments */
+    uint64_t retrans_bytes; /**< Number of retransmitted payload bytes */
+    uint64_t out_of_order;  /**< Number of segments filling a hole in
+                                 sequence space shortly after segments
+                                 with greater SEQ were sent */
+    uint64_t dup_acks;      /**< Number of duplicate ACKs sent by this
+                                 side */
+
+    uint64_t rtt_num;       /**< Number of RTT samples */
+    uint64_t rtt_min;       /**< Minimum RTT (in microseconds) */
+    uint64_t rtt_max;       /**< Maximum RTT (in microseconds) */
+    uint64_t rtt_sum;       /**< Sum of RTT samples (in microseconds) */
+
+    te_vec   goodput;       /**< Number of new payload bytes (uint64_t)
+                                 sent in each interval since the first
+                                 packet of the capture */
+    te_vec   chunk_retrans; /**< Number of retransmissions (int) in each
+                                 chunk of sequence space since the first
+                                 packet of the flow; segments preceding
+                                 it are not counted */
+} sockts_pcap_tcp_flow;
+
+/** Parameters of TCP flows analysis. */
+typedef struct sockts_pcap_tcp_opts {
+    const char     *filter;         /**< BPF filter (may be @c NULL) */
+    uint64_t        interval_us;    /**< Goodput interval (in
+                                         microseconds), @c 0 to disable
+                                         goodput computation */
+    unsigned int    chunk_size;     /**< Chunk size for counting
+                                         retransmissions per chunk,
+                                         @c 0 to disable */
+} sockts_pcap_tcp_opts;
+
+/**
+ * Analyze TCP flows in PCAP file. The file is processed in one pass,
+ * memory used for every flow does not depend on the number of packets
+ * except for goodput and per-chunk retransmissions vectors (their size
+ * is determined by capture duration and amount of transferred data).
+ * Ethernet (with VLAN tags), Linux cooked and raw IP captures of IPv4
+ * and IPv6 packets are supported, non-TCP packets are ignored.
+ *
+ * @param[in]  pcap_file    Path to PCAP file.
+ * @param[in]  opts         Analysis parameters.
+ * @param[out] flows        Where to save vector of sockts_pcap_tcp_flow,
+ *                          it should be released with
+ *                          sockts_pcap_tcp_flows_free().
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_pcap_tcp_flows_get(const char *pcap_file,
+                                          const sockts_pcap_tcp_opts *opts,
+                                          te_vec *flows);
+
+/**
+ * Release TCP flows obtained with sockts_pcap_tcp_flows_get().
+ *
+ * @param flows     Vector of sockts_pcap_tcp_flow.
+ */
+extern void sockts_pcap_tcp_flows_free(te_vec *flows);
+
+/**
+ * Print statistics of TCP flows.
+ *
+ * @param flows     Vector of sockts_pcap_tcp_flow.
+ */
+extern void sockts_pcap_tcp_flows_log(te_vec *flows);
+
+/**
+ * Get TCP retransmissions for chunks from PCAP file with TCP connection.
  * The retransmissions only from one direction of connection are counted.
+ * If there are multiple matching connections, the one with the greatest
+ * number of data packets is chosen.
  *
  * @param[in]   pcap_file       Path to PCAP file
  * @param[in]   dst_addr        Destination address to choose direction of connection
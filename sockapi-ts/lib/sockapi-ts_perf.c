@@ -0,0 +1,582 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ * Implementation of performance regression gate.
+ */
+
+#include "sockapi-ts_perf.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <libgen.h>
+#include <sys/stat.h>
+
+/** Environment variable with the baseline directory */
+#define SOCKTS_PERF_BASELINE_DIR_ENV "SOCKTS_PERF_BASELINE_DIR"
+/** Environment variable enabling baseline update mode */
+#define SOCKTS_PERF_BASELINE_UPDATE_ENV "SOCKTS_PERF_BASELINE_UPDATE"
+/** Environment variable with the run configuration name */
+#define SOCKTS_PERF_CFG_ENV "SOCKTS_PERF_CFG"
+/** Environment variable with the set of ool options */
+#define SOCKTS_PERF_OOL_ENV "SOCKTS_PERF_OOL"
+
+/** Statistics of measurement samples */
+typedef struct sockts_perf_sample_stats {
+    unsigned int    num;    /**< Number of samples */
+    double          mean;   /**< Mean value */
+    double          stddev; /**< Sample standard deviation */
+} sockts_perf_sample_stats;
+
+/**
+ * Get environment variable value usable as a file name.
+ *
+ * @param name      Variable name
+ * @param defval    Value to use if the variable is not set or empty
+ * @param str       Where to append the value
+ */
+static void
+perf_env_to_file_name(const char *name, const char *defval, te_string *str)
+{
+    const char *val = getenv(name);
+    size_t      start = str->len;
+    size_t      i;
+
+    if (val == NULL || *val == '\0')
+        val = defval;
+
+    te_string_append(str, "%s", val);
+    for (i = start; i < str->len; i++)
+    {
+        if (str->ptr[i] == '/' || isspace((unsigned char)str->ptr[i]))
+            str->ptr[i] = '_';
+    }
+}
+
+/**
+ * Create a directory with all its parents.
+ *
+ * @param path      Directory path (it is changed and restored)
+ *
+ * @return Status code.
+ */
+static te_errno
+perf_mkdir_p(char *path)
+{
+    char       *p;
+    te_errno    rc;
+
+    for (p = path + 1; ; p++)
+    {
+        if (*p != '/' && *p != '\0')
+            continue;
+
+        if (*p == '/')
+            *p = '\0';
+        else
+            p = NULL;
+
+        if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        {
+            rc = TE_OS_RC(TE_TAPI, errno);
+            ERROR("%s(): failed to create directory '%s': %r", __FUNCTION__,
+                  path, rc);
+            if (p != NULL)
+                *p = '/';
+            return rc;
+        }
+
+        if (p == NULL)
+            break;
+        *p = '/';
+    }
+
+    return 0;
+}
+
+static te_errno perf_incbeta_check(void);
+
+/* See description in sockapi-ts_perf.h */
+te_errno
+sockts_perf_gate_init(sockts_perf_gate *gate, int argc, char **argv)
+{
+    te_string   path = TE_STRING_INIT;
+    const char *dir = getenv(SOCKTS_PERF_BASELINE_DIR_ENV);
+    const char *update = getenv(SOCKTS_PERF_BASELINE_UPDATE_ENV);
+    char       *p;
+    int         i;
+    te_errno    rc;
+
+    memset(gate, 0, sizeof(*gate));
+    gate->iter = (te_string)TE_STRING_INIT;
+
+    if (dir == NULL || *dir == '\0')
+    {
+        RING("Performance baseline directory is not specified, "
+             "regression gate is disabled");
+        return 0;
+    }
+
+    rc = perf_incbeta_check();
+    if (rc != 0)
+        return rc;
+
+    gate->update = (update != NULL && strcmp(update, "yes") == 0);
+
+    /*
+     * Iteration is identified by the test name and all its arguments,
+     * Tester service arguments are skipped.
+     */
+    te_string_append(&gate->iter, "%s", basename(argv[0]));
+    for (i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "te_", strlen("te_")) == 0)
+            continue;
+        te_string_append(&gate->iter, " %s", argv[i]);
+    }
+    for (p = gate->iter.ptr; *p != '\0'; p++)
+    {
+        if (*p == '\n')
+            *p = ' ';
+    }
+
+    te_string_append(&path, "%s/", dir);
+    perf_env_to_file_name(SOCKTS_PERF_CFG_ENV, "default", &path);
+    rc = perf_mkdir_p(path.ptr);
+    if (rc != 0)
+    {
+        te_string_free(&path);
+        return rc;
+    }
+    te_string_append(&path, "/");
+    perf_env_to_file_name(SOCKTS_PERF_OOL_ENV, "default", &path);
+    gate->path = path.ptr;
+
+    RING("Performance baseline file is '%s'%s", gate->path,
+         gate->update ? ", it is updated" : "");
+
+    return 0;
+}
+
+/**
+ * Get statistics of measurement samples.
+ *
+ * @param samples   TE vector with double values
+ * @param stats     Where to save statistics
+ */
+static void
+perf_samples_stats(te_vec *samples, sockts_perf_sample_stats *stats)
+{
+    double *val;
+    double  delta;
+    double  m2 = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    TE_VEC_FOREACH(samples, val)
+    {
+        stats->num++;
+        delta = *val - stats->mean;
+        stats->mean += delta / stats->num;
+        m2 += delta * (*val - stats->mean);
+    }
+
+    if (stats->num > 1)
+        stats->stddev = sqrt(m2 / (stats->num - 1));
+}
+
+/**
+ * Evaluate continued fraction of the regularized incomplete beta function
+ * with modified Lentz's method.
+ *
+ * @param a     Parameter a
+ * @param b     Parameter b
+ * @param x     Argument
+ *
+ * @return Value of the continued fraction.
+ */
+static double
+perf_incbeta_cf(double a, double b, double x)
+{
+    const double    tiny = 1e-300;
+    double          c = 1;
+    double          d;
+    double          f;
+    double          num;
+    double          delta;
+    int             i;
+    int             m;
+
+    /* The first (odd, m = 0) term is applied here. */
+    d = 1 - (a + b) * x / (a + 1);
+    d = fabs(d) < tiny ? 1 / tiny : 1 / d;
+    f = d;
+
+    for (i = 2; i <= 400; i++)
+    {
+        m = i / 2;
+        if (i % 2 == 0)
+            num = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+        else
+            num = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+
+        d = 1 + num * d;
+        d = fabs(d) < tiny ? 1 / tiny : 1 / d;
+        c = 1 + num / c;
+        c = fabs(c) < tiny ? tiny : c;
+        delta = c * d;
+        f *= delta;
+        if (fabs(delta - 1) < 1e-12)
+            break;
+    }
+
+    return f;
+}
+
+/**
+ * Regularized incomplete beta function I_x(a, b).
+ *
+ * @param a     Parameter a
+ * @param b     Parameter b
+ * @param x     Argument from @c 0 to @c 1
+ *
+ * @return Function value.
+ */
+static double
+perf_incbeta(double a, double b, double x)
+{
+    double front;
+
+    if (x <= 0)
+        return 0;
+    if (x >= 1)
+        return 1;
+
+    front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) +
+                a * log(x) + b * log(1 - x));
+
+    /* The continued fraction converges fast for x < (a + 1) / (a + b + 2) */
+    if (x < (a + 1) / (a + b + 2))
+        return front * perf_incbeta_cf(a, b, x) / a;
+    else
+        return 1 - front * perf_incbeta_cf(b, a, 1 - x) / b;
+}
+
+/**
+ * Get probability that Student's t-distributed value is not less than
+ * @p t.
+ *
+ * @param t     Value
+ * @param df    Degrees of freedom
+ *
+ * @return Probability.
+ */
+static double
+perf_t_upper_tail(double t, double df)
+{
+    double p = 0.5 * perf_incbeta(df / 2, 0.5, df / (df + t * t));
+
+    return t >= 0 ? p : 1 - p;
+}
+
+/**
+ * Check the incomplete beta function and Student's t-distribution tail
+ * against known values, so that a broken implementation does not
+ * silently produce wrong verdicts.
+ *
+ * @return Status code.
+ */
+static te_errno
+perf_incbeta_check(void)
+{
+    static const struct {
+        double a;
+        double b;
+        double x;
+        double val;
+    } incbeta[] = {
+        { 1, 1, 0.3, 0.3 },
+        { 2, 2, 0.2, 0.104 },
+        { 2, 3, 0.5, 0.6875 },
+        { 5, 0.5, 0.9, 0.3166429 },
+        { 0.5, 5, 0.1, 0.6833571 },
+    };
+    static const struct {
+        double t;
+        double df;
+        double val;
+    } t_tail[] = {
+        { 0, 10, 0.5 },
+        { 2, 10, 0.0366940 },
+        { -2, 10, 0.9633060 },
+        { 2.5, 3.5, 0.0378473 },
+    };
+
+    double          val;
+    unsigned int    i;
+
+    for (i = 0; i < TE_ARRAY_LEN(incbeta); i++)
+    {
+        val = perf_incbeta(incbeta[i].a, incbeta[i].b, incbeta[i].x);
+        if (fabs(val - incbeta[i].val) > 1e-6)
+        {
+            ERROR("%s(): I_%g(%g, %g) = %g instead of %g", __FUNCTION__,
+                  incbeta[i].x, incbeta[i].a, incbeta[i].b, val,
+                  incbeta[i].val);
+            return TE_RC(TE_TAPI, TE_EFAIL);
+        }
+    }
+
+    for (i = 0; i < TE_ARRAY_LEN(t_tail); i++)
+    {
+        val = perf_t_upper_tail(t_tail[i].t, t_tail[i].df);
+        if (fabs(val - t_tail[i].val) > 1e-6)
+        {
+            ERROR("%s(): P(T >= %g, df = %g) = %g instead of %g",
+                  __FUNCTION__, t_tail[i].t, t_tail[i].df, val,
+                  t_tail[i].val);
+            return TE_RC(TE_TAPI, TE_EFAIL);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Get one-sided p-value of Welch's t-test for hypothesis that mean of
+ * the current samples is greater than mean of the baseline.
+ *
+ * @param base      Baseline statistics
+ * @param cur       Current statistics
+ *
+ * @return p-value.
+ */
+static double
+perf_welch_p_greater(const sockts_perf_sample_stats *base,
+                     const sockts_perf_sample_stats *cur)
+{
+    double v_base = base->stddev * base->stddev / base->num;
+    double v_cur = cur->stddev * cur->stddev / cur->num;
+    double se2 = v_base + v_cur;
+    double df;
+
+    if (se2 == 0)
+        return cur->mean > base->mean ? 0 : 1;
+
+    df = se2 * se2 / (v_base * v_base / (base->num - 1) +
+                      v_cur * v_cur / (cur->num - 1));
+
+    return perf_t_upper_tail((cur->mean - base->mean) / sqrt(se2), df);
+}
+
+/**
+ * Find a measurement in the baseline file.
+ *
+ * @param path      Baseline file
+ * @param key       Measurement key
+ * @param stats     Where to save baseline statistics
+ * @param found     Set to @c TRUE if the measurement is found
+ * @param others    If not @c NULL, lines of other measurements are
+ *                  appended to it
+ *
+ * @return Status code.
+ */
+static te_errno
+perf_baseline_read(const char *path, const char *key,
+                   sockts_perf_sample_stats *stats, te_bool *found,
+                   te_string *others)
+{
+    FILE       *f;
+    char       *line = NULL;
+    size_t      line_size = 0;
+    ssize_t     len;
+    int         key_off;
+    te_errno    rc;
+
+    *found = FALSE;
+
+    f = fopen(path, "r");
+    if (f == NULL)
+    {
+        if (errno == ENOENT)
+            return 0;
+
+        rc = TE_OS_RC(TE_TAPI, errno);
+        ERROR("%s(): failed to open '%s': %r", __FUNCTION__, path, rc);
+        return rc;
+    }
+
+    while ((len = getline(&line, &line_size, f)) > 0)
+    {
+        if (line[len - 1] == '\n')
+            line[--len] = '\0';
+
+        key_off = -1;
+        if (sscanf(line, "%u %lf %lf %n", &stats->num, &stats->mean,
+                   &stats->stddev, &key_off) != 3 || key_off < 0)
+        {
+            WARN("%s(): skipping malformed line in '%s': %s", __FUNCTION__,
+                 path, line);
+            continue;
+        }
+
+        if (!*found && strcmp(line + key_off, key) == 0)
+            *found = TRUE;
+        else if (others != NULL)
+            te_string_append(others, "%s\n", line);
+
+        if (*found && others == NULL)
+            break;
+    }
+
+    free(line);
+    fclose(f);
+
+    if (!*found)
+        memset(stats, 0, sizeof(*stats));
+
+    return 0;
+}
+
+/**
+ * Save statistics of a measurement in the baseline file replacing
+ * the previous value.
+ *
+ * @param path      Baseline file
+ * @param key       Measurement key
+ * @param stats     Statistics to save
+ *
+ * @return Status code.
+ */
+static te_errno
+perf_baseline_write(const char *path, const char *key,
+                    const sockts_perf_sample_stats *stats)
+{
+    te_string                   content = TE_STRING_INIT;
+    te_string                   tmp_path = TE_STRING_INIT;
+    sockts_perf_sample_stats    old;
+    te_bool                     found;
+    FILE                       *f;
+    te_errno                    rc;
+
+    rc = perf_baseline_read(path, key, &old, &found, &content);
+    if (rc != 0)
+        goto out;
+
+    te_string_append(&content, "%u %.9g %.9g %s\n", stats->num, stats->mean,
+                     stats->stddev, key);
+
+    /* Write to a temporary file first to keep the baseline consistent */
+    te_string_append(&tmp_path, "%s.tmp", path);
+    f = fopen(tmp_path.ptr, "w");
+    if (f == NULL)
+    {
+        rc = TE_OS_RC(TE_TAPI, errno);
+        ERROR("%s(): failed to open '%s': %r", __FUNCTION__, tmp_path.ptr,
+              rc);
+        goto out;
+    }
+
+    if (fputs(content.ptr, f) == EOF)
+    {
+        rc = TE_OS_RC(TE_TAPI, errno);
+        ERROR("%s(): failed to write '%s': %r", __FUNCTION__, tmp_path.ptr,
+              rc);
+        fclose(f);
+        goto out;
+    }
+
+    if (fclose(f) != 0 || rename(tmp_path.ptr, path) != 0)
+    {
+        rc = TE_OS_RC(TE_TAPI, errno);
+        ERROR("%s(): failed to save '%s': %r", __FUNCTION__, path, rc);
+    }
+
+out:
+    te_string_free(&content);
+    te_string_free(&tmp_path);
+    return rc;
+}
+
+/* See description in sockapi-ts_perf.h */
+te_errno
+sockts_perf_gate_check(sockts_perf_gate *gate, const char *name,
+                       sockts_perf_better better, te_vec *samples)
+{
+    te_string                   key = TE_STRING_INIT;
+    sockts_perf_sample_stats    base;
+    sockts_perf_sample_stats    cur;
+    te_bool                     found;
+    double                      p_worse;
+    double                      p_better;
+    double                      change;
+    te_errno                    rc = 0;
+
+    if (gate->path == NULL)
+        return 0;
+
+    perf_samples_stats(samples, &cur);
+    RING("%s: %u samples, mean %.3f, standard deviation %.3f", name,
+         cur.num, cur.mean, cur.stddev);
+    if (cur.num < 2)
+    {
+        WARN("%s(): at least two samples are required for comparison "
+             "with baseline", __FUNCTION__);
+        return 0;
+    }
+
+    te_string_append(&key, "%s %s", gate->iter.ptr, name);
+
+    if (gate->update)
+    {
+        rc = perf_baseline_write(gate->path, key.ptr, &cur);
+        goto out;
+    }
+
+    rc = perf_baseline_read(gate->path, key.ptr, &base, &found, NULL);
+    if (rc != 0)
+        goto out;
+
+    if (!found || base.num < 2)
+    {
+        WARN("There is no baseline for '%s'", name);
+        goto out;
+    }
+
+    change = base.mean == 0 ? 0 : 100 * (cur.mean - base.mean) / base.mean;
+    p_better = perf_welch_p_greater(&base, &cur);
+    p_worse = 1 - p_better;
+    if (better == SOCKTS_PERF_LOWER_BETTER)
+    {
+        change = -change;
+        p_worse = p_better;
+        p_better = 1 - p_worse;
+    }
+
+    RING("%s: baseline %u samples, mean %.3f, standard deviation %.3f; "
+         "change %+.2f%%, p-value of regression %.4g", name, base.num,
+         base.mean, base.stddev, change, p_worse);
+
+    if (p_worse < SOCKTS_PERF_ALPHA && -change > SOCKTS_PERF_MIN_CHANGE)
+    {
+        gate->regressed = TRUE;
+        ERROR_VERDICT("Statistically significant regression of %s", name);
+    }
+    else if (p_better < SOCKTS_PERF_ALPHA && change > SOCKTS_PERF_MIN_CHANGE)
+    {
+        RING("%s is significantly better than baseline, consider updating "
+             "the baseline", name);
+    }
+
+out:
+    te_string_free(&key);
+    return rc;
+}
+
+/* See description in sockapi-ts_perf.h */
+void
+sockts_perf_gate_fini(sockts_perf_gate *gate)
+{
+    free(gate->path);
+    gate->path = NULL;
+    te_string_free(&gate->iter);
+}
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/** @file
+ * @brief Performance regression gate
+ *
+ * Test API to compare performance measurements with stored baseline.
+ *
+ * Baseline is stored on the Engine host in a directory specified by
+ * @c SOCKTS_PERF_BASELINE_DIR environment variable (the gate is disabled
+ * if it is not set), in a file per run configuration
+ * (@c SOCKTS_PERF_CFG) and set of ool options (@c SOCKTS_PERF_OOL).
+ * Every line of the file keeps the number of samples, their mean and
+ * standard deviation for a measurement of a test iteration. If
+ * @c SOCKTS_PERF_BASELINE_UPDATE is @c yes, measurements are saved as
+ * new baseline instead of comparing.
+ */
+
+#ifndef __TS_SOCKAPI_TS_PERF_H__
+#define __TS_SOCKAPI_TS_PERF_H__
+
+#include "sockapi-test.h"
+#include "te_string.h"
+#include "te_vector.h"
+
+/**
+ * Significance level of one-sided Welch's t-test used to detect
+ * a regression.
+ */
+#define SOCKTS_PERF_ALPHA 0.01
+
+/**
+ * Minimum change of the mean in percents to report a regression, so that
+ * statistically significant but negligible changes are ignored.
+ */
+#define SOCKTS_PERF_MIN_CHANGE 3
+
+/** Which direction of a measurement change is an improvement */
+typedef enum sockts_perf_better {
+    SOCKTS_PERF_HIGHER_BETTER,  /**< Throughput, rate */
+    SOCKTS_PERF_LOWER_BETTER,   /**< Latency */
+} sockts_perf_better;
+
+/** Performance regression gate of a test iteration */
+typedef struct sockts_perf_gate {
+    char       *path;       /**< Baseline file, @c NULL if the gate is
+                                 disabled */
+    te_string   iter;       /**< Test iteration identifier */
+    te_bool     update;     /**< Save measurements as baseline */
+    te_bool     regressed;  /**< Set to @c TRUE if a regression is
+                                 detected */
+} sockts_perf_gate;
+
+/**
+ * Initialize performance regression gate for the current test iteration.
+ *
+ * @param[out] gate     Gate to initialize
+ * @param[in]  argc     Number of test arguments
+ * @param[in]  argv     Test arguments
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_perf_gate_init(sockts_perf_gate *gate,
+                                      int argc, char **argv);
+
+/**
+ * Compare samples of a measurement with the baseline using one-sided
+ * Welch's t-test. If the measurement is significantly worse than the
+ * baseline (see @ref SOCKTS_PERF_ALPHA and @ref SOCKTS_PERF_MIN_CHANGE),
+ * print an error verdict and set @b regressed field of @p gate.
+ * In update mode save samples statistics as new baseline.
+ *
+ * @param gate      Performance regression gate
+ * @param name      Name of the measurement, unique in the test iteration
+ *                  (it is used in a verdict)
+ * @param better    Which direction of change is an improvement
+ * @param samples   TE vector with double values of the measurement
+ *                  obtained in different runs
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_perf_gate_check(sockts_perf_gate *gate,
+                                       const char *name,
+                                       sockts_perf_better better,
+                                       te_vec *samples);
+
+/**
+ * Release resources allocated for performance regression gate.
+ *
+ * @param gate      Performance regression gate
+ */
+extern void sockts_perf_gate_fini(sockts_perf_gate *gate);
+
+#endif /* __TS_SOCKAPI_TS_PERF_H__ */
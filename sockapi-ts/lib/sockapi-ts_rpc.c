@@ -199,6 +199,18 @@ rpc_many_sendto(rcf_rpc_server *rpcs, int num,
 int
 rpc_many_send(rcf_rpc_server *rpcs, int sock, int flags,
               const tarpc_size_t *vector, int nops, uint64_t *sent)
+{
+    return rpc_many_send_batch(rpcs, sock, flags, vector, nops, NULL, 1, 0,
+                               NULL, NULL, sent, NULL, NULL);
+}
+
+int
+rpc_many_send_batch(rcf_rpc_server *rpcs, int sock, int flags,
+                    const tarpc_size_t *vector, int nops,
+                    const char *func_name, unsigned int batch,
+                    tarpc_size_t pool_size, const char *gen_func,
+                    const tarpc_pat_gen_arg *gen_arg,
+                    uint64_t *sent, uint64_t *calls, uint64_t *duration)
 {
     tarpc_many_send_in  in;
     tarpc_many_send_out out;
@@ -214,6 +226,12 @@ rpc_many_send(rcf_rpc_server *rpcs, int sock, int flags,
 
     in.sock = sock;
     in.flags = flags;
+    in.func_name = (char *)(func_name == NULL ? "" : func_name);
+    in.batch = batch;
+    in.pool_size = pool_size;
+    in.gen_func = (char *)(gen_func == NULL ? "" : gen_func);
+    if (gen_arg != NULL)
+        in.gen_arg = *gen_arg;
 
     if (vector != NULL && rpcs->op != RCF_RPC_WAIT)
     {
@@ -224,11 +242,20 @@ rpc_many_send(rcf_rpc_server *rpcs, int sock, int flags,
     rcf_rpc_call(rpcs, "many_send", &in, &out);
 
     if (out.retval == 0)
+    {
         *sent = out.bytes;
+        if (calls != NULL)
+            *calls = out.calls;
+        if (duration != NULL)
+            *duration = out.duration;
+    }
 
     CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(many_send, out.retval);
-    TAPI_RPC_LOG(rpcs, many_send, "%d, %u, %p", "%d",
-                 sock, nops, vector, out.retval);
+    TAPI_RPC_LOG(rpcs, many_send, "%d, %u, %p, %s, batch=%u, pool=%u",
+                 "%d calls=%" TE_PRINTF_64 "u duration=%" TE_PRINTF_64 "u ns",
+                 sock, nops, vector, in.func_name, batch,
+                 (unsigned int)pool_size, out.retval, out.calls,
+                 out.duration);
     RETVAL_INT(many_send, out.retval);
 }
 
@@ -1085,10 +1112,49 @@ rpc_get_socket_from_array(rcf_rpc_server *rpcs, rpc_ptr handle,
     RETVAL_INT(get_socket_from_array, out.retval);
 }
 
+/**
+ * Copy throughput samples from RPC output.
+ *
+ * @param val         Samples array from RPC output.
+ * @param len         Number of samples.
+ * @param samples     Where to save allocated copy of samples or @c NULL.
+ * @param n_samples   Where to save number of samples or @c NULL.
+ */
+static void
+copy_tput_samples(const uint64_t *val, unsigned int len,
+                  uint64_t **samples, unsigned int *n_samples)
+{
+    if (samples != NULL)
+    {
+        *samples = NULL;
+        if (len > 0)
+        {
+            *samples = TE_ALLOC(len * sizeof(**samples));
+            memcpy(*samples, val, len * sizeof(**samples));
+        }
+    }
+
+    if (n_samples != NULL)
+        *n_samples = len;
+}
+
 int
 rpc_many_recv(rcf_rpc_server *rpcs, int sock, tarpc_size_t length, int num,
               int duration, void *last_packet, tarpc_size_t last_packet_len,
               te_bool count_fails, int *fails_num)
+{
+    return rpc_many_recv_samples(rpcs, sock, length, num, duration,
+                                 last_packet, last_packet_len, count_fails,
+                                 fails_num, 0, NULL, NULL);
+}
+
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_many_recv_samples(rcf_rpc_server *rpcs, int sock, tarpc_size_t length,
+                      int num, int duration, void *last_packet,
+                      tarpc_size_t last_packet_len, te_bool count_fails,
+                      int *fails_num, uint64_t bucket_us,
+                      uint64_t **samples, unsigned int *n_samples)
 {
     struct tarpc_many_recv_in  in;
     struct tarpc_many_recv_out out;
@@ -1103,17 +1169,22 @@ rpc_many_recv(rcf_rpc_server *rpcs, int sock, tarpc_size_t length, int num,
     in.last_packet.last_packet_val = last_packet;
     in.last_packet.last_packet_len = last_packet_len;
     in.count_fails = count_fails;
+    in.bucket_us = bucket_us;
 
     rcf_rpc_call(rpcs, "many_recv", &in, &out);
 
     CHECK_RETVAL_VAR_IS_GTE_MINUS_ONE(many_recv, out.retval);
     TAPI_RPC_LOG(rpcs, many_recv,
-                 "%d, %td, %d, %d, 0x%x, %td, %d, 0x%x", "%d, fails %d",
+                 "%d, %td, %d, %d, 0x%x, %td, %d, 0x%x, %" TE_PRINTF_64 "u",
+                 "%d, fails %d, samples %u",
                  sock, length, num, duration, last_packet, last_packet_len,
-                 count_fails, fails_num, out.retval, out.fails_num);
+                 count_fails, fails_num, bucket_us, out.retval,
+                 out.fails_num, out.samples.samples_len);
 
     if (fails_num != NULL)
         *fails_num = out.fails_num;
+    copy_tput_samples(out.samples.samples_val, out.samples.samples_len,
+                      samples, n_samples);
 
     RETVAL_INT(many_recv, out.retval);
 }
@@ -1956,6 +2027,49 @@ rpc_sockts_proc_zc_compl_queue(rcf_rpc_server *rpcs, rpc_ptr qhead,
     RETVAL_INT(sockts_proc_zc_compl_queue, out.retval);
 }
 
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_sockts_zc_compl_queue_stats(rcf_rpc_server *rpcs, rpc_ptr qhead,
+                                te_bool reset,
+                                tarpc_sockts_zc_compl_stats *stats)
+{
+    tarpc_sockts_zc_compl_queue_stats_in  in;
+    tarpc_sockts_zc_compl_queue_stats_out out;
+
+    if (rpcs == NULL)
+    {
+        ERROR("%s(): Invalid RPC server handle", __FUNCTION__);
+        RETVAL_INT(sockts_zc_compl_queue_stats, -1);
+    }
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    in.qhead = qhead;
+    in.reset = reset;
+
+    rcf_rpc_call(rpcs, "sockts_zc_compl_queue_stats", &in, &out);
+
+    CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_zc_compl_queue_stats,
+                                          out.retval);
+    TAPI_RPC_LOG(rpcs, sockts_zc_compl_queue_stats, RPC_PTR_FMT ", %s",
+                 "%d in_flight=%u max_in_flight=%u "
+                 "completed=%" TE_PRINTF_64 "u "
+                 "dropped=%" TE_PRINTF_64 "u "
+                 "latency min=%" TE_PRINTF_64 "u p50=%" TE_PRINTF_64 "u "
+                 "p99=%" TE_PRINTF_64 "u max=%" TE_PRINTF_64 "u ns",
+                 RPC_PTR_VAL(qhead), reset ? "TRUE" : "FALSE",
+                 out.retval, out.stats.in_flight, out.stats.max_in_flight,
+                 out.stats.completed, out.stats.dropped,
+                 out.stats.lat_min, out.stats.lat_p50,
+                 out.stats.lat_p99, out.stats.lat_max);
+
+    if (stats != NULL && rpcs->op != RCF_RPC_WAIT)
+        *stats = out.stats;
+
+    RETVAL_INT(sockts_zc_compl_queue_stats, out.retval);
+}
+
 /**
  * Obtain string representation of rpc_onload_zc_mmsg structure.
  *
@@ -3236,6 +3350,17 @@ rpc_many_send_cork(rcf_rpc_server *rpcs, int fd, int fd_aux,
 tarpc_ssize_t
 rpc_recv_timing(rcf_rpc_server *rpcs, int fd, int fd_aux,
                 tarpc_size_t length, uint64_t *duration)
+{
+    return rpc_recv_timing_samples(rpcs, fd, fd_aux, length, duration,
+                                   0, NULL, NULL);
+}
+
+/* See decription in sockapi-ts_rpc.h */
+tarpc_ssize_t
+rpc_recv_timing_samples(rcf_rpc_server *rpcs, int fd, int fd_aux,
+                        tarpc_size_t length, uint64_t *duration,
+                        uint64_t bucket_us, uint64_t **samples,
+                        unsigned int *n_samples)
 {
     tarpc_recv_timing_in  in;
     tarpc_recv_timing_out out;
@@ -3246,18 +3371,22 @@ rpc_recv_timing(rcf_rpc_server *rpcs, int fd, int fd_aux,
     in.fd = fd;
     in.fd_aux = fd_aux;
     in.length = length;
+    in.bucket_us = bucket_us;
 
     rcf_rpc_call(rpcs, "recv_timing", &in, &out);
 
     CHECK_RETVAL_VAR_IS_GTE_MINUS_ONE(recv_timing, out.retval);
 
     TAPI_RPC_LOG(rpcs, recv_timing,
-                 "%d, %d, %" TE_PRINTF_SIZE_T "u",
-                 "%d duration %" TE_PRINTF_64 "u",
-                 fd, fd_aux, length, out.retval, out.duration);
+                 "%d, %d, %" TE_PRINTF_SIZE_T "u, %" TE_PRINTF_64 "u",
+                 "%d duration %" TE_PRINTF_64 "u samples %u",
+                 fd, fd_aux, length, bucket_us, out.retval, out.duration,
+                 out.samples.samples_len);
 
     if (duration != NULL)
         *duration = out.duration;
+    copy_tput_samples(out.samples.samples_val, out.samples.samples_len,
+                      samples, n_samples);
 
     RETVAL_INT(recv_timing, out.retval);
 }
@@ -3692,9 +3821,13 @@ rpc_connect_send_dur_time(rcf_rpc_server *rpcs,
 
 /* See decription in sockapi-ts_rpc.h */
 int
-rpc_sockts_iomux_timeout_loop(rcf_rpc_server *rpcs, iomux_call_type iomux,
-                              struct tarpc_pollfd *fds, unsigned int nfds,
-                              int timeout, unsigned int n_calls)
+rpc_sockts_iomux_timeout_loop_gen(rcf_rpc_server *rpcs,
+                                  iomux_call_type iomux,
+                                  struct tarpc_pollfd *fds,
+                                  unsigned int nfds, int timeout,
+                                  unsigned int n_calls,
+                                  tarpc_sockts_iomux_timeout_stats *stats,
+                                  uint64_t *late, uint64_t *early)
 {
     tarpc_sockts_iomux_timeout_loop_in in;
     tarpc_sockts_iomux_timeout_loop_out out;
@@ -3715,6 +3848,8 @@ rpc_sockts_iomux_timeout_loop(rcf_rpc_server *rpcs, iomux_call_type iomux,
     in.fds.fds_len = nfds;
     in.timeout = timeout;
     in.n_calls = n_calls;
+    if (stats != NULL || late != NULL || early != NULL)
+        in.hist_size = SOCKTS_IOMUX_TIMEOUT_HIST_SIZE;
 
     rcf_rpc_call(rpcs, "sockts_iomux_timeout_loop", &in, &out);
 
@@ -3728,18 +3863,50 @@ rpc_sockts_iomux_timeout_loop(rcf_rpc_server *rpcs, iomux_call_type iomux,
     CHECK_RETVAL_VAR_IS_GTE_MINUS_ONE(sockts_iomux_timeout_loop,
                                       out.retval);
     TAPI_RPC_LOG(rpcs, sockts_iomux_timeout_loop,
-                 "%s(), fds=%p[%s], nfds=%u, timeout=%d, n_calls=%u", "%d",
+                 "%s(), fds=%p[%s], nfds=%u, timeout=%d, n_calls=%u, "
+                 "wait={min=%llu, p50=%llu, p99=%llu, p99.9=%llu, "
+                 "max=%llu} ns", "%d",
                  iomux_call_en2str(iomux), fds, log_str.ptr, nfds, timeout,
-                 n_calls, out.retval);
+                 n_calls,
+                 (long long unsigned int)out.stats.wait_min,
+                 (long long unsigned int)out.stats.wait_p50,
+                 (long long unsigned int)out.stats.wait_p99,
+                 (long long unsigned int)out.stats.wait_p999,
+                 (long long unsigned int)out.stats.wait_max, out.retval);
+
+    if (rpcs->op != RCF_RPC_WAIT)
+    {
+        if (stats != NULL)
+            *stats = out.stats;
+        if (late != NULL)
+        {
+            memset(late, 0, SOCKTS_IOMUX_TIMEOUT_HIST_SIZE * sizeof(*late));
+            memcpy(late, out.late.late_val,
+                   MIN(out.late.late_len, SOCKTS_IOMUX_TIMEOUT_HIST_SIZE) *
+                   sizeof(*late));
+        }
+        if (early != NULL)
+        {
+            memset(early, 0,
+                   SOCKTS_IOMUX_TIMEOUT_HIST_SIZE * sizeof(*early));
+            memcpy(early, out.early.early_val,
+                   MIN(out.early.early_len,
+                       SOCKTS_IOMUX_TIMEOUT_HIST_SIZE) * sizeof(*early));
+        }
+    }
+
     RETVAL_INT(sockts_iomux_timeout_loop, out.retval);
 }
 
 /* See description in sockapi-ts_rpc.h */
 int
-rpc_sockts_peek_stream_receiver(rcf_rpc_server *rpcs, int s,
-                                int time2run, int time2wait,
-                                tarpc_pat_gen_arg *gen_arg,
-                                uint64_t *received)
+rpc_sockts_peek_stream_receiver_gen(rcf_rpc_server *rpcs, int s,
+                                    int time2run, int time2wait,
+                                    int peek_count, te_bool fixed_ratio,
+                                    unsigned int batch,
+                                    tarpc_pat_gen_arg *gen_arg,
+                                    uint64_t *received,
+                                    tarpc_sockts_peek_stream_stats *stats)
 {
     tarpc_sockts_peek_stream_receiver_in in;
     tarpc_sockts_peek_stream_receiver_out out;
@@ -3750,6 +3917,9 @@ rpc_sockts_peek_stream_receiver(rcf_rpc_server *rpcs, int s,
     in.fd = s;
     in.time2run = time2run;
     in.time2wait = time2wait;
+    in.peek_count = peek_count;
+    in.fixed_ratio = fixed_ratio;
+    in.batch = batch;
     memcpy(&in.gen_arg, gen_arg, sizeof(*gen_arg));
 
     rcf_rpc_call(rpcs, "sockts_peek_stream_receiver", &in, &out);
@@ -3757,18 +3927,335 @@ rpc_sockts_peek_stream_receiver(rcf_rpc_server *rpcs, int s,
     CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_peek_stream_receiver,
                                           out.retval);
     TAPI_RPC_LOG(rpcs, sockts_peek_stream_receiver,
-                 "time2run=%d, time2wait=%d, gen_arg=["
-                 TARPC_PAT_GEN_ARG_FMT "], received=%llu",
-                 "%d", time2run, time2wait,
+                 "time2run=%d, time2wait=%d, peek_count=%d%s, batch=%u, "
+                 "gen_arg=[" TARPC_PAT_GEN_ARG_FMT "], received=%llu, "
+                 "peek={calls=%llu, bytes=%llu, ns/call=%llu}, "
+                 "recv={calls=%llu, ns/call=%llu}, mbps=%llu",
+                 "%d", time2run, time2wait, peek_count,
+                 fixed_ratio ? " (fixed)" : "", batch,
                  TARPC_PAT_GEN_ARG_VAL(*gen_arg),
-                 (long long unsigned int)(out.received), out.retval);
+                 (long long unsigned int)(out.received),
+                 (long long unsigned int)out.stats.peek_calls,
+                 (long long unsigned int)out.stats.peek_bytes,
+                 (long long unsigned int)(out.stats.peek_calls == 0 ? 0 :
+                        out.stats.peek_ns / out.stats.peek_calls),
+                 (long long unsigned int)out.stats.recv_calls,
+                 (long long unsigned int)(out.stats.recv_calls == 0 ? 0 :
+                        out.stats.recv_ns / out.stats.recv_calls),
+                 (long long unsigned int)out.stats.mbps, out.retval);
 
     if (rpcs->op != RCF_RPC_WAIT)
     {
         memcpy(gen_arg, &out.gen_arg, sizeof(*gen_arg));
         if (received != NULL)
             *received = out.received;
+        if (stats != NULL)
+            *stats = out.stats;
     }
 
     RETVAL_INT(sockts_peek_stream_receiver, out.retval);
 }
+
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_sockts_traffic_engine_gen(rcf_rpc_server *rpcs,
+                              const int *fds, unsigned int n_fds,
+                              te_bool snd, const char *func_name,
+                              size_t size, unsigned int batch,
+                              unsigned int threads, unsigned int time2run,
+                              unsigned int sample_interval, rpc_ptr stop,
+                              const int *cpus, unsigned int n_cpus,
+                              tarpc_sockts_traffic_engine_stats *stats,
+                              uint64_t **samples, unsigned int *n_samples,
+                              uint64_t *duration,
+                              tarpc_sockts_traffic_engine_cpu *cpu_util)
+{
+    tarpc_sockts_traffic_engine_in  in;
+    tarpc_sockts_traffic_engine_out out;
+
+    te_string    log_str = TE_STRING_INIT_STATIC(1024);
+    te_string    cpus_str = TE_STRING_INIT_STATIC(1024);
+    unsigned int i;
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    in.fds.fds_val = (tarpc_int *)fds;
+    in.fds.fds_len = n_fds;
+    in.snd = snd;
+    in.func_name = (char *)func_name;
+    in.size = size;
+    in.batch = batch;
+    in.threads = threads;
+    in.time2run = time2run;
+    in.sample_interval = sample_interval;
+    in.stop = stop;
+    in.cpus.cpus_val = (tarpc_int *)cpus;
+    in.cpus.cpus_len = n_cpus;
+
+    rcf_rpc_call(rpcs, "sockts_traffic_engine", &in, &out);
+
+    CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_traffic_engine,
+                                          out.retval);
+
+    for (i = 0; i < n_fds; i++)
+        te_string_append(&log_str, "%s%d", i == 0 ? "" : ", ", fds[i]);
+    for (i = 0; i < n_cpus; i++)
+        te_string_append(&cpus_str, "%s%d", i == 0 ? "" : ", ", cpus[i]);
+
+    TAPI_RPC_LOG(rpcs, sockts_traffic_engine,
+                 "fds=[%s], snd=%s, func=%s, size=%llu, batch=%u, "
+                 "threads=%u, time2run=%u, sample_interval=%u, stop="
+                 RPC_PTR_FMT ", cpus=[%s], samples=%u, duration=%llu",
+                 "%d", log_str.ptr, snd ? "TRUE" : "FALSE", func_name,
+                 (long long unsigned int)size, batch, threads, time2run,
+                 sample_interval, RPC_PTR_VAL(stop), cpus_str.ptr,
+                 out.samples.samples_len,
+                 (long long unsigned int)out.duration, out.retval);
+
+    if (rpcs->op != RCF_RPC_WAIT)
+    {
+        if (stats != NULL && out.stats.stats_val != NULL)
+        {
+            memcpy(stats, out.stats.stats_val,
+                   MIN(n_fds, out.stats.stats_len) * sizeof(*stats));
+        }
+
+        if (samples != NULL)
+        {
+            *samples = NULL;
+            if (out.samples.samples_len > 0)
+            {
+                *samples = TE_ALLOC(out.samples.samples_len *
+                                    sizeof(**samples));
+                memcpy(*samples, out.samples.samples_val,
+                       out.samples.samples_len * sizeof(**samples));
+            }
+        }
+        if (n_samples != NULL)
+            *n_samples = out.samples.samples_len;
+        if (duration != NULL)
+            *duration = out.duration;
+        if (cpu_util != NULL && out.cpu.cpu_val != NULL)
+        {
+            memcpy(cpu_util, out.cpu.cpu_val,
+                   MIN(n_cpus, out.cpu.cpu_len) * sizeof(*cpu_util));
+        }
+    }
+
+    RETVAL_INT(sockts_traffic_engine, out.retval);
+}
+
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_sockts_get_cpus(rcf_rpc_server *rpcs, int **cpus, unsigned int *n_cpus)
+{
+    tarpc_sockts_get_cpus_in  in;
+    tarpc_sockts_get_cpus_out out;
+
+    te_string    log_str = TE_STRING_INIT_STATIC(1024);
+    unsigned int i;
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    rcf_rpc_call(rpcs, "sockts_get_cpus", &in, &out);
+
+    CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_get_cpus, out.retval);
+
+    for (i = 0; i < out.cpus.cpus_len; i++)
+    {
+        te_string_append(&log_str, "%s%d", i == 0 ? "" : ", ",
+                         out.cpus.cpus_val[i]);
+    }
+
+    TAPI_RPC_LOG(rpcs, sockts_get_cpus, "", "%d cpus=[%s]",
+                 out.retval, log_str.ptr);
+
+    if (rpcs->op != RCF_RPC_WAIT)
+    {
+        *cpus = NULL;
+        *n_cpus = out.cpus.cpus_len;
+        if (out.cpus.cpus_len > 0)
+        {
+            *cpus = TE_ALLOC(out.cpus.cpus_len * sizeof(**cpus));
+            memcpy(*cpus, out.cpus.cpus_val,
+                   out.cpus.cpus_len * sizeof(**cpus));
+        }
+    }
+
+    RETVAL_INT(sockts_get_cpus, out.retval);
+}
+
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_sockts_conn_rate_gen(rcf_rpc_server *rpcs,
+                         const struct sockaddr *addr,
+                         const int *listeners, unsigned int n_listeners,
+                         unsigned int threads, unsigned int window,
+                         unsigned int num, unsigned int time2run,
+                         te_bool keep, unsigned int req_size,
+                         tarpc_sockts_conn_rate_stats *stats)
+{
+    tarpc_sockts_conn_rate_in  in;
+    tarpc_sockts_conn_rate_out out;
+    struct tarpc_sa            rpc_addr;
+
+    te_string    log_str = TE_STRING_INIT_STATIC(1024);
+    unsigned int i;
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    if (addr != NULL)
+    {
+        sockaddr_input_h2rpc(addr, &rpc_addr);
+        in.addr.addr_val = &rpc_addr;
+        in.addr.addr_len = 1;
+    }
+    in.listeners.listeners_val = (tarpc_int *)listeners;
+    in.listeners.listeners_len = n_listeners;
+    in.threads = threads;
+    in.window = window;
+    in.num = num;
+    in.time2run = time2run;
+    in.keep = keep;
+    in.req_size = req_size;
+
+    rcf_rpc_call(rpcs, "sockts_conn_rate", &in, &out);
+
+    CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_conn_rate, out.retval);
+
+    for (i = 0; i < n_listeners; i++)
+    {
+        te_string_append(&log_str, "%s%d", i == 0 ? "" : ", ",
+                         listeners[i]);
+    }
+
+    TAPI_RPC_LOG(rpcs, sockts_conn_rate,
+                 "addr=%s, listeners=[%s], threads=%u, window=%u, num=%u, "
+                 "time2run=%u, keep=%s, req_size=%u",
+                 "%d connected=%" TE_PRINTF_64 "u failed=%" TE_PRINTF_64 "u "
+                 "completed=%" TE_PRINTF_64 "u accepted=%" TE_PRINTF_64 "u "
+                 "served=%" TE_PRINTF_64 "u duration=%" TE_PRINTF_64 "u "
+                 "latency p50=%" TE_PRINTF_64 "u p99=%" TE_PRINTF_64 "u ns "
+                 "accept p50=%" TE_PRINTF_64 "u p99=%" TE_PRINTF_64 "u ns",
+                 addr == NULL ? "none" : sockaddr_h2str(addr), log_str.ptr,
+                 threads, window, num, time2run, keep ? "TRUE" : "FALSE",
+                 req_size, out.retval, out.stats.connected,
+                 out.stats.failed, out.stats.completed, out.stats.accepted,
+                 out.stats.served, out.stats.duration,
+                 out.stats.lat_p50, out.stats.lat_p99,
+                 out.stats.acc_lat_p50, out.stats.acc_lat_p99);
+
+    if (stats != NULL && rpcs->op != RCF_RPC_WAIT)
+        *stats = out.stats;
+
+    RETVAL_INT(sockts_conn_rate, out.retval);
+}
+
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_sockts_epoll_bench(rcf_rpc_server *rpcs, rpc_ptr socks_arr,
+                       unsigned int socks_num, unsigned int ready_num,
+                       uint32_t events, uint32_t idle_events,
+                       unsigned int maxevents, unsigned int wait_calls,
+                       tarpc_sockts_epoll_bench_stats *stats)
+{
+    tarpc_sockts_epoll_bench_in  in;
+    tarpc_sockts_epoll_bench_out out;
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    in.socks_arr = socks_arr;
+    in.socks_num = socks_num;
+    in.ready_num = ready_num;
+    in.events = events;
+    in.idle_events = idle_events;
+    in.maxevents = maxevents;
+    in.wait_calls = wait_calls;
+
+    rcf_rpc_call(rpcs, "sockts_epoll_bench", &in, &out);
+
+    CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_epoll_bench, out.retval);
+    TAPI_RPC_LOG(rpcs, sockts_epoll_bench,
+                 "socks=" RPC_PTR_FMT ", socks_num=%u, ready_num=%u, "
+                 "events=%s, idle_events=%s, maxevents=%u, wait_calls=%u",
+                 "%d add=%" TE_PRINTF_64 "u mod=%" TE_PRINTF_64 "u "
+                 "del=%" TE_PRINTF_64 "u wait p50=%" TE_PRINTF_64 "u "
+                 "p99=%" TE_PRINTF_64 "u ns, fairness=%u",
+                 RPC_PTR_VAL(socks_arr), socks_num, ready_num,
+                 epoll_event_rpc2str(events),
+                 epoll_event_rpc2str(idle_events), maxevents, wait_calls,
+                 out.retval, out.stats.add_ns, out.stats.mod_ns,
+                 out.stats.del_ns, out.stats.wait_p50, out.stats.wait_p99,
+                 out.stats.fairness);
+
+    if (stats != NULL && rpcs->op != RCF_RPC_WAIT)
+        *stats = out.stats;
+
+    RETVAL_INT(sockts_epoll_bench, out.retval);
+}
+
+static const char *
+zc_send_mode_rpc2str(tarpc_sockts_zc_send_mode mode)
+{
+    switch (mode)
+    {
+#define MODE2STR(name_) \
+    case TARPC_ZC_SEND_ ## name_: return #name_
+
+        MODE2STR(REG_BUFS);
+        MODE2STR(ALLOC_BUFS);
+        MODE2STR(MSG_ZEROCOPY);
+        MODE2STR(COPY);
+
+#undef MODE2STR
+
+        default: return "Unknown send mode";
+    }
+}
+
+/* See description in sockapi-ts_rpc.h */
+int
+rpc_sockts_zc_send_bench(rcf_rpc_server *rpcs, int fd,
+                         tarpc_sockts_zc_send_mode mode, unsigned int size,
+                         unsigned int window, unsigned int time2run,
+                         tarpc_sockts_zc_send_bench_stats *stats)
+{
+    tarpc_sockts_zc_send_bench_in  in;
+    tarpc_sockts_zc_send_bench_out out;
+
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+
+    in.fd = fd;
+    in.mode = mode;
+    in.size = size;
+    in.window = window;
+    in.time2run = time2run;
+
+    if (rpcs->timeout == RCF_RPC_UNSPEC_TIMEOUT)
+        rpcs->timeout = TE_SEC2MS(TAPI_RPC_TIMEOUT_EXTRA_SEC) + time2run;
+
+    rcf_rpc_call(rpcs, "sockts_zc_send_bench", &in, &out);
+
+    CHECK_RETVAL_VAR_IS_ZERO_OR_MINUS_ONE(sockts_zc_send_bench, out.retval);
+    TAPI_RPC_LOG(rpcs, sockts_zc_send_bench,
+                 "fd=%d, mode=%s, size=%u, window=%u, time2run=%u",
+                 "%d mode=%s bytes=%" TE_PRINTF_64 "u "
+                 "mbps=%" TE_PRINTF_64 "u cpu user=%" TE_PRINTF_64 "u "
+                 "sys=%" TE_PRINTF_64 "u us, completions=%" TE_PRINTF_64 "u "
+                 "lag p50=%" TE_PRINTF_64 "u p99=%" TE_PRINTF_64 "u ns",
+                 fd, zc_send_mode_rpc2str(mode), size, window, time2run,
+                 out.retval, zc_send_mode_rpc2str(out.stats.mode),
+                 out.stats.bytes, out.stats.mbps, out.stats.cpu_user,
+                 out.stats.cpu_sys, out.stats.completions,
+                 out.stats.lag_p50, out.stats.lag_p99);
+
+    if (stats != NULL && rpcs->op != RCF_RPC_WAIT)
+        *stats = out.stats;
+
+    RETVAL_INT(sockts_zc_send_bench, out.retval);
+}
@@ -98,6 +98,43 @@ extern int rpc_send_traffic(rcf_rpc_server *handle, int num, int *s,
 extern int rpc_many_send(rcf_rpc_server *handle, int sock, int flags,
                          const tarpc_size_t *vector, int nops, uint64_t *sent);
 
+/**
+ * Send a number of messages each after other with no delay, passing
+ * @p batch messages to a single @b sendmmsg() call (or coalescing them
+ * in a single message for @b sendmsg()). Payload is taken from a pool
+ * filled once before sending, so that send rate is not limited by data
+ * generation.
+ *
+ * @param handle        RPC server
+ * @param sock          socket for sending
+ * @param flags         flags for send function
+ * @param vector        array of messages lengths
+ * @param nops          number of messages (the length of @p vector)
+ * @param func_name     send function: "send", "sendmsg" or "sendmmsg"
+ * @param batch         number of messages per @b sendmsg() or
+ *                      @b sendmmsg() call
+ * @param pool_size     payload pool size (data repeats with this period),
+ *                      @c 0 for the longest message length; it must not
+ *                      be less than the longest message length
+ * @param gen_func      pattern generator (@c RPC_PATTERN_GEN or
+ *                      @c RPC_PATTERN_GEN_LCG, as for tapi_pat_sender)
+ *                      or @c NULL for random data
+ * @param gen_arg       pattern generator argument or @c NULL
+ * @param sent          total bytes are sent on exit
+ * @param calls         where to save number of send calls or @c NULL
+ * @param duration      where to save time spent sending
+ *                      (in nanoseconds) or @c NULL
+ *
+ * @return   -1 in the case of failure or 0 on success
+ */
+extern int rpc_many_send_batch(rcf_rpc_server *handle, int sock, int flags,
+                               const tarpc_size_t *vector, int nops,
+                               const char *func_name, unsigned int batch,
+                               tarpc_size_t pool_size, const char *gen_func,
+                               const tarpc_pat_gen_arg *gen_arg,
+                               uint64_t *sent, uint64_t *calls,
+                               uint64_t *duration);
+
 /**
  * Execute a number of sendto() operation each after other with no delay.
  *
@@ -499,6 +536,37 @@ extern int rpc_many_recv(rcf_rpc_server *rpcs, int sock, tarpc_size_t length,
                          tarpc_size_t last_packet_len, te_bool count_fails,
                          int *fails_num);
 
+/**
+ * Same as rpc_many_recv(), but also collect throughput time series:
+ * number of bytes received in each @p bucket_us microseconds interval
+ * since the start of the call (CLOCK_MONOTONIC is used).
+ *
+ * @param rpcs            RPC server
+ * @param sock            Socket
+ * @param length          Packets length
+ * @param num             Packets number or @c -1 for unlimited number
+ * @param duration        How long receive packets or @c -1
+ * @param last_packet     Last packet or @c NULL
+ * @param last_packet_len Last packet length
+ * @param count_fails     Don't stop on fail
+ * @param fails           Fails number (OUT) or @c NULL
+ * @param bucket_us       Sampling bucket length in microseconds,
+ *                        @c 0 to disable sampling
+ * @param samples         Where to save bytes received in each bucket
+ *                        (allocated, should be released by the caller)
+ *                        or @c NULL
+ * @param n_samples       Where to save number of @p samples or @c NULL
+ *
+ * @return Received packets number or @c -1 in case of failure
+ */
+extern int rpc_many_recv_samples(rcf_rpc_server *rpcs, int sock,
+                                 tarpc_size_t length, int num, int duration,
+                                 void *last_packet,
+                                 tarpc_size_t last_packet_len,
+                                 te_bool count_fails, int *fails_num,
+                                 uint64_t bucket_us, uint64_t **samples,
+                                 unsigned int *n_samples);
+
 
 /**
  * Send @p num packets with arbitrary send function.
@@ -596,7 +664,7 @@ rpc_traffic_processor_get_bytes(rcf_rpc_server *rpcs, rpc_ptr bytes)
     
     rpc_get_buf(rpcs, bytes, 8, (uint8_t *)buf);
     
-    return (uint64_t)(ntohl(buf[0])) + (uint64_t)ntohl(buf[1]);
+    return ((uint64_t)ntohl(buf[0]) << 32) + (uint64_t)ntohl(buf[1]);
 }
 
 /** 
@@ -966,6 +1034,25 @@ extern int rpc_sockts_free_zc_compl_queue(rcf_rpc_server *rpcs,
 extern int rpc_sockts_proc_zc_compl_queue(rcf_rpc_server *rpcs,
                                           rpc_ptr qhead, int timeout);
 
+/**
+ * Get statistics of a completion queue: number of sent ZC buffers
+ * still waiting for completion and distribution of completion latency
+ * (time from adding a buffer to the queue after @b onload_zc_send()
+ * till its completion message is processed) over the last completions.
+ *
+ * @param rpcs          RPC server handle.
+ * @param qhead         RPC pointer to the head of the queue.
+ * @param reset         If @c TRUE, reset counters and latencies after
+ *                      getting them.
+ * @param stats         Where to save statistics (may be @c NULL).
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+extern int rpc_sockts_zc_compl_queue_stats(
+                                     rcf_rpc_server *rpcs, rpc_ptr qhead,
+                                     te_bool reset,
+                                     tarpc_sockts_zc_compl_stats *stats);
+
 /**
  * Call @b onload_zc_send() on TA.
  *
@@ -1655,6 +1742,33 @@ extern int rpc_many_send_cork(rcf_rpc_server *rpcs, int fd, int fd_aux,
 extern tarpc_ssize_t rpc_recv_timing(rcf_rpc_server *rpcs, int fd, int fd_aux,
                                tarpc_size_t length, uint64_t *duration);
 
+/**
+ * Same as rpc_recv_timing(), but also collect throughput time series
+ * to see how throughput changes while data is received (slow start,
+ * recovery after losses, etc.).
+ *
+ * @param rpcs        RPC server handle.
+ * @param fd          Socket descriptor.
+ * @param fd_aux      Auxiliary socket descriptor, see rpc_recv_timing().
+ * @param length      How many bytes should be received.
+ * @param duration    Where to save measured duration (in microseconds).
+ * @param bucket_us   Sampling bucket length (in microseconds), @c 0 to
+ *                    disable sampling.
+ * @param samples     Where to save bytes received in each bucket since
+ *                    the measurement start (allocated, should be released
+ *                    by the caller) or @c NULL.
+ * @param n_samples   Where to save number of @p samples or @c NULL.
+ *
+ * @return Length of data actually received on success, or @c -1 in case of
+ *         failure.
+ */
+extern tarpc_ssize_t rpc_recv_timing_samples(rcf_rpc_server *rpcs, int fd,
+                                             int fd_aux, tarpc_size_t length,
+                                             uint64_t *duration,
+                                             uint64_t bucket_us,
+                                             uint64_t **samples,
+                                             unsigned int *n_samples);
+
 /**
  * Call epoll_wait() in a loop until it returns non-zero (expect at most
  * one event).
@@ -1875,10 +1989,20 @@ extern int rpc_connect_send_dur_time(rcf_rpc_server *rpcs,
                                      uint64_t duration,
                                      uint64_t *sent);
 
+/**
+ * Number of buckets in histograms of iomux timeout accuracy. Bucket @c 0
+ * counts calls deviated from the timeout by less than a microsecond,
+ * bucket @c i - by [2^(i-1), 2^i) microseconds, the last bucket also
+ * counts all the greater deviations.
+ */
+#define SOCKTS_IOMUX_TIMEOUT_HIST_SIZE 16
+
 /**
  * Call iomux function multiple times in a loop. Iomux function is expected
  * to terminate due to timeout here; calling it multiple times helps to
  * check whether timeout works as expected for small timeout values.
+ * Optionally wait time of every call is measured with
+ * @c CLOCK_MONOTONIC.
  *
  * @param rpcs            RPC server.
  * @param iomux           Iomux function to call.
@@ -1887,19 +2011,58 @@ extern int rpc_connect_send_dur_time(rcf_rpc_server *rpcs,
  * @param nfds            Number of elements in @p fds.
  * @param timeout         Timeout for @p iomux (in milliseconds).
  * @param n_calls         Number of times to call @p iomux.
+ * @param stats           Where to save wait time statistics
+ *                        (may be @c NULL).
+ * @param late            Where to save histogram of wait time exceeding
+ *                        the timeout (array of
+ *                        @ref SOCKTS_IOMUX_TIMEOUT_HIST_SIZE elements,
+ *                        may be @c NULL).
+ * @param early           Where to save histogram of wait time less than
+ *                        the timeout (array of
+ *                        @ref SOCKTS_IOMUX_TIMEOUT_HIST_SIZE elements,
+ *                        may be @c NULL).
  *
  * @return @c 0 on success, @c -1 on failure.
  */
-extern int rpc_sockts_iomux_timeout_loop(rcf_rpc_server *rpcs,
-                                         iomux_call_type iomux,
-                                         struct tarpc_pollfd *fds,
-                                         unsigned int nfds,
-                                         int timeout, unsigned int n_calls);
+extern int rpc_sockts_iomux_timeout_loop_gen(
+                                rcf_rpc_server *rpcs,
+                                iomux_call_type iomux,
+                                struct tarpc_pollfd *fds,
+                                unsigned int nfds, int timeout,
+                                unsigned int n_calls,
+                                tarpc_sockts_iomux_timeout_stats *stats,
+                                uint64_t *late, uint64_t *early);
+
+/**
+ * Call iomux function multiple times in a loop without measuring
+ * wait time, see rpc_sockts_iomux_timeout_loop_gen().
+ *
+ * @param rpcs            RPC server.
+ * @param iomux           Iomux function to call.
+ * @param fds             Array of tarpc_pollfd structures describing
+ *                        which events to wait on which FDs.
+ * @param nfds            Number of elements in @p fds.
+ * @param timeout         Timeout for @p iomux (in milliseconds).
+ * @param n_calls         Number of times to call @p iomux.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static inline int
+rpc_sockts_iomux_timeout_loop(rcf_rpc_server *rpcs, iomux_call_type iomux,
+                              struct tarpc_pollfd *fds, unsigned int nfds,
+                              int timeout, unsigned int n_calls)
+{
+    return rpc_sockts_iomux_timeout_loop_gen(rpcs, iomux, fds, nfds,
+                                             timeout, n_calls,
+                                             NULL, NULL, NULL);
+}
 
 /**
  * Receive from a TCP peer data generated by fill_buff_with_sequence_lcg(),
  * check that it matches the expectation. When receiving, often pass
  * @c MSG_PEEK flag to recv() to re-read the same data with the next call.
+ * Time spent in recv() calls is measured, so the function may be used
+ * to estimate the cost of @c MSG_PEEK.
  *
  * @param rpcs        RPC server handle.
  * @param s           Socket FD.
@@ -1907,15 +2070,263 @@ extern int rpc_sockts_iomux_timeout_loop(rcf_rpc_server *rpcs,
  * @param time2wait   Time to wait for the next packet (in milliseconds;
  *                    if this time expires, the function returns even
  *                    if @p time2run is not expired yet).
+ * @param peek_count  Number of recv() calls with @c MSG_PEEK per every
+ *                    call without this flag (@c 0 - never peek).
+ * @param fixed_ratio If @c TRUE, exactly @p peek_count calls with
+ *                    @c MSG_PEEK precede every call without it;
+ *                    otherwise @p peek_count is the average number
+ *                    and flags are chosen randomly.
+ * @param batch       Number of bytes to request with every recv() call;
+ *                    if @c 0, it is chosen randomly from [1, 1024].
  * @param gen_arg     Argument for fill_buff_with_sequence_lcg(),
  *                    must be the same as the argument passed on peer.
  * @param received    Where to save number of received bytes.
+ * @param stats       Where to save receiving statistics (may be @c NULL).
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+extern int rpc_sockts_peek_stream_receiver_gen(
+                                    rcf_rpc_server *rpcs, int s,
+                                    int time2run, int time2wait,
+                                    int peek_count, te_bool fixed_ratio,
+                                    unsigned int batch,
+                                    tarpc_pat_gen_arg *gen_arg,
+                                    uint64_t *received,
+                                    tarpc_sockts_peek_stream_stats *stats);
+
+/**
+ * Call rpc_sockts_peek_stream_receiver_gen() with two recv(MSG_PEEK)
+ * calls per every call without this flag in average and random
+ * size of requested data.
+ *
+ * @param rpcs        RPC server handle.
+ * @param s           Socket FD.
+ * @param time2run    Time to run (in milliseconds).
+ * @param time2wait   Time to wait for the next packet (in milliseconds).
+ * @param gen_arg     Argument for fill_buff_with_sequence_lcg().
+ * @param received    Where to save number of received bytes.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static inline int
+rpc_sockts_peek_stream_receiver(rcf_rpc_server *rpcs, int s,
+                                int time2run, int time2wait,
+                                tarpc_pat_gen_arg *gen_arg,
+                                uint64_t *received)
+{
+    return rpc_sockts_peek_stream_receiver_gen(rpcs, s, time2run,
+                                               time2wait, 2, FALSE, 0,
+                                               gen_arg, received, NULL);
+}
+
+/**
+ * Send or receive traffic on multiple sockets in multiple threads on
+ * RPC server. Sockets are distributed between threads in round-robin
+ * manner, each thread waits for its sockets with poll(). Sockets are
+ * switched to non-blocking mode for the run. Receiving stops on a socket
+ * when its peer closes the connection. Threads may be pinned to CPUs,
+ * utilisation of these CPUs during the run is reported then.
+ *
+ * @param rpcs            RPC server.
+ * @param fds             Sockets.
+ * @param n_fds           Number of sockets.
+ * @param snd             If @c TRUE, send traffic, otherwise receive it.
+ * @param func_name       Send function (send, sendto, sendmsg, sendmmsg,
+ *                        onload_zc_send) or receive function (recv,
+ *                        recvmsg, recvmmsg).
+ * @param size            Bytes per message.
+ * @param batch           Messages per @b sendmmsg() or @b recvmmsg() call.
+ * @param threads         Number of threads (no more than @p n_fds are
+ *                        started).
+ * @param time2run        How long to run, in milliseconds.
+ * @param sample_interval Throughput sampling interval, in milliseconds,
+ *                        @c 0 to disable sampling.
+ * @param stop            Stop flag allocated with rpc_malloc(),
+ *                        or @c RPC_NULL.
+ * @param cpus            CPUs to pin threads to, thread @c i is pinned
+ *                        to @p cpus[i % @p n_cpus] (may be @c NULL).
+ * @param n_cpus          Number of @p cpus, @c 0 to not pin threads.
+ * @param stats           Where to save per socket statistics
+ *                        (array of @p n_fds items, may be @c NULL).
+ * @param samples         Where to save bytes transferred in each sampling
+ *                        interval (allocated, should be released by
+ *                        the caller; may be @c NULL).
+ * @param n_samples       Where to save number of @p samples.
+ * @param duration        Where to save actual run time, in microseconds
+ *                        (may be @c NULL).
+ * @param cpu_util        Where to save utilisation of @p cpus during
+ *                        the run (array of @p n_cpus items, may be
+ *                        @c NULL).
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+extern int rpc_sockts_traffic_engine_gen(
+                                rcf_rpc_server *rpcs,
+                                const int *fds, unsigned int n_fds,
+                                te_bool snd, const char *func_name,
+                                size_t size, unsigned int batch,
+                                unsigned int threads,
+                                unsigned int time2run,
+                                unsigned int sample_interval,
+                                rpc_ptr stop,
+                                const int *cpus, unsigned int n_cpus,
+                                tarpc_sockts_traffic_engine_stats *stats,
+                                uint64_t **samples,
+                                unsigned int *n_samples,
+                                uint64_t *duration,
+                                tarpc_sockts_traffic_engine_cpu *cpu_util);
+
+/**
+ * Send or receive traffic on multiple sockets in multiple threads on
+ * RPC server without pinning threads to CPUs.
+ * See rpc_sockts_traffic_engine_gen() for details.
+ */
+static inline int
+rpc_sockts_traffic_engine(rcf_rpc_server *rpcs,
+                          const int *fds, unsigned int n_fds,
+                          te_bool snd, const char *func_name,
+                          size_t size, unsigned int batch,
+                          unsigned int threads, unsigned int time2run,
+                          unsigned int sample_interval, rpc_ptr stop,
+                          tarpc_sockts_traffic_engine_stats *stats,
+                          uint64_t **samples, unsigned int *n_samples,
+                          uint64_t *duration)
+{
+    return rpc_sockts_traffic_engine_gen(rpcs, fds, n_fds, snd, func_name,
+                                         size, batch, threads, time2run,
+                                         sample_interval, stop, NULL, 0,
+                                         stats, samples, n_samples,
+                                         duration, NULL);
+}
+
+/**
+ * Get CPUs the RPC server process is allowed to run on (its CPU
+ * affinity).
+ *
+ * @param rpcs      RPC server.
+ * @param cpus      Where to save allocated array of CPU numbers
+ *                  (should be released by the caller).
+ * @param n_cpus    Where to save number of CPUs.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+extern int rpc_sockts_get_cpus(rcf_rpc_server *rpcs, int **cpus,
+                               unsigned int *n_cpus);
+
+/**
+ * Measure connection establishment rate. Connecting threads open
+ * connections with non-blocking @b connect() keeping @p window
+ * connections in flight each and waiting for their completion with
+ * @b epoll_wait(). Connections are also accepted on @p listeners,
+ * a thread per listening socket (accepting alone runs for @p time2run),
+ * the time of every successful @b accept4() call is measured.
+ * If @p req_size is not zero, connecting side sends a request of this
+ * size over every established connection and waits for a response of
+ * the same size before closing it; accepting side answers the request
+ * and closes the connection. Functions are resolved according to RPC
+ * server library settings, so it works both with libc and accelerated
+ * library.
+ *
+ * @param rpcs        RPC server.
+ * @param addr        Address to connect to or @c NULL to only accept.
+ * @param listeners   Listening sockets (may be @c NULL).
+ * @param n_listeners Number of @p listeners, @c 0 to only connect.
+ * @param threads     Number of connecting threads.
+ * @param window      Connections in flight per thread.
+ * @param num         Connections per thread, @c 0 for unlimited.
+ * @param time2run    How long to run, in milliseconds.
+ * @param keep        If @c TRUE, keep connections open until the end,
+ *                    otherwise close them once established or once
+ *                    the response is received (accepted connections
+ *                    are always closed if @p req_size is not zero).
+ * @param req_size    Request and response size, @c 0 to only connect.
+ * @param stats       Where to save results (may be @c NULL).
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+extern int rpc_sockts_conn_rate_gen(rcf_rpc_server *rpcs,
+                                    const struct sockaddr *addr,
+                                    const int *listeners,
+                                    unsigned int n_listeners,
+                                    unsigned int threads,
+                                    unsigned int window,
+                                    unsigned int num,
+                                    unsigned int time2run,
+                                    te_bool keep, unsigned int req_size,
+                                    tarpc_sockts_conn_rate_stats *stats);
+
+/**
+ * Measure connection establishment rate with a single listening socket
+ * and without request/response exchange.
+ * See rpc_sockts_conn_rate_gen() for details.
+ *
+ * @param listener    Listening socket or @c -1 to only connect.
+ */
+static inline int
+rpc_sockts_conn_rate(rcf_rpc_server *rpcs, const struct sockaddr *addr,
+                     int listener, unsigned int threads,
+                     unsigned int window, unsigned int num,
+                     unsigned int time2run, te_bool keep,
+                     tarpc_sockts_conn_rate_stats *stats)
+{
+    return rpc_sockts_conn_rate_gen(rpcs, addr, &listener,
+                                    listener >= 0 ? 1 : 0, threads, window,
+                                    num, time2run, keep, 0, stats);
+}
+
+/**
+ * Measure epoll scalability for sockets opened by @ref rpc_many_socket(),
+ * @ref rpc_many_connect() or @ref rpc_many_accept(). A new epoll set is
+ * created; first @p ready_num sockets are added with @p events (which
+ * should be reported), the rest with @p idle_events (which should not).
+ * Average cost of @b epoll_ctl() ADD, MOD and DEL for the whole set,
+ * latency of non-blocking @b epoll_wait() and fairness of reporting
+ * ready sockets (when @p maxevents is less than @p ready_num) are
+ * measured.
+ *
+ * @param rpcs          RPC server.
+ * @param socks_arr     Sockets array handle.
+ * @param socks_num     Number of sockets.
+ * @param ready_num     Number of sockets expected to be ready.
+ * @param events        Events of ready sockets (@ref rpc_epoll_evt).
+ * @param idle_events   Events of other sockets (@ref rpc_epoll_evt).
+ * @param maxevents     @b epoll_wait() @a maxevents.
+ * @param wait_calls    Number of @b epoll_wait() calls.
+ * @param stats         Where to save results.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+extern int rpc_sockts_epoll_bench(rcf_rpc_server *rpcs, rpc_ptr socks_arr,
+                                  unsigned int socks_num,
+                                  unsigned int ready_num, uint32_t events,
+                                  uint32_t idle_events,
+                                  unsigned int maxevents,
+                                  unsigned int wait_calls,
+                                  tarpc_sockts_epoll_bench_stats *stats);
+
+/**
+ * Stream data from a connected socket for @p time2run and measure send
+ * throughput, CPU time of the sending thread and completion lag (time
+ * from sending a buffer till its completion message is processed), so
+ * that zero-copy and copy send can be compared on the same setup.
+ * In zero-copy modes no more than @p window buffers are in flight;
+ * a buffer is reused only after its completion. Onload modes fall back
+ * to @c MSG_ZEROCOPY if the socket is not accelerated.
+ *
+ * @param rpcs        RPC server.
+ * @param fd          Connected socket.
+ * @param mode        How to send data.
+ * @param size        Bytes per send call.
+ * @param window      Maximum number of buffers in flight.
+ * @param time2run    How long to send, in milliseconds.
+ * @param stats       Where to save results (may be @c NULL).
  *
  * @return @c 0 on success, @c -1 on failure.
  */
-extern int rpc_sockts_peek_stream_receiver(rcf_rpc_server *rpcs, int s,
-                                           int time2run, int time2wait,
-                                           tarpc_pat_gen_arg *gen_arg,
-                                           uint64_t *received);
+extern int rpc_sockts_zc_send_bench(rcf_rpc_server *rpcs, int fd,
+                                    tarpc_sockts_zc_send_mode mode,
+                                    unsigned int size, unsigned int window,
+                                    unsigned int time2run,
+                                    tarpc_sockts_zc_send_bench_stats *stats);
 
 #endif /* !__SOCKAPI_TS_RPC_H__ */
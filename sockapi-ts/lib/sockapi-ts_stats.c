@@ -4,7 +4,7 @@
  * @brief TAPI to calculate statistics.
  *
  * Implementation of functions for calculating statistics from TE vector
- * with integers.
+ * with integers and streaming statistics of 64-bit values.
  *
  * @author Roman Zhukov <Roman.Zhukov@oktetlabs.ru>
  */
@@ -12,13 +12,114 @@
 #include "sockapi-ts_stats.h"
 
 #include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+
+/**
+ * Swap two elements of an array.
+ *
+ * @param a     The first element
+ * @param b     The second element
+ * @param size  Size of an element
+ */
+static void
+sockts_stats_swap(uint8_t *a, uint8_t *b, size_t size)
+{
+    uint8_t tmp;
+    size_t  i;
+
+    for (i = 0; i < size; i++)
+    {
+        tmp = a[i];
+        a[i] = b[i];
+        b[i] = tmp;
+    }
+}
+
+/**
+ * Partially reorder an array so that the element with index @p k is the
+ * one which would be there if the array was sorted (Hoare's selection).
+ *
+ * Three-way partitioning is used so that arrays with many equal elements
+ * (e.g. latencies quantised to a timer tick) are handled in linear time.
+ *
+ * @param base      Array
+ * @param n         Number of elements
+ * @param size      Size of an element
+ * @param k         Index of the element to select
+ * @param cmp       Comparison function as for qsort()
+ */
+static void
+sockts_stats_select(void *base, size_t n, size_t size, size_t k,
+                    int (*cmp)(const void *, const void *))
+{
+    uint8_t    *arr = base;
+    uint8_t    *pivot;
+    size_t      left = 0;
+    size_t      right = n - 1;
+    size_t      lt;
+    size_t      gt;
+    size_t      i;
+    int         rc;
+
+    pivot = TE_ALLOC(size);
+
+    while (left < right)
+    {
+        /* Random pivot makes the worst case unlikely on sorted input */
+        memcpy(pivot, arr + (left + rand() % (right - left + 1)) * size,
+               size);
+
+        /*
+         * Split [left, right] into elements less than the pivot
+         * [left, lt), equal to it [lt, gt) and greater than it
+         * [gt, right].
+         */
+        for (lt = i = left, gt = right + 1; i < gt; )
+        {
+            rc = cmp(arr + i * size, pivot);
+            if (rc < 0)
+            {
+                sockts_stats_swap(arr + i * size, arr + lt * size, size);
+                lt++;
+                i++;
+            }
+            else if (rc > 0)
+            {
+                gt--;
+                sockts_stats_swap(arr + i * size, arr + gt * size, size);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        if (k < lt)
+            right = lt - 1;
+        else if (k >= gt)
+            left = gt;
+        else
+            break;
+    }
+
+    free(pivot);
+}
 
 static int
 sockts_qsort_compare_int(const void* pa, const void* pb)
 {
     const int* a = pa;
     const int* b = pb;
-    return *a - *b;
+    return (*a > *b) - (*a < *b);
+}
+
+static int
+sockts_qsort_compare_u64(const void *pa, const void *pb)
+{
+    const uint64_t *a = pa;
+    const uint64_t *b = pb;
+    return (*a > *b) - (*a < *b);
 }
 
 /** See definition in sockapi-ts_stats.h */
@@ -26,9 +127,9 @@ te_errno
 sockts_stats_int_get(te_vec *values, sockts_stats_int *stats)
 {
     size_t values_n = te_vec_size(values);
-    long int sum = 0;
-    size_t i;
-    int *values_sorted = NULL;
+    long long int sum = 0;
+    int *values_copy = NULL;
+    int *elem;
 
     if (values_n == 0)
         return TE_EINVAL;
@@ -36,19 +137,25 @@ sockts_stats_int_get(te_vec *values, sockts_stats_int *stats)
     if (values->element_size != sizeof(int) || stats == NULL)
         return TE_EINVAL;
 
-    values_sorted = TE_ALLOC(values_n * sizeof(int));
-    memcpy(values_sorted, values->data.ptr, values_n * sizeof(int));
-    qsort(values_sorted, values_n, sizeof(int), &sockts_qsort_compare_int);
-
-    stats->median = values_sorted[values_n >> 1u];
-    stats->min = values_sorted[0];
-    stats->max = values_sorted[values_n - 1];
+    stats->min = INT_MAX;
+    stats->max = INT_MIN;
+    TE_VEC_FOREACH(values, elem)
+    {
+        if (*elem < stats->min)
+            stats->min = *elem;
+        if (*elem > stats->max)
+            stats->max = *elem;
+        sum += *elem;
+    }
+    stats->mean = (int)llround((double)sum / values_n);
 
-    for (i = 0; i < values_n; i++)
-        sum += values_sorted[i];
-    stats->mean = (int) (sum / values_n);
+    values_copy = TE_ALLOC(values_n * sizeof(int));
+    memcpy(values_copy, values->data.ptr, values_n * sizeof(int));
+    sockts_stats_select(values_copy, values_n, sizeof(int), values_n >> 1u,
+                        &sockts_qsort_compare_int);
+    stats->median = values_copy[values_n >> 1u];
 
-    free(values_sorted);
+    free(values_copy);
     return 0;
 }
 
@@ -84,3 +191,238 @@ sockts_stats_int_out_of_range_num(te_vec *values, int range_value,
 
     return num_min + num_max;
 }
+
+/**
+ * Get index of a histogram bucket counting a value.
+ *
+ * @param stats     Statistics
+ * @param value     Value
+ *
+ * @return Bucket index.
+ */
+static size_t
+sockts_stats_u64_bucket_idx(const sockts_stats_u64 *stats, uint64_t value)
+{
+    unsigned int shift;
+
+    if (value < (1ULL << stats->precision))
+        return value;
+
+    shift = 63 - __builtin_clzll(value) - (stats->precision - 1);
+
+    return ((size_t)shift << (stats->precision - 1)) + (value >> shift);
+}
+
+/** See definition in sockapi-ts_stats.h */
+te_errno
+sockts_stats_u64_init(sockts_stats_u64 *stats, unsigned int precision)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (precision < 1 || precision > 16)
+    {
+        ERROR("%s(): invalid precision %u", __FUNCTION__, precision);
+        return TE_RC(TE_TAPI, TE_EINVAL);
+    }
+
+    stats->precision = precision;
+    stats->n_buckets = (size_t)(64 - precision + 2) << (precision - 1);
+    stats->buckets = TE_ALLOC(stats->n_buckets * sizeof(*stats->buckets));
+    if (stats->buckets == NULL)
+        return TE_RC(TE_TAPI, TE_ENOMEM);
+
+    return 0;
+}
+
+/** See definition in sockapi-ts_stats.h */
+void
+sockts_stats_u64_free(sockts_stats_u64 *stats)
+{
+    free(stats->buckets);
+    stats->buckets = NULL;
+}
+
+/** See definition in sockapi-ts_stats.h */
+void
+sockts_stats_u64_add_n(sockts_stats_u64 *stats, uint64_t value,
+                       uint64_t count)
+{
+    double delta;
+
+    if (count == 0)
+        return;
+
+    if (stats->num == 0 || value < stats->min)
+        stats->min = value;
+    if (value > stats->max)
+        stats->max = value;
+
+    /* Welford's update with weight of the new value */
+    stats->num += count;
+    delta = (double)value - stats->mean;
+    stats->mean += delta * count / stats->num;
+    stats->m2 += delta * count * ((double)value - stats->mean);
+
+    stats->buckets[sockts_stats_u64_bucket_idx(stats, value)] += count;
+}
+
+/** See definition in sockapi-ts_stats.h */
+te_errno
+sockts_stats_u64_merge(sockts_stats_u64 *dst, const sockts_stats_u64 *src)
+{
+    uint64_t    num;
+    double      delta;
+    size_t      i;
+
+    if (dst->precision != src->precision)
+    {
+        ERROR("%s(): precision mismatch: %u vs %u", __FUNCTION__,
+              dst->precision, src->precision);
+        return TE_RC(TE_TAPI, TE_EINVAL);
+    }
+
+    if (src->num == 0)
+        return 0;
+
+    for (i = 0; i < dst->n_buckets; i++)
+        dst->buckets[i] += src->buckets[i];
+
+    if (dst->num == 0 || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+
+    /* Chan's formula for combining mean and variance of two sets */
+    num = dst->num + src->num;
+    delta = src->mean - dst->mean;
+    dst->m2 += src->m2 + delta * delta * dst->num / num * src->num;
+    dst->mean += delta * src->num / num;
+    dst->num = num;
+
+    return 0;
+}
+
+/** See definition in sockapi-ts_stats.h */
+double
+sockts_stats_u64_stddev(const sockts_stats_u64 *stats)
+{
+    if (stats->num < 2)
+        return 0;
+
+    return sqrt(stats->m2 / (stats->num - 1));
+}
+
+/** See definition in sockapi-ts_stats.h */
+uint64_t
+sockts_stats_u64_bucket_value(const sockts_stats_u64 *stats, size_t idx)
+{
+    unsigned int shift;
+
+    if (idx < (1ULL << stats->precision))
+        return idx;
+
+    shift = (idx >> (stats->precision - 1)) - 1;
+
+    return (uint64_t)(idx - ((size_t)shift << (stats->precision - 1))) <<
+           shift;
+}
+
+/** See definition in sockapi-ts_stats.h */
+uint64_t
+sockts_stats_u64_pct(const sockts_stats_u64 *stats, double pct)
+{
+    uint64_t    rank;
+    uint64_t    total = 0;
+    uint64_t    value;
+    size_t      i;
+
+    if (stats->num == 0)
+        return 0;
+
+    rank = (uint64_t)ceil(pct / 100.0 * stats->num);
+    if (rank < 1)
+        rank = 1;
+    if (rank > stats->num)
+        rank = stats->num;
+
+    for (i = 0; i < stats->n_buckets - 1; i++)
+    {
+        total += stats->buckets[i];
+        if (total >= rank)
+            break;
+    }
+
+    /* The highest value of the bucket, so the estimation is not lower */
+    value = i + 1 < stats->n_buckets ?
+                sockts_stats_u64_bucket_value(stats, i + 1) - 1 :
+                UINT64_MAX;
+    if (value > stats->max)
+        value = stats->max;
+    if (value < stats->min)
+        value = stats->min;
+
+    return value;
+}
+
+/** See definition in sockapi-ts_stats.h */
+te_errno
+sockts_stats_u64_mean_ci(const sockts_stats_u64 *stats, double level,
+                         double *half_width)
+{
+    static const struct {
+        double level;
+        double z;
+    } z_table[] = {
+        { 80, 1.2816 },
+        { 90, 1.6449 },
+        { 95, 1.9600 },
+        { 98, 2.3263 },
+        { 99, 2.5758 },
+        { 99.9, 3.2905 },
+    };
+
+    unsigned int i;
+
+    if (stats->num < 2)
+    {
+        ERROR("%s(): at least two values are required", __FUNCTION__);
+        return TE_RC(TE_TAPI, TE_EINVAL);
+    }
+
+    for (i = 0; i < TE_ARRAY_LEN(z_table); i++)
+    {
+        if (fabs(z_table[i].level - level) < 1e-6)
+        {
+            *half_width = z_table[i].z * sockts_stats_u64_stddev(stats) /
+                          sqrt(stats->num);
+            return 0;
+        }
+    }
+
+    ERROR("%s(): unsupported confidence level %f", __FUNCTION__, level);
+    return TE_RC(TE_TAPI, TE_EINVAL);
+}
+
+/** See definition in sockapi-ts_stats.h */
+te_errno
+sockts_stats_u64_vec_pct(te_vec *values, double pct, uint64_t *value)
+{
+    size_t      values_n = te_vec_size(values);
+    uint64_t    rank;
+
+    if (values_n == 0 || values->element_size != sizeof(uint64_t) ||
+        pct < 0 || pct > 100)
+    {
+        return TE_RC(TE_TAPI, TE_EINVAL);
+    }
+
+    rank = (uint64_t)ceil(pct / 100.0 * values_n);
+    if (rank < 1)
+        rank = 1;
+
+    sockts_stats_select(values->data.ptr, values_n, sizeof(uint64_t),
+                        rank - 1, &sockts_qsort_compare_u64);
+    *value = *(uint64_t *)te_vec_get(values, rank - 1);
+
+    return 0;
+}
@@ -4,7 +4,7 @@
  * @brief TAPI to calculate statistics.
  *
  * Definitions of functions for calculating statistics from TE vector
- * with integers.
+ * with integers and streaming statistics of 64-bit values.
  *
  * @author Roman Zhukov <Roman.Zhukov@oktetlabs.ru>
  */
@@ -54,4 +54,147 @@ extern unsigned int sockts_stats_int_out_of_range_num(te_vec *values,
                                                       unsigned int *num_min,
                                                       unsigned int *num_max);
 
+/** Default precision of percentiles estimation: error is below 1% */
+#define SOCKTS_STATS_PRECISION_DEF 8
+
+/**
+ * Streaming statistics of 64-bit values. Mean and variance are updated
+ * with Welford's algorithm, percentiles are estimated with log-linear
+ * histogram: values below 2^precision are counted exactly, every next
+ * power-of-two range is split into 2^(precision - 1) equal buckets, so
+ * the relative error of a percentile is below 2^-(precision - 1).
+ * Memory does not depend on the number of values. Statistics gathered
+ * separately (for example, for different connections) can be merged.
+ */
+typedef struct sockts_stats_u64 {
+    uint64_t        num;        /**< Number of values */
+    uint64_t        min;        /**< Minimum value */
+    uint64_t        max;        /**< Maximum value */
+    double          mean;       /**< Mean value */
+    double          m2;         /**< Sum of squared differences from
+                                     the mean */
+    unsigned int    precision;  /**< Number of bits of a value counted
+                                     exactly */
+    size_t          n_buckets;  /**< Number of histogram buckets */
+    uint64_t       *buckets;    /**< Histogram buckets */
+} sockts_stats_u64;
+
+/**
+ * Initialize streaming statistics.
+ *
+ * @param[out] stats        Statistics to initialize
+ * @param[in]  precision    Number of bits of a value counted exactly
+ *                          in percentiles estimation, from @c 1 to @c 16
+ *                          (see @ref SOCKTS_STATS_PRECISION_DEF)
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_stats_u64_init(sockts_stats_u64 *stats,
+                                      unsigned int precision);
+
+/**
+ * Release memory allocated for streaming statistics.
+ *
+ * @param[in] stats     Statistics
+ */
+extern void sockts_stats_u64_free(sockts_stats_u64 *stats);
+
+/**
+ * Add a value to streaming statistics a number of times. It may be used
+ * to add buckets of a histogram obtained elsewhere.
+ *
+ * @param[in] stats     Statistics
+ * @param[in] value     Value
+ * @param[in] count     How many times to add the value
+ */
+extern void sockts_stats_u64_add_n(sockts_stats_u64 *stats, uint64_t value,
+                                   uint64_t count);
+
+/**
+ * Add a value to streaming statistics.
+ *
+ * @param[in] stats     Statistics
+ * @param[in] value     Value
+ */
+static inline void
+sockts_stats_u64_add(sockts_stats_u64 *stats, uint64_t value)
+{
+    sockts_stats_u64_add_n(stats, value, 1);
+}
+
+/**
+ * Add all values of streaming statistics to another one.
+ *
+ * @param[in] dst       Statistics to add values to
+ * @param[in] src       Statistics to add values from, must have the same
+ *                      precision as @p dst
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_stats_u64_merge(sockts_stats_u64 *dst,
+                                       const sockts_stats_u64 *src);
+
+/**
+ * Get sample standard deviation of values.
+ *
+ * @param[in] stats     Statistics
+ *
+ * @return Standard deviation, @c 0 if there are less than two values.
+ */
+extern double sockts_stats_u64_stddev(const sockts_stats_u64 *stats);
+
+/**
+ * Get estimation of a percentile: a value which is not less than @p pct
+ * percents of values. It is not less than minimum and not greater than
+ * maximum value.
+ *
+ * @param[in] stats     Statistics
+ * @param[in] pct       Percentile, from @c 0 to @c 100
+ *
+ * @return Percentile value, @c 0 if there are no values.
+ */
+extern uint64_t sockts_stats_u64_pct(const sockts_stats_u64 *stats,
+                                     double pct);
+
+/**
+ * Get confidence interval of the mean value. Normal distribution of
+ * the sample mean is assumed, so the number of values should not be
+ * small (at least a few tens).
+ *
+ * @param[in]  stats        Statistics
+ * @param[in]  level        Confidence level in percents: @c 80, @c 90,
+ *                          @c 95, @c 98, @c 99 or @c 99.9
+ * @param[out] half_width   Where to save half width of the interval
+ *                          around the mean
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_stats_u64_mean_ci(const sockts_stats_u64 *stats,
+                                         double level, double *half_width);
+
+/**
+ * Get the lowest value counted by a histogram bucket.
+ *
+ * @param[in] stats     Statistics
+ * @param[in] idx       Bucket index
+ *
+ * @return The value.
+ */
+extern uint64_t sockts_stats_u64_bucket_value(const sockts_stats_u64 *stats,
+                                              size_t idx);
+
+/**
+ * Get exact percentile of values in TE vector with selection algorithm
+ * (linear time on average). Order of values in the vector is changed.
+ *
+ * @param[in]  values       TE vector with uint64_t values
+ * @param[in]  pct          Percentile, from @c 0 to @c 100
+ * @param[out] value        Where to save the value which is not less than
+ *                          @p pct percents of values
+ *
+ * @return Status code.
+ */
+extern te_errno sockts_stats_u64_vec_pct(te_vec *values, double pct,
+                                         uint64_t *value);
+
 #endif /* __SOCKAPI_TS_STATS_H__ */
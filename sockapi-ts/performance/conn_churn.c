@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-conn_churn Connection churn rate
+ *
+ * @objective Measure rate of short TCP connections accepted on IUT,
+ *            each carrying a single request and response, with fd
+ *            caching enabled or disabled.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param fd_caching    If @c TRUE, enable fd caching on IUT, otherwise
+ *                      disable it
+ * @param listeners_num Number of listening sockets on IUT; if it is
+ *                      greater than @c 1, they are bound to the same
+ *                      address with @c SO_REUSEPORT
+ * @param threads       Number of connecting threads on Tester
+ * @param window        Connections in flight per connecting thread
+ * @param req_size      Size of request and response
+ * @param duration      How long to open connections in a run, in seconds
+ * @param n_runs        Number of runs, connection rate is compared with
+ *                      performance baseline if it is specified
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/conn_churn"
+
+#include "sockapi-test.h"
+#include "te_mi_log.h"
+#include "sockapi-ts_perf.h"
+
+/** Value of EF_SOCKET_CACHE_MAX and EF_PER_SOCKET_CACHE_MAX */
+#define SOCKET_CACHE_MAX 4096
+
+/** Backlog of listening sockets */
+#define LISTEN_BACKLOG 1024
+
+/**
+ * How long IUT accepts connections after Tester stops opening them,
+ * in milliseconds.
+ */
+#define ACCEPT_MARGIN 1000
+
+/** Convert nanoseconds to microseconds for reporting. */
+#define NS2US(_ns) ((double)(_ns) / 1000)
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *iut_addr = NULL;
+
+    te_bool fd_caching;
+    int     listeners_num;
+    int     threads;
+    int     window;
+    int     req_size;
+    int     duration;
+    int     n_runs;
+
+    struct sockaddr_storage      listen_addr;
+    tarpc_sockts_conn_rate_stats iut_stats;
+    tarpc_sockts_conn_rate_stats tst_stats;
+
+    sockts_perf_gate gate = { .path = NULL, .iter = TE_STRING_INIT };
+    te_vec           cps_vec = TE_VEC_INIT(double);
+
+    int    *iut_s = NULL;
+    double  cps;
+    int     i;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_BOOL_PARAM(fd_caching);
+    TEST_GET_INT_PARAM(listeners_num);
+    TEST_GET_INT_PARAM(threads);
+    TEST_GET_INT_PARAM(window);
+    TEST_GET_INT_PARAM(req_size);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_INT_PARAM(n_runs);
+
+    CHECK_RC(sockts_perf_gate_init(&gate, argc, argv));
+
+    TEST_STEP("Enable or disable fd caching on IUT according to "
+              "@p fd_caching.");
+    if (fd_caching)
+    {
+        CHECK_RC(tapi_sh_env_set_int(pco_iut, "EF_SOCKET_CACHE_MAX",
+                                     SOCKET_CACHE_MAX, TRUE, FALSE));
+        CHECK_RC(tapi_sh_env_set_int(pco_iut, "EF_PER_SOCKET_CACHE_MAX",
+                                     SOCKET_CACHE_MAX, TRUE, FALSE));
+    }
+    else
+    {
+        CHECK_RC(tapi_sh_env_unset(pco_iut, "EF_SOCKET_CACHE_MAX", FALSE,
+                                   FALSE));
+        CHECK_RC(tapi_sh_env_unset(pco_iut, "EF_PER_SOCKET_CACHE_MAX",
+                                   FALSE, FALSE));
+    }
+
+    TEST_STEP("If Onload cluster is configured, set its size to "
+              "@p listeners_num.");
+    if (cfg_find_fmt(NULL, "/agent:%s/env:EF_CLUSTER_NAME",
+                     pco_iut->ta) == 0)
+    {
+        CHECK_RC(tapi_sh_env_set_int(pco_iut, "EF_CLUSTER_SIZE",
+                                     listeners_num, TRUE, FALSE));
+    }
+    CHECK_RC(rcf_rpc_server_restart(pco_iut));
+
+    TEST_STEP("Create @p listeners_num listening sockets on IUT bound to "
+              "the same address, with @c SO_REUSEPORT if there are more "
+              "than one.");
+    tapi_sockaddr_clone_exact(iut_addr, &listen_addr);
+    TAPI_SET_NEW_PORT(pco_iut, SA(&listen_addr));
+
+    iut_s = TE_ALLOC(listeners_num * sizeof(*iut_s));
+    for (i = 0; i < listeners_num; i++)
+        iut_s[i] = -1;
+
+    for (i = 0; i < listeners_num; i++)
+    {
+        iut_s[i] = rpc_socket(pco_iut, rpc_socket_domain_by_addr(iut_addr),
+                              RPC_SOCK_STREAM, RPC_PROTO_DEF);
+        if (listeners_num > 1)
+            rpc_setsockopt_int(pco_iut, iut_s[i], RPC_SO_REUSEPORT, 1);
+        rpc_bind(pco_iut, iut_s[i], SA(&listen_addr));
+        rpc_listen(pco_iut, iut_s[i], LISTEN_BACKLOG);
+    }
+
+    TEST_STEP("Repeat @p n_runs times: accept connections on IUT, "
+              "answer a request of @p req_size bytes on every one and "
+              "close it; open connections to IUT from @p threads threads "
+              "on Tester keeping @p window connections in flight each, "
+              "send a request and close every connection after receiving "
+              "the response.");
+    for (i = 0; i < n_runs; i++)
+    {
+        TEST_SUBSTEP("Run %d: open connections for @p duration seconds.",
+                     i + 1);
+        pco_iut->timeout = TE_SEC2MS(duration) + ACCEPT_MARGIN +
+                           pco_iut->def_timeout;
+        pco_iut->op = RCF_RPC_CALL;
+        rpc_sockts_conn_rate_gen(pco_iut, NULL, iut_s, listeners_num,
+                                 0, 0, 0,
+                                 TE_SEC2MS(duration) + ACCEPT_MARGIN,
+                                 FALSE, req_size, NULL);
+
+        pco_tst->timeout = TE_SEC2MS(duration) + pco_tst->def_timeout;
+        rpc_sockts_conn_rate_gen(pco_tst, SA(&listen_addr), NULL, 0,
+                                 threads, window, 0, TE_SEC2MS(duration),
+                                 FALSE, req_size, &tst_stats);
+
+        pco_iut->op = RCF_RPC_WAIT;
+        rpc_sockts_conn_rate_gen(pco_iut, NULL, iut_s, listeners_num,
+                                 0, 0, 0,
+                                 TE_SEC2MS(duration) + ACCEPT_MARGIN,
+                                 FALSE, req_size, &iut_stats);
+
+        TEST_SUBSTEP("Report connection rate and percentiles of connect "
+                     "latency and accept time.");
+        if (tst_stats.completed == 0 || tst_stats.duration == 0)
+        {
+            ERROR_VERDICT("No request/response exchange was completed");
+            test_failed = TRUE;
+            break;
+        }
+
+        cps = tst_stats.completed * 1000000.0 / tst_stats.duration;
+        TE_VEC_APPEND(&cps_vec, cps);
+
+        TEST_ARTIFACT("fd_caching = %s, listeners = %d, "
+                      "connections per second = %.0f, connect latency "
+                      "p50/p99/p99.9 = %.1f/%.1f/%.1f us, accept time "
+                      "p50/p99/p99.9 = %.1f/%.1f/%.1f us",
+                      fd_caching ? "TRUE" : "FALSE", listeners_num, cps,
+                      NS2US(tst_stats.lat_p50), NS2US(tst_stats.lat_p99),
+                      NS2US(tst_stats.lat_p999),
+                      NS2US(iut_stats.acc_lat_p50),
+                      NS2US(iut_stats.acc_lat_p99),
+                      NS2US(iut_stats.acc_lat_p999));
+
+        if (tst_stats.failed > 0 || iut_stats.failed > 0)
+        {
+            WARN("Failed connections or exchanges: %llu on Tester, "
+                 "%llu on IUT",
+                 (unsigned long long)tst_stats.failed,
+                 (unsigned long long)iut_stats.failed);
+        }
+
+        CHECK_RC(te_mi_log_meas("conn_churn",
+            TE_MI_MEAS_V(TE_MI_MEAS(RPS, "Connections per second", SINGLE,
+                                    cps, PLAIN),
+                         TE_MI_MEAS(LATENCY, "Connect latency", MEDIAN,
+                                    NS2US(tst_stats.lat_p50), MICRO),
+                         TE_MI_MEAS(LATENCY, "Connect latency", PERCENTILE,
+                                    NS2US(tst_stats.lat_p99), MICRO),
+                         TE_MI_MEAS(LATENCY, "Accept time", MEDIAN,
+                                    NS2US(iut_stats.acc_lat_p50), MICRO),
+                         TE_MI_MEAS(LATENCY, "Accept time", PERCENTILE,
+                                    NS2US(iut_stats.acc_lat_p99), MICRO)),
+            NULL, NULL));
+    }
+
+    if (!test_failed)
+    {
+        TEST_STEP("Compare connection rate with performance baseline.");
+        CHECK_RC(sockts_perf_gate_check(&gate, "connections per second",
+                                        SOCKTS_PERF_HIGHER_BETTER,
+                                        &cps_vec));
+    }
+
+    if (test_failed || gate.regressed)
+        TEST_STOP;
+    TEST_SUCCESS;
+
+cleanup:
+    for (i = 0; iut_s != NULL && i < listeners_num; i++)
+        CLEANUP_RPC_CLOSE(pco_iut, iut_s[i]);
+    free(iut_s);
+    sockts_perf_gate_fini(&gate);
+    te_vec_free(&cps_vec);
+    TEST_END;
+}
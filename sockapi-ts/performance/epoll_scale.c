@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-epoll_scale epoll scalability
+ *
+ * @objective Measure how cost of @b epoll_ctl() and latency of
+ *            @b epoll_wait() change with the number of sockets in an
+ *            epoll set, and how fairly ready sockets are reported.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param sock_num      Number of TCP connections in the epoll set
+ * @param ready_num     Number of sockets which are ready
+ * @param maxevents     @b epoll_wait() @a maxevents
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/epoll_scale"
+
+#include "sockapi-test.h"
+#include "te_mi_log.h"
+
+/** Number of epoll_wait() calls */
+#define WAIT_CALLS 10000
+
+/** How long establishing all the connections may take, in milliseconds. */
+#define CONNECT_TIMEOUT 300000
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *tst_addr = NULL;
+
+    int sock_num;
+    int ready_num;
+    int maxevents;
+
+    struct sockaddr_storage        listen_addr;
+    tarpc_sockts_epoll_bench_stats stats;
+
+    rpc_ptr iut_h = RPC_NULL;
+    rpc_ptr tst_h = RPC_NULL;
+    int     tst_s = -1;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_INT_PARAM(sock_num);
+    TEST_GET_INT_PARAM(ready_num);
+    TEST_GET_INT_PARAM(maxevents);
+
+    if (ready_num < 1 || ready_num > sock_num)
+        TEST_FAIL("ready_num must be in range [1, sock_num]");
+
+    TEST_STEP("Increase limit of open files on IUT and Tester if it is "
+              "less than @p sock_num.");
+    sockts_inc_rlimit(pco_iut, RPC_RLIMIT_NOFILE, sock_num + 100);
+    sockts_inc_rlimit(pco_tst, RPC_RLIMIT_NOFILE, sock_num + 100);
+
+    TEST_STEP("Establish @p sock_num TCP connections from IUT to Tester, "
+              "no data is sent over them.");
+    tapi_sockaddr_clone_exact(tst_addr, &listen_addr);
+    TAPI_SET_NEW_PORT(pco_tst, SA(&listen_addr));
+
+    tst_s = rpc_socket(pco_tst, rpc_socket_domain_by_addr(tst_addr),
+                       RPC_SOCK_STREAM, RPC_PROTO_DEF);
+    rpc_bind(pco_tst, tst_s, SA(&listen_addr));
+    rpc_listen(pco_tst, tst_s, -1);
+
+    pco_tst->timeout = CONNECT_TIMEOUT;
+    pco_tst->op = RCF_RPC_CALL;
+    rpc_many_accept(pco_tst, tst_s, sock_num, 0, 0, NULL, NULL, &tst_h);
+
+    pco_iut->timeout = CONNECT_TIMEOUT;
+    rpc_many_connect(pco_iut, SA(&listen_addr), sock_num, 0, 0, NULL, NULL,
+                     &iut_h);
+
+    pco_tst->timeout = CONNECT_TIMEOUT;
+    rpc_many_accept(pco_tst, tst_s, sock_num, 0, 0, NULL, NULL, &tst_h);
+
+    TEST_STEP("Add IUT sockets to a new epoll set: the first @p ready_num "
+              "with @c EPOLLOUT, which is reported for connected sockets, "
+              "and the rest with @c EPOLLIN, which should not be reported "
+              "since Tester does not send data. Measure cost of "
+              "@b epoll_ctl() and latency of @b epoll_wait() with "
+              "@p maxevents.");
+    rpc_sockts_epoll_bench(pco_iut, iut_h, sock_num, ready_num,
+                           RPC_EPOLLOUT, RPC_EPOLLIN, maxevents, WAIT_CALLS,
+                           &stats);
+
+    TEST_STEP("Report the results.");
+    TEST_ARTIFACT("sockets = %d, ready = %d, maxevents = %d, "
+                  "epoll_ctl() ADD/MOD/DEL = %llu/%llu/%llu ns, "
+                  "epoll_wait() p50/p99/max = %llu/%llu/%llu ns, "
+                  "reports of a ready socket min/max = %llu/%llu, "
+                  "Jain index = %.3f",
+                  sock_num, ready_num, maxevents,
+                  (unsigned long long)stats.add_ns,
+                  (unsigned long long)stats.mod_ns,
+                  (unsigned long long)stats.del_ns,
+                  (unsigned long long)stats.wait_p50,
+                  (unsigned long long)stats.wait_p99,
+                  (unsigned long long)stats.wait_max,
+                  (unsigned long long)stats.fair_min,
+                  (unsigned long long)stats.fair_max,
+                  stats.fairness / 1000.0);
+
+    CHECK_RC(te_mi_log_meas("epoll_scale",
+        TE_MI_MEAS_V(TE_MI_MEAS(LATENCY, "epoll_ctl(ADD)", MEAN,
+                                stats.add_ns, NANO),
+                     TE_MI_MEAS(LATENCY, "epoll_ctl(MOD)", MEAN,
+                                stats.mod_ns, NANO),
+                     TE_MI_MEAS(LATENCY, "epoll_ctl(DEL)", MEAN,
+                                stats.del_ns, NANO),
+                     TE_MI_MEAS(LATENCY, "epoll_wait()", MEDIAN,
+                                stats.wait_p50, NANO),
+                     TE_MI_MEAS(LATENCY, "epoll_wait()", PERCENTILE,
+                                stats.wait_p99, NANO)),
+        NULL, NULL));
+
+    if (stats.unexpected > 0)
+    {
+        ERROR_VERDICT("Events were reported for sockets which are not "
+                      "ready");
+        test_failed = TRUE;
+    }
+
+    if (stats.events == 0)
+    {
+        ERROR_VERDICT("No events were reported");
+        test_failed = TRUE;
+    }
+    else if (stats.fair_min == 0)
+    {
+        ERROR_VERDICT("Some ready sockets were never reported");
+        test_failed = TRUE;
+    }
+
+    if (test_failed)
+        TEST_STOP;
+    TEST_SUCCESS;
+
+cleanup:
+    if (iut_h != RPC_NULL)
+        rpc_many_close(pco_iut, iut_h, sock_num);
+    if (tst_h != RPC_NULL)
+        rpc_many_close(pco_tst, tst_h, sock_num);
+    CLEANUP_RPC_CLOSE(pco_tst, tst_s);
+    TEST_END;
+}
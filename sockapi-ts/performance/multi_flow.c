@@ -0,0 +1,308 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-multi_flow Multi-flow throughput scaling
+ *
+ * @objective Measure how aggregate throughput of parallel flows scales
+ *            with the number of CPUs.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param sock_type     Socket type:
+ *                      - @c SOCK_STREAM
+ *                      - @c SOCK_DGRAM
+ * @param size          Bytes per send call
+ * @param duration      How long to send traffic for each number of flows,
+ *                      in seconds
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/multi_flow"
+
+#include "sockapi-test.h"
+#include "te_string.h"
+#include "te_mi_log.h"
+
+/**
+ * How long the receiver runs after the sender is done, in milliseconds.
+ * TCP receivers stop earlier when senders close their sockets.
+ */
+#define RECV_MARGIN 2000
+
+/**
+ * Run K flows from IUT to Tester, each side serving them by K threads
+ * pinned to the first K CPUs.
+ *
+ * @param pco_iut       IUT RPC server
+ * @param pco_tst       Tester RPC server
+ * @param iut_addr      Base IUT address
+ * @param tst_addr      Base Tester address
+ * @param sock_type     Socket type
+ * @param size          Bytes per send call
+ * @param duration      How long to send traffic, in seconds
+ * @param k             Number of flows
+ * @param iut_cpus      IUT CPUs (at least @p k)
+ * @param tst_cpus      Tester CPUs (at least @p k)
+ * @param tst_stats     Where to save per flow statistics of receivers
+ * @param iut_util      Where to save utilisation of IUT CPUs
+ * @param tst_util      Where to save utilisation of Tester CPUs
+ * @param tx_bytes      Where to save number of sent bytes
+ * @param tx_time       Where to save actual send time, in microseconds
+ */
+static void
+run_flows(rcf_rpc_server *pco_iut, rcf_rpc_server *pco_tst,
+          const struct sockaddr *iut_addr, const struct sockaddr *tst_addr,
+          rpc_socket_type sock_type, int size, int duration,
+          unsigned int k, const int *iut_cpus, const int *tst_cpus,
+          tarpc_sockts_traffic_engine_stats *tst_stats,
+          tarpc_sockts_traffic_engine_cpu *iut_util,
+          tarpc_sockts_traffic_engine_cpu *tst_util,
+          uint64_t *tx_bytes, uint64_t *tx_time)
+{
+    tarpc_sockts_traffic_engine_stats *iut_stats;
+
+    struct sockaddr_storage iut_bind_addr;
+    struct sockaddr_storage tst_bind_addr;
+
+    int          *iut_s;
+    int          *tst_s;
+    unsigned int  i;
+    int           rc;
+
+    iut_s = TE_ALLOC(k * sizeof(*iut_s));
+    tst_s = TE_ALLOC(k * sizeof(*tst_s));
+    iut_stats = TE_ALLOC(k * sizeof(*iut_stats));
+
+    for (i = 0; i < k; i++)
+    {
+        CHECK_RC(tapi_sockaddr_clone(pco_iut, iut_addr, &iut_bind_addr));
+        CHECK_RC(tapi_sockaddr_clone(pco_tst, tst_addr, &tst_bind_addr));
+        GEN_CONNECTION(pco_tst, pco_iut, sock_type, RPC_PROTO_DEF,
+                       SA(&tst_bind_addr), SA(&iut_bind_addr),
+                       &tst_s[i], &iut_s[i]);
+    }
+
+    pco_tst->timeout = TE_SEC2MS(duration) + RECV_MARGIN +
+                       pco_tst->def_timeout;
+    pco_tst->op = RCF_RPC_CALL;
+    rpc_sockts_traffic_engine_gen(pco_tst, tst_s, k, FALSE, "recv", size,
+                                  1, k, TE_SEC2MS(duration) + RECV_MARGIN,
+                                  0, RPC_NULL, tst_cpus, k, NULL, NULL,
+                                  NULL, NULL, NULL);
+
+    pco_iut->timeout = TE_SEC2MS(duration) + pco_iut->def_timeout;
+    rpc_sockts_traffic_engine_gen(pco_iut, iut_s, k, TRUE, "send", size,
+                                  1, k, TE_SEC2MS(duration), 0, RPC_NULL,
+                                  iut_cpus, k, iut_stats, NULL, NULL,
+                                  tx_time, iut_util);
+
+    /* Receivers of TCP flows stop on EOF. */
+    for (i = 0; i < k; i++)
+        RPC_CLOSE(pco_iut, iut_s[i]);
+
+    pco_tst->op = RCF_RPC_WAIT;
+    rpc_sockts_traffic_engine_gen(pco_tst, tst_s, k, FALSE, "recv", size,
+                                  1, k, TE_SEC2MS(duration) + RECV_MARGIN,
+                                  0, RPC_NULL, tst_cpus, k, tst_stats,
+                                  NULL, NULL, NULL, tst_util);
+
+    for (i = 0; i < k; i++)
+        RPC_CLOSE(pco_tst, tst_s[i]);
+
+    *tx_bytes = 0;
+    for (i = 0; i < k; i++)
+        *tx_bytes += iut_stats[i].bytes;
+
+    free(iut_s);
+    free(tst_s);
+    free(iut_stats);
+}
+
+/**
+ * Compute Jain's fairness index of per flow throughput:
+ * (sum x)^2 / (n * sum x^2). It is @c 1 if all flows get the same
+ * throughput and @c 1/n if one flow gets everything.
+ *
+ * @param stats     Per flow statistics
+ * @param n         Number of flows
+ *
+ * @return Fairness index.
+ */
+static double
+jain_index(const tarpc_sockts_traffic_engine_stats *stats, unsigned int n)
+{
+    double       sum = 0;
+    double       sum_sq = 0;
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        sum += stats[i].bytes;
+        sum_sq += (double)stats[i].bytes * stats[i].bytes;
+    }
+
+    return sum_sq == 0 ? 0 : sum * sum / (n * sum_sq);
+}
+
+/**
+ * Print utilisation of CPUs and get the average one.
+ *
+ * @param str       String to append utilisation of each CPU to
+ * @param util      CPUs utilisation
+ * @param n         Number of CPUs
+ *
+ * @return Average utilisation, in percents.
+ */
+static double
+cpu_util_print(te_string *str, const tarpc_sockts_traffic_engine_cpu *util,
+               unsigned int n)
+{
+    double       sum = 0;
+    double       pct;
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        pct = util[i].total == 0 ? 0 :
+              100.0 * util[i].busy / util[i].total;
+        sum += pct;
+        te_string_append(str, "%scpu%d %.1f%%", i == 0 ? "" : ", ",
+                         util[i].cpu, pct);
+    }
+
+    return sum / n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *iut_addr = NULL;
+    const struct sockaddr *tst_addr = NULL;
+
+    rpc_socket_type sock_type;
+    int             size;
+    int             duration;
+
+    int          *iut_cpus = NULL;
+    int          *tst_cpus = NULL;
+    unsigned int  n_iut_cpus;
+    unsigned int  n_tst_cpus;
+    unsigned int  k_max;
+    unsigned int  k;
+
+    tarpc_sockts_traffic_engine_stats *tst_stats = NULL;
+    tarpc_sockts_traffic_engine_cpu   *iut_util = NULL;
+    tarpc_sockts_traffic_engine_cpu   *tst_util = NULL;
+
+    te_string   iut_util_str = TE_STRING_INIT;
+    te_string   tst_util_str = TE_STRING_INIT;
+    te_string   meas_name = TE_STRING_INIT;
+    uint64_t    tx_bytes;
+    uint64_t    rx_bytes;
+    uint64_t    tx_time;
+    double      tx_gbps;
+    double      rx_gbps;
+    double      jain;
+    double      iut_avg;
+    double      tst_avg;
+    unsigned int i;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_SOCK_TYPE(sock_type);
+    TEST_GET_INT_PARAM(size);
+    TEST_GET_INT_PARAM(duration);
+
+    TEST_STEP("Get CPUs available on IUT and Tester, the maximum number "
+              "of flows is the minimum of their numbers.");
+    rpc_sockts_get_cpus(pco_iut, &iut_cpus, &n_iut_cpus);
+    rpc_sockts_get_cpus(pco_tst, &tst_cpus, &n_tst_cpus);
+    k_max = MIN(n_iut_cpus, n_tst_cpus);
+    if (k_max == 0)
+        TEST_FAIL("No CPUs available");
+
+    tst_stats = TE_ALLOC(k_max * sizeof(*tst_stats));
+    iut_util = TE_ALLOC(k_max * sizeof(*iut_util));
+    tst_util = TE_ALLOC(k_max * sizeof(*tst_util));
+
+    TEST_STEP("For K = 1, 2, 4, ... and the maximum number of flows: "
+              "establish K connections, send traffic over them from IUT "
+              "for @p duration seconds by K threads pinned to K CPUs and "
+              "receive it on Tester in the same way.");
+    for (k = 1; ; k = MIN(2 * k, k_max))
+    {
+        TEST_SUBSTEP("Run %u flows.", k);
+        run_flows(pco_iut, pco_tst, iut_addr, tst_addr, sock_type, size,
+                  duration, k, iut_cpus, tst_cpus, tst_stats, iut_util,
+                  tst_util, &tx_bytes, &tx_time);
+
+        TEST_SUBSTEP("Report aggregate throughput, fairness of flows "
+                     "and utilisation of CPUs.");
+        rx_bytes = 0;
+        for (i = 0; i < k; i++)
+            rx_bytes += tst_stats[i].bytes;
+
+        if (tx_time == 0)
+            TEST_FAIL("Sender reported zero run time");
+
+        tx_gbps = tx_bytes * 8.0 / tx_time / 1000;
+        rx_gbps = rx_bytes * 8.0 / tx_time / 1000;
+        jain = jain_index(tst_stats, k);
+
+        te_string_reset(&iut_util_str);
+        te_string_reset(&tst_util_str);
+        iut_avg = cpu_util_print(&iut_util_str, iut_util, k);
+        tst_avg = cpu_util_print(&tst_util_str, tst_util, k);
+
+        TEST_ARTIFACT("flows = %u, throughput tx = %.3f Gbit/s, "
+                      "throughput rx = %.3f Gbit/s, Jain index = %.3f, "
+                      "IUT CPU = %.1f%%, Tester CPU = %.1f%%",
+                      k, tx_gbps, rx_gbps, jain, iut_avg, tst_avg);
+        RING("Flows %u, IUT CPUs utilisation: %s; Tester CPUs "
+             "utilisation: %s", k, iut_util_str.ptr, tst_util_str.ptr);
+
+        te_string_reset(&meas_name);
+        te_string_append(&meas_name, "%u flows", k);
+        CHECK_RC(te_mi_log_meas("multi_flow",
+            TE_MI_MEAS_V(TE_MI_MEAS(THROUGHPUT, meas_name.ptr, SINGLE,
+                                    rx_gbps, GIGA),
+                         TE_MI_MEAS(CPU, meas_name.ptr, MEAN,
+                                    iut_avg, PLAIN)),
+            NULL, NULL));
+
+        if (rx_bytes == 0)
+        {
+            ERROR_VERDICT("No data was received over %u flows", k);
+            test_failed = TRUE;
+        }
+
+        if (k == k_max)
+            break;
+    }
+
+    if (test_failed)
+        TEST_STOP;
+    TEST_SUCCESS;
+
+cleanup:
+    free(iut_cpus);
+    free(tst_cpus);
+    free(tst_stats);
+    free(iut_util);
+    free(tst_util);
+    te_string_free(&iut_util_str);
+    te_string_free(&tst_util_str);
+    te_string_free(&meas_name);
+    TEST_END;
+}
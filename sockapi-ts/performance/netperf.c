@@ -8,6 +8,10 @@
  *
  * @objective Measure performance with netperf
  *
+ * @param n_runs    Number of netperf runs (from @c 1 to @c 60, the test
+ *                  duration in seconds), results are compared with
+ *                  performance baseline if it is specified
+ *
  * @par Test sequence:
  *
  * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
@@ -19,8 +23,9 @@
 #include "tapi_job.h"
 #include "tapi_job_factory_rpc.h"
 #include "onload.h"
+#include "sockapi-ts_perf.h"
 
-/* Duration of the test in seconds. */
+/* Duration of the test in seconds, it is split between runs. */
 #define TEST_DURATION 60
 /** Send and receive socket buffer size */
 #define SOCK_BUF_SIZE 65536
@@ -84,9 +89,16 @@ main(int argc, char *argv[])
     tapi_netperf_report        report;
     tapi_netperf_test_name     test_name;
 
+    sockts_perf_gate gate = { .path = NULL, .iter = TE_STRING_INIT };
+    te_vec           mbps_send = TE_VEC_INIT(double);
+    te_vec           mbps_recv = TE_VEC_INIT(double);
+    te_vec           trps = TE_VEC_INIT(double);
+
     int      port = -1;
-    uint32_t duration = TEST_DURATION;
+    uint32_t duration;
     int32_t  payload;
+    int      n_runs;
+    int      i;
 
     TEST_START;
     TEST_GET_PCO(pco_iut);
@@ -95,6 +107,15 @@ main(int argc, char *argv[])
     TEST_GET_ADDR(pco_iut, iut_addr);
     TEST_GET_ENUM_PARAM(test_name, TEST_NAME_MAP_LIST);
     TEST_GET_INT_PARAM(payload);
+    TEST_GET_INT_PARAM(n_runs);
+    if (n_runs < 1 || n_runs > TEST_DURATION)
+    {
+        TEST_FAIL("n_runs must be from 1 to %d, the test duration in "
+                  "seconds", TEST_DURATION);
+    }
+
+    CHECK_RC(sockts_perf_gate_init(&gate, argc, argv));
+    duration = TEST_DURATION / n_runs;
 
     opt = tapi_netperf_default_opt;
     opt.test_name = test_name;
@@ -163,38 +184,66 @@ main(int argc, char *argv[])
 
     CHECK_RC(tapi_netperf_client_add_sched_param(netperf, sched_param));
 
-    TEST_STEP("Start netperf and netserver.");
+    TEST_STEP("Start netserver.");
     CHECK_RC(tapi_netperf_start_server(netserver));
     /* ST-2384: Looks like netserver sometimes starts slowly, so let's add
      * bigger timeout than TAPI_WAIT_NETWORK. */
     SLEEP(1);
-    CHECK_RC(tapi_netperf_start_client(netperf));
-
-    TEST_STEP("Wait for netperf completion.");
-    CHECK_RC(tapi_netperf_wait_client(netperf,
-                                      TE_SEC2MS(duration + pco_iut->def_timeout)));
-
-    TEST_STEP("Get netperf report.");
-    CHECK_RC(tapi_netperf_get_report(netperf, &report));
 
-    switch (report.tst_type)
+    TEST_STEP("Run netperf @p n_runs times.");
+    for (i = 0; i < n_runs; i++)
     {
-        case TAPI_NETPERF_TYPE_STREAM:
-            TEST_ARTIFACT("test_name = %s, payload = %d, throughput tx = %lf 10^6bits/sec, "
-                          "throughput rx = %lf 10^6bits/sec", test_name_enum2str(test_name),
-                          payload ,report.stream.mbps_send,
-                          report.stream.mbps_recv);
-            break;
-
-        case TAPI_NETPERF_TYPE_RR:
-            TEST_ARTIFACT("test_name = %s, payload = %d, transactions per second = %lf",
-                          test_name_enum2str(test_name), payload,
-                          report.rr.trps);
-            break;
+        TEST_SUBSTEP("Start netperf and wait for its completion.");
+        CHECK_RC(tapi_netperf_start_client(netperf));
+        CHECK_RC(tapi_netperf_wait_client(netperf,
+                                TE_SEC2MS(duration + pco_iut->def_timeout)));
+
+        TEST_SUBSTEP("Get netperf report.");
+        CHECK_RC(tapi_netperf_get_report(netperf, &report));
+
+        switch (report.tst_type)
+        {
+            case TAPI_NETPERF_TYPE_STREAM:
+                TEST_ARTIFACT("test_name = %s, payload = %d, "
+                              "throughput tx = %lf 10^6bits/sec, "
+                              "throughput rx = %lf 10^6bits/sec",
+                              test_name_enum2str(test_name), payload,
+                              report.stream.mbps_send,
+                              report.stream.mbps_recv);
+                TE_VEC_APPEND(&mbps_send, report.stream.mbps_send);
+                TE_VEC_APPEND(&mbps_recv, report.stream.mbps_recv);
+                break;
+
+            case TAPI_NETPERF_TYPE_RR:
+                TEST_ARTIFACT("test_name = %s, payload = %d, "
+                              "transactions per second = %lf",
+                              test_name_enum2str(test_name), payload,
+                              report.rr.trps);
+                TE_VEC_APPEND(&trps, report.rr.trps);
+                break;
+        }
+
+        tapi_netperf_mi_report(&report);
     }
 
-    tapi_netperf_mi_report(&report);
+    TEST_STEP("Compare results with performance baseline.");
+    if (report.tst_type == TAPI_NETPERF_TYPE_STREAM)
+    {
+        CHECK_RC(sockts_perf_gate_check(&gate, "throughput tx",
+                                        SOCKTS_PERF_HIGHER_BETTER,
+                                        &mbps_send));
+        CHECK_RC(sockts_perf_gate_check(&gate, "throughput rx",
+                                        SOCKTS_PERF_HIGHER_BETTER,
+                                        &mbps_recv));
+    }
+    else
+    {
+        CHECK_RC(sockts_perf_gate_check(&gate, "transactions per second",
+                                        SOCKTS_PERF_HIGHER_BETTER, &trps));
+    }
 
+    if (gate.regressed)
+        TEST_STOP;
     TEST_SUCCESS;
 
 cleanup:
@@ -203,5 +252,9 @@ cleanup:
     CHECK_RC(tapi_netperf_destroy_server(netserver));
     tapi_job_factory_destroy(netperf_factory);
     tapi_job_factory_destroy(netserver_factory);
+    sockts_perf_gate_fini(&gate);
+    te_vec_free(&mbps_send);
+    te_vec_free(&mbps_recv);
+    te_vec_free(&trps);
     TEST_END;
 }
@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-peek_cost Cost of MSG_PEEK
+ *
+ * @objective Measure cost of @b recv() with @c MSG_PEEK compared to
+ *            consuming @b recv() for several peek/consume ratios, on
+ *            accelerated or kernel stack.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param accelerate    If @c FALSE, disable Onload acceleration on IUT
+ *                      to measure kernel stack
+ * @param batch         Bytes requested by every @b recv() call
+ * @param duration      How long to send data for every ratio, in seconds
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/peek_cost"
+
+#include "sockapi-test.h"
+#include "te_string.h"
+#include "te_mi_log.h"
+#include "onload.h"
+
+/** Numbers of recv(MSG_PEEK) calls per consuming recv() call */
+static const int peek_counts[] = { 0, 1, 4 };
+
+/** Average time of a call in nanoseconds, or zero if there were none. */
+#define NS_PER_CALL(_ns, _calls) \
+    ((_calls) == 0 ? 0 : (double)(_ns) / (_calls))
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *iut_addr = NULL;
+    const struct sockaddr *tst_addr = NULL;
+
+    te_bool accelerate;
+    int     batch;
+    int     duration;
+
+    tapi_pat_sender                 sender_ctx;
+    tarpc_pat_gen_arg              *lcg_arg = NULL;
+    tarpc_pat_gen_arg               recv_gen_arg;
+    tarpc_sockts_peek_stream_stats  stats;
+
+    te_string   meas_name = TE_STRING_INIT;
+    te_bool     acc_disabled = FALSE;
+    int         iut_s = -1;
+    int         tst_s = -1;
+    uint64_t    received;
+    double      peek_ns;
+    double      recv_ns;
+    unsigned int i;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_BOOL_PARAM(accelerate);
+    TEST_GET_INT_PARAM(batch);
+    TEST_GET_INT_PARAM(duration);
+
+    if (!accelerate && tapi_onload_run())
+    {
+        TEST_STEP("If @p accelerate is @c FALSE, disable Onload "
+                  "acceleration on IUT.");
+        CHECK_RC(tapi_onload_acc(pco_iut, FALSE));
+        acc_disabled = TRUE;
+    }
+
+    TEST_STEP("Create a pair of connected TCP sockets on IUT and Tester.");
+    GEN_CONNECTION(pco_tst, pco_iut, RPC_SOCK_STREAM, RPC_PROTO_DEF,
+                   tst_addr, iut_addr, &tst_s, &iut_s);
+
+    tapi_pat_sender_init(&sender_ctx);
+    sender_ctx.gen_func = RPC_PATTERN_GEN_LCG;
+    sender_ctx.duration_sec = duration;
+    sender_ctx.size.min = SOCKTS_MSG_STREAM_MAX;
+    sender_ctx.size.max = SOCKTS_MSG_STREAM_MAX;
+    sender_ctx.size.once = FALSE;
+
+    lcg_arg = &sender_ctx.gen_arg;
+    lcg_arg->offset = 0;
+    lcg_arg->coef1 = rand_range(0, RAND_MAX);
+    lcg_arg->coef2 = rand_range(0, RAND_MAX) | 1;
+    lcg_arg->coef3 = rand_range(0, RAND_MAX);
+    memcpy(&recv_gen_arg, lcg_arg, sizeof(recv_gen_arg));
+
+    TEST_STEP("For every number of @c MSG_PEEK calls per consuming call "
+              "in @ref peek_counts: send data from Tester for @p duration "
+              "seconds, receive and check it on IUT requesting @p batch "
+              "bytes with every @b recv() call, passing @c MSG_PEEK to "
+              "the given number of calls before every consuming call.");
+    for (i = 0; i < TE_ARRAY_LEN(peek_counts); i++)
+    {
+        TEST_SUBSTEP("Receive with %d peeking calls per consuming call.",
+                     peek_counts[i]);
+        pco_iut->timeout = TE_SEC2MS(duration + 1) + pco_iut->def_timeout;
+        pco_iut->op = RCF_RPC_CALL;
+        rpc_sockts_peek_stream_receiver_gen(pco_iut, iut_s,
+                                            TE_SEC2MS(duration + 1),
+                                            TAPI_WAIT_NETWORK_DELAY,
+                                            peek_counts[i], TRUE, batch,
+                                            &recv_gen_arg, &received,
+                                            &stats);
+
+        MSLEEP(100);
+
+        pco_tst->timeout = TE_SEC2MS(duration) + pco_tst->def_timeout;
+        rpc_pattern_sender(pco_tst, tst_s, &sender_ctx);
+
+        RPC_AWAIT_ERROR(pco_iut);
+        rc = rpc_sockts_peek_stream_receiver_gen(pco_iut, iut_s,
+                                                 TE_SEC2MS(duration + 1),
+                                                 TAPI_WAIT_NETWORK_DELAY,
+                                                 peek_counts[i], TRUE,
+                                                 batch, &recv_gen_arg,
+                                                 &received, &stats);
+        if (rc < 0)
+        {
+            TEST_VERDICT("rpc_sockts_peek_stream_receiver_gen() failed "
+                         "with error " RPC_ERROR_FMT,
+                         RPC_ERROR_ARGS(pco_iut));
+        }
+
+        if (received != sender_ctx.sent)
+            TEST_VERDICT("Received different number of bytes than sent");
+
+        TEST_SUBSTEP("Report throughput and time per peeking and "
+                     "consuming call.");
+        peek_ns = NS_PER_CALL(stats.peek_ns, stats.peek_calls);
+        recv_ns = NS_PER_CALL(stats.recv_ns, stats.recv_calls);
+
+        TEST_ARTIFACT("accelerate = %s, peek count = %d, throughput = "
+                      "%.3f Gbit/s, recv(MSG_PEEK) = %.1f ns per call, "
+                      "recv() = %.1f ns per call, re-read bytes = %llu, "
+                      "consumed bytes = %llu",
+                      accelerate ? "TRUE" : "FALSE", peek_counts[i],
+                      stats.mbps / 1000.0, peek_ns, recv_ns,
+                      (unsigned long long)stats.peek_bytes,
+                      (unsigned long long)stats.recv_bytes);
+
+        te_string_reset(&meas_name);
+        te_string_append(&meas_name, "peek count %d", peek_counts[i]);
+        CHECK_RC(te_mi_log_meas("peek_cost",
+            TE_MI_MEAS_V(TE_MI_MEAS(THROUGHPUT, meas_name.ptr, SINGLE,
+                                    stats.mbps / 1000.0, GIGA),
+                         TE_MI_MEAS(LATENCY, "recv()", MEAN,
+                                    recv_ns, NANO)),
+            NULL, NULL));
+
+        if (peek_counts[i] == 0)
+            continue;
+
+        CHECK_RC(te_mi_log_meas("peek_cost",
+            TE_MI_MEAS_V(TE_MI_MEAS(LATENCY, "recv(MSG_PEEK)", MEAN,
+                                    peek_ns, NANO)),
+            NULL, NULL));
+
+        if (stats.peek_bytes == 0)
+        {
+            ERROR_VERDICT("No bytes were re-read with %d peeking calls "
+                          "per consuming call", peek_counts[i]);
+            test_failed = TRUE;
+        }
+    }
+
+    if (test_failed)
+        TEST_STOP;
+    TEST_SUCCESS;
+
+cleanup:
+    CLEANUP_RPC_CLOSE(pco_iut, iut_s);
+    CLEANUP_RPC_CLOSE(pco_tst, tst_s);
+
+    if (acc_disabled)
+        CLEANUP_CHECK_RC(tapi_onload_acc(pco_iut, TRUE));
+
+    te_string_free(&meas_name);
+    TEST_END;
+}
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-send_batch Batched send rate
+ *
+ * @objective Measure rate of sending small UDP datagrams from IUT with
+ *            one message per call and with batches of messages passed
+ *            to a single call.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param func          Send function:
+ *                      - @b send()
+ *                      - @b sendmsg() (a batch is sent as a single
+ *                        datagram)
+ *                      - @b sendmmsg()
+ * @param batch         Number of messages per call (ignored for
+ *                      @b send())
+ * @param size          Message size
+ * @param num           Number of messages
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/send_batch"
+
+#include "sockapi-test.h"
+#include "te_mi_log.h"
+
+/** How long sending may take, in milliseconds. */
+#define SEND_TIMEOUT 60000
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *iut_addr = NULL;
+    const struct sockaddr *tst_addr = NULL;
+
+    const char *func;
+    int         batch;
+    int         size;
+    int         num;
+
+    int           iut_s = -1;
+    int           tst_s = -1;
+    tarpc_size_t *vector = NULL;
+    uint64_t      sent;
+    uint64_t      calls;
+    uint64_t      duration;
+    double        mps;
+    double        ns_per_msg;
+    int           i;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_STRING_PARAM(func);
+    TEST_GET_INT_PARAM(batch);
+    TEST_GET_INT_PARAM(size);
+    TEST_GET_INT_PARAM(num);
+
+    if (size <= 0 || num <= 0)
+        TEST_FAIL("size and num must be positive");
+
+    TEST_STEP("Create connected UDP sockets on IUT and Tester.");
+    GEN_CONNECTION(pco_tst, pco_iut, RPC_SOCK_DGRAM, RPC_PROTO_DEF,
+                   tst_addr, iut_addr, &tst_s, &iut_s);
+
+    TEST_STEP("Send @p num messages of @p size bytes from IUT with "
+              "@p func, passing @p batch messages to a single call.");
+    vector = TE_ALLOC(num * sizeof(*vector));
+    for (i = 0; i < num; i++)
+        vector[i] = size;
+
+    pco_iut->timeout = SEND_TIMEOUT;
+    rpc_many_send_batch(pco_iut, iut_s, 0, vector, num, func, batch, 0,
+                        NULL, NULL, &sent, &calls, &duration);
+
+    TEST_STEP("Report message rate and time spent per message and per "
+              "call.");
+    if (duration == 0 || calls == 0)
+        TEST_FAIL("Sender reported zero run time or number of calls");
+
+    mps = num * 1000000000.0 / duration;
+    ns_per_msg = (double)duration / num;
+
+    TEST_ARTIFACT("func = %s, batch = %d, messages per second = %.0f, "
+                  "time per message = %.1f ns, time per call = %.1f ns",
+                  func, batch, mps, ns_per_msg,
+                  (double)duration / calls);
+
+    CHECK_RC(te_mi_log_meas("send_batch",
+        TE_MI_MEAS_V(TE_MI_MEAS(RPS, "Messages per second", SINGLE,
+                                mps, PLAIN),
+                     TE_MI_MEAS(LATENCY, "Time per message", SINGLE,
+                                ns_per_msg, NANO)),
+        NULL, NULL));
+
+    if (sent != (uint64_t)size * num)
+    {
+        TEST_VERDICT("%llu bytes were sent instead of %llu",
+                     (unsigned long long)sent,
+                     (unsigned long long)size * num);
+    }
+
+    TEST_SUCCESS;
+
+cleanup:
+    CLEANUP_RPC_CLOSE(pco_iut, iut_s);
+    CLEANUP_RPC_CLOSE(pco_tst, tst_s);
+    free(vector);
+    TEST_END;
+}
@@ -25,6 +25,9 @@
  * @param spin Non-blocking calls or not:
  *        - @c True
  *        - @c False
+ * @param n_runs Number of sfnt-pingpong runs, mean and percentile latency
+ *               are compared with performance baseline if it is specified:
+ *        - 5
  *
  * @par Scenario:
  *
@@ -39,6 +42,7 @@
 #include "te_vector.h"
 #include "te_mi_log.h"
 #include "onload.h"
+#include "sockapi-ts_perf.h"
 
 /** Default maximum time per message size (sec). */
 #define TIME_PER_MSG 3
@@ -69,8 +73,16 @@ main(int argc, char *argv[])
     tapi_sfnt_pp_app_server_t *server;
     tapi_sfnt_pp_report       *report;
     int                        i;
+    int                        j;
+    int                        n_runs;
     te_vec                     vec = TE_VEC_INIT(int);
     te_string                  res = TE_STRING_INIT;
+    te_vec                    *means = NULL;
+    te_vec                    *percentiles = NULL;
+    sockts_perf_gate           gate = { .path = NULL,
+                                        .iter = TE_STRING_INIT };
+    char                       name[64];
+    double                     sample;
 
     tapi_job_wrapper_t    *wrap;
     /*
@@ -92,9 +104,20 @@ main(int argc, char *argv[])
     TEST_GET_INT_LIST_PARAM(sizes, sizes_len);
     TEST_GET_SFNT_PP_MUXER(muxer);
     TEST_GET_BOOL_PARAM(spin);
+    TEST_GET_INT_PARAM(n_runs);
+
+    CHECK_RC(sockts_perf_gate_init(&gate, argc, argv));
 
     te_vec_append_array(&vec, sizes, sizes_len);
 
+    means = TE_ALLOC(sizes_len * sizeof(*means));
+    percentiles = TE_ALLOC(sizes_len * sizeof(*percentiles));
+    for (i = 0; i < sizes_len; i++)
+    {
+        means[i] = (te_vec)TE_VEC_INIT(double);
+        percentiles[i] = (te_vec)TE_VEC_INIT(double);
+    }
+
     opt = tapi_sfnt_pp_opt_default_opt;
     opt.proto = proto_rpc2h(proto);
     opt.server = tst_addr;
@@ -134,38 +157,63 @@ main(int argc, char *argv[])
 
     CHECK_RC(tapi_sfnt_pp_client_add_sched_param(client, sched_param));
 
-    TEST_STEP("Start client and start server");
-    CHECK_RC(tapi_sfnt_pp_start_server(server));
-    TEST_SUBSTEP("Wait for a while before connecting "
-                 "to allow the server to start.");
-    TAPI_WAIT_NETWORK;
-    CHECK_RC(tapi_sfnt_pp_start_client(client));
-
-    TEST_STEP("Wait for sfnt-pingpong client completion.");
-    CHECK_RC(tapi_sfnt_pp_wait_client(client,
+    TEST_STEP("Run sfnt-pingpong @p n_runs times.");
+    for (j = 0; j < n_runs; j++)
+    {
+        TEST_SUBSTEP("Start client and start server");
+        CHECK_RC(tapi_sfnt_pp_start_server(server));
+        TEST_SUBSTEP("Wait for a while before connecting "
+                     "to allow the server to start.");
+        TAPI_WAIT_NETWORK;
+        CHECK_RC(tapi_sfnt_pp_start_client(client));
+
+        TEST_SUBSTEP("Wait for sfnt-pingpong client completion.");
+        CHECK_RC(tapi_sfnt_pp_wait_client(client,
                     TE_SEC2MS(TIME_PER_MSG * sizes_len + EXTRA_TIME_TO_WAIT)));
 
-    TEST_STEP("Wait for sfnt-pingpong server completion.");
-    CHECK_RC(tapi_sfnt_pp_wait_server(
-                server, TAPI_WAIT_NETWORK_DELAY));
-
-    TEST_STEP("Get report");
-    CHECK_RC(tapi_sfnt_pp_get_report(client, &report));
+        TEST_SUBSTEP("Wait for sfnt-pingpong server completion.");
+        CHECK_RC(tapi_sfnt_pp_wait_server(
+                    server, TAPI_WAIT_NETWORK_DELAY));
+
+        TEST_SUBSTEP("Get report");
+        CHECK_RC(tapi_sfnt_pp_get_report(client, &report));
+
+        te_string_reset(&res);
+        te_string_append(&res, "size      mean      min       median    "
+                         "max       ile       stddev\n");
+        for (i = 0; i < sizes_len; i++)
+        {
+            te_string_append(&res, "%-10d%-10d%-10d%-10d%-10d%-10d%-10d\n",
+                             report[i].size, report[i].mean, report[i].min,
+                             report[i].median, report[i].max,
+                             report[i].percentile, report[i].stddev);
+            sample = report[i].mean;
+            TE_VEC_APPEND(&means[i], sample);
+            sample = report[i].percentile;
+            TE_VEC_APPEND(&percentiles[i], sample);
+        }
+        TEST_ARTIFACT("%s", res.ptr);
+
+        for (i = 0; i < sizes_len; i++)
+            tapi_sfnt_pp_mi_report(&report[i]);
+    }
 
-    te_string_append(&res, "size      mean      min       median    max       "
-                    "ile       stddev\n");
+    TEST_STEP("Compare mean and percentile latency with performance "
+              "baseline.");
     for (i = 0; i < sizes_len; i++)
     {
-        te_string_append(&res, "%-10d%-10d%-10d%-10d%-10d%-10d%-10d\n",
-                         report[i].size, report[i].mean, report[i].min,
-                         report[i].median, report[i].max, report[i].percentile,
-                         report[i].stddev);
+        TE_SPRINTF(name, "mean latency for size %d", sizes[i]);
+        CHECK_RC(sockts_perf_gate_check(&gate, name,
+                                        SOCKTS_PERF_LOWER_BETTER,
+                                        &means[i]));
+        TE_SPRINTF(name, "percentile latency for size %d", sizes[i]);
+        CHECK_RC(sockts_perf_gate_check(&gate, name,
+                                        SOCKTS_PERF_LOWER_BETTER,
+                                        &percentiles[i]));
     }
-    TEST_ARTIFACT("%s", res.ptr);
-
-    for (i = 0; i < sizes_len; i++)
-        tapi_sfnt_pp_mi_report(&report[i]);
 
+    if (gate.regressed)
+        TEST_STOP;
     TEST_SUCCESS;
 
 cleanup:
@@ -174,5 +222,13 @@ cleanup:
     CHECK_RC(tapi_sfnt_pp_destroy_server(server));
     te_string_free(&res);
     te_vec_free(&vec);
+    for (i = 0; means != NULL && i < sizes_len; i++)
+    {
+        te_vec_free(&means[i]);
+        te_vec_free(&percentiles[i]);
+    }
+    free(means);
+    free(percentiles);
+    sockts_perf_gate_fini(&gate);
     TEST_END;
 }
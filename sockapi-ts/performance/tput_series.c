@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-tput_series Throughput time series
+ *
+ * @objective Check how throughput of a single flow changes while data
+ *            is transferred (slow start, drops, recovery), not only its
+ *            average value.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param sock_type     Socket type:
+ *                      - @c SOCK_STREAM
+ *                      - @c SOCK_DGRAM
+ * @param size          Bytes per send call
+ * @param num           Number of send calls
+ * @param bucket_us     Length of a sampling interval, in microseconds
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/tput_series"
+
+#include "sockapi-test.h"
+#include "te_string.h"
+#include "te_mi_log.h"
+
+/** Datagram which tells UDP receiver to stop. */
+#define LAST_PACKET "bye!"
+
+/** Length of @ref LAST_PACKET */
+#define LAST_PACKET_LEN strlen(LAST_PACKET)
+
+/** How many times to try sending @ref LAST_PACKET. */
+#define STOP_MAX_ATTEMPTS 10
+
+/**
+ * How long UDP receiver may wait for data, in milliseconds. It normally
+ * stops much earlier, on @ref LAST_PACKET.
+ */
+#define RECV_TIMEOUT 60000
+
+/** Part of the peak throughput which is considered as reaching it. */
+#define RAMP_LEVEL 0.9
+
+/** Summary of throughput time series */
+typedef struct series_summary {
+    double       peak_gbps;     /**< Maximum throughput of an interval */
+    double       mean_gbps;     /**< Average throughput */
+    unsigned int ramp_us;       /**< Time to reach @ref RAMP_LEVEL of
+                                     the peak throughput */
+    unsigned int first;         /**< Index of the first interval with
+                                     data */
+    unsigned int last;          /**< Index of the last interval with
+                                     data */
+} series_summary;
+
+/**
+ * Summarize throughput time series. Idle intervals before the first
+ * and after the last received byte are not taken into account, the last
+ * interval with data is not used for the peak since it is usually
+ * partial.
+ *
+ * @param samples       Bytes received in each interval
+ * @param n_samples     Number of intervals
+ * @param bucket_us     Length of an interval, in microseconds
+ * @param summary       Where to save the summary
+ *
+ * @return @c FALSE if no data was received.
+ */
+static te_bool
+series_summarize(const uint64_t *samples, unsigned int n_samples,
+                 unsigned int bucket_us, series_summary *summary)
+{
+    uint64_t     peak = 0;
+    uint64_t     total = 0;
+    unsigned int i;
+
+    memset(summary, 0, sizeof(*summary));
+
+    for (i = 0; i < n_samples && samples[i] == 0; i++);
+    if (i == n_samples)
+        return FALSE;
+    summary->first = i;
+
+    for (i = n_samples; samples[i - 1] == 0; i--);
+    summary->last = i - 1;
+
+    for (i = summary->first; i <= summary->last; i++)
+    {
+        total += samples[i];
+        if (i < summary->last || summary->first == summary->last)
+            peak = MAX(peak, samples[i]);
+    }
+
+    for (i = summary->first; i <= summary->last; i++)
+    {
+        if (samples[i] >= peak * RAMP_LEVEL)
+            break;
+    }
+
+    summary->peak_gbps = peak * 8.0 / bucket_us / 1000;
+    summary->mean_gbps = total * 8.0 /
+                         ((summary->last - summary->first + 1) *
+                          bucket_us) / 1000;
+    summary->ramp_us = (i - summary->first + 1) * bucket_us;
+
+    return TRUE;
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *iut_addr = NULL;
+    const struct sockaddr *tst_addr = NULL;
+
+    rpc_socket_type sock_type;
+    int             size;
+    int             num;
+    int             bucket_us;
+
+    int             iut_s = -1;
+    int             tst_s = -1;
+    tarpc_size_t   *vector = NULL;
+    uint64_t       *samples = NULL;
+    unsigned int    n_samples = 0;
+    uint64_t        sent;
+    uint64_t        received;
+    uint64_t        duration;
+    series_summary  summary;
+    te_string       series_str = TE_STRING_INIT;
+    te_bool         done;
+    unsigned int    i;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_SOCK_TYPE(sock_type);
+    TEST_GET_INT_PARAM(size);
+    TEST_GET_INT_PARAM(num);
+    TEST_GET_INT_PARAM(bucket_us);
+
+    if (size <= 0 || num <= 0 || bucket_us <= 0)
+        TEST_FAIL("size, num and bucket_us must be positive");
+
+    TEST_STEP("Establish connection of @p sock_type type between IUT "
+              "and Tester.");
+    GEN_CONNECTION(pco_tst, pco_iut, sock_type, RPC_PROTO_DEF,
+                   tst_addr, iut_addr, &tst_s, &iut_s);
+
+    vector = TE_ALLOC(num * sizeof(*vector));
+    for (i = 0; i < (unsigned int)num; i++)
+        vector[i] = size;
+
+    TEST_STEP("Start receiving data on Tester, collecting number of "
+              "received bytes in each @p bucket_us interval.");
+    pco_tst->op = RCF_RPC_CALL;
+    if (sock_type == RPC_SOCK_STREAM)
+    {
+        rpc_recv_timing_samples(pco_tst, tst_s, -1,
+                                (tarpc_size_t)size * num, &duration,
+                                bucket_us, &samples, &n_samples);
+    }
+    else
+    {
+        rpc_many_recv_samples(pco_tst, tst_s, size, -1, RECV_TIMEOUT,
+                              LAST_PACKET, LAST_PACKET_LEN, FALSE, NULL,
+                              bucket_us, &samples, &n_samples);
+    }
+
+    TEST_STEP("Send @p num messages of @p size bytes from IUT.");
+    pco_iut->timeout = RECV_TIMEOUT;
+    rpc_many_send(pco_iut, iut_s, 0, vector, num, &sent);
+
+    if (sock_type == RPC_SOCK_DGRAM)
+    {
+        TEST_SUBSTEP("Send the last datagram to stop receiver on Tester.");
+        TAPI_WAIT_NETWORK;
+        for (i = 0; i < STOP_MAX_ATTEMPTS; i++)
+        {
+            rpc_send(pco_iut, iut_s, LAST_PACKET, LAST_PACKET_LEN, 0);
+            CHECK_RC(rcf_rpc_server_is_op_done(pco_tst, &done));
+            if (done)
+                break;
+
+            TAPI_WAIT_NETWORK;
+        }
+    }
+
+    TEST_STEP("Wait for the receiver on Tester.");
+    pco_tst->timeout = RECV_TIMEOUT;
+    pco_tst->op = RCF_RPC_WAIT;
+    if (sock_type == RPC_SOCK_STREAM)
+    {
+        received = rpc_recv_timing_samples(pco_tst, tst_s, -1,
+                                           (tarpc_size_t)size * num,
+                                           &duration, bucket_us, &samples,
+                                           &n_samples);
+    }
+    else
+    {
+        rc = rpc_many_recv_samples(pco_tst, tst_s, size, -1, RECV_TIMEOUT,
+                                   LAST_PACKET, LAST_PACKET_LEN, FALSE,
+                                   NULL, bucket_us, &samples, &n_samples);
+        received = (uint64_t)rc * size;
+        RING("%d of %d datagrams were received", rc, num);
+    }
+
+    TEST_STEP("Report peak and mean throughput, time to reach the peak "
+              "and the whole time series.");
+    if (!series_summarize(samples, n_samples, bucket_us, &summary))
+        TEST_VERDICT("No data was received on Tester");
+
+    for (i = summary.first; i <= summary.last; i++)
+    {
+        te_string_append(&series_str, "%s%u us %.3f",
+                         i == summary.first ? "" : ", ",
+                         (i - summary.first + 1) * bucket_us,
+                         samples[i] * 8.0 / bucket_us / 1000);
+    }
+    RING("Throughput series, Gbit/s: %s", series_str.ptr);
+
+    TEST_ARTIFACT("sent = %llu bytes, received = %llu bytes, "
+                  "peak = %.3f Gbit/s, mean = %.3f Gbit/s, "
+                  "ramp-up = %u us",
+                  (unsigned long long)sent, (unsigned long long)received,
+                  summary.peak_gbps, summary.mean_gbps, summary.ramp_us);
+
+    CHECK_RC(te_mi_log_meas("tput_series",
+        TE_MI_MEAS_V(TE_MI_MEAS(THROUGHPUT, "Peak throughput", MAX,
+                                summary.peak_gbps, GIGA),
+                     TE_MI_MEAS(THROUGHPUT, "Mean throughput", MEAN,
+                                summary.mean_gbps, GIGA),
+                     TE_MI_MEAS(LATENCY, "Ramp-up time", SINGLE,
+                                summary.ramp_us, MICRO)),
+        NULL, NULL));
+
+    if (sock_type == RPC_SOCK_STREAM && received != (uint64_t)size * num)
+    {
+        TEST_VERDICT("Tester received %llu bytes instead of %llu",
+                     (unsigned long long)received,
+                     (unsigned long long)size * num);
+    }
+
+    TEST_SUCCESS;
+
+cleanup:
+    CLEANUP_RPC_CLOSE(pco_iut, iut_s);
+    CLEANUP_RPC_CLOSE(pco_tst, tst_s);
+    free(vector);
+    free(samples);
+    te_string_free(&series_str);
+    TEST_END;
+}
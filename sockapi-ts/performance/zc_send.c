@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* (c) Copyright 2004 - 2022 Xilinx, Inc. All rights reserved. */
+/*
+ * Socket API Test Suite
+ */
+
+/** @page performance-zc_send Zero-copy send throughput
+ *
+ * @objective Compare throughput, CPU usage and completion lag of
+ *            zero-copy and ordinary send over a TCP connection.
+ *
+ * @param env           Testing environment:
+ *                      - @ref arg_types_env_peer2peer
+ *                      - @ref arg_types_env_peer2peer_ipv6
+ * @param mode          How to send data:
+ *                      - @c reg_bufs (@b onload_zc_send() with registered
+ *                        buffers)
+ *                      - @c alloc_bufs (@b onload_zc_send() with buffers
+ *                        from @b onload_zc_alloc_buffers())
+ *                      - @c msg_zerocopy (@b send() with
+ *                        @c MSG_ZEROCOPY)
+ *                      - @c copy (ordinary @b send())
+ * @param size          Bytes per send call
+ * @param window        Maximum number of zero-copy buffers in flight
+ * @param duration      How long to send, in seconds
+ *
+ * @par Test sequence:
+ *
+ * @author Artemii Morozov <Artemii.Morozov@oktetlabs.ru>
+ */
+#define TE_TEST_NAME  "performance/zc_send"
+
+#include "sockapi-test.h"
+#include "te_mi_log.h"
+
+/** List of "mode" parameter values for TEST_GET_ENUM_PARAM() */
+#define ZC_SEND_MODE_MAPPING_LIST \
+    { "reg_bufs", TARPC_ZC_SEND_REG_BUFS },           \
+    { "alloc_bufs", TARPC_ZC_SEND_ALLOC_BUFS },       \
+    { "msg_zerocopy", TARPC_ZC_SEND_MSG_ZEROCOPY },   \
+    { "copy", TARPC_ZC_SEND_COPY }
+
+/**
+ * Get name of a send mode.
+ *
+ * @param mode      Send mode
+ *
+ * @return Name of the mode as in "mode" parameter.
+ */
+static const char *
+zc_send_mode2str(tarpc_sockts_zc_send_mode mode)
+{
+    switch (mode)
+    {
+        case TARPC_ZC_SEND_REG_BUFS:
+            return "reg_bufs";
+
+        case TARPC_ZC_SEND_ALLOC_BUFS:
+            return "alloc_bufs";
+
+        case TARPC_ZC_SEND_MSG_ZEROCOPY:
+            return "msg_zerocopy";
+
+        case TARPC_ZC_SEND_COPY:
+            return "copy";
+
+        default:
+            return "<unknown>";
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server        *pco_iut = NULL;
+    rcf_rpc_server        *pco_tst = NULL;
+    const struct sockaddr *iut_addr = NULL;
+    const struct sockaddr *tst_addr = NULL;
+
+    tarpc_sockts_zc_send_mode mode;
+    int                       size;
+    int                       window;
+    int                       duration;
+
+    tarpc_sockts_zc_send_bench_stats stats;
+
+    int      iut_s = -1;
+    int      tst_s = -1;
+    uint64_t received = 0;
+    double   cpu_pct;
+
+    TEST_START;
+    TEST_GET_PCO(pco_iut);
+    TEST_GET_PCO(pco_tst);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_ENUM_PARAM(mode, ZC_SEND_MODE_MAPPING_LIST);
+    TEST_GET_INT_PARAM(size);
+    TEST_GET_INT_PARAM(window);
+    TEST_GET_INT_PARAM(duration);
+
+    TEST_STEP("Establish TCP connection between IUT and Tester.");
+    GEN_CONNECTION(pco_tst, pco_iut, RPC_SOCK_STREAM, RPC_PROTO_DEF,
+                   tst_addr, iut_addr, &tst_s, &iut_s);
+
+    TEST_STEP("Start receiving data on Tester.");
+    pco_tst->op = RCF_RPC_CALL;
+    rpc_simple_receiver(pco_tst, tst_s, 0, &received);
+
+    TEST_STEP("Send data from IUT for @p duration seconds in @p mode with "
+              "@p size bytes per call and no more than @p window buffers "
+              "in flight.");
+    pco_iut->timeout = TE_SEC2MS(duration) + pco_iut->def_timeout;
+    rpc_sockts_zc_send_bench(pco_iut, iut_s, mode, size, window,
+                             TE_SEC2MS(duration), &stats);
+
+    TEST_STEP("Wait until Tester receives all the data.");
+    pco_tst->timeout = pco_tst->def_timeout + TE_SEC2MS(duration);
+    rpc_simple_receiver(pco_tst, tst_s, 0, &received);
+
+    TEST_STEP("Report throughput, CPU usage of the sending thread and "
+              "completion lag.");
+    if (stats.duration == 0)
+        TEST_FAIL("Sender reported zero run time");
+
+    if (stats.mode != mode)
+    {
+        RING_VERDICT("Sending in %s mode is not supported, %s mode was "
+                     "used instead", zc_send_mode2str(mode),
+                     zc_send_mode2str(stats.mode));
+    }
+
+    cpu_pct = 100.0 * (stats.cpu_user + stats.cpu_sys) / stats.duration;
+
+    TEST_ARTIFACT("mode = %s, throughput = %.3f Gbit/s, CPU = %.1f%% "
+                  "(user %.1f%%, sys %.1f%%), window waits = %llu, "
+                  "completion lag p50/p99/max = %llu/%llu/%llu ns, "
+                  "copied completions = %llu of %llu",
+                  zc_send_mode2str(stats.mode), stats.mbps / 1000.0,
+                  cpu_pct, 100.0 * stats.cpu_user / stats.duration,
+                  100.0 * stats.cpu_sys / stats.duration,
+                  (unsigned long long)stats.window_waits,
+                  (unsigned long long)stats.lag_p50,
+                  (unsigned long long)stats.lag_p99,
+                  (unsigned long long)stats.lag_max,
+                  (unsigned long long)stats.copied,
+                  (unsigned long long)stats.completions);
+
+    CHECK_RC(te_mi_log_meas("zc_send",
+        TE_MI_MEAS_V(TE_MI_MEAS(THROUGHPUT, "Send throughput", SINGLE,
+                                stats.mbps / 1000.0, GIGA),
+                     TE_MI_MEAS(CPU, "Sending thread", SINGLE,
+                                cpu_pct, PLAIN)),
+        NULL, NULL));
+
+    if (stats.completions > 0)
+    {
+        CHECK_RC(te_mi_log_meas("zc_send",
+            TE_MI_MEAS_V(TE_MI_MEAS(LATENCY, "Completion lag", MEDIAN,
+                                    stats.lag_p50, NANO),
+                         TE_MI_MEAS(LATENCY, "Completion lag", PERCENTILE,
+                                    stats.lag_p99, NANO)),
+            NULL, NULL));
+    }
+
+    if (stats.bytes == 0)
+        TEST_VERDICT("No data was sent");
+
+    if (received != stats.bytes)
+    {
+        TEST_VERDICT("Tester received %llu bytes instead of %llu",
+                     (unsigned long long)received,
+                     (unsigned long long)stats.bytes);
+    }
+
+    TEST_SUCCESS;
+
+cleanup:
+    CLEANUP_RPC_CLOSE(pco_iut, iut_s);
+    CLEANUP_RPC_CLOSE(pco_tst, tst_s);
+    TEST_END;
+}
@@ -68,10 +68,25 @@
 #include <sys/types.h>
 #endif
 
+#ifdef HAVE_LINUX_INET_DIAG_H
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#endif
+
 #ifdef HAVE_SYS_WAIT_H
 #include <sys/wait.h>
 #endif
 
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
+
 #ifdef HAVE_CTYPE_H
 #include <ctype.h>
 #endif
@@ -1556,6 +1571,51 @@ alloc_fill_zc_bufs(api_func func_alloc, api_func func_release,
     return 0;
 }
 
+/** Get CLOCK_MONOTONIC time in nanoseconds. */
+static uint64_t
+mono_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Compare two uint64_t values for qsort().
+ *
+ * @param a     First value.
+ * @param b     Second value.
+ *
+ * @return Result of comparison.
+ */
+static int
+u64_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Get a percentile from sorted values.
+ *
+ * @param val     Sorted values.
+ * @param n       Number of values.
+ * @param pct     Percentile multiplied by 10.
+ *
+ * @return Value of the percentile, @c 0 if there are no values.
+ */
+static uint64_t
+u64_sorted_pct(const uint64_t *val, unsigned int n, unsigned int pct)
+{
+    if (n == 0)
+        return 0;
+
+    return val[MIN(n - 1, (uint64_t)n * pct / 1000)];
+}
+
 #ifdef ONLOAD_SO_ONLOADZC_COMPLETE
 
 /**
@@ -1565,8 +1625,17 @@ alloc_fill_zc_bufs(api_func func_alloc, api_func func_release,
  */
 typedef struct zc_compl_buf {
     TAILQ_ENTRY(zc_compl_buf)   links;  /**< Queue links */
+    TAILQ_ENTRY(zc_compl_buf)   fd_links;   /**< Links in the queue of
+                                                 buffers sent from the
+                                                 same FD */
+    struct zc_compl_buf        *hash_next;  /**< Next buffer in the same
+                                                 bucket of the hash
+                                                 table */
     int                         fd;     /**< Socket FD from which the
                                              buffer was sent */
+    uint64_t                    sent_ns;    /**< When the buffer was added
+                                                 to a completion queue
+                                                 (CLOCK_MONOTONIC, ns) */
 
     uint8_t *ptr;                       /**< Pointer to the ZC buffer
                                              (may be not filled) */
@@ -1574,12 +1643,382 @@ typedef struct zc_compl_buf {
                                              (may be not filled) */
 } zc_compl_buf;
 
-/** Type of queue head for buffers sent with onload_zc_send() */
-typedef TAILQ_HEAD(zc_compl_bufs, zc_compl_buf) zc_compl_bufs;
+/** Type of list of zc_compl_buf structures */
+typedef TAILQ_HEAD(zc_compl_buf_list, zc_compl_buf) zc_compl_buf_list;
+
+/** Buffers of a completion queue sent from the same FD */
+typedef struct zc_compl_fd_bufs {
+    zc_compl_buf_list   bufs;   /**< Buffers linked by fd_links */
+    unsigned int        num;    /**< Number of buffers */
+} zc_compl_fd_bufs;
+
+/** Initial number of buckets in hash table of a completion queue */
+#define ZC_COMPL_HASH_MIN_SIZE 64
+
+/** Initial size of FD index of a completion queue */
+#define ZC_COMPL_FD_MIN_SIZE 64
+
+/** Number of the last completion latencies kept for statistics */
+#define ZC_COMPL_LAT_NUM 65536
+
+/**
+ * Maximum number of completion messages retrieved by a single
+ * recvmsg(MSG_ERRQUEUE) call.
+ */
+#define ZC_COMPL_BATCH 64
+
+/**
+ * Queue of buffers sent with onload_zc_send() for which completion
+ * events should arrive. Buffers are kept in the order of sending and
+ * are also indexed by completion cookie (which is the pointer to
+ * zc_compl_buf) and by FD, so that processing of a completion event
+ * or dropping buffers of a socket does not walk over the whole queue.
+ *
+ * A queue is changed by a single thread at a time, no locks are used.
+ * Counters and latencies are updated with atomic stores so that
+ * statistics can be obtained concurrently.
+ */
+typedef struct zc_compl_bufs {
+    zc_compl_buf_list   bufs;       /**< Buffers in the order of sending */
+    zc_compl_buf      **hash;       /**< Hash table of buffers */
+    unsigned int        hash_size;  /**< Number of buckets in the hash
+                                         table (power of 2) */
+    zc_compl_fd_bufs  **by_fd;      /**< Buffers indexed by FD */
+    unsigned int        by_fd_size; /**< Number of elements in by_fd */
+
+    unsigned int        num;        /**< Number of buffers in flight */
+    unsigned int        max_num;    /**< Maximum number of buffers in
+                                         flight */
+    uint64_t            completed;  /**< Number of buffers for which
+                                         completion events arrived */
+    uint64_t            dropped;    /**< Number of buffers removed without
+                                         completion event */
+    uint64_t            lat_num;    /**< Number of measured latencies */
+    uint64_t            lat_min;    /**< Minimum completion latency, ns */
+    uint64_t            lat_max;    /**< Maximum completion latency, ns */
+    uint64_t           *lat;        /**< Ring of the last
+                                         @c ZC_COMPL_LAT_NUM completion
+                                         latencies, ns */
+} zc_compl_bufs;
+
+/**
+ * Initialize a completion queue. Memory for indexes is allocated when
+ * buffers are added.
+ *
+ * @param q     Queue to initialize.
+ */
+static void
+zc_compl_bufs_init(zc_compl_bufs *q)
+{
+    memset(q, 0, sizeof(*q));
+    TAILQ_INIT(&q->bufs);
+    q->lat_min = UINT64_MAX;
+}
+
+/**
+ * Release memory allocated for a completion queue.
+ *
+ * @param q           Queue to release.
+ * @param free_bufs   If @c TRUE, free zc_compl_buf structures remaining
+ *                    in the queue.
+ */
+static void
+zc_compl_bufs_fini(zc_compl_bufs *q, te_bool free_bufs)
+{
+    zc_compl_buf *p;
+    zc_compl_buf *q_aux;
+    unsigned int i;
+
+    TAILQ_FOREACH_SAFE(p, &q->bufs, links, q_aux)
+    {
+        TAILQ_REMOVE(&q->bufs, p, links);
+        if (free_bufs)
+            free(p);
+    }
+
+    for (i = 0; i < q->by_fd_size; i++)
+        free(q->by_fd[i]);
+
+    free(q->by_fd);
+    free(q->hash);
+    free(q->lat);
+    zc_compl_bufs_init(q);
+}
+
+/**
+ * Get hash table bucket for a completion cookie.
+ *
+ * @param q         Completion queue.
+ * @param cookie    Cookie (pointer to zc_compl_buf).
+ *
+ * @return Bucket index.
+ */
+static unsigned int
+zc_compl_bufs_bucket(const zc_compl_bufs *q, const void *cookie)
+{
+    uint64_t h = (uint64_t)(uintptr_t)cookie * 0x9e3779b97f4a7c15ULL;
+
+    return (h >> 32) & (q->hash_size - 1);
+}
+
+/**
+ * Make the hash table of a completion queue big enough for one more
+ * buffer. If the table cannot be enlarged, the old one is kept.
+ *
+ * @param q     Completion queue.
+ *
+ * @return @c 0 on success, @c -1 if there is no hash table at all.
+ */
+static int
+zc_compl_bufs_hash_grow(zc_compl_bufs *q)
+{
+    zc_compl_buf  **hash;
+    zc_compl_buf  **old_hash = q->hash;
+    zc_compl_buf   *p;
+    unsigned int    size;
+    unsigned int    i;
+
+    if (q->hash != NULL && q->num < q->hash_size)
+        return 0;
+
+    size = q->hash_size == 0 ? ZC_COMPL_HASH_MIN_SIZE : q->hash_size * 2;
+    hash = calloc(size, sizeof(*hash));
+    if (hash == NULL)
+    {
+        if (q->hash != NULL)
+            return 0;
+
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate hash table of completion "
+                         "queue");
+        return -1;
+    }
+
+    q->hash = hash;
+    q->hash_size = size;
+    TAILQ_FOREACH(p, &q->bufs, links)
+    {
+        i = zc_compl_bufs_bucket(q, p);
+        p->hash_next = hash[i];
+        hash[i] = p;
+    }
+
+    free(old_hash);
+    return 0;
+}
+
+/**
+ * Get buffers of a completion queue sent from a given FD.
+ *
+ * @param q         Completion queue.
+ * @param fd        Socket FD.
+ * @param create    If @c TRUE, allocate the entry if it does not exist.
+ *
+ * @return Pointer to the entry or @c NULL.
+ */
+static zc_compl_fd_bufs *
+zc_compl_bufs_by_fd(zc_compl_bufs *q, int fd, te_bool create)
+{
+    zc_compl_fd_bufs  **by_fd;
+    unsigned int        size;
+
+    if (fd < 0)
+    {
+        if (create)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EBADF),
+                             "Negative FD of sent ZC buffer");
+        }
+        return NULL;
+    }
+
+    if ((unsigned int)fd < q->by_fd_size && q->by_fd[fd] != NULL)
+        return q->by_fd[fd];
+
+    if (!create)
+        return NULL;
+
+    if ((unsigned int)fd >= q->by_fd_size)
+    {
+        size = q->by_fd_size == 0 ? ZC_COMPL_FD_MIN_SIZE : q->by_fd_size;
+        while (size <= (unsigned int)fd)
+            size *= 2;
+
+        by_fd = realloc(q->by_fd, size * sizeof(*by_fd));
+        if (by_fd == NULL)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                             "Failed to allocate FD index of completion "
+                             "queue");
+            return NULL;
+        }
+        memset(by_fd + q->by_fd_size, 0,
+               (size - q->by_fd_size) * sizeof(*by_fd));
+        q->by_fd = by_fd;
+        q->by_fd_size = size;
+    }
+
+    q->by_fd[fd] = calloc(1, sizeof(*q->by_fd[fd]));
+    if (q->by_fd[fd] == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate FD entry of completion queue");
+        return NULL;
+    }
+    TAILQ_INIT(&q->by_fd[fd]->bufs);
+
+    return q->by_fd[fd];
+}
+
+/**
+ * Get number of buffers in a completion queue sent from a given FD.
+ *
+ * @param q     Completion queue.
+ * @param fd    Socket FD.
+ *
+ * @return Number of buffers.
+ */
+static unsigned int
+zc_compl_bufs_fd_num(zc_compl_bufs *q, int fd)
+{
+    zc_compl_fd_bufs *fd_bufs = zc_compl_bufs_by_fd(q, fd, FALSE);
+
+    return fd_bufs == NULL ? 0 : fd_bufs->num;
+}
+
+/**
+ * Add a sent buffer to the end of a completion queue.
+ *
+ * @note Errors are reported with te_rpc_error_set().
+ *
+ * @param q       Completion queue.
+ * @param buf     Buffer with filled @b fd.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_compl_bufs_add(zc_compl_bufs *q, zc_compl_buf *buf)
+{
+    zc_compl_fd_bufs *fd_bufs;
+    unsigned int i;
+
+    fd_bufs = zc_compl_bufs_by_fd(q, buf->fd, TRUE);
+    if (fd_bufs == NULL || zc_compl_bufs_hash_grow(q) < 0)
+        return -1;
+
+    i = zc_compl_bufs_bucket(q, buf);
+    buf->hash_next = q->hash[i];
+    q->hash[i] = buf;
+
+    TAILQ_INSERT_TAIL(&q->bufs, buf, links);
+    TAILQ_INSERT_TAIL(&fd_bufs->bufs, buf, fd_links);
+    fd_bufs->num++;
+
+    buf->sent_ns = mono_time_ns();
+    __atomic_store_n(&q->num, q->num + 1, __ATOMIC_RELAXED);
+    if (q->num > q->max_num)
+        __atomic_store_n(&q->max_num, q->num, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * Find a buffer in a completion queue by completion cookie.
+ *
+ * @param q         Completion queue.
+ * @param cookie    Cookie from completion message.
+ *
+ * @return Pointer to the buffer or @c NULL if it is not in the queue.
+ */
+static zc_compl_buf *
+zc_compl_bufs_find(zc_compl_bufs *q, const void *cookie)
+{
+    zc_compl_buf *p;
+
+    if (q->hash_size == 0)
+        return NULL;
+
+    for (p = q->hash[zc_compl_bufs_bucket(q, cookie)]; p != NULL;
+         p = p->hash_next)
+    {
+        if (p == cookie)
+            return p;
+    }
+
+    return NULL;
+}
+
+/**
+ * Account completion latency of a buffer.
+ *
+ * @param q       Completion queue.
+ * @param buf     Completed buffer.
+ */
+static void
+zc_compl_bufs_add_lat(zc_compl_bufs *q, const zc_compl_buf *buf)
+{
+    uint64_t lat = mono_time_ns() - buf->sent_ns;
+
+    if (q->lat == NULL)
+    {
+        q->lat = calloc(ZC_COMPL_LAT_NUM, sizeof(*q->lat));
+        if (q->lat == NULL)
+        {
+            ERROR("%s(): failed to allocate memory for completion "
+                  "latencies", __FUNCTION__);
+            return;
+        }
+    }
+
+    __atomic_store_n(&q->lat[q->lat_num % ZC_COMPL_LAT_NUM], lat,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&q->lat_num, q->lat_num + 1, __ATOMIC_RELEASE);
+    if (lat < q->lat_min)
+        __atomic_store_n(&q->lat_min, lat, __ATOMIC_RELAXED);
+    if (lat > q->lat_max)
+        __atomic_store_n(&q->lat_max, lat, __ATOMIC_RELAXED);
+}
+
+/**
+ * Remove a buffer from a completion queue.
+ *
+ * @param q           Completion queue.
+ * @param buf         Buffer to remove.
+ * @param completed   @c TRUE if completion event arrived for the buffer,
+ *                    @c FALSE if it is dropped without it.
+ */
+static void
+zc_compl_bufs_remove(zc_compl_bufs *q, zc_compl_buf *buf,
+                     te_bool completed)
+{
+    zc_compl_fd_bufs *fd_bufs = q->by_fd[buf->fd];
+    zc_compl_buf **pp;
+
+    for (pp = &q->hash[zc_compl_bufs_bucket(q, buf)]; *pp != buf;
+         pp = &(*pp)->hash_next);
+    *pp = buf->hash_next;
+
+    TAILQ_REMOVE(&q->bufs, buf, links);
+    TAILQ_REMOVE(&fd_bufs->bufs, buf, fd_links);
+    fd_bufs->num--;
+    __atomic_store_n(&q->num, q->num - 1, __ATOMIC_RELAXED);
+
+    if (completed)
+    {
+        __atomic_store_n(&q->completed, q->completed + 1,
+                         __ATOMIC_RELAXED);
+        zc_compl_bufs_add_lat(q, buf);
+    }
+    else
+    {
+        __atomic_store_n(&q->dropped, q->dropped + 1, __ATOMIC_RELAXED);
+    }
+}
 
 /**
  * Remove from queue of zc_compl_buf structures all the elements
- * with a given FD.
+ * with a given FD. They are accounted as dropped without completion
+ * event.
  *
  * @param compl_bufs        Queue to process.
  * @param fd                FD to look for.
@@ -1592,22 +2031,100 @@ static unsigned int
 remove_compl_bufs_by_fd(zc_compl_bufs *compl_bufs, int fd,
                         te_bool free_compl_bufs)
 {
+    zc_compl_fd_bufs *fd_bufs;
     zc_compl_buf *p;
     zc_compl_buf *q;
     unsigned int count = 0;
 
-    TAILQ_FOREACH_SAFE(p, compl_bufs, links, q)
+    fd_bufs = zc_compl_bufs_by_fd(compl_bufs, fd, FALSE);
+    if (fd_bufs == NULL)
+        return 0;
+
+    TAILQ_FOREACH_SAFE(p, &fd_bufs->bufs, fd_links, q)
+    {
+        zc_compl_bufs_remove(compl_bufs, p, FALSE);
+        if (free_compl_bufs)
+            free(p);
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Process completion messages retrieved by a single
+ * recvmsg(MSG_ERRQUEUE) call.
+ *
+ * @note Errors are reported with te_rpc_error_set().
+ *
+ * @param sent_bufs         Queue of sent buffers.
+ * @param msg               Message with control data.
+ * @param fd                FD on which the message was received.
+ * @param free_compl_bufs   If @c TRUE, free a zc_compl_buf structure after
+ *                          removing it from the queue.
+ * @param completed_num     Will be incremented by number of completed
+ *                          buffers.
+ *
+ * @return @c 0 on success, @c -1 if some completion message was not
+ *         expected.
+ */
+static int
+proc_zc_compl_msg(zc_compl_bufs *sent_bufs, struct msghdr *msg, int fd,
+                  te_bool free_compl_bufs, unsigned int *completed_num)
+{
+    struct cmsghdr   *cmsg;
+    zc_compl_buf     *compl_buf;
+    void             *cookie;
+    int               rc = 0;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(msg, cmsg))
     {
-        if (p->fd == fd)
+        if (cmsg->cmsg_level == SOL_IP &&
+            cmsg->cmsg_type == ONLOAD_SO_ONLOADZC_COMPLETE)
+        {
+            memcpy(&cookie, CMSG_DATA(cmsg), sizeof(cookie));
+
+            compl_buf = zc_compl_bufs_find(sent_bufs, cookie);
+            if (compl_buf != NULL)
+            {
+                if (compl_buf->fd != fd)
+                {
+                    te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                                     "Completion event for buffer "
+                                     "sent via another FD was "
+                                     "received");
+                    rc = -1;
+                }
+                zc_compl_bufs_remove(sent_bufs, compl_buf, TRUE);
+                if (free_compl_bufs)
+                    free(compl_buf);
+                (*completed_num)++;
+            }
+            else
+            {
+                te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                                 "Completion event for unknown "
+                                 "buffer was received");
+                rc = -1;
+            }
+        }
+        else
         {
-            TAILQ_REMOVE(compl_bufs, p, links);
-            if (free_compl_bufs)
-                free(p);
-            count++;
+            WARN("%s(): ignored control message with level=%d (%s) "
+                 "type=%d (%s) when processing completion events",
+                 __FUNCTION__,
+                 cmsg->cmsg_level,
+                 socklevel_rpc2str(
+                        socklevel_h2rpc(cmsg->cmsg_level)),
+                 cmsg->cmsg_type,
+                 sockopt_rpc2str(
+                      sockopt_h2rpc(cmsg->cmsg_level,
+                                    cmsg->cmsg_type)));
         }
     }
 
-    return count;
+    return rc;
 }
 
 /**
@@ -1634,8 +2151,11 @@ wait_for_zc_completion(zc_compl_bufs *sent_bufs,
     api_func          func_recvmsg = NULL;
     api_func          func_getsockopt = NULL;
     struct msghdr     msgc;
-    uint8_t           control_data[500];
-    struct cmsghdr   *cmsg;
+    union {
+        struct cmsghdr  align;
+        uint8_t         buf[ZC_COMPL_BATCH *
+                            CMSG_SPACE(sizeof(void *))];
+    }                 control_data;
     zc_compl_buf     *sent_buf = NULL;
     struct pollfd     pfd;
     te_bool           failed = FALSE;
@@ -1649,11 +2169,11 @@ wait_for_zc_completion(zc_compl_bufs *sent_bufs,
     TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "getsockopt", &func_getsockopt);
 
     memset(&msgc, 0, sizeof(msgc));
-    msgc.msg_control = control_data;
-    while (!TAILQ_EMPTY(sent_bufs))
+    msgc.msg_control = control_data.buf;
+    while (!TAILQ_EMPTY(&sent_bufs->bufs))
     {
-        sent_buf = TAILQ_FIRST(sent_bufs);
-        msgc.msg_controllen = sizeof(control_data);
+        sent_buf = TAILQ_FIRST(&sent_bufs->bufs);
+        msgc.msg_controllen = sizeof(control_data.buf);
 
         pfd.fd = sent_buf->fd;
         pfd.events = pfd.revents = 0;
@@ -1746,75 +2266,36 @@ wait_for_zc_completion(zc_compl_bufs *sent_bufs,
         if (rc >= 0)
         {
             rc = 0;
-            cmsg = CMSG_FIRSTHDR(&msgc);
-            if (cmsg == NULL)
-            {
-                te_rpc_error_set(
-                     TE_OS_RC(TE_TA_UNIX, errno),
-                     "recvmsg() returned success but no control message "
-                     "can be retrieved");
-                rc = -1;
-                goto finish;
-            }
 
-            for ( ; cmsg != NULL; cmsg = CMSG_NXTHDR(&msgc, cmsg))
-            {
-                if (cmsg->cmsg_level == SOL_IP &&
-                    cmsg->cmsg_type == ONLOAD_SO_ONLOADZC_COMPLETE)
+            /*
+             * Reap all the completion messages queued on the socket
+             * before polling again. Reading of error queue never blocks,
+             * so the loop ends when recvmsg() fails with EAGAIN or no
+             * buffers remain in flight for the socket.
+             */
+            do {
+                if (CMSG_FIRSTHDR(&msgc) == NULL)
                 {
-                    zc_compl_buf *compl_buf;
-                    zc_compl_buf *buf_aux;
-                    te_bool       found;
+                    te_rpc_error_set(
+                         TE_OS_RC(TE_TA_UNIX, errno),
+                         "recvmsg() returned success but no control "
+                         "message can be retrieved");
+                    rc = -1;
+                    goto finish;
+                }
 
-                    found = FALSE;
-                    memcpy(&compl_buf, CMSG_DATA(cmsg), sizeof(compl_buf));
+                if (proc_zc_compl_msg(sent_bufs, &msgc, pfd.fd,
+                                      free_compl_bufs,
+                                      &completed_num) < 0)
+                    failed = TRUE;
 
-                    TAILQ_FOREACH(buf_aux, sent_bufs, links)
-                    {
-                        if (buf_aux == compl_buf)
-                        {
-                            found = TRUE;
-                            break;
-                        }
-                    }
+                if (zc_compl_bufs_fd_num(sent_bufs, pfd.fd) == 0)
+                    break;
 
-                    if (found)
-                    {
-                        if (compl_buf->fd != sent_buf->fd)
-                        {
-                            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
-                                             "Completion event for buffer "
-                                             "sent via another FD was "
-                                             "received");
-                            failed = TRUE;
-                        }
-                        TAILQ_REMOVE(sent_bufs, compl_buf, links);
-                        if (free_compl_bufs)
-                            free(compl_buf);
-                        completed_num++;
-                    }
-                    else
-                    {
-                        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
-                                         "Completion event for unknown "
-                                         "buffer was received");
-                        failed = TRUE;
-                    }
-                }
-                else
-                {
-                    WARN("%s(): ignored control message with level=%d (%s) "
-                         "type=%d (%s) when processing completion events",
-                         __FUNCTION__,
-                         cmsg->cmsg_level,
-                         socklevel_rpc2str(
-                                socklevel_h2rpc(cmsg->cmsg_level)),
-                         cmsg->cmsg_type,
-                         sockopt_rpc2str(
-                              sockopt_h2rpc(cmsg->cmsg_level,
-                                            cmsg->cmsg_type)));
-                }
-            }
+                msgc.msg_controllen = sizeof(control_data.buf);
+            } while (func_recvmsg(pfd.fd, &msgc, MSG_ERRQUEUE) >= 0);
+
+            errno = saved_errno;
         }
         else
         {
@@ -2152,7 +2633,9 @@ onload_zc_send_msg_more_rbufs(tarpc_onload_zc_send_msg_more_in *in)
     int                     rc2 = 0;
 
     zc_compl_buf            compl_bufs[2];
-    zc_compl_bufs           sent_bufs = TAILQ_HEAD_INITIALIZER(sent_bufs);
+    zc_compl_bufs           sent_bufs;
+
+    zc_compl_bufs_init(&sent_bufs);
 
     buf = rcf_pch_mem_get(in->buf);
     if (buf == NULL)
@@ -2208,8 +2691,11 @@ onload_zc_send_msg_more_rbufs(tarpc_onload_zc_send_msg_more_in *in)
         goto cleanup;
 
     rc1 = rc;
-    if (in->first_zc)
-        TAILQ_INSERT_TAIL(&sent_bufs, &compl_bufs[0], links);
+    if (in->first_zc && zc_compl_bufs_add(&sent_bufs, &compl_bufs[0]) < 0)
+    {
+        rc = -1;
+        goto cleanup;
+    }
 
     if (in->set_nodelay)
     {
@@ -2229,17 +2715,18 @@ onload_zc_send_msg_more_rbufs(tarpc_onload_zc_send_msg_more_in *in)
         goto cleanup;
 
     rc2 = rc;
-    if (in->second_zc)
-        TAILQ_INSERT_TAIL(&sent_bufs, &compl_bufs[1], links);
+    if (in->second_zc && zc_compl_bufs_add(&sent_bufs, &compl_bufs[1]) < 0)
+        rc = -1;
 
 cleanup:
 
-    if (!TAILQ_EMPTY(&sent_bufs))
+    if (!TAILQ_EMPTY(&sent_bufs.bufs))
     {
         rc_aux = wait_for_zc_completion(&sent_bufs, FALSE, TRUE, -1);
         if (rc_aux < 0)
             rc = -1;
     }
+    zc_compl_bufs_fini(&sent_bufs, FALSE);
 
     rc_aux = unreg_unmap_zc_rbufs(func_unreg_bufs, in->fd, mem_handle,
                                   mem, mem_size);
@@ -2521,7 +3008,7 @@ sockts_alloc_zc_compl_queue(void)
         return NULL;
     }
 
-    TAILQ_INIT(bufs);
+    zc_compl_bufs_init(bufs);
 
     return bufs;
 }
@@ -2550,15 +3037,7 @@ TARPC_FUNC_STATIC(sockts_alloc_zc_compl_queue, {},
 static void
 sockts_free_zc_compl_queue(zc_compl_bufs *bufs)
 {
-    zc_compl_buf *p;
-    zc_compl_buf *q;
-
-    TAILQ_FOREACH_SAFE(p, bufs, links, q)
-    {
-        TAILQ_REMOVE(bufs, p, links);
-        free(p);
-    }
-
+    zc_compl_bufs_fini(bufs, TRUE);
     free(bufs);
 }
 
@@ -2614,7 +3093,7 @@ sockts_proc_zc_compl_queue(zc_compl_bufs *bufs, int timeout)
     if (rc < 0)
         return -1;
 
-    if (!TAILQ_EMPTY(bufs))
+    if (!TAILQ_EMPTY(&bufs->bufs))
         return 1;
 
     return 0;
@@ -2637,6 +3116,92 @@ TARPC_FUNC_STATIC(sockts_proc_zc_compl_queue, {},
     }
 })
 
+/**
+ * Get statistics of a queue of sent ZC buffers. It may be called while
+ * the queue is used by another thread; latency percentiles are then
+ * computed over a snapshot of the last completions.
+ *
+ * @param bufs      Head of the queue.
+ * @param reset     If @c TRUE, reset counters and latencies after
+ *                  getting them (the queue should not be used
+ *                  concurrently then).
+ * @param stats     Where to save statistics.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+sockts_zc_compl_queue_stats(zc_compl_bufs *bufs, te_bool reset,
+                            tarpc_sockts_zc_compl_stats *stats)
+{
+    uint64_t     *lat = NULL;
+    uint64_t      lat_num;
+    unsigned int  n = 0;
+    unsigned int  i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    lat_num = __atomic_load_n(&bufs->lat_num, __ATOMIC_ACQUIRE);
+    if (lat_num > 0 && bufs->lat != NULL)
+    {
+        n = MIN(lat_num, ZC_COMPL_LAT_NUM);
+        lat = TE_ALLOC(n * sizeof(*lat));
+        if (lat == NULL)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                             "Failed to allocate memory for latencies");
+            return -1;
+        }
+
+        for (i = 0; i < n; i++)
+            lat[i] = __atomic_load_n(&bufs->lat[i], __ATOMIC_RELAXED);
+        qsort(lat, n, sizeof(*lat), u64_cmp);
+
+        stats->lat_min = __atomic_load_n(&bufs->lat_min, __ATOMIC_RELAXED);
+        stats->lat_max = __atomic_load_n(&bufs->lat_max, __ATOMIC_RELAXED);
+    }
+
+    stats->in_flight = __atomic_load_n(&bufs->num, __ATOMIC_RELAXED);
+    stats->max_in_flight = __atomic_load_n(&bufs->max_num,
+                                           __ATOMIC_RELAXED);
+    stats->completed = __atomic_load_n(&bufs->completed, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&bufs->dropped, __ATOMIC_RELAXED);
+    stats->lat_num = n;
+    stats->lat_p50 = u64_sorted_pct(lat, n, 500);
+    stats->lat_p90 = u64_sorted_pct(lat, n, 900);
+    stats->lat_p99 = u64_sorted_pct(lat, n, 990);
+    stats->lat_p999 = u64_sorted_pct(lat, n, 999);
+    free(lat);
+
+    if (reset)
+    {
+        bufs->max_num = bufs->num;
+        bufs->completed = 0;
+        bufs->dropped = 0;
+        bufs->lat_num = 0;
+        bufs->lat_min = UINT64_MAX;
+        bufs->lat_max = 0;
+    }
+
+    return 0;
+}
+
+TARPC_FUNC_STATIC(sockts_zc_compl_queue_stats, {},
+{
+    zc_compl_bufs *bufs;
+
+    bufs = rcf_pch_mem_get(in->qhead);
+    if (bufs == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOENT),
+                         "Failed to resolve queue head pointer");
+        out->retval = -1;
+    }
+    else
+    {
+        MAKE_CALL(out->retval = func(bufs, in->reset, &out->stats));
+    }
+})
+
 #endif /* ifdef ONLOAD_SO_ONLOADZC_COMPLETE */
 
 /**
@@ -2661,7 +3226,7 @@ typedef struct zc_mmsg_data {
                                                   allocation
                                                   specifications */
 #ifdef ONLOAD_SO_ONLOADZC_COMPLETE
-    zc_compl_bufs                compl_bufs;   /**< Queue of zc_compl_buf
+    zc_compl_buf_list            compl_bufs;   /**< Queue of zc_compl_buf
                                                     structures used when
                                                     waiting for completion
                                                     messages */
@@ -3033,8 +3598,10 @@ cleanup:
  *                        structures.
  * @param bufs_counter    If not @c NULL, will be incremented by
  *                        number of structures appended to the queue.
+ *
+ * @return @c 0 on success, @c -1 on failure.
  */
-static void
+static int
 zc_mmsg_data_get_sent_rbufs(zc_mmsg_data *mmsg_data,
                             zc_compl_bufs *reg_bufs_queue,
                             unsigned int *bufs_counter)
@@ -3046,11 +3613,11 @@ zc_mmsg_data_get_sent_rbufs(zc_mmsg_data *mmsg_data,
     zc_compl_buf *compl_buf = NULL;
 
     if (mmsg_data->mmsg->rc <= 0)
-        return;
+        return 0;
 
     iovs = mmsg_data->mmsg->msg.iov;
     if (iovs == NULL)
-        return;
+        return 0;
 
     buf_specs = mmsg_data->buf_specs;
 
@@ -3066,7 +3633,11 @@ zc_mmsg_data_get_sent_rbufs(zc_mmsg_data *mmsg_data,
                 {
                     compl_buf = (zc_compl_buf *)(iovs[i].app_cookie);
                     TAILQ_REMOVE(&mmsg_data->compl_bufs, compl_buf, links);
-                    TAILQ_INSERT_TAIL(reg_bufs_queue, compl_buf, links);
+                    if (zc_compl_bufs_add(reg_bufs_queue, compl_buf) < 0)
+                    {
+                        free(compl_buf);
+                        return -1;
+                    }
                     if (bufs_counter != NULL)
                         (*bufs_counter)++;
                 }
@@ -3078,6 +3649,8 @@ zc_mmsg_data_get_sent_rbufs(zc_mmsg_data *mmsg_data,
             iov_len_sum += mmsg_data->mmsg->msg.iov[i].iov_len;
         }
     }
+
+    return 0;
 }
 
 /**
@@ -3103,18 +3676,28 @@ zc_mmsg_data_proc_completions(zc_mmsg_data *mmsgs, unsigned int mlen,
 {
     unsigned int i;
     unsigned int sent_bufs_cnt = 0;
-    zc_compl_bufs local_queue = TAILQ_HEAD_INITIALIZER(local_queue);
+    zc_compl_bufs local_queue;
     zc_compl_bufs *queue_ptr = NULL;
+    int rc = 0;
 
     if (compl_queue != NULL)
+    {
         queue_ptr = compl_queue;
+    }
     else
+    {
+        zc_compl_bufs_init(&local_queue);
         queue_ptr = &local_queue;
+    }
 
     for (i = 0; i < mlen; i++)
     {
-        zc_mmsg_data_get_sent_rbufs(&mmsgs[i], queue_ptr,
-                                    &sent_bufs_cnt);
+        if (zc_mmsg_data_get_sent_rbufs(&mmsgs[i], queue_ptr,
+                                        &sent_bufs_cnt) < 0)
+        {
+            rc = -1;
+            break;
+        }
     }
 
     if (sent_bufs_cnt > 0)
@@ -3122,11 +3705,15 @@ zc_mmsg_data_proc_completions(zc_mmsg_data *mmsgs, unsigned int mlen,
         RING("%s(): %u buffers were sent, completion queue %p",
              __FUNCTION__, sent_bufs_cnt, queue_ptr);
 
-        if (compl_queue == NULL)
-            return wait_for_zc_completion(queue_ptr, TRUE, TRUE, -1);
+        if (compl_queue == NULL &&
+            wait_for_zc_completion(queue_ptr, TRUE, TRUE, -1) < 0)
+            rc = -1;
     }
 
-    return 0;
+    if (compl_queue == NULL)
+        zc_compl_bufs_fini(&local_queue, TRUE);
+
+    return rc;
 }
 
 #endif /* ONLOAD_SO_ONLOADZC_COMPLETE */
@@ -5897,6 +6484,101 @@ duration_is_expired(int duration, struct timeval *tv_start)
     return FALSE;
 }
 
+/**
+ * Maximum number of throughput samples collected by a single RPC call,
+ * bytes received after the last sample are not accounted.
+ */
+#define TPUT_SAMPLES_MAX (1024 * 1024)
+
+/** Throughput time series: bytes received in each time bucket. */
+typedef struct tput_samples {
+    uint64_t      bucket;   /**< Bucket length in nanoseconds,
+                                 @c 0 if sampling is disabled */
+    uint64_t      start;    /**< Start time in nanoseconds */
+    uint64_t     *val;      /**< Bytes in each bucket */
+    unsigned int  len;      /**< Number of used buckets */
+    unsigned int  size;     /**< Number of allocated buckets */
+} tput_samples;
+
+/**
+ * Start collecting throughput samples.
+ *
+ * @param s           Samples to initialize.
+ * @param bucket_us   Bucket length in microseconds, @c 0 to disable
+ *                    sampling.
+ */
+static void
+tput_samples_start(tput_samples *s, uint64_t bucket_us)
+{
+    memset(s, 0, sizeof(*s));
+    s->bucket = bucket_us * 1000;
+    if (s->bucket != 0)
+        s->start = mono_time_ns();
+}
+
+/**
+ * Account received bytes in the current time bucket.
+ *
+ * @param s       Samples.
+ * @param bytes   Number of received bytes.
+ */
+static void
+tput_samples_add(tput_samples *s, size_t bytes)
+{
+    uint64_t      idx;
+    unsigned int  size;
+    uint64_t     *val;
+
+    if (s->bucket == 0)
+        return;
+
+    idx = (mono_time_ns() - s->start) / s->bucket;
+    if (idx >= TPUT_SAMPLES_MAX)
+        return;
+
+    if (idx >= s->size)
+    {
+        size = s->size == 0 ? 64 : s->size;
+        while (size <= idx)
+            size *= 2;
+
+        val = realloc(s->val, size * sizeof(*val));
+        if (val == NULL)
+        {
+            ERROR("%s(): failed to allocate %u samples", __FUNCTION__, size);
+            return;
+        }
+        memset(val + s->size, 0, (size - s->size) * sizeof(*val));
+        s->val = val;
+        s->size = size;
+    }
+
+    s->val[idx] += bytes;
+    if (idx >= s->len)
+        s->len = idx + 1;
+}
+
+/**
+ * Move collected samples to an RPC output array.
+ *
+ * @param s       Samples (released).
+ * @param val     Where to save the array.
+ * @param len     Where to save the array length.
+ */
+static void
+tput_samples_move(tput_samples *s, uint64_t **val, u_int *len)
+{
+    if (s->len == 0)
+    {
+        free(s->val);
+        s->val = NULL;
+    }
+
+    *val = s->val;
+    *len = s->len;
+    memset(s, 0, sizeof(*s));
+}
+
 /**
  * Receive packets with function @b recv() until @p num packets are received
  * or packet, which is equal to @p last_packet, is received.
@@ -5910,13 +6592,15 @@ duration_is_expired(int duration, struct timeval *tv_start)
  * @param last_packet_len Last packet length
  * @param count_fails     Don't stop on fail
  * @param fails           Fails number (OUT)
+ * @param samples         Where to account received bytes over time
+ *                        or @c NULL
  * 
  * @return Received packets number or @c -1 in case of failure
  */
 int
 many_recv(tarpc_lib_flags lib_flags, int sock, int num, int duration,
           size_t length, uint8_t *last_packet, size_t last_packet_len,
-          te_bool count_fails, int *fails)
+          te_bool count_fails, int *fails, tput_samples *samples)
 {
     struct timeval tv_start;
     api_func func = NULL;
@@ -5943,6 +6627,9 @@ many_recv(tarpc_lib_flags lib_flags, int sock, int num, int duration,
             break;
 
         res = func(sock, buf, length, 0);
+        if (res > 0 && samples != NULL)
+            tput_samples_add(samples, res);
+
         if (last_packet != NULL && res == (int)last_packet_len &&
             memcmp(last_packet, buf, last_packet_len) == 0)
         {
@@ -5977,11 +6664,17 @@ many_recv(tarpc_lib_flags lib_flags, int sock, int num, int duration,
 
 TARPC_FUNC(many_recv, {}, 
 {
+     tput_samples samples;
+
+     tput_samples_start(&samples, in->bucket_us);
      MAKE_CALL(out->retval = many_recv(in->common.lib_flags, in->sock,
                                        in->num, in->duration, in->length,
                                        in->last_packet.last_packet_val,
                                        in->last_packet.last_packet_len,
-                                       in->count_fails, &out->fails_num));
+                                       in->count_fails, &out->fails_num,
+                                       &samples));
+     tput_samples_move(&samples, &out->samples.samples_val,
+                       &out->samples.samples_len);
 }
 )
 
@@ -5996,6 +6689,8 @@ TARPC_FUNC(many_recv, {},
  *                    receive data from @p fd and measure duration.
  * @param length      How many bytes should be received.
  * @param duration    Where to save measured duration, in microseconds.
+ * @param samples     Where to account received bytes over time
+ *                    or @c NULL.
  * @param te_err      Where to save TE error (not related to checked
  *                    recv() call).
  *
@@ -6004,7 +6699,7 @@ TARPC_FUNC(many_recv, {},
  */
 ssize_t
 recv_timing(tarpc_lib_flags lib_flags, int fd, int fd_aux, size_t length,
-            uint64_t *duration, te_errno *te_err)
+            uint64_t *duration, tput_samples *samples, te_errno *te_err)
 {
     struct timeval tv_start;
     struct timeval tv_end;
@@ -6053,6 +6748,9 @@ recv_timing(tarpc_lib_flags lib_flags, int fd, int fd_aux, size_t length,
         return -1;
     }
 
+    if (samples != NULL)
+        tput_samples_start(samples, samples->bucket / 1000);
+
     while (TRUE)
     {
         received = recv_func(fd, buf, length, 0);
@@ -6064,6 +6762,9 @@ recv_timing(tarpc_lib_flags lib_flags, int fd, int fd_aux, size_t length,
             return -1;
         }
 
+        if (samples != NULL)
+            tput_samples_add(samples, received);
+
         total_read += received;
         if (total_read >= length)
             break;
@@ -6086,11 +6787,16 @@ recv_timing(tarpc_lib_flags lib_flags, int fd, int fd_aux, size_t length,
 
 TARPC_FUNC(recv_timing, {},
 {
-    te_errno te_err = 0;
+    te_errno     te_err = 0;
+    tput_samples samples;
 
+    tput_samples_start(&samples, in->bucket_us);
     MAKE_CALL(out->retval = recv_timing(in->common.lib_flags, in->fd,
                                         in->fd_aux, in->length,
-                                        &out->duration, &te_err));
+                                        &out->duration, &samples,
+                                        &te_err));
+    tput_samples_move(&samples, &out->samples.samples_val,
+                      &out->samples.samples_len);
 
     if (te_err != 0)
         out->common._errno = te_err;
@@ -6247,6 +6953,8 @@ traffic_processor(tarpc_lib_flags lib_flags, int s, te_bool snd,
 {
     te_errno rc;
     uint64_t bytes = 0;
+    uint64_t bytes_word;
+    uint32_t bytes_net[2];
     uint8_t *buf;
     int      err;
     int      val = 1;
@@ -6292,8 +7000,14 @@ traffic_processor(tarpc_lib_flags lib_flags, int s, te_bool snd,
             break;
         }
         bytes += len;
-        *(uint32_t *)bytes_p = htonl(bytes >> 32);
-        *((uint32_t *)bytes_p + 1) = htonl(bytes & 0xFFFFFFFF);
+        /*
+         * Publish both halves with a single store, so that a reader
+         * never sees a torn counter.
+         */
+        bytes_net[0] = htonl(bytes >> 32);
+        bytes_net[1] = htonl(bytes & 0xFFFFFFFF);
+        memcpy(&bytes_word, bytes_net, sizeof(bytes_word));
+        __atomic_store_n((uint64_t *)bytes_p, bytes_word, __ATOMIC_RELAXED);
     }
     
 cleanup:    
@@ -6624,22 +7338,126 @@ TARPC_FUNC(incorrect_crc_send_test, {},
 #endif /* Incorrect CRC test */
 
 /*-------------- many_send() -----------------------------*/
+
+/** Maximum number of messages passed to a single send call. */
+#define MANY_SEND_MAX_BATCH 1024
+
+/** Maximum size of the payload pool. */
+#define MANY_SEND_MAX_POOL (64 * 1024 * 1024)
+
+/**
+ * Allocate payload pool for many_send() and fill it with data.
+ * The first @p max_len bytes are repeated after the pool end, so
+ * that a message starting at any pool position is contiguous and
+ * sent data repeats with period @p size.
+ *
+ * @param in        RPC input.
+ * @param size      Pool size.
+ * @param max_len   Maximum message length (not greater than @p size).
+ * @param mem       Where to save allocated memory (to be released).
+ * @param pool      Where to save pointer to the pool data.
+ *
+ * @return Status code.
+ */
+static te_errno
+many_send_pool_fill(tarpc_many_send_in *in, size_t size, size_t max_len,
+                    uint8_t **mem, uint8_t **pool)
+{
+    const char        *gen_func = in->gen_func;
+    tarpc_pat_gen_arg  gen_arg = in->gen_arg;
+    api_func_ptr       fill_buf = NULL;
+    size_t             offset = 0;
+    te_errno           rc;
+
+    if (gen_func == NULL || *gen_func == '\0')
+    {
+        *mem = *pool = malloc(size + max_len);
+        if (*mem == NULL)
+            return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+
+        te_fill_buf(*pool, size);
+        memcpy(*pool + size, *pool, max_len);
+        return 0;
+    }
+
+    rc = tarpc_find_func(TARPC_LIB_DEFAULT, gen_func,
+                         (api_func *)&fill_buf);
+    if (rc != 0)
+    {
+        ERROR("%s(): failed to resolve %s()", __FUNCTION__, gen_func);
+        return rc;
+    }
+
+    /* LCG generator fills from an aligned position, data starts later. */
+    if (strcmp(gen_func, "tarpc_fill_buff_with_sequence_lcg") == 0)
+        offset = gen_arg.offset;
+
+    *mem = malloc(TARPC_LCG_LEN(size) + max_len);
+    if (*mem == NULL)
+        return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+
+    rc = fill_buf(*mem, size, &gen_arg);
+    if (rc != 0)
+    {
+        ERROR("%s(): %s() failed: %r", __FUNCTION__, gen_func, rc);
+        free(*mem);
+        *mem = NULL;
+        return rc;
+    }
+
+    *pool = *mem + offset;
+    memcpy(*pool + size, *pool, max_len);
+    return 0;
+}
+
+/**
+ * Send a vector of messages from a payload pool, one message per
+ * @b send() call or a batch of messages per @b sendmsg() (messages are
+ * coalesced in a single one) or @b sendmmsg() call. Payload is the
+ * pattern requested by caller, it repeats every @a pool_size bytes.
+ *
+ * @param in      RPC input.
+ * @param out     RPC output.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
 int
 many_send(tarpc_many_send_in *in, tarpc_many_send_out *out)
 {
     ssize_t        rc = 0;
     unsigned int   i;
-    api_func  send_func;
+    unsigned int   j;
+    unsigned int   n;
+    api_func       send_func;
+    const char    *func_name = in->func_name;
+    unsigned int   batch = in->batch;
     size_t         max_len = 0;
-    uint8_t       *buf = NULL;
+    size_t         pool_size = in->pool_size;
+    size_t         len;
+    uint8_t       *mem = NULL;
+    uint8_t       *pool = NULL;
+    struct iovec  *iov = NULL;
+    struct msghdr  msg;
+#ifdef HAVE_STRUCT_MMSGHDR
+    struct mmsghdr *mmsgs = NULL;
+#endif
+    struct timespec ts_start;
+    struct timespec ts_end;
     int            flags;
 
     out->bytes = 0;
+    out->calls = 0;
+    out->duration = 0;
 
-    if (in->vector.vector_len == 0)
+    if (func_name == NULL || *func_name == '\0')
+        func_name = "send";
+    if (batch == 0 || strcmp(func_name, "send") == 0)
+        batch = 1;
+
+    if (in->vector.vector_len == 0 || batch > MANY_SEND_MAX_BATCH)
     {
-        ERROR("%s(): Invalid number of send() operations to be executed",
-              __FUNCTION__);
+        ERROR("%s(): Invalid number of send() operations to be executed "
+              "or batch size", __FUNCTION__);
         out->common._errno = TE_RC(TE_TA_UNIX, TE_EINVAL);
         rc = -1;
         goto many_send_exit;
@@ -6659,46 +7477,134 @@ many_send(tarpc_many_send_in *in, tarpc_many_send_out *out)
         max_len = MAX(max_len, in->vector.vector_val[i]);
     }
 
-    buf = calloc(1, max_len);
-    if (buf == NULL)
+    if (pool_size == 0)
+        pool_size = max_len;
+    pool_size = MIN(pool_size, MANY_SEND_MAX_POOL);
+    if (pool_size < max_len)
     {
-        ERROR("%s(): Out of memory", __FUNCTION__);
-        out->common._errno = TE_RC(TE_TA_UNIX, TE_ENOMEM);
+        ERROR("%s(): payload pool size %u is less than the longest "
+              "message length %u", __FUNCTION__, (unsigned int)pool_size,
+              (unsigned int)max_len);
+        out->common._errno = TE_RC(TE_TA_UNIX, TE_EINVAL);
+        rc = -1;
+        goto many_send_exit;
+    }
+
+    if (strcmp(func_name, "send") != 0 && strcmp(func_name, "sendmsg") != 0
+#ifdef HAVE_STRUCT_MMSGHDR
+        && strcmp(func_name, "sendmmsg") != 0
+#endif
+       )
+    {
+        ERROR("%s(): function %s is not supported", __FUNCTION__, func_name);
+        out->common._errno = TE_RC(TE_TA_UNIX, TE_EINVAL);
         rc = -1;
         goto many_send_exit;
     }
 
-    memset(buf, 0xDEADBEEF, sizeof(max_len));
+    rc = many_send_pool_fill(in, pool_size, max_len, &mem, &pool);
+    if (rc == 0)
+    {
+        iov = calloc(batch, sizeof(*iov));
+#ifdef HAVE_STRUCT_MMSGHDR
+        mmsgs = calloc(batch, sizeof(*mmsgs));
+        if (mmsgs == NULL)
+            rc = TE_RC(TE_TA_UNIX, TE_ENOMEM);
+#endif
+        if (iov == NULL)
+            rc = TE_RC(TE_TA_UNIX, TE_ENOMEM);
+    }
+    if (rc != 0)
+    {
+        ERROR("%s(): failed to prepare payload pool: %r", __FUNCTION__, rc);
+        out->common._errno = rc;
+        rc = -1;
+        goto many_send_exit;
+    }
 
-    if (tarpc_find_func(in->common.lib_flags, "send", &send_func) != 0)
+    if (tarpc_find_func(in->common.lib_flags, func_name, &send_func) != 0)
     {
-        ERROR("Failed to resolve send() function");
+        ERROR("Failed to resolve %s() function", func_name);
         rc = -1;
         goto many_send_exit;
     }
 
     flags = send_recv_flags_rpc2h(in->flags);
-    for (i = 0; i < in->vector.vector_len; i++)
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    for (i = 0; i < in->vector.vector_len; i += n)
     {
-        if (i % 1024 == 0)
-            RING("%s(): [%d] send(%d, buf, %u, 0x%x)", __FUNCTION__, i,
-                 in->sock, in->vector.vector_val[i], flags);
-        rc = send_func(in->sock, buf, in->vector.vector_val[i], flags);
-        if (rc != (ssize_t)in->vector.vector_val[i])
+        n = MIN(batch, in->vector.vector_len - i);
+
+        /* Payload continues where the previous call stopped. */
+        for (j = 0, len = 0; j < n; j++)
         {
-           ERROR("%s(): %dth send(%d, buf, %u, 0x%x) failed: %d",
-                 __FUNCTION__,
-                 i, in->sock, in->vector.vector_val[i], flags, errno);
+            iov[j].iov_base = pool + (out->bytes + len) % pool_size;
+            iov[j].iov_len = in->vector.vector_val[i + j];
+            len += iov[j].iov_len;
+#ifdef HAVE_STRUCT_MMSGHDR
+            mmsgs[j].msg_hdr.msg_iov = &iov[j];
+            mmsgs[j].msg_hdr.msg_iovlen = 1;
+#endif
+        }
+
+        if (batch == 1)
+        {
+            if (i % 1024 == 0)
+                RING("%s(): [%d] send(%d, buf, %u, 0x%x)", __FUNCTION__, i,
+                     in->sock, in->vector.vector_val[i], flags);
+            rc = send_func(in->sock, iov[0].iov_base, len, flags);
+        }
+        else if (strcmp(func_name, "sendmsg") == 0)
+        {
+            msg.msg_iovlen = n;
+            rc = send_func(in->sock, &msg, flags);
+        }
+#ifdef HAVE_STRUCT_MMSGHDR
+        else
+        {
+            rc = send_func(in->sock, mmsgs, n, flags);
+            if (rc > 0)
+            {
+                /* Not sent messages are passed to the next call. */
+                n = rc;
+                for (j = 0, len = 0; j < n; j++)
+                {
+                    if (mmsgs[j].msg_len != iov[j].iov_len)
+                        break;
+                    len += iov[j].iov_len;
+                }
+                rc = (j == n) ? (ssize_t)len : -1;
+            }
+        }
+#endif
+        out->calls++;
+
+        if (rc != (ssize_t)len)
+        {
+            ERROR("%s(): %dth %s(%d, %u messages, 0x%x) failed: %d, "
+                  "errno %r", __FUNCTION__, i, func_name, in->sock, n,
+                  flags, (int)rc, RPC_ERRNO);
             rc = -1;
             goto many_send_exit;
         }
         out->bytes += rc;
         rc = 0;
     }
+    clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+    out->duration = (uint64_t)(ts_end.tv_sec - ts_start.tv_sec) *
+                    1000000000ULL + ts_end.tv_nsec - ts_start.tv_nsec;
 
 many_send_exit:
 
-    free(buf);
+    free(mem);
+    free(iov);
+#ifdef HAVE_STRUCT_MMSGHDR
+    free(mmsgs);
+#endif
     return rc;
 }
 
@@ -8867,7 +9773,7 @@ tarpc_send_func_onload_zc_send_user_buf(send_func_ctx *ctx,
      * and stays in the queue until completion message is received for it.
      */
 
-    if (!TAILQ_EMPTY(&ctx->compl_bufs))
+    if (!TAILQ_EMPTY(&ctx->compl_bufs.bufs))
     {
         /*
          * Try to wait for completions of buffers sent previously;
@@ -8883,15 +9789,15 @@ tarpc_send_func_onload_zc_send_user_buf(send_func_ctx *ctx,
             return -1;
     }
 
-    if (TAILQ_EMPTY(&ctx->compl_bufs))
+    if (TAILQ_EMPTY(&ctx->compl_bufs.bufs))
     {
         p_start = ctx->user_buf;
         len_avail = ctx->user_buf_len;
     }
     else
     {
-        first_buf = TAILQ_FIRST(&ctx->compl_bufs);
-        last_buf = TAILQ_LAST(&ctx->compl_bufs, zc_compl_bufs);
+        first_buf = TAILQ_FIRST(&ctx->compl_bufs.bufs);
+        last_buf = TAILQ_LAST(&ctx->compl_bufs.bufs, zc_compl_buf_list);
         len_avail = 0;
 
         /*
@@ -8983,10 +9889,11 @@ tarpc_send_func_onload_zc_send_user_buf(send_func_ctx *ctx,
         }
     }
 
+    if (rc >= 0 && zc_compl_bufs_add(&ctx->compl_bufs, new_buf) < 0)
+        rc = -1;
+
     if (rc < 0)
         free(new_buf);
-    else
-        TAILQ_INSERT_TAIL(&ctx->compl_bufs, new_buf, links);
 
      return rc;
 }
@@ -9485,30 +10392,277 @@ TARPC_FUNC_STATIC(epoll_wait_loop, {},
 })
 
 /**
- * Get TCP state from a tool's output (netstat, onload_stackdump,
- * zf_stackdump).
- *
- * @param tool        Command line of the tool.
- * @param loc_addr    Local address.
- * @param rem_addr    Remote address.
- * @param state       Where to save obtained TCP state.
- * @param found       Will be set to @c TRUE if a socket was found.
+ * Open a netlink socket to query states of TCP sockets with sock_diag.
  *
- * @return Status code.
+ * @return The socket, or @c -1 if sock_diag cannot be used (netstat is
+ *         used instead then).
  */
-static te_errno
-tcp_get_state_from_tool(const char *tool,
-                        struct sockaddr *loc_addr,
-                        struct sockaddr *rem_addr,
-                        rpc_tcp_state *state, te_bool *found)
+static int
+tcp_diag_open(void)
 {
-#define STATE_LEN 256
-    te_string  cmd = TE_STRING_INIT;
-    FILE      *f = NULL;
-    char       buf[STATE_LEN];
-    ssize_t    rc;
-    te_errno   res = 0;
-    pid_t      cmd_pid;
+#ifdef HAVE_LINUX_INET_DIAG_H
+    int s = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+
+    if (s < 0)
+    {
+        WARN("%s(): failed to open sock_diag socket, errno %r, "
+             "netstat will be used", __FUNCTION__, te_rc_os2te(errno));
+    }
+
+    return s;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Close a socket opened by tcp_diag_open().
+ *
+ * @param s     The socket or @c -1.
+ */
+static void
+tcp_diag_close(int s)
+{
+    if (s >= 0)
+        close(s);
+}
+
+#ifdef HAVE_LINUX_INET_DIAG_H
+
+/** Kernel state of a TCP request socket, it is reported as SYN_RECV. */
+#define TCP_DIAG_NEW_SYN_RECV 12
+
+/** Size of a buffer to receive sock_diag replies. */
+#define TCP_DIAG_BUF_SIZE 8192
+
+/** Maximum length of a sock_diag bytecode address/port condition. */
+#define TCP_DIAG_COND_MAX_LEN \
+    (sizeof(struct inet_diag_bc_op) + sizeof(struct inet_diag_hostcond) + \
+     sizeof(struct in6_addr))
+
+/**
+ * Put sock_diag bytecode condition matching an address and a port.
+ *
+ * @param bc        Where to put the condition.
+ * @param addr      Address and port to match.
+ * @param local     @c TRUE to match local address, @c FALSE to match
+ *                  remote one.
+ * @param no        Offset to jump to if the condition is false.
+ *
+ * @return Length of the condition.
+ */
+static size_t
+tcp_diag_put_cond(uint8_t *bc, const struct sockaddr *addr, te_bool local,
+                  unsigned short no)
+{
+    struct inet_diag_bc_op     *op = (struct inet_diag_bc_op *)bc;
+    struct inet_diag_hostcond  *cond = (struct inet_diag_hostcond *)(op + 1);
+    size_t                      addr_len = te_netaddr_get_size(
+                                                    addr->sa_family);
+    size_t                      len = sizeof(*op) + sizeof(*cond) +
+                                      addr_len;
+
+    op->code = local ? INET_DIAG_BC_S_COND : INET_DIAG_BC_D_COND;
+    op->yes = len;
+    op->no = no;
+
+    cond->family = addr->sa_family;
+    cond->prefix_len = addr_len * 8;
+    cond->port = ntohs(te_sockaddr_get_port(addr));
+    memcpy(cond->addr, te_sockaddr_get_netaddr(addr), addr_len);
+
+    return len;
+}
+
+/**
+ * Dump TCP sockets of an address family matching a 4-tuple with
+ * sock_diag.
+ *
+ * @param s           sock_diag netlink socket.
+ * @param family      Address family of sockets to dump.
+ * @param loc_addr    Local address.
+ * @param rem_addr    Remote address.
+ * @param state       Where to save TCP state of the first found socket.
+ * @param found       Will be set to @c TRUE if a socket was found.
+ *
+ * @return Status code.
+ */
+static te_errno
+tcp_diag_dump(int s, int family, const struct sockaddr *loc_addr,
+              const struct sockaddr *rem_addr, rpc_tcp_state *state,
+              te_bool *found)
+{
+    struct {
+        struct nlmsghdr         nlh;
+        struct inet_diag_req_v2 req;
+        struct rtattr           rta;
+        uint8_t                 bc[2 * TCP_DIAG_COND_MAX_LEN];
+    } msg;
+
+    uint8_t             buf[TCP_DIAG_BUF_SIZE]
+                                __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct sockaddr_nl  nladdr = { .nl_family = AF_NETLINK };
+    struct nlmsghdr    *h;
+    struct inet_diag_msg *diag_msg;
+    size_t              cond_len;
+    size_t              bc_len;
+    ssize_t             len;
+    te_bool             done = FALSE;
+
+    memset(&msg, 0, sizeof(msg));
+
+    /*
+     * Both conditions have the same length. A false condition jumps past
+     * the end of the bytecode, so the socket is rejected.
+     */
+    cond_len = sizeof(struct inet_diag_bc_op) +
+               sizeof(struct inet_diag_hostcond) +
+               te_netaddr_get_size(loc_addr->sa_family);
+    bc_len = 2 * cond_len;
+    tcp_diag_put_cond(msg.bc, loc_addr, TRUE, bc_len + 4);
+    tcp_diag_put_cond(msg.bc + cond_len, rem_addr, FALSE, cond_len + 4);
+
+    msg.rta.rta_type = INET_DIAG_REQ_BYTECODE;
+    msg.rta.rta_len = RTA_LENGTH(bc_len);
+
+    msg.req.sdiag_family = family;
+    msg.req.sdiag_protocol = IPPROTO_TCP;
+    msg.req.idiag_states = ~0U;
+
+    msg.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(msg.req)) + msg.rta.rta_len;
+    msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+
+    if (sendto(s, &msg, msg.nlh.nlmsg_len, 0,
+               (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0)
+    {
+        ERROR("%s(): failed to send sock_diag request, errno %r",
+              __FUNCTION__, te_rc_os2te(errno));
+        return TE_RC(TE_TA_UNIX, te_rc_os2te(errno));
+    }
+
+    while (!done)
+    {
+        len = recv(s, buf, sizeof(buf), 0);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            ERROR("%s(): failed to receive sock_diag reply, errno %r",
+                  __FUNCTION__, te_rc_os2te(errno));
+            return TE_RC(TE_TA_UNIX, te_rc_os2te(errno));
+        }
+
+        for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, (size_t)len);
+             h = NLMSG_NEXT(h, len))
+        {
+            if (h->nlmsg_type == NLMSG_DONE)
+            {
+                done = TRUE;
+                break;
+            }
+
+            if (h->nlmsg_type == NLMSG_ERROR)
+            {
+                struct nlmsgerr *err = NLMSG_DATA(h);
+
+                ERROR("%s(): sock_diag request failed, errno %r",
+                      __FUNCTION__, te_rc_os2te(-err->error));
+                return TE_RC(TE_TA_UNIX, te_rc_os2te(-err->error));
+            }
+
+            if (h->nlmsg_type != SOCK_DIAG_BY_FAMILY || *found)
+                continue;
+
+            diag_msg = NLMSG_DATA(h);
+            *found = TRUE;
+            if (diag_msg->idiag_state == TCP_DIAG_NEW_SYN_RECV)
+                *state = RPC_TCP_SYN_RECV;
+            else
+                *state = tcp_state_h2rpc(diag_msg->idiag_state);
+        }
+    }
+
+    return 0;
+}
+
+#endif /* HAVE_LINUX_INET_DIAG_H */
+
+/**
+ * Get state of a kernel TCP socket with sock_diag. Only sockets matching
+ * the addresses are dumped by the kernel, so it does not depend on the
+ * number of sockets in the system. An IPv4 4-tuple is also searched
+ * among IPv6 sockets with IPv4-mapped addresses.
+ *
+ * @param s           Socket returned by tcp_diag_open().
+ * @param loc_addr    Local address.
+ * @param rem_addr    Remote address.
+ * @param state       Where to save obtained TCP state.
+ * @param found       Will be set to @c TRUE if a socket was found.
+ *
+ * @return Status code.
+ */
+static te_errno
+tcp_get_state_from_diag(int s, struct sockaddr *loc_addr,
+                        struct sockaddr *rem_addr,
+                        rpc_tcp_state *state, te_bool *found)
+{
+#ifdef HAVE_LINUX_INET_DIAG_H
+    te_errno rc;
+
+    *found = FALSE;
+    *state = RPC_TCP_UNKNOWN;
+
+    if (loc_addr->sa_family != rem_addr->sa_family)
+    {
+        ERROR("%s(): local and remote addresses have different families",
+              __FUNCTION__);
+        return TE_RC(TE_TA_UNIX, TE_EINVAL);
+    }
+
+    rc = tcp_diag_dump(s, loc_addr->sa_family, loc_addr, rem_addr,
+                       state, found);
+    if (rc == 0 && !*found && loc_addr->sa_family == AF_INET)
+        rc = tcp_diag_dump(s, AF_INET6, loc_addr, rem_addr, state, found);
+
+    return rc;
+#else
+    UNUSED(s);
+    UNUSED(loc_addr);
+    UNUSED(rem_addr);
+    UNUSED(state);
+    UNUSED(found);
+
+    return TE_RC(TE_TA_UNIX, TE_EOPNOTSUPP);
+#endif
+}
+
+/**
+ * Get TCP state from a tool's output (netstat, onload_stackdump,
+ * zf_stackdump).
+ *
+ * @param tool        Command line of the tool.
+ * @param loc_addr    Local address.
+ * @param rem_addr    Remote address.
+ * @param state       Where to save obtained TCP state.
+ * @param found       Will be set to @c TRUE if a socket was found.
+ *
+ * @return Status code.
+ */
+static te_errno
+tcp_get_state_from_tool(const char *tool,
+                        struct sockaddr *loc_addr,
+                        struct sockaddr *rem_addr,
+                        rpc_tcp_state *state, te_bool *found)
+{
+#define STATE_LEN 256
+    te_string  cmd = TE_STRING_INIT;
+    FILE      *f = NULL;
+    char       buf[STATE_LEN];
+    ssize_t    rc;
+    te_errno   res = 0;
+    pid_t      cmd_pid;
 
     char       loc_addr_str[INET6_ADDRSTRLEN] = "";
     char       rem_addr_str[INET6_ADDRSTRLEN] = "";
@@ -9648,10 +10802,12 @@ cleanup:
 }
 
 /**
- * Get state of a TCP socket from output of one of the tools (netstat,
- * onload_stackdump, zf_stackdump). All the available tools will be
+ * Get state of a TCP socket with sock_diag (or from netstat output if
+ * sock_diag is not available) or from output of one of the Onload tools
+ * (onload_stackdump, zf_stackdump). All the available tools will be
  * tried in search of the socket.
  *
+ * @param diag_sock             Socket returned by tcp_diag_open().
  * @param loc_addr              Local address.
  * @param rem_addr              Remote address.
  * @param onload_stdump         Whether te_onload_stdump should be tried.
@@ -9661,21 +10817,36 @@ cleanup:
  * @param state                 Where to save obtained TCP state.
  * @param found                 Will be set to @c TRUE if TCP socket was
  *                              found.
+ * @param in_kernel             Will be set to @c TRUE if the socket was
+ *                              found with sock_diag (may be @c NULL).
  *
  * @return Status code.
  */
 static te_errno
-tcp_get_state(struct sockaddr *loc_addr, struct sockaddr *rem_addr,
+tcp_get_state(int diag_sock,
+              struct sockaddr *loc_addr, struct sockaddr *rem_addr,
               te_bool onload_stdump, te_bool onload_stdump_netstat,
               te_bool zf_stdump,
-              rpc_tcp_state *state, te_bool *found)
+              rpc_tcp_state *state, te_bool *found, te_bool *in_kernel)
 {
     te_errno rc = 0;
 
     *found = FALSE;
 
-    rc = tcp_get_state_from_tool("netstat -atn",
-                                 loc_addr, rem_addr, state, found);
+    if (diag_sock >= 0)
+    {
+        rc = tcp_get_state_from_diag(diag_sock, loc_addr, rem_addr,
+                                     state, found);
+        if (in_kernel != NULL)
+            *in_kernel = *found;
+    }
+    else
+    {
+        rc = tcp_get_state_from_tool("netstat -atn",
+                                     loc_addr, rem_addr, state, found);
+        if (in_kernel != NULL)
+            *in_kernel = FALSE;
+    }
 
     if (rc == 0 && onload_stdump && !*found)
         rc = tcp_get_state_from_tool("te_onload_stdump netstat",
@@ -9793,6 +10964,18 @@ find_netstat_tools(te_bool *onload_stdump, te_bool *onload_stdump_netstat,
                                 ta_dir);
 }
 
+/**
+ * Interval between TCP state queries when the socket is found with
+ * sock_diag, in microseconds.
+ */
+#define TCP_STATE_POLL_DIAG_US 500
+
+/**
+ * Interval between TCP state queries when external tools are run,
+ * in microseconds.
+ */
+#define TCP_STATE_POLL_TOOL_US 100000
+
 /**
  * Wait until TCP socket disappears, measure time it took.
  *
@@ -9831,6 +11014,8 @@ wait_tcp_socket_termination(struct sockaddr *loc_addr,
     te_errno        rc;
     int             retval;
     te_bool         found = FALSE;
+    te_bool         in_kernel = FALSE;
+    int             diag_sock;
 
     struct timeval  tv_start_close;
     struct timeval  tv_start;
@@ -9845,17 +11030,22 @@ wait_tcp_socket_termination(struct sockaddr *loc_addr,
     if (rc != 0)
         return rc;
 
+    diag_sock = tcp_diag_open();
+
     *last_state = RPC_TCP_UNKNOWN;
     GET_TIME(tv_start);
     memcpy(&tv_start_close, &tv_start, sizeof(tv_start));
 
     while (TRUE)
     {
-        rc = tcp_get_state(loc_addr, rem_addr,
+        rc = tcp_get_state(diag_sock, loc_addr, rem_addr,
                            onload_stdump, onload_stdump_netstat, zf_stdump,
-                           &cur_state, &found);
+                           &cur_state, &found, &in_kernel);
         if (rc != 0)
+        {
+            tcp_diag_close(diag_sock);
             return rc;
+        }
 
         if (!found)
             break;
@@ -9871,10 +11061,11 @@ wait_tcp_socket_termination(struct sockaddr *loc_addr,
 
         *last_state = cur_state;
         prev_state = cur_state;
-        usleep(100000);
+        usleep(in_kernel ? TCP_STATE_POLL_DIAG_US : TCP_STATE_POLL_TOOL_US);
     }
 
     GET_TIME(tv_end);
+    tcp_diag_close(diag_sock);
 
     *last_state_time = TE_US2MS(TIMEVAL_SUB(tv_end, tv_start));
     *close_time = TE_US2MS(TIMEVAL_SUB(tv_end, tv_start_close));
@@ -10080,7 +11271,7 @@ TARPC_FUNC(sendmmsg_disconnect, {},
 )
 
 /**
- * Get TCP socket state from netstat-like tools.
+ * Get TCP socket state with sock_diag or from netstat-like tools.
  *
  * @param loc_addr      Local address/port.
  * @param rem_addr      Remote address/port.
@@ -10098,6 +11289,7 @@ get_tcp_socket_state(struct sockaddr *loc_addr,
     te_errno        rc;
     rpc_tcp_state   sock_state;
     te_bool         sock_found;
+    int             diag_sock;
 
     te_bool onload_stdump = FALSE;
     te_bool onload_stdump_netstat = FALSE;
@@ -10110,9 +11302,11 @@ get_tcp_socket_state(struct sockaddr *loc_addr,
     if (rc != 0)
         return rc;
 
-    rc = tcp_get_state(loc_addr, rem_addr,
+    diag_sock = tcp_diag_open();
+    rc = tcp_get_state(diag_sock, loc_addr, rem_addr,
                        onload_stdump, onload_stdump_netstat, zf_stdump,
-                       &sock_state, &sock_found);
+                       &sock_state, &sock_found, NULL);
+    tcp_diag_close(diag_sock);
     if (rc != 0)
         return rc;
 
@@ -10328,7 +11522,7 @@ sockts_send_func_ctx_init_zc_buf(tarpc_ptr ctx_ptr, int fd,
         return -1;
     }
 
-    TAILQ_INIT(&ctx->compl_bufs);
+    zc_compl_bufs_init(&ctx->compl_bufs);
 
     ctx->user_buf_len = buf_size;
     return alloc_register_zc_buf(fd, sockts_zc_reg_buf_type(),
@@ -10372,8 +11566,6 @@ sockts_send_func_ctx_clean_zc_buf(tarpc_ptr ctx_ptr, int fd, int timeout)
     send_func_ctx *ctx;
     int rc_wait;
     int rc_unreg;
-    zc_compl_buf *buf;
-    zc_compl_buf *buf_aux;
 
     api_func func_unreg_bufs = NULL;
 
@@ -10389,18 +11581,14 @@ sockts_send_func_ctx_clean_zc_buf(tarpc_ptr ctx_ptr, int fd, int timeout)
     }
 
     rc_wait = wait_for_zc_completion(&ctx->compl_bufs, TRUE, TRUE, timeout);
-    if (rc_wait >= 0 && !TAILQ_EMPTY(&ctx->compl_bufs))
+    if (rc_wait >= 0 && !TAILQ_EMPTY(&ctx->compl_bufs.bufs))
     {
         te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EFAIL),
                          "Not all the buffers were completed");
         rc_wait = -1;
     }
 
-    TAILQ_FOREACH_SAFE(buf, &ctx->compl_bufs, links, buf_aux)
-    {
-        TAILQ_REMOVE(&ctx->compl_bufs, buf, links);
-        free(buf);
-    }
+    zc_compl_bufs_fini(&ctx->compl_bufs, TRUE);
 
     rc_unreg = unreg_unmap_zc_rbufs(func_unreg_bufs, fd,
                                     ctx->buf_handle, ctx->user_buf,
@@ -11121,16 +12309,47 @@ TARPC_FUNC(connect_send_dur_time, {},
 }
 )
 
+/**
+ * Get index of a bucket in iomux timeout accuracy histogram.
+ * Bucket @c 0 is for deviations less than a microsecond, bucket @c i
+ * is for deviations in [2^(i-1), 2^i) microseconds, the last bucket
+ * also gets all the greater deviations.
+ *
+ * @param dev_ns      Absolute deviation of wait time from the timeout
+ *                    (in nanoseconds).
+ * @param size        Number of buckets.
+ *
+ * @return Bucket index.
+ */
+static unsigned int
+iomux_timeout_hist_idx(uint64_t dev_ns, unsigned int size)
+{
+    uint64_t     us = dev_ns / 1000;
+    unsigned int idx = 0;
+
+    while (us > 0 && idx < size - 1)
+    {
+        us >>= 1;
+        idx++;
+    }
+
+    return idx;
+}
+
 /**
  * Call specified iomux function requested number of times (expecting
- * that it times out every time).
+ * that it times out every time). If histogram size is not zero, actual
+ * wait time of every call is measured and its deviation from the timeout
+ * is reported.
  *
  * @param in          Parameters of rpc_sockts_iomux_timeout_loop().
+ * @param out         Where to save measurement results.
  *
  * @return @c 0 on success, @c -1 on failure.
  */
 static int
-sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in)
+sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in,
+                          tarpc_sockts_iomux_timeout_loop_out *out)
 {
     iomux_funcs iomux_f;
     iomux_func iomux = in->iomux;
@@ -11153,6 +12372,13 @@ sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in)
     api_func oo_epoll;
     struct onload_ordered_epoll_event *oo_events = NULL;
 
+    unsigned int hist_size = in->hist_size;
+    uint64_t timeout_ns = (uint64_t)MAX(timeout, 0) * 1000000;
+    uint64_t *waits = NULL;
+    unsigned int n_waits = 0;
+    uint64_t start_ns = 0;
+    uint64_t wait_ns;
+
     if (iomux_find_func(in->common.lib_flags, &iomux, &iomux_f) != 0)
     {
         te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOENT),
@@ -11191,6 +12417,24 @@ sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in)
         }
     }
 
+    if (hist_size > 0)
+    {
+        waits = TE_ALLOC(MAX(n_calls, 1) * sizeof(*waits));
+        out->late.late_val = TE_ALLOC(hist_size * sizeof(uint64_t));
+        out->early.early_val = TE_ALLOC(hist_size * sizeof(uint64_t));
+        if (waits == NULL || out->late.late_val == NULL ||
+            out->early.early_val == NULL)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                             "Failed to allocate memory for wait "
+                             "time statistics");
+            rc = -1;
+            goto finish;
+        }
+        out->late.late_len = hist_size;
+        out->early.early_len = hist_size;
+    }
+
     for (i = 0; i < nfds; i++)
     {
         rc = iomux_add_fd(iomux, &iomux_f, &iomux_st,
@@ -11222,6 +12466,9 @@ sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in)
             }
         }
 
+        if (hist_size > 0)
+            start_ns = mono_time_ns();
+
         if (in->oo_epoll)
         {
             rc = oo_epoll(iomux_st.epoll, iomux_ret.epoll.events,
@@ -11246,6 +12493,22 @@ sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in)
             }
         }
 
+        if (hist_size > 0)
+        {
+            wait_ns = mono_time_ns() - start_ns;
+            waits[n_waits++] = wait_ns;
+            if (wait_ns >= timeout_ns)
+            {
+                out->late.late_val[iomux_timeout_hist_idx(
+                                wait_ns - timeout_ns, hist_size)]++;
+            }
+            else
+            {
+                out->early.early_val[iomux_timeout_hist_idx(
+                                timeout_ns - wait_ns, hist_size)]++;
+            }
+        }
+
         if (rc > 0)
         {
             te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EFAIL),
@@ -11275,6 +12538,17 @@ sockts_iomux_timeout_loop(tarpc_sockts_iomux_timeout_loop_in *in)
 
 finish:
 
+    if (n_waits > 0)
+    {
+        qsort(waits, n_waits, sizeof(*waits), u64_cmp);
+        out->stats.calls = n_waits;
+        out->stats.wait_min = waits[0];
+        out->stats.wait_p50 = u64_sorted_pct(waits, n_waits, 500);
+        out->stats.wait_p99 = u64_sorted_pct(waits, n_waits, 990);
+        out->stats.wait_p999 = u64_sorted_pct(waits, n_waits, 999);
+        out->stats.wait_max = waits[n_waits - 1];
+    }
+
     rc_aux = iomux_close(iomux, &iomux_f, &iomux_st);
     if (rc_aux < 0)
     {
@@ -11290,21 +12564,29 @@ finish:
         }
     }
 
+    free(waits);
     free(oo_events);
     return rc;
 }
 
 TARPC_FUNC_STATIC(sockts_iomux_timeout_loop, {},
 {
-    MAKE_CALL(out->retval = func(in));
+    MAKE_CALL(out->retval = func(in, out));
 })
 
+/** Default maximum number of bytes requested by a single recv() call. */
+#define PEEK_STREAM_DEF_BATCH 1024
+
 /**
  * Receive data sent from TCP peer, often using recv() with
  * @c MSG_PEEK flag. It is supposed that data is generated by
  * tarpc_fill_buff_with_sequence_lcg(); this function checks
  * whether received data matches the expected pattern.
  *
+ * Time spent in recv() calls with and without @c MSG_PEEK and the
+ * number of bytes re-read because of @c MSG_PEEK are reported, so that
+ * the cost of peeking may be measured.
+ *
  * @param in      Input arguments of RPC call.
  * @param out     Output arguments of RPC call.
  *
@@ -11327,27 +12609,48 @@ sockts_peek_stream_receiver(tarpc_sockts_peek_stream_receiver_in *in,
     int rc;
     int res = -1;
 
-    char buf[1024];
-    char check_buf[TARPC_LCG_LEN(sizeof(buf))];
+    char *buf = NULL;
+    char *check_buf = NULL;
+    size_t buf_size;
     uint32_t offset;
     int data_len;
     int flags;
+    int peeks_left;
 
     tarpc_pat_gen_arg cur_arg;
     tarpc_pat_gen_arg saved_arg;
     uint64_t received;
 
-    /*
-     * Average number of recv() calls with MSG_PEEK per every
-     * call without this flag.
-     */
-    const int peek_count = 2;
+    tarpc_sockts_peek_stream_stats *stats = &out->stats;
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+    uint64_t call_ns;
 
     TRY_FIND_FUNC(in->common.lib_flags, "poll", &func_poll);
     TRY_FIND_FUNC(in->common.lib_flags, "recv", &func_recv);
 
+    if (in->peek_count < 0)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                         "Number of recv(MSG_PEEK) calls is negative");
+        return -1;
+    }
+
+    buf_size = (in->batch == 0 ? PEEK_STREAM_DEF_BATCH : in->batch);
+    buf = TE_ALLOC(buf_size);
+    check_buf = TE_ALLOC(TARPC_LCG_LEN(buf_size));
+    if (buf == NULL || check_buf == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate receive buffers");
+        free(buf);
+        free(check_buf);
+        return -1;
+    }
+
     memcpy(&cur_arg, &in->gen_arg, sizeof(cur_arg));
     received = 0;
+    peeks_left = in->peek_count;
 
     while (TRUE)
     {
@@ -11402,13 +12705,37 @@ sockts_peek_stream_receiver(tarpc_sockts_peek_stream_receiver_in *in,
             goto cleanup;
         }
 
-        if (rand_range(0, peek_count) < peek_count)
+        /*
+         * With fixed ratio exactly peek_count recv(MSG_PEEK) calls
+         * precede every call without this flag, otherwise it is their
+         * average number.
+         */
+        if (in->fixed_ratio)
+        {
+            flags = (peeks_left > 0 ? MSG_PEEK : 0);
+            peeks_left = (flags != 0 ? peeks_left - 1 : in->peek_count);
+        }
+        else if (rand_range(0, in->peek_count) < in->peek_count)
+        {
             flags = MSG_PEEK;
+        }
         else
+        {
             flags = 0;
+        }
+
+        if (in->batch == 0)
+            data_len = rand_range(1, buf_size);
+        else
+            data_len = buf_size;
 
-        data_len = rand_range(1, sizeof(buf));
+        call_ns = mono_time_ns();
+        if (first_ns == 0)
+            first_ns = call_ns;
         rc = func_recv(in->fd, buf, data_len, flags);
+        last_ns = mono_time_ns();
+        call_ns = last_ns - call_ns;
+
         if (rc < 0)
         {
             te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
@@ -11424,7 +12751,17 @@ sockts_peek_stream_receiver(tarpc_sockts_peek_stream_receiver_in *in,
         data_len = rc;
 
         if (flags & MSG_PEEK)
+        {
+            stats->peek_calls++;
+            stats->peek_bytes += data_len;
+            stats->peek_ns += call_ns;
             memcpy(&saved_arg, &cur_arg, sizeof(saved_arg));
+        }
+        else
+        {
+            stats->recv_calls++;
+            stats->recv_ns += call_ns;
+        }
 
         offset = cur_arg.offset;
         te_rc = tarpc_fill_buff_with_sequence_lcg(check_buf, data_len,
@@ -11452,8 +12789,15 @@ sockts_peek_stream_receiver(tarpc_sockts_peek_stream_receiver_in *in,
     res = 0;
 cleanup:
 
+    stats->recv_bytes = received;
+    stats->duration = (last_ns - first_ns) / 1000;
+    if (last_ns > first_ns)
+        stats->mbps = received * 8000 / (last_ns - first_ns);
+
     memcpy(&out->gen_arg, &cur_arg, sizeof(cur_arg));
     out->received = received;
+    free(buf);
+    free(check_buf);
     return res;
 }
 
@@ -11461,3 +12805,2545 @@ TARPC_FUNC_STATIC(sockts_peek_stream_receiver, {},
 {
     MAKE_CALL(out->retval = func(in, out));
 })
+
+/*-------------- sockts_traffic_engine() --------------------------*/
+
+/** Maximum number of I/O calls on a socket per poll() event. */
+#define TRAFFIC_ENGINE_BURST 64
+
+/**
+ * Maximum time to block in poll(), in milliseconds, so that the stop flag
+ * is noticed.
+ */
+#define TRAFFIC_ENGINE_POLL_TIMEOUT 100
+
+/** How sockts_traffic_engine() transfers data. */
+typedef enum traffic_engine_func {
+    TRAFFIC_ENGINE_SEND_WRAPPER,  /**< Send function wrapper returned by
+                                       tarpc_send_func_find() */
+    TRAFFIC_ENGINE_SENDMMSG,      /**< sendmmsg() */
+    TRAFFIC_ENGINE_RECV,          /**< recv() */
+    TRAFFIC_ENGINE_RECVMSG,       /**< recvmsg() */
+    TRAFFIC_ENGINE_RECVMMSG,      /**< recvmmsg() */
+} traffic_engine_func;
+
+/** Context of a sockts_traffic_engine() thread. */
+typedef struct traffic_engine_thread {
+    tarpc_sockts_traffic_engine_in  *in;    /**< RPC input */
+    traffic_engine_func              type;  /**< How data is transferred */
+    tarpc_send_func_ptr              send_func; /**< Send wrapper */
+    send_func_ctx                    send_ctx;  /**< Send wrapper
+                                                     context */
+    api_func                         func;  /**< Resolved function */
+    api_func_ptr                     func_poll; /**< Resolved poll() */
+
+    tarpc_sockts_traffic_engine_stats *stats; /**< Statistics of all
+                                                   sockets */
+    struct pollfd   *pfds;          /**< Sockets served by the thread */
+    unsigned int    *sock_idx;      /**< Indexes of the sockets in
+                                         RPC input */
+    unsigned int     n_socks;       /**< Number of served sockets */
+
+    uint8_t         *buf;           /**< Data buffer */
+    struct iovec    *iov;           /**< Vector per message */
+#ifdef HAVE_STRUCT_MMSGHDR
+    struct mmsghdr  *mmsgs;         /**< Messages for sendmmsg()/
+                                         recvmmsg() */
+#endif
+    struct msghdr    msg;           /**< Message for recvmsg() */
+
+    const volatile uint8_t *stop;   /**< Stop flag or @c NULL */
+    uint64_t         start;         /**< Start time, in nanoseconds */
+    uint64_t         deadline;      /**< Finish time, in nanoseconds */
+    uint64_t         interval;      /**< Sampling interval,
+                                         in nanoseconds */
+    uint64_t        *samples;       /**< Bytes transferred in each
+                                         interval */
+    unsigned int     n_samples;     /**< Number of allocated samples */
+    unsigned int     last_sample;   /**< Number of touched samples */
+
+    int              cpu;           /**< CPU to pin the thread to,
+                                         or @c -1 */
+    pthread_t        thread;        /**< Thread ID */
+    te_errno         err;           /**< Error occurred in the thread */
+} traffic_engine_thread;
+
+/**
+ * Make a single send or receive call.
+ *
+ * @param th      Thread context.
+ * @param fd      Socket.
+ *
+ * @return Number of transferred bytes or @c -1 with @b errno set.
+ */
+static ssize_t
+traffic_engine_call(traffic_engine_thread *th, int fd)
+{
+    size_t  size = th->in->size;
+    ssize_t rc;
+#ifdef HAVE_STRUCT_MMSGHDR
+    unsigned int i;
+#endif
+
+    switch (th->type)
+    {
+        case TRAFFIC_ENGINE_SEND_WRAPPER:
+            return th->send_func(&th->send_ctx, fd, th->buf, size, 0);
+
+        case TRAFFIC_ENGINE_RECV:
+            return th->func(fd, th->buf, size, 0);
+
+        case TRAFFIC_ENGINE_RECVMSG:
+            th->iov[0].iov_len = size;
+            th->msg.msg_iov = th->iov;
+            th->msg.msg_iovlen = 1;
+            return th->func(fd, &th->msg, 0);
+
+#ifdef HAVE_STRUCT_MMSGHDR
+        case TRAFFIC_ENGINE_SENDMMSG:
+        case TRAFFIC_ENGINE_RECVMMSG:
+            for (i = 0; i < th->in->batch; i++)
+            {
+                th->iov[i].iov_len = size;
+                th->mmsgs[i].msg_len = 0;
+            }
+
+            if (th->type == TRAFFIC_ENGINE_SENDMMSG)
+                rc = th->func(fd, th->mmsgs, th->in->batch, 0);
+            else
+                rc = th->func(fd, th->mmsgs, th->in->batch, 0, NULL);
+            if (rc <= 0)
+                return rc;
+
+            for (i = 0, size = 0; i < (unsigned int)rc; i++)
+                size += th->mmsgs[i].msg_len;
+
+            return size;
+#endif
+
+        default:
+            UNUSED(rc);
+            errno = EINVAL;
+            return -1;
+    }
+}
+
+/**
+ * Serve sockets of a thread until the time is out, the stop flag is set
+ * or all the sockets are closed by peers.
+ *
+ * @param arg     Thread context.
+ *
+ * @return @c NULL.
+ */
+static void *
+traffic_engine_thread_func(void *arg)
+{
+    traffic_engine_thread *th = arg;
+    te_bool                snd = th->in->snd;
+    unsigned int           n_active = th->n_socks;
+    unsigned int           i;
+    unsigned int           j;
+    unsigned int           k;
+    uint64_t               now;
+    int                    timeout;
+    ssize_t                rc;
+
+    while (n_active > 0)
+    {
+        now = mono_time_ns();
+        if (now >= th->deadline ||
+            (th->stop != NULL && __atomic_load_n(th->stop, __ATOMIC_RELAXED)))
+            break;
+
+        timeout = (th->deadline - now + 999999) / 1000000;
+        if (timeout > TRAFFIC_ENGINE_POLL_TIMEOUT)
+            timeout = TRAFFIC_ENGINE_POLL_TIMEOUT;
+
+        rc = th->func_poll(th->pfds, th->n_socks, timeout);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            th->err = TE_OS_RC(TE_TA_UNIX, errno);
+            ERROR("%s(): poll() failed: %r", __FUNCTION__, th->err);
+            break;
+        }
+
+        for (i = 0; i < th->n_socks && rc > 0; i++)
+        {
+            tarpc_sockts_traffic_engine_stats *stats;
+
+            if (th->pfds[i].revents == 0)
+                continue;
+
+            rc--;
+            stats = &th->stats[th->sock_idx[i]];
+            for (k = 0; k < TRAFFIC_ENGINE_BURST; k++)
+            {
+                ssize_t len = traffic_engine_call(th, th->pfds[i].fd);
+
+                stats->calls++;
+                if (len < 0)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        stats->eagain++;
+                        break;
+                    }
+
+                    th->err = TE_OS_RC(TE_TA_UNIX, errno);
+                    ERROR("%s(): failed to %s data on socket %d: %r",
+                          __FUNCTION__, snd ? "send" : "receive",
+                          th->pfds[i].fd, th->err);
+                    return NULL;
+                }
+                if (len == 0 && !snd)
+                {
+                    /* Negative fd is ignored by poll(). */
+                    th->pfds[i].fd = -1;
+                    n_active--;
+                    break;
+                }
+
+                stats->bytes += len;
+                if (th->n_samples > 0)
+                {
+                    j = (mono_time_ns() - th->start) / th->interval;
+                    if (j < th->n_samples)
+                    {
+                        th->samples[j] += len;
+                        if (j >= th->last_sample)
+                            th->last_sample = j + 1;
+                    }
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Resolve functions and allocate buffers of a thread.
+ *
+ * @param th      Thread context.
+ *
+ * @return Status code.
+ */
+static te_errno
+traffic_engine_thread_init(traffic_engine_thread *th)
+{
+    tarpc_sockts_traffic_engine_in *in = th->in;
+    const char     *name = in->func_name;
+    unsigned int    n_iov = 1;
+    unsigned int    i;
+    te_errno        rc;
+
+    th->send_ctx.lib_flags = in->common.lib_flags;
+
+    if (in->snd && strcmp(name, "sendmmsg") != 0)
+    {
+        th->type = TRAFFIC_ENGINE_SEND_WRAPPER;
+        th->send_func = tarpc_send_func_find(name);
+        if (th->send_func == NULL)
+            return TE_RC(TE_TA_UNIX, TE_EINVAL);
+    }
+    else
+    {
+        if (in->snd)
+            th->type = TRAFFIC_ENGINE_SENDMMSG;
+        else if (strcmp(name, "recv") == 0)
+            th->type = TRAFFIC_ENGINE_RECV;
+        else if (strcmp(name, "recvmsg") == 0)
+            th->type = TRAFFIC_ENGINE_RECVMSG;
+        else if (strcmp(name, "recvmmsg") == 0)
+            th->type = TRAFFIC_ENGINE_RECVMMSG;
+        else
+        {
+            ERROR("%s(): function %s is not supported", __FUNCTION__, name);
+            return TE_RC(TE_TA_UNIX, TE_EINVAL);
+        }
+
+        rc = tarpc_find_func(in->common.lib_flags, name, &th->func);
+        if (rc != 0)
+            return rc;
+    }
+
+    rc = tarpc_find_func(in->common.lib_flags, "poll",
+                         (api_func *)&th->func_poll);
+    if (rc != 0)
+        return rc;
+
+    if (th->type == TRAFFIC_ENGINE_SENDMMSG ||
+        th->type == TRAFFIC_ENGINE_RECVMMSG)
+    {
+#ifdef HAVE_STRUCT_MMSGHDR
+        n_iov = in->batch;
+        th->mmsgs = TE_ALLOC(n_iov * sizeof(*th->mmsgs));
+        if (th->mmsgs == NULL)
+            return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+#else
+        ERROR("%s(): %s is not supported", __FUNCTION__, name);
+        return TE_RC(TE_TA_UNIX, TE_EOPNOTSUPP);
+#endif
+    }
+
+    th->buf = TE_ALLOC(n_iov * in->size);
+    th->iov = TE_ALLOC(n_iov * sizeof(*th->iov));
+    if (th->buf == NULL || th->iov == NULL)
+        return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+
+    for (i = 0; i < n_iov; i++)
+    {
+        th->iov[i].iov_base = th->buf + i * in->size;
+        th->iov[i].iov_len = in->size;
+#ifdef HAVE_STRUCT_MMSGHDR
+        if (th->mmsgs != NULL)
+        {
+            th->mmsgs[i].msg_hdr.msg_iov = &th->iov[i];
+            th->mmsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+#endif
+    }
+
+    if (th->n_samples > 0)
+    {
+        th->samples = TE_ALLOC(th->n_samples * sizeof(*th->samples));
+        if (th->samples == NULL)
+            return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+    }
+
+    return 0;
+}
+
+/**
+ * Release resources of a thread.
+ *
+ * @param th      Thread context.
+ */
+static void
+traffic_engine_thread_clean(traffic_engine_thread *th)
+{
+    free(th->pfds);
+    free(th->sock_idx);
+    free(th->buf);
+    free(th->iov);
+#ifdef HAVE_STRUCT_MMSGHDR
+    free(th->mmsgs);
+#endif
+    free(th->samples);
+}
+
+/**
+ * Get busy and total time of CPUs from /proc/stat.
+ *
+ * @param cpus      CPU numbers.
+ * @param n_cpus    Number of CPUs.
+ * @param res       Where to save the times (array of @p n_cpus items).
+ *
+ * @return Status code.
+ */
+static te_errno
+traffic_engine_cpu_times(const tarpc_int *cpus, unsigned int n_cpus,
+                         tarpc_sockts_traffic_engine_cpu *res)
+{
+    FILE               *f;
+    char                line[256];
+    int                 cpu;
+    unsigned long long  v[8];
+    uint64_t            idle;
+    uint64_t            busy;
+    unsigned int        n_found = 0;
+    unsigned int        i;
+    te_errno            rc;
+
+    f = fopen("/proc/stat", "r");
+    if (f == NULL)
+    {
+        rc = TE_OS_RC(TE_TA_UNIX, errno);
+        ERROR("%s(): failed to open /proc/stat: %r", __FUNCTION__, rc);
+        return rc;
+    }
+
+    memset(v, 0, sizeof(v));
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        /*
+         * Skip the aggregate "cpu  ..." line, otherwise %d would skip
+         * spaces and take its first counter for a CPU number.
+         */
+        if (strncmp(line, "cpu", 3) != 0 ||
+            !isdigit((unsigned char)line[3]))
+            continue;
+
+        /* user nice system idle iowait irq softirq steal */
+        if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &cpu, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+                   &v[7]) < 5)
+            continue;
+
+        idle = v[3] + v[4];
+        busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+        for (i = 0; i < n_cpus; i++)
+        {
+            if (cpus[i] == cpu)
+            {
+                res[i].cpu = cpu;
+                res[i].busy = busy;
+                res[i].total = busy + idle;
+                n_found++;
+            }
+        }
+        memset(v, 0, sizeof(v));
+    }
+    fclose(f);
+
+    if (n_found != n_cpus)
+    {
+        ERROR("%s(): not all CPUs are found in /proc/stat", __FUNCTION__);
+        return TE_RC(TE_TA_UNIX, TE_ENOENT);
+    }
+
+    return 0;
+}
+
+/**
+ * Start a thread of sockts_traffic_engine() pinning it to a CPU
+ * if required.
+ *
+ * @param th      Thread context.
+ *
+ * @return Status code.
+ */
+static te_errno
+traffic_engine_thread_start(traffic_engine_thread *th)
+{
+    pthread_attr_t  attr;
+    int             rc;
+
+    rc = pthread_attr_init(&attr);
+    if (rc != 0)
+        return TE_OS_RC(TE_TA_UNIX, rc);
+
+    if (th->cpu >= 0)
+    {
+#ifdef CPU_SET
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(th->cpu, &set);
+        rc = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+#else
+        rc = EOPNOTSUPP;
+#endif
+    }
+
+    if (rc == 0)
+        rc = pthread_create(&th->thread, &attr, traffic_engine_thread_func, th);
+
+    pthread_attr_destroy(&attr);
+
+    return rc == 0 ? 0 : TE_OS_RC(TE_TA_UNIX, rc);
+}
+
+/**
+ * Send or receive traffic on multiple sockets in multiple threads.
+ * Sockets are distributed between threads in round-robin manner, each
+ * thread waits for its sockets with poll() and does a bounded number of
+ * calls per ready socket. Sockets are switched to non-blocking mode for
+ * the run. Threads may be pinned to CPUs, utilisation of these CPUs
+ * during the run is reported.
+ *
+ * @param in      Input RPC argument.
+ * @param out     Output RPC argument.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+sockts_traffic_engine(tarpc_sockts_traffic_engine_in *in,
+                      tarpc_sockts_traffic_engine_out *out)
+{
+    traffic_engine_thread  *ths = NULL;
+    unsigned int            n_fds = in->fds.fds_len;
+    unsigned int            n_cpus = in->cpus.cpus_len;
+    tarpc_sockts_traffic_engine_cpu *cpu_start = NULL;
+    unsigned int            n_threads = in->threads;
+    unsigned int            n_nonblock = 0;
+    unsigned int            n_started = 0;
+    unsigned int            n_samples = 0;
+    unsigned int            i;
+    unsigned int            j;
+    uint64_t                start;
+    te_errno                err = 0;
+    int                     val;
+    int                     res = -1;
+
+    if (n_fds == 0 || n_threads == 0 || in->size == 0 ||
+        in->batch == 0 || in->time2run == 0)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                         "Sockets, threads, size, batch and time2run "
+                         "must be positive");
+        return -1;
+    }
+
+    for (i = 0; i < n_cpus; i++)
+    {
+        if (in->cpus.cpus_val[i] < 0)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                             "Invalid CPU number %d", in->cpus.cpus_val[i]);
+            return -1;
+        }
+    }
+
+    if (n_threads > n_fds)
+        n_threads = n_fds;
+    if (in->sample_interval > 0)
+        n_samples = in->time2run / in->sample_interval + 1;
+
+    out->stats.stats_val = TE_ALLOC(n_fds * sizeof(*out->stats.stats_val));
+    out->stats.stats_len = n_fds;
+    ths = TE_ALLOC(n_threads * sizeof(*ths));
+    if (n_cpus > 0)
+    {
+        cpu_start = TE_ALLOC(n_cpus * sizeof(*cpu_start));
+        out->cpu.cpu_val = TE_ALLOC(n_cpus * sizeof(*out->cpu.cpu_val));
+        out->cpu.cpu_len = n_cpus;
+    }
+    if (out->stats.stats_val == NULL || ths == NULL ||
+        (n_cpus > 0 && (cpu_start == NULL || out->cpu.cpu_val == NULL)))
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate memory");
+        goto cleanup;
+    }
+
+    for (i = 0; i < n_threads; i++)
+    {
+        traffic_engine_thread *th = &ths[i];
+
+        th->in = in;
+        th->stats = out->stats.stats_val;
+        th->stop = in->stop == RPC_NULL ? NULL :
+                                          rcf_pch_mem_get(in->stop);
+        th->n_samples = n_samples;
+        th->interval = (uint64_t)in->sample_interval * 1000000;
+        th->cpu = n_cpus == 0 ? -1 : in->cpus.cpus_val[i % n_cpus];
+        th->n_socks = n_fds / n_threads + (i < n_fds % n_threads);
+        th->pfds = TE_ALLOC(th->n_socks * sizeof(*th->pfds));
+        th->sock_idx = TE_ALLOC(th->n_socks * sizeof(*th->sock_idx));
+        if (th->pfds == NULL || th->sock_idx == NULL)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                             "Failed to allocate memory");
+            goto cleanup;
+        }
+
+        for (j = 0; j < th->n_socks; j++)
+        {
+            th->sock_idx[j] = i + j * n_threads;
+            th->pfds[j].fd = in->fds.fds_val[th->sock_idx[j]];
+            th->pfds[j].events = in->snd ? POLLOUT : POLLIN;
+        }
+
+        err = traffic_engine_thread_init(th);
+        if (err != 0)
+        {
+            te_rpc_error_set(err, "Failed to initialize thread %u", i);
+            goto cleanup;
+        }
+    }
+
+    for (n_nonblock = 0; n_nonblock < n_fds; n_nonblock++)
+    {
+        val = 1;
+        if (ioctl(in->fds.fds_val[n_nonblock], FIONBIO, &val) < 0)
+        {
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                             "Failed to set socket %d to non-blocking mode",
+                             in->fds.fds_val[n_nonblock]);
+            goto cleanup;
+        }
+    }
+
+    if (n_cpus > 0)
+    {
+        err = traffic_engine_cpu_times(in->cpus.cpus_val, n_cpus, cpu_start);
+        if (err != 0)
+        {
+            te_rpc_error_set(err, "Failed to get CPU times");
+            goto cleanup;
+        }
+    }
+
+    start = mono_time_ns();
+    for (n_started = 0; n_started < n_threads; n_started++)
+    {
+        ths[n_started].start = start;
+        ths[n_started].deadline = start +
+                                  (uint64_t)in->time2run * 1000000;
+
+        err = traffic_engine_thread_start(&ths[n_started]);
+        if (err != 0)
+        {
+            te_rpc_error_set(err, "Failed to create thread %u", n_started);
+            break;
+        }
+    }
+
+    for (i = 0; i < n_started; i++)
+    {
+        pthread_join(ths[i].thread, NULL);
+        if (ths[i].err != 0 && err == 0)
+        {
+            err = ths[i].err;
+            te_rpc_error_set(err, "Thread %u failed", i);
+        }
+    }
+    out->duration = (mono_time_ns() - start) / 1000;
+
+    if (err != 0)
+        goto cleanup;
+
+    if (n_cpus > 0)
+    {
+        err = traffic_engine_cpu_times(in->cpus.cpus_val, n_cpus,
+                                       out->cpu.cpu_val);
+        if (err != 0)
+        {
+            te_rpc_error_set(err, "Failed to get CPU times");
+            goto cleanup;
+        }
+
+        for (i = 0; i < n_cpus; i++)
+        {
+            out->cpu.cpu_val[i].busy -= cpu_start[i].busy;
+            out->cpu.cpu_val[i].total -= cpu_start[i].total;
+        }
+    }
+
+    for (i = 0; i < n_threads; i++)
+    {
+        if (ths[i].last_sample > out->samples.samples_len)
+            out->samples.samples_len = ths[i].last_sample;
+    }
+    if (out->samples.samples_len > 0)
+    {
+        out->samples.samples_val =
+            TE_ALLOC(out->samples.samples_len *
+                     sizeof(*out->samples.samples_val));
+        if (out->samples.samples_val == NULL)
+        {
+            out->samples.samples_len = 0;
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                             "Failed to allocate memory");
+            goto cleanup;
+        }
+
+        for (i = 0; i < n_threads; i++)
+        {
+            for (j = 0; j < ths[i].last_sample; j++)
+                out->samples.samples_val[j] += ths[i].samples[j];
+        }
+    }
+
+    res = 0;
+
+cleanup:
+    for (i = 0; i < n_nonblock; i++)
+    {
+        val = 0;
+        ioctl(in->fds.fds_val[i], FIONBIO, &val);
+    }
+
+    if (ths != NULL)
+    {
+        for (i = 0; i < n_threads; i++)
+            traffic_engine_thread_clean(&ths[i]);
+        free(ths);
+    }
+    free(cpu_start);
+
+    return res;
+}
+
+TARPC_FUNC_STATIC(sockts_traffic_engine, {},
+{
+    MAKE_CALL(out->retval = func(in, out));
+})
+
+/*-------------- sockts_get_cpus() --------------------------*/
+
+/**
+ * Get CPUs the RPC server process is allowed to run on.
+ *
+ * @param out     Output RPC argument.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+sockts_get_cpus(tarpc_sockts_get_cpus_out *out)
+{
+#ifdef CPU_SET
+    cpu_set_t       set;
+    unsigned int    n = 0;
+    int             i;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    {
+        te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                         "sched_getaffinity() failed");
+        return -1;
+    }
+
+    out->cpus.cpus_val = TE_ALLOC(CPU_COUNT(&set) *
+                                  sizeof(*out->cpus.cpus_val));
+    if (out->cpus.cpus_val == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate memory");
+        return -1;
+    }
+
+    for (i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (CPU_ISSET(i, &set))
+            out->cpus.cpus_val[n++] = i;
+    }
+    out->cpus.cpus_len = n;
+
+    return 0;
+#else
+    UNUSED(out);
+    te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EOPNOTSUPP),
+                     "CPU affinity is not supported");
+    return -1;
+#endif
+}
+
+TARPC_FUNC_STATIC(sockts_get_cpus, {},
+{
+    MAKE_CALL(out->retval = func(out));
+})
+
+/*-------------- sockts_conn_rate() --------------------------*/
+
+/** Maximum number of connect latencies saved by a thread. */
+#define CONN_RATE_MAX_LAT (1024 * 1024)
+
+/** Maximum number of connections in flight per thread. */
+#define CONN_RATE_MAX_WINDOW 4096
+
+/** Time to wait for events before checking the deadline, ms. */
+#define CONN_RATE_WAIT_TIMEOUT 100
+
+/** Maximum number of events retrieved at once by an accepting thread. */
+#define CONN_RATE_ACC_EVENTS 64
+
+/** Functions used by sockts_conn_rate(). */
+typedef struct conn_rate_funcs {
+    api_func socket;            /**< socket() */
+    api_func connect;           /**< connect() */
+    api_func accept4;           /**< accept4() */
+    api_func close;             /**< close() */
+    api_func getsockopt;        /**< getsockopt() */
+    api_func send;              /**< send() */
+    api_func recv;              /**< recv() */
+    api_func epoll_create;      /**< epoll_create() */
+    api_func epoll_ctl;         /**< epoll_ctl() */
+    api_func epoll_wait;        /**< epoll_wait() */
+} conn_rate_funcs;
+
+/** State shared by sockts_conn_rate() threads. */
+typedef struct conn_rate_ctx {
+    tarpc_sockts_conn_rate_in  *in;         /**< RPC input */
+    conn_rate_funcs             f;          /**< Resolved functions */
+    struct sockaddr_storage     addr;       /**< Address to connect to */
+    socklen_t                   addr_len;   /**< Length of @a addr */
+    uint64_t                    deadline;   /**< Finish time, ns */
+    te_bool                     connect_done; /**< All connecting threads
+                                                   finished */
+} conn_rate_ctx;
+
+/** Stage of a connection. */
+typedef enum conn_rate_state {
+    CONN_RATE_CONNECTING,   /**< Waiting for connect() completion */
+    CONN_RATE_REQUEST,      /**< Transferring request */
+    CONN_RATE_RESPONSE,     /**< Transferring response */
+} conn_rate_state;
+
+/** Connection served by an accepting thread. */
+typedef struct conn_rate_conn {
+    te_bool         open;   /**< The socket is open */
+    conn_rate_state state;  /**< Receiving request or sending response */
+    unsigned int    off;    /**< Bytes of request or response
+                                 transferred */
+} conn_rate_conn;
+
+/** Connecting or accepting thread of sockts_conn_rate(). */
+typedef struct conn_rate_thread {
+    conn_rate_ctx  *ctx;        /**< Shared state */
+    pthread_t       thread;     /**< Thread ID */
+    int             listener;   /**< Listening socket of accepting
+                                     thread */
+    uint64_t        connected;  /**< Established connections */
+    uint64_t        failed;     /**< Failed connection attempts or
+                                     exchanges */
+    uint64_t        completed;  /**< Completed exchanges */
+    uint64_t        accepted;   /**< Accepted connections */
+    uint64_t        served;     /**< Answered requests */
+    uint64_t       *lat;        /**< Connect latencies or accept4()
+                                     times, ns */
+    unsigned int    n_lat;      /**< Number of saved latencies */
+    char           *buf;        /**< Request/response buffer */
+    conn_rate_conn *conns;      /**< Served connections indexed by
+                                     socket */
+    unsigned int    n_conns;    /**< Number of items in @a conns */
+    te_errno        err;        /**< Error occurred in the thread */
+} conn_rate_thread;
+
+/** Connection in flight. */
+typedef struct conn_rate_slot {
+    int             fd;     /**< Socket or @c -1 if the slot is free */
+    uint64_t        start;  /**< When connect() was called, ns */
+    conn_rate_state state;  /**< Stage of the connection */
+    unsigned int    off;    /**< Bytes of request or response
+                                 transferred */
+} conn_rate_slot;
+
+/**
+ * Append a socket to a dynamic array of sockets kept open until
+ * the end of sockts_conn_rate().
+ *
+ * @param fds     Array (reallocated).
+ * @param n       Number of items (updated).
+ * @param size    Allocated items (updated).
+ * @param fd      Socket.
+ *
+ * @return Status code.
+ */
+static te_errno
+conn_rate_keep(int **fds, unsigned int *n, unsigned int *size, int fd)
+{
+    int *p;
+
+    if (*n == *size)
+    {
+        p = realloc(*fds, (*size == 0 ? 1024 : *size * 2) * sizeof(*p));
+        if (p == NULL)
+            return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+
+        *fds = p;
+        *size = *size == 0 ? 1024 : *size * 2;
+    }
+
+    (*fds)[(*n)++] = fd;
+    return 0;
+}
+
+/**
+ * Account an established connection.
+ *
+ * @param th      Thread context.
+ * @param slot    Connection slot.
+ */
+static void
+conn_rate_connected(conn_rate_thread *th, conn_rate_slot *slot)
+{
+    th->connected++;
+    if (th->n_lat < CONN_RATE_MAX_LAT)
+        th->lat[th->n_lat++] = mono_time_ns() - slot->start;
+}
+
+/**
+ * Finish a connection attempt or a request/response exchange: account
+ * its result and close or keep the socket.
+ *
+ * @param th      Thread context.
+ * @param slot    Connection slot (released).
+ * @param err     Connection error (@c 0 on success).
+ * @param kept    Array of kept sockets.
+ * @param n_kept  Number of kept sockets.
+ * @param kept_size Allocated size of @p kept.
+ */
+static void
+conn_rate_done(conn_rate_thread *th, conn_rate_slot *slot, int err,
+               int **kept, unsigned int *n_kept, unsigned int *kept_size)
+{
+    conn_rate_ctx *ctx = th->ctx;
+
+    if (err != 0)
+        th->failed++;
+    else if (slot->state == CONN_RATE_CONNECTING)
+        conn_rate_connected(th, slot);
+    else
+        th->completed++;
+
+    if (err != 0 || !ctx->in->keep ||
+        conn_rate_keep(kept, n_kept, kept_size, slot->fd) != 0)
+        ctx->f.close(slot->fd);
+
+    slot->fd = -1;
+}
+
+/**
+ * Process an event on a connection in flight: complete connection
+ * establishment, send request or receive response.
+ *
+ * @param th      Thread context.
+ * @param epfd    Epoll set of the thread.
+ * @param idx     Index of the connection slot.
+ * @param slots   Connection slots.
+ * @param kept    Array of kept sockets.
+ * @param n_kept  Number of kept sockets.
+ * @param kept_size Allocated size of @p kept.
+ *
+ * @return @c TRUE if the slot is released.
+ */
+static te_bool
+conn_rate_event(conn_rate_thread *th, int epfd, unsigned int idx,
+                conn_rate_slot *slots, int **kept, unsigned int *n_kept,
+                unsigned int *kept_size)
+{
+    conn_rate_ctx      *ctx = th->ctx;
+    conn_rate_funcs    *f = &ctx->f;
+    conn_rate_slot     *slot = &slots[idx];
+    unsigned int        req_size = ctx->in->req_size;
+    struct epoll_event  ev;
+    socklen_t           optlen;
+    int                 err = 0;
+    int                 len;
+
+    memset(&ev, 0, sizeof(ev));
+
+    switch (slot->state)
+    {
+        case CONN_RATE_CONNECTING:
+            optlen = sizeof(err);
+            if (f->getsockopt(slot->fd, SOL_SOCKET, SO_ERROR,
+                              &err, &optlen) < 0)
+                err = errno;
+            if (err != 0 || req_size == 0)
+                break;
+
+            conn_rate_connected(th, slot);
+            slot->state = CONN_RATE_REQUEST;
+            slot->off = 0;
+            /* The socket is writable, send request right now. */
+            /* FALLTHROUGH */
+
+        case CONN_RATE_REQUEST:
+            len = f->send(slot->fd, th->buf, req_size - slot->off,
+                          MSG_NOSIGNAL);
+            if (len < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return FALSE;
+                err = errno;
+                break;
+            }
+
+            slot->off += len;
+            if (slot->off < req_size)
+                return FALSE;
+
+            slot->state = CONN_RATE_RESPONSE;
+            slot->off = 0;
+            ev.events = EPOLLIN;
+            ev.data.u32 = idx;
+            if (f->epoll_ctl(epfd, EPOLL_CTL_MOD, slot->fd, &ev) < 0)
+            {
+                err = errno;
+                break;
+            }
+            return FALSE;
+
+        case CONN_RATE_RESPONSE:
+            len = f->recv(slot->fd, th->buf, req_size - slot->off, 0);
+            if (len < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return FALSE;
+                err = errno;
+                break;
+            }
+            if (len == 0)
+            {
+                err = ECONNRESET;
+                break;
+            }
+
+            slot->off += len;
+            if (slot->off < req_size)
+                return FALSE;
+            break;
+    }
+
+    f->epoll_ctl(epfd, EPOLL_CTL_DEL, slot->fd, &ev);
+    conn_rate_done(th, slot, err, kept, n_kept, kept_size);
+    return TRUE;
+}
+
+/**
+ * Open connections with non-blocking connect() keeping a window of
+ * connections in flight, wait for their completion with epoll. If
+ * request size is specified, send a request over every established
+ * connection and wait for a response of the same size before closing it.
+ *
+ * @param arg     Thread context.
+ *
+ * @return @c NULL.
+ */
+static void *
+conn_rate_connect_thread(void *arg)
+{
+    conn_rate_thread   *th = arg;
+    conn_rate_ctx      *ctx = th->ctx;
+    conn_rate_funcs    *f = &ctx->f;
+    unsigned int        window = ctx->in->window;
+    unsigned int        num = ctx->in->num;
+    conn_rate_slot     *slots = NULL;
+    struct epoll_event *evts = NULL;
+    struct epoll_event  ev;
+    int                *kept = NULL;
+    unsigned int        n_kept = 0;
+    unsigned int        kept_size = 0;
+    unsigned int        in_flight = 0;
+    unsigned int        started = 0;
+    unsigned int        free_slot = 0;
+    unsigned int        i;
+    uint64_t            now;
+    int                 epfd = -1;
+    int                 timeout;
+    int                 rc;
+    int                 s;
+
+    slots = TE_ALLOC(window * sizeof(*slots));
+    evts = TE_ALLOC(window * sizeof(*evts));
+    th->lat = TE_ALLOC(CONN_RATE_MAX_LAT * sizeof(*th->lat));
+    th->buf = TE_ALLOC(MAX(ctx->in->req_size, 1));
+    if (slots == NULL || evts == NULL || th->lat == NULL || th->buf == NULL)
+    {
+        th->err = TE_RC(TE_TA_UNIX, TE_ENOMEM);
+        goto cleanup;
+    }
+    for (i = 0; i < window; i++)
+        slots[i].fd = -1;
+
+    epfd = f->epoll_create(window);
+    if (epfd < 0)
+    {
+        th->err = TE_OS_RC(TE_TA_UNIX, errno);
+        ERROR("%s(): epoll_create() failed: %r", __FUNCTION__, th->err);
+        goto cleanup;
+    }
+
+    while (TRUE)
+    {
+        now = mono_time_ns();
+        if (now >= ctx->deadline)
+            break;
+
+        while (in_flight < window && (num == 0 || started < num))
+        {
+            while (slots[free_slot].fd >= 0)
+                free_slot = (free_slot + 1) % window;
+
+            s = f->socket(ctx->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK,
+                          0);
+            if (s < 0)
+            {
+                /* Out of fds is an expected limit when keeping sockets. */
+                if (errno == EMFILE || errno == ENFILE)
+                {
+                    RING("%s(): socket() failed with %r, stop connecting",
+                         __FUNCTION__, TE_OS_RC(TE_TA_UNIX, errno));
+                    num = started;
+                    break;
+                }
+
+                th->err = TE_OS_RC(TE_TA_UNIX, errno);
+                ERROR("%s(): socket() failed: %r", __FUNCTION__, th->err);
+                goto cleanup;
+            }
+
+            started++;
+            slots[free_slot].fd = s;
+            slots[free_slot].state = CONN_RATE_CONNECTING;
+            slots[free_slot].start = mono_time_ns();
+            rc = f->connect(s, SA(&ctx->addr), ctx->addr_len);
+            if ((rc == 0 && ctx->in->req_size == 0) ||
+                (rc != 0 && errno != EINPROGRESS))
+            {
+                conn_rate_done(th, &slots[free_slot], rc == 0 ? 0 : errno,
+                               &kept, &n_kept, &kept_size);
+                continue;
+            }
+
+            /*
+             * Connection established at once is reported writable,
+             * so the request is sent when its event is processed.
+             */
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLOUT;
+            ev.data.u32 = free_slot;
+            if (f->epoll_ctl(epfd, EPOLL_CTL_ADD, s, &ev) < 0)
+            {
+                th->err = TE_OS_RC(TE_TA_UNIX, errno);
+                ERROR("%s(): epoll_ctl() failed: %r", __FUNCTION__, th->err);
+                goto cleanup;
+            }
+            in_flight++;
+        }
+
+        if (in_flight == 0)
+            break;
+
+        timeout = (ctx->deadline - now + 999999) / 1000000;
+        rc = f->epoll_wait(epfd, evts, window,
+                           MIN(timeout, CONN_RATE_WAIT_TIMEOUT));
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            th->err = TE_OS_RC(TE_TA_UNIX, errno);
+            ERROR("%s(): epoll_wait() failed: %r", __FUNCTION__, th->err);
+            goto cleanup;
+        }
+
+        for (i = 0; i < (unsigned int)rc; i++)
+        {
+            if (conn_rate_event(th, epfd, evts[i].data.u32, slots,
+                                &kept, &n_kept, &kept_size))
+                in_flight--;
+        }
+    }
+
+cleanup:
+    for (i = 0; slots != NULL && i < window; i++)
+    {
+        if (slots[i].fd >= 0)
+            f->close(slots[i].fd);
+    }
+    for (i = 0; i < n_kept; i++)
+        f->close(kept[i]);
+    if (epfd >= 0)
+        f->close(epfd);
+
+    free(kept);
+    free(evts);
+    free(slots);
+    return NULL;
+}
+
+/**
+ * Start serving an accepted connection: add it to the epoll set to
+ * receive a request.
+ *
+ * @param th      Thread context.
+ * @param epfd    Epoll set of the thread.
+ * @param s       Accepted socket.
+ *
+ * @return Status code.
+ */
+static te_errno
+conn_rate_serve_add(conn_rate_thread *th, int epfd, int s)
+{
+    struct epoll_event  ev;
+    conn_rate_conn     *p;
+    unsigned int        n;
+
+    if ((unsigned int)s >= th->n_conns)
+    {
+        n = MAX(th->n_conns, 1024);
+        while (n <= (unsigned int)s)
+            n *= 2;
+
+        p = realloc(th->conns, n * sizeof(*p));
+        if (p == NULL)
+            return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+
+        memset(p + th->n_conns, 0, (n - th->n_conns) * sizeof(*p));
+        th->conns = p;
+        th->n_conns = n;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = s;
+    if (th->ctx->f.epoll_ctl(epfd, EPOLL_CTL_ADD, s, &ev) < 0)
+        return TE_OS_RC(TE_TA_UNIX, errno);
+
+    th->conns[s].open = TRUE;
+    th->conns[s].state = CONN_RATE_REQUEST;
+    th->conns[s].off = 0;
+
+    return 0;
+}
+
+/**
+ * Process an event on a served connection: receive request and send
+ * response of the same size, then close the connection.
+ *
+ * @param th      Thread context.
+ * @param epfd    Epoll set of the thread.
+ * @param s       Socket of the connection.
+ */
+static void
+conn_rate_serve(conn_rate_thread *th, int epfd, int s)
+{
+    conn_rate_funcs    *f = &th->ctx->f;
+    conn_rate_conn     *conn = &th->conns[s];
+    unsigned int        req_size = th->ctx->in->req_size;
+    struct epoll_event  ev;
+    int                 len;
+
+    memset(&ev, 0, sizeof(ev));
+
+    switch (conn->state)
+    {
+        case CONN_RATE_REQUEST:
+            len = f->recv(s, th->buf, req_size - conn->off, 0);
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return;
+            if (len <= 0)
+            {
+                th->failed++;
+                break;
+            }
+
+            conn->off += len;
+            if (conn->off < req_size)
+                return;
+
+            conn->state = CONN_RATE_RESPONSE;
+            conn->off = 0;
+            /* FALLTHROUGH */
+
+        case CONN_RATE_RESPONSE:
+            len = f->send(s, th->buf, req_size - conn->off, MSG_NOSIGNAL);
+            if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                th->failed++;
+                break;
+            }
+
+            if (len > 0)
+                conn->off += len;
+            if (conn->off < req_size)
+            {
+                ev.events = EPOLLOUT;
+                ev.data.fd = s;
+                if (f->epoll_ctl(epfd, EPOLL_CTL_MOD, s, &ev) == 0)
+                    return;
+
+                th->failed++;
+                break;
+            }
+
+            th->served++;
+            break;
+
+        default:
+            break;
+    }
+
+    f->epoll_ctl(epfd, EPOLL_CTL_DEL, s, &ev);
+    f->close(s);
+    conn->open = FALSE;
+}
+
+/**
+ * Accept connections on a non-blocking listening socket until the time
+ * is out, or until connecting threads finish and the accept queue is
+ * empty. If request size is specified, answer a request on every
+ * accepted connection and close it.
+ *
+ * @param arg     Thread context.
+ *
+ * @return @c NULL.
+ */
+static void *
+conn_rate_accept_thread(void *arg)
+{
+    conn_rate_thread   *th = arg;
+    conn_rate_ctx      *ctx = th->ctx;
+    conn_rate_funcs    *f = &ctx->f;
+    int                 listener = th->listener;
+    unsigned int        req_size = ctx->in->req_size;
+    int                *kept = NULL;
+    unsigned int        n_kept = 0;
+    unsigned int        kept_size = 0;
+    unsigned int        i;
+    struct epoll_event  evts[CONN_RATE_ACC_EVENTS];
+    struct epoll_event  ev;
+    uint64_t            start;
+    uint64_t            now;
+    int                 epfd = -1;
+    int                 timeout;
+    int                 rc;
+    int                 s;
+
+    th->lat = TE_ALLOC(CONN_RATE_MAX_LAT * sizeof(*th->lat));
+    th->buf = TE_ALLOC(MAX(req_size, 1));
+    if (th->lat == NULL || th->buf == NULL)
+    {
+        th->err = TE_RC(TE_TA_UNIX, TE_ENOMEM);
+        goto cleanup;
+    }
+
+    epfd = f->epoll_create(1);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    if (epfd < 0 || f->epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev) < 0)
+    {
+        th->err = TE_OS_RC(TE_TA_UNIX, errno);
+        ERROR("%s(): failed to create epoll set: %r", __FUNCTION__, th->err);
+        goto cleanup;
+    }
+
+    while (TRUE)
+    {
+        start = mono_time_ns();
+        s = f->accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+        if (s >= 0)
+        {
+            th->accepted++;
+            if (th->n_lat < CONN_RATE_MAX_LAT)
+                th->lat[th->n_lat++] = mono_time_ns() - start;
+
+            if (req_size > 0)
+            {
+                if (conn_rate_serve_add(th, epfd, s) != 0)
+                {
+                    th->failed++;
+                    f->close(s);
+                }
+            }
+            else if (!ctx->in->keep ||
+                     conn_rate_keep(&kept, &n_kept, &kept_size, s) != 0)
+            {
+                f->close(s);
+            }
+            continue;
+        }
+
+        if (errno == EMFILE || errno == ENFILE)
+        {
+            RING("%s(): accept4() failed with %r, stop accepting",
+                 __FUNCTION__, TE_OS_RC(TE_TA_UNIX, errno));
+            break;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != ECONNABORTED && errno != EINTR)
+        {
+            th->err = TE_OS_RC(TE_TA_UNIX, errno);
+            ERROR("%s(): accept4() failed: %r", __FUNCTION__, th->err);
+            break;
+        }
+
+        now = mono_time_ns();
+        if (now >= ctx->deadline)
+            break;
+
+        timeout = (ctx->deadline - now + 999999) / 1000000;
+        rc = f->epoll_wait(epfd, evts, CONN_RATE_ACC_EVENTS,
+                           MIN(timeout, CONN_RATE_WAIT_TIMEOUT));
+        /* Connections established by peer may still be queued. */
+        if (rc <= 0 && __atomic_load_n(&ctx->connect_done, __ATOMIC_ACQUIRE))
+            break;
+
+        for (i = 0; rc > 0 && i < (unsigned int)rc; i++)
+        {
+            if (evts[i].data.fd != listener)
+                conn_rate_serve(th, epfd, evts[i].data.fd);
+        }
+    }
+
+cleanup:
+    for (i = 0; i < th->n_conns; i++)
+    {
+        if (th->conns[i].open)
+            f->close(i);
+    }
+    for (i = 0; i < n_kept; i++)
+        f->close(kept[i]);
+    if (epfd >= 0)
+        f->close(epfd);
+
+    free(th->conns);
+    free(kept);
+    return NULL;
+}
+
+/**
+ * Merge latencies saved by threads and get their percentiles.
+ *
+ * @param ths       Threads.
+ * @param n_threads Number of threads.
+ * @param pct       Percentiles multiplied by 10, @c 0 for minimum and
+ *                  @c 1000 for maximum.
+ * @param n_pct     Number of percentiles.
+ * @param res       Where to save values of percentiles.
+ *
+ * @return Status code.
+ */
+static te_errno
+conn_rate_lat_pct(const conn_rate_thread *ths, unsigned int n_threads,
+                  const unsigned int *pct, unsigned int n_pct,
+                  uint64_t **res)
+{
+    uint64_t       *lat;
+    unsigned int    n_lat = 0;
+    unsigned int    i;
+
+    for (i = 0; i < n_threads; i++)
+        n_lat += ths[i].n_lat;
+    if (n_lat == 0)
+        return 0;
+
+    lat = TE_ALLOC(n_lat * sizeof(*lat));
+    if (lat == NULL)
+        return TE_RC(TE_TA_UNIX, TE_ENOMEM);
+
+    for (i = 0, n_lat = 0; i < n_threads; i++)
+    {
+        memcpy(lat + n_lat, ths[i].lat, ths[i].n_lat * sizeof(*lat));
+        n_lat += ths[i].n_lat;
+    }
+    qsort(lat, n_lat, sizeof(*lat), u64_cmp);
+
+    for (i = 0; i < n_pct; i++)
+        *res[i] = u64_sorted_pct(lat, n_lat, pct[i]);
+
+    free(lat);
+    return 0;
+}
+
+/**
+ * Measure connection establishment rate: open connections from
+ * multiple threads with non-blocking connect(), each thread keeping
+ * a window of connections in flight, and/or accept connections on
+ * listening sockets (a thread per socket). Connections are closed as
+ * soon as they are established (so that sockets may be reused), kept
+ * until the end, or closed after a request/response exchange.
+ *
+ * @param in      RPC input.
+ * @param out     RPC output.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+sockts_conn_rate(tarpc_sockts_conn_rate_in *in,
+                 tarpc_sockts_conn_rate_out *out)
+{
+    static const unsigned int pct[] = { 0, 500, 900, 990, 999, 1000 };
+
+    tarpc_sockts_conn_rate_stats *stats = &out->stats;
+
+    uint64_t           *lat_res[] = { &stats->lat_min, &stats->lat_p50,
+                                      &stats->lat_p90, &stats->lat_p99,
+                                      &stats->lat_p999, &stats->lat_max };
+    uint64_t           *acc_lat_res[] = { &stats->acc_lat_min,
+                                          &stats->acc_lat_p50,
+                                          &stats->acc_lat_p90,
+                                          &stats->acc_lat_p99,
+                                          &stats->acc_lat_p999,
+                                          &stats->acc_lat_max };
+    conn_rate_ctx       ctx;
+    conn_rate_thread   *ths = NULL;
+    conn_rate_thread   *accs = NULL;
+    unsigned int        n_threads = 0;
+    unsigned int        n_started = 0;
+    unsigned int        n_listeners = in->listeners.listeners_len;
+    unsigned int        n_acc_started = 0;
+    struct sockaddr    *addr;
+    uint64_t            start;
+    unsigned int        i;
+    te_errno            rc;
+    int                 val = 1;
+    int                 res = -1;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.in = in;
+
+    if (in->addr.addr_len > 0)
+    {
+        n_threads = in->threads;
+        if (n_threads == 0 || in->window == 0 ||
+            in->window > CONN_RATE_MAX_WINDOW)
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                             "Invalid number of threads or window size");
+            return -1;
+        }
+
+        rc = sockaddr_rpc2h(in->addr.addr_val, SA(&ctx.addr),
+                            sizeof(ctx.addr), &addr, &ctx.addr_len);
+        if (rc != 0)
+        {
+            te_rpc_error_set(rc, "Failed to convert address");
+            return -1;
+        }
+        if (addr != SA(&ctx.addr))
+            memcpy(&ctx.addr, addr, ctx.addr_len);
+    }
+    else if (n_listeners == 0)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                         "Neither address nor listener is specified");
+        return -1;
+    }
+
+    if ((rc = tarpc_find_func(in->common.lib_flags, "socket",
+                              &ctx.f.socket)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "connect",
+                              &ctx.f.connect)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "accept4",
+                              &ctx.f.accept4)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "close",
+                              &ctx.f.close)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "getsockopt",
+                              &ctx.f.getsockopt)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "send",
+                              &ctx.f.send)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "recv",
+                              &ctx.f.recv)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "epoll_create",
+                              &ctx.f.epoll_create)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "epoll_ctl",
+                              &ctx.f.epoll_ctl)) != 0 ||
+        (rc = tarpc_find_func(in->common.lib_flags, "epoll_wait",
+                              &ctx.f.epoll_wait)) != 0)
+    {
+        te_rpc_error_set(rc, "Failed to resolve functions");
+        return -1;
+    }
+
+    ths = TE_ALLOC(MAX(n_threads, 1) * sizeof(*ths));
+    accs = TE_ALLOC(MAX(n_listeners, 1) * sizeof(*accs));
+    if (ths == NULL || accs == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate memory");
+        goto cleanup;
+    }
+
+    for (i = 0; i < n_listeners; i++)
+    {
+        if (ioctl(in->listeners.listeners_val[i], FIONBIO, &val) < 0)
+        {
+            rc = TE_OS_RC(TE_TA_UNIX, errno);
+            ERROR("%s(): failed to make listener non-blocking: %r",
+                  __FUNCTION__, rc);
+            n_listeners = i;
+            goto restore;
+        }
+    }
+
+    start = mono_time_ns();
+    ctx.deadline = start + (uint64_t)in->time2run * 1000000;
+
+    for (n_acc_started = 0; n_acc_started < n_listeners; n_acc_started++)
+    {
+        accs[n_acc_started].ctx = &ctx;
+        accs[n_acc_started].listener =
+            in->listeners.listeners_val[n_acc_started];
+        rc = pthread_create(&accs[n_acc_started].thread, NULL,
+                            conn_rate_accept_thread, &accs[n_acc_started]);
+        if (rc != 0)
+        {
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, rc),
+                             "Failed to create accepting thread %u",
+                             n_acc_started);
+            break;
+        }
+    }
+
+    for (n_started = 0;
+         n_acc_started == n_listeners && n_started < n_threads;
+         n_started++)
+    {
+        ths[n_started].ctx = &ctx;
+        rc = pthread_create(&ths[n_started].thread, NULL,
+                            conn_rate_connect_thread, &ths[n_started]);
+        if (rc != 0)
+        {
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, rc),
+                             "Failed to create thread %u", n_started);
+            break;
+        }
+    }
+
+    rc = 0;
+    for (i = 0; i < n_started; i++)
+    {
+        pthread_join(ths[i].thread, NULL);
+        if (ths[i].err != 0 && rc == 0)
+            rc = ths[i].err;
+
+        stats->connected += ths[i].connected;
+        stats->failed += ths[i].failed;
+        stats->completed += ths[i].completed;
+    }
+    stats->duration = (mono_time_ns() - start) / 1000;
+
+    /* Accepting alone runs for the whole time2run. */
+    __atomic_store_n(&ctx.connect_done, n_threads > 0, __ATOMIC_RELEASE);
+    for (i = 0; i < n_acc_started; i++)
+    {
+        pthread_join(accs[i].thread, NULL);
+        if (accs[i].err != 0 && rc == 0)
+            rc = accs[i].err;
+
+        stats->accepted += accs[i].accepted;
+        stats->served += accs[i].served;
+        stats->failed += accs[i].failed;
+    }
+    if (n_threads == 0)
+        stats->duration = (mono_time_ns() - start) / 1000;
+
+restore:
+    for (i = 0; i < n_listeners; i++)
+    {
+        val = 0;
+        ioctl(in->listeners.listeners_val[i], FIONBIO, &val);
+    }
+
+    if (rc != 0)
+    {
+        te_rpc_error_set(rc, "Connection rate test failed");
+        goto cleanup;
+    }
+    if (n_started < n_threads || n_acc_started < n_listeners)
+        goto cleanup;
+
+    if ((rc = conn_rate_lat_pct(ths, n_threads, pct, TE_ARRAY_LEN(pct),
+                                lat_res)) != 0 ||
+        (rc = conn_rate_lat_pct(accs, n_listeners, pct, TE_ARRAY_LEN(pct),
+                                acc_lat_res)) != 0)
+    {
+        te_rpc_error_set(rc, "Failed to get latency percentiles");
+        goto cleanup;
+    }
+
+    res = 0;
+
+cleanup:
+    for (i = 0; ths != NULL && i < n_threads; i++)
+    {
+        free(ths[i].lat);
+        free(ths[i].buf);
+    }
+    for (i = 0; accs != NULL && i < in->listeners.listeners_len; i++)
+    {
+        free(accs[i].lat);
+        free(accs[i].buf);
+    }
+    free(ths);
+    free(accs);
+
+    return res;
+}
+
+TARPC_FUNC_STATIC(sockts_conn_rate, {},
+{
+    MAKE_CALL(out->retval = func(in, out));
+})
+
+/*-------------- sockts_epoll_bench() --------------------------*/
+
+/**
+ * Call epoll_ctl() for all sockets and measure average time per call.
+ *
+ * @param epoll_ctl_f   Resolved epoll_ctl().
+ * @param epfd          Epoll FD.
+ * @param op            Operation.
+ * @param sockets       Sockets.
+ * @param n             Number of sockets.
+ * @param ready_num     Number of first sockets which use @p events,
+ *                      the rest use @p idle_events.
+ * @param events        Events of ready sockets.
+ * @param idle_events   Events of the rest sockets.
+ * @param ns_per_op     Where to save average time per call, ns.
+ *
+ * @return @c 0 on success, @c -1 on failure (RPC error is set).
+ */
+static int
+epoll_bench_ctl(api_func epoll_ctl_f, int epfd, int op, const int *sockets,
+                unsigned int n, unsigned int ready_num, uint32_t events,
+                uint32_t idle_events, uint64_t *ns_per_op)
+{
+    struct epoll_event  ev;
+    uint64_t            start;
+    unsigned int        i;
+
+    memset(&ev, 0, sizeof(ev));
+
+    start = mono_time_ns();
+    for (i = 0; i < n; i++)
+    {
+        ev.events = i < ready_num ? events : idle_events;
+        ev.data.u32 = i;
+        if (epoll_ctl_f(epfd, op, sockets[i], &ev) != 0)
+        {
+            te_rpc_error_set(TE_OS_RC(TE_RPC, errno),
+                             "epoll_ctl(%d) failed for socket %d",
+                             op, sockets[i]);
+            return -1;
+        }
+    }
+    *ns_per_op = (mono_time_ns() - start) / n;
+
+    return 0;
+}
+
+/**
+ * Measure scalability of epoll: average cost of epoll_ctl() ADD, MOD and
+ * DEL operations over a set of sockets, latency of epoll_wait() when
+ * a part of the sockets is ready, and fairness of reporting events
+ * of the ready sockets when they do not fit in @a maxevents.
+ *
+ * @param in      RPC input.
+ * @param out     RPC output.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+sockts_epoll_bench(tarpc_sockts_epoll_bench_in *in,
+                   tarpc_sockts_epoll_bench_out *out)
+{
+    tarpc_sockts_epoll_bench_stats *stats = &out->stats;
+
+    api_func            epoll_create_f;
+    api_func            epoll_ctl_f;
+    api_func            epoll_wait_f;
+    api_func            close_f;
+    int                *sockets;
+    unsigned int        n = in->socks_num;
+    unsigned int        ready_num = MIN(in->ready_num, n);
+    uint32_t            events = epoll_event_rpc2h(in->events);
+    uint32_t            idle_events = epoll_event_rpc2h(in->idle_events);
+    struct epoll_event *evts = NULL;
+    uint64_t           *lat = NULL;
+    uint64_t           *reported = NULL;
+    uint64_t            sum = 0;
+    uint64_t            sum_sq = 0;
+    uint64_t            start;
+    unsigned int        i;
+    int                 epfd = -1;
+    int                 rc;
+    int                 res = -1;
+
+    sockets = rcf_pch_mem_get(in->socks_arr);
+    if (sockets == NULL || n == 0 || in->maxevents == 0 ||
+        in->wait_calls == 0)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                         "Invalid sockets, maxevents or number of calls");
+        return -1;
+    }
+
+    if (tarpc_find_func(in->common.lib_flags, "epoll_create",
+                        &epoll_create_f) != 0 ||
+        tarpc_find_func(in->common.lib_flags, "epoll_ctl",
+                        &epoll_ctl_f) != 0 ||
+        tarpc_find_func(in->common.lib_flags, "epoll_wait",
+                        &epoll_wait_f) != 0 ||
+        tarpc_find_func(in->common.lib_flags, "close", &close_f) != 0)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOENT),
+                         "fail to resolve functions");
+        return -1;
+    }
+
+    evts = TE_ALLOC(in->maxevents * sizeof(*evts));
+    lat = TE_ALLOC(in->wait_calls * sizeof(*lat));
+    reported = TE_ALLOC(n * sizeof(*reported));
+    if (evts == NULL || lat == NULL || reported == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate memory");
+        goto cleanup;
+    }
+
+    epfd = epoll_create_f(n);
+    if (epfd < 0)
+    {
+        te_rpc_error_set(TE_OS_RC(TE_RPC, errno), "epoll_create() failed");
+        goto cleanup;
+    }
+
+    if (epoll_bench_ctl(epoll_ctl_f, epfd, EPOLL_CTL_ADD, sockets, n,
+                        ready_num, events, idle_events,
+                        &stats->add_ns) != 0 ||
+        epoll_bench_ctl(epoll_ctl_f, epfd, EPOLL_CTL_MOD, sockets, n,
+                        ready_num, events, idle_events,
+                        &stats->mod_ns) != 0)
+        goto cleanup;
+
+    for (i = 0; i < in->wait_calls; i++)
+    {
+        start = mono_time_ns();
+        rc = epoll_wait_f(epfd, evts, in->maxevents, 0);
+        lat[i] = mono_time_ns() - start;
+        if (rc < 0)
+        {
+            te_rpc_error_set(TE_OS_RC(TE_RPC, errno),
+                             "epoll_wait() failed");
+            goto cleanup;
+        }
+
+        stats->events += rc;
+        while (rc-- > 0)
+        {
+            if (evts[rc].data.u32 < n)
+                reported[evts[rc].data.u32]++;
+        }
+    }
+
+    if (epoll_bench_ctl(epoll_ctl_f, epfd, EPOLL_CTL_DEL, sockets, n,
+                        ready_num, events, idle_events,
+                        &stats->del_ns) != 0)
+        goto cleanup;
+
+    qsort(lat, in->wait_calls, sizeof(*lat), u64_cmp);
+    stats->wait_min = lat[0];
+    stats->wait_p50 = u64_sorted_pct(lat, in->wait_calls, 500);
+    stats->wait_p99 = u64_sorted_pct(lat, in->wait_calls, 990);
+    stats->wait_max = lat[in->wait_calls - 1];
+
+    /*
+     * Fairness among ready sockets: the least and the most reported
+     * socket and Jain's index (sum^2 / (n * sum of squares)).
+     */
+    if (ready_num > 0)
+    {
+        stats->fair_min = reported[0];
+        for (i = 0; i < ready_num; i++)
+        {
+            stats->fair_min = MIN(stats->fair_min, reported[i]);
+            stats->fair_max = MAX(stats->fair_max, reported[i]);
+            sum += reported[i];
+            sum_sq += reported[i] * reported[i];
+        }
+        if (sum_sq > 0)
+        {
+            stats->fairness = (double)sum * sum * 1000 /
+                              ((double)ready_num * sum_sq);
+        }
+    }
+    for (i = ready_num; i < n; i++)
+        stats->unexpected += reported[i];
+
+    res = 0;
+
+cleanup:
+    if (epfd >= 0)
+        close_f(epfd);
+    free(evts);
+    free(lat);
+    free(reported);
+
+    return res;
+}
+
+TARPC_FUNC_STATIC(sockts_epoll_bench, {},
+{
+    MAKE_CALL(out->retval = func(in, out));
+})
+
+/*-------------- sockts_zc_send_bench() --------------------------*/
+
+/** Maximum number of buffers in flight in sockts_zc_send_bench() */
+#define ZC_SEND_BENCH_MAX_WINDOW 65536
+
+/** Timeout of poll() when waiting for send completions, ms */
+#define ZC_SEND_BENCH_POLL_TIMEOUT 100
+
+/** How long to wait for the remaining send completions at the end, ms */
+#define ZC_SEND_BENCH_FINISH_TIMEOUT 1000
+
+/** Number of the last completion lags used for percentiles */
+#define ZC_SEND_BENCH_LAG_NUM 65536
+
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && \
+    defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+/** Sending with MSG_ZEROCOPY is supported */
+#define ZC_SEND_BENCH_MSG_ZEROCOPY
+#endif
+
+/**
+ * Get CPU time consumed by the calling thread.
+ *
+ * @param user_us     Where to save user time, in microseconds.
+ * @param sys_us      Where to save system time, in microseconds.
+ */
+static void
+thread_cpu_time(uint64_t *user_us, uint64_t *sys_us)
+{
+#ifdef HAVE_SYS_RESOURCE_H
+    struct rusage ru;
+
+#ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &ru) == 0)
+#else
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+#endif
+    {
+        *user_us = ru.ru_utime.tv_sec * 1000000ULL + ru.ru_utime.tv_usec;
+        *sys_us = ru.ru_stime.tv_sec * 1000000ULL + ru.ru_stime.tv_usec;
+        return;
+    }
+#endif
+
+    *user_us = 0;
+    *sys_us = 0;
+}
+
+#ifdef ONLOAD_SO_ONLOADZC_COMPLETE
+/**
+ * Wait for completion of some buffers sent with onload_zc_send().
+ *
+ * @param q         Completion queue.
+ * @param fd        Socket FD.
+ * @param poll_f    Resolved poll().
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_send_bench_reg_reap(zc_compl_bufs *q, int fd, api_func_ptr poll_f)
+{
+    struct pollfd pfd;
+    int           rc;
+
+    pfd.fd = fd;
+    pfd.events = pfd.revents = 0;
+    rc = poll_f(&pfd, 1, ZC_SEND_BENCH_POLL_TIMEOUT);
+    if (rc < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+
+        te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                         "poll() failed when waiting for completions");
+        return -1;
+    }
+    if (rc == 0)
+        return 0;
+
+    return wait_for_zc_completion(q, FALSE, FALSE, 0);
+}
+
+/**
+ * Send data with onload_zc_send() from a registered buffer split in
+ * @p window chunks. A chunk is reused after completion message arrives
+ * for it.
+ *
+ * @param fd          Socket FD.
+ * @param size        Bytes per send call (chunk size).
+ * @param window      Number of chunks.
+ * @param deadline    When to stop sending (mono_time_ns()).
+ * @param stats       Where to account results.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_send_bench_reg(int fd, size_t size, unsigned int window,
+                  uint64_t deadline,
+                  tarpc_sockts_zc_send_bench_stats *stats)
+{
+    api_func_ptr            zc_send_f;
+    api_func                unreg_f;
+    api_func_ptr            poll_f;
+    zc_compl_bufs           q;
+    zc_compl_buf           *chunks;
+    zc_compl_buf           *chunk;
+    tarpc_sockts_zc_compl_stats cstats;
+    struct onload_zc_mmsg   mmsg;
+    struct onload_zc_iovec  iov;
+    onload_zc_handle        handle = NULL;
+    void                   *mem = MAP_FAILED;
+    size_t                  mem_size = size * window;
+    uint64_t                sent = 0;
+    int                     rc = 0;
+    int                     res;
+
+    TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "onload_zc_send", &zc_send_f);
+    TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "onload_zc_unregister_buffers",
+                  &unreg_f);
+    TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "poll", &poll_f);
+
+    chunks = TE_ALLOC(window * sizeof(*chunks));
+    if (chunks == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate chunks");
+        return -1;
+    }
+
+    if (alloc_register_zc_buf(fd, sockts_zc_reg_buf_type(), &mem_size,
+                              &mem, &handle) < 0)
+    {
+        free(chunks);
+        return -1;
+    }
+    te_fill_buf(mem, size * window);
+
+    zc_compl_bufs_init(&q);
+
+    memset(&mmsg, 0, sizeof(mmsg));
+    mmsg.fd = fd;
+    mmsg.msg.iov = &iov;
+    mmsg.msg.msghdr.msg_iovlen = 1;
+
+    while (mono_time_ns() < deadline)
+    {
+        chunk = &chunks[sent % window];
+        if (zc_compl_bufs_find(&q, chunk) != NULL)
+        {
+            stats->window_waits++;
+            if (zc_send_bench_reg_reap(&q, fd, poll_f) < 0)
+            {
+                rc = -1;
+                break;
+            }
+            continue;
+        }
+
+        chunk->fd = fd;
+        chunk->ptr = (uint8_t *)mem + (sent % window) * size;
+        chunk->len = size;
+
+        memset(&iov, 0, sizeof(iov));
+        iov.iov_base = chunk->ptr;
+        iov.iov_len = size;
+        iov.buf = handle;
+        iov.app_cookie = chunk;
+        mmsg.rc = 0;
+
+        res = zc_send_f(&mmsg, 1, 0);
+        if (res == 1 && mmsg.rc < 0)
+            res = mmsg.rc;
+        if (res != 1)
+        {
+            te_rpc_error_set(res < 0 ? TE_OS_RC(TE_TA_UNIX, -res) :
+                                       TE_RC(TE_TA_UNIX, TE_EFAIL),
+                             "onload_zc_send() failed, rc=%d", res);
+            rc = -1;
+            break;
+        }
+
+        if (zc_compl_bufs_add(&q, chunk) < 0)
+        {
+            rc = -1;
+            break;
+        }
+
+        stats->bytes += mmsg.rc;
+        stats->calls++;
+        sent++;
+    }
+
+    /* Buffers can be unregistered only after all of them are completed */
+    if (!TAILQ_EMPTY(&q.bufs))
+    {
+        if (wait_for_zc_completion(&q, FALSE, FALSE,
+                                   ZC_SEND_BENCH_FINISH_TIMEOUT) < 0)
+        {
+            rc = -1;
+        }
+        else if (!TAILQ_EMPTY(&q.bufs))
+        {
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EFAIL),
+                             "Not all the buffers were completed");
+            rc = -1;
+        }
+    }
+
+    sockts_zc_compl_queue_stats(&q, FALSE, &cstats);
+    stats->completions = cstats.completed;
+    stats->lag_min = cstats.lat_min;
+    stats->lag_p50 = cstats.lat_p50;
+    stats->lag_p99 = cstats.lat_p99;
+    stats->lag_max = cstats.lat_max;
+
+    zc_compl_bufs_fini(&q, FALSE);
+    if (unreg_unmap_zc_rbufs(unreg_f, fd, handle, mem, mem_size) < 0)
+        rc = -1;
+    free(chunks);
+
+    return rc;
+}
+#endif /* ONLOAD_SO_ONLOADZC_COMPLETE */
+
+/**
+ * Send data with onload_zc_send() copying it to buffers allocated
+ * with onload_zc_alloc_buffers(). Onload owns the buffers after
+ * sending, so there are no completions.
+ *
+ * @param fd          Socket FD.
+ * @param size        Bytes per send call.
+ * @param deadline    When to stop sending (mono_time_ns()).
+ * @param stats       Where to account results.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_send_bench_alloc(int fd, size_t size, uint64_t deadline,
+                    tarpc_sockts_zc_send_bench_stats *stats)
+{
+    api_func_ptr    zc_send_f;
+    api_func        alloc_f;
+    api_func        release_f;
+    char           *buf;
+    ssize_t         res;
+    int             rc = 0;
+
+    TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "onload_zc_send", &zc_send_f);
+    TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "onload_zc_alloc_buffers", &alloc_f);
+    TRY_FIND_FUNC(TARPC_LIB_DEFAULT, "onload_zc_release_buffers",
+                  &release_f);
+
+    buf = TE_ALLOC(size);
+    if (buf == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate buffer");
+        return -1;
+    }
+    te_fill_buf(buf, size);
+
+    while (mono_time_ns() < deadline)
+    {
+        res = onload_zc_send_data(zc_send_f, alloc_f, release_f, fd,
+                                  buf, size, 0);
+        if (res < 0)
+        {
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                             "onload_zc_send() with allocated buffers "
+                             "failed");
+            rc = -1;
+            break;
+        }
+
+        stats->bytes += res;
+        stats->calls++;
+    }
+
+    free(buf);
+    return rc;
+}
+
+#ifdef ZC_SEND_BENCH_MSG_ZEROCOPY
+/** State of sending with MSG_ZEROCOPY. */
+typedef struct zc_send_bench_mzc_state {
+    api_func        recvmsg_f;  /**< Resolved recvmsg() */
+    api_func_ptr    poll_f;     /**< Resolved poll() */
+    int             fd;         /**< Socket FD */
+    unsigned int    window;     /**< Number of chunks */
+    uint64_t        sent;       /**< Number of send calls */
+    uint64_t        done;       /**< Number of completed send calls */
+    uint64_t       *sent_ns;    /**< Send time of each chunk */
+    uint64_t       *lags;       /**< Ring of the last completion lags */
+
+    tarpc_sockts_zc_send_bench_stats *stats; /**< Results */
+} zc_send_bench_mzc_state;
+
+/**
+ * Wait for MSG_ZEROCOPY completions and retrieve all of them from
+ * the socket error queue. Completions of a TCP socket arrive in order
+ * of sending, so a notification for a range of send calls completes
+ * the oldest chunks in flight.
+ *
+ * @param st          Sending state.
+ * @param timeout     poll() timeout, ms.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_send_bench_mzc_reap(zc_send_bench_mzc_state *st, int timeout)
+{
+    struct pollfd               pfd;
+    struct msghdr               msg;
+    struct cmsghdr             *cmsg;
+    struct sock_extended_err    serr;
+    union {
+        struct cmsghdr  align;
+        uint8_t         buf[CMSG_SPACE(sizeof(serr) +
+                                       sizeof(struct sockaddr_in6))];
+    }                           control;
+    uint64_t                    now;
+    uint64_t                    lag;
+    uint32_t                    num;
+    int                         rc;
+
+    pfd.fd = st->fd;
+    pfd.events = pfd.revents = 0;
+    rc = st->poll_f(&pfd, 1, timeout);
+    if (rc < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+
+        te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                         "poll() failed when waiting for completions");
+        return -1;
+    }
+    if (rc == 0)
+        return 0;
+
+    while (TRUE)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        rc = st->recvmsg_f(st->fd, &msg, MSG_ERRQUEUE);
+        if (rc < 0)
+        {
+            if (errno == EAGAIN)
+                return 0;
+            if (errno == EINTR)
+                continue;
+
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                             "recvmsg(MSG_ERRQUEUE) failed");
+            return -1;
+        }
+
+        now = mono_time_ns();
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (!(cmsg->cmsg_level == SOL_IP &&
+                  cmsg->cmsg_type == IP_RECVERR) &&
+                !(cmsg->cmsg_level == SOL_IPV6 &&
+                  cmsg->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, serr.ee_errno),
+                                 "Unexpected error queue message, "
+                                 "origin %u", serr.ee_origin);
+                return -1;
+            }
+
+            num = serr.ee_data - serr.ee_info + 1;
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                st->stats->copied += num;
+            st->stats->completions += num;
+
+            for ( ; num > 0 && st->done < st->sent; num--, st->done++)
+            {
+                lag = now - st->sent_ns[st->done % st->window];
+                st->lags[st->done % ZC_SEND_BENCH_LAG_NUM] = lag;
+                if (st->done == 0 || lag < st->stats->lag_min)
+                    st->stats->lag_min = lag;
+                st->stats->lag_max = MAX(st->stats->lag_max, lag);
+            }
+        }
+    }
+}
+
+/**
+ * Send data with MSG_ZEROCOPY from a buffer split in @p window chunks.
+ * A chunk is reused after completion notification arrives for it.
+ *
+ * @param lib_flags   How to resolve functions.
+ * @param fd          Socket FD.
+ * @param size        Bytes per send call (chunk size).
+ * @param window      Number of chunks.
+ * @param deadline    When to stop sending (mono_time_ns()).
+ * @param stats       Where to account results.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_send_bench_mzc(tarpc_lib_flags lib_flags, int fd, size_t size,
+                  unsigned int window, uint64_t deadline,
+                  tarpc_sockts_zc_send_bench_stats *stats)
+{
+    zc_send_bench_mzc_state st;
+    api_func                send_f;
+    api_func                setsockopt_f;
+    uint8_t                *mem = NULL;
+    uint64_t                finish;
+    unsigned int            n;
+    ssize_t                 res;
+    int                     one = 1;
+    int                     rc = 0;
+
+    memset(&st, 0, sizeof(st));
+    st.fd = fd;
+    st.window = window;
+    st.stats = stats;
+
+    TRY_FIND_FUNC(lib_flags, "send", &send_f);
+    TRY_FIND_FUNC(lib_flags, "setsockopt", &setsockopt_f);
+    TRY_FIND_FUNC(lib_flags, "recvmsg", &st.recvmsg_f);
+    TRY_FIND_FUNC(lib_flags, "poll", &st.poll_f);
+
+    if (setsockopt_f(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+    {
+        te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                         "setsockopt(SO_ZEROCOPY) failed");
+        return -1;
+    }
+
+    mem = TE_ALLOC(size * window);
+    st.sent_ns = TE_ALLOC(window * sizeof(*st.sent_ns));
+    st.lags = TE_ALLOC(ZC_SEND_BENCH_LAG_NUM * sizeof(*st.lags));
+    if (mem == NULL || st.sent_ns == NULL || st.lags == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate send buffers");
+        rc = -1;
+        goto cleanup;
+    }
+    te_fill_buf(mem, size * window);
+
+    while (mono_time_ns() < deadline)
+    {
+        if (st.sent - st.done == window)
+        {
+            stats->window_waits++;
+            if (zc_send_bench_mzc_reap(&st,
+                                       ZC_SEND_BENCH_POLL_TIMEOUT) < 0)
+            {
+                rc = -1;
+                break;
+            }
+            continue;
+        }
+
+        st.sent_ns[st.sent % window] = mono_time_ns();
+        res = send_f(fd, mem + (st.sent % window) * size, size,
+                     MSG_ZEROCOPY);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == ENOBUFS)
+            {
+                /* Out of socket option memory to track notifications */
+                stats->window_waits++;
+                if (zc_send_bench_mzc_reap(&st,
+                                           ZC_SEND_BENCH_POLL_TIMEOUT) < 0)
+                {
+                    rc = -1;
+                    break;
+                }
+                continue;
+            }
+
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno),
+                             "send(MSG_ZEROCOPY) failed");
+            rc = -1;
+            break;
+        }
+
+        stats->bytes += res;
+        stats->calls++;
+        st.sent++;
+    }
+
+    /* Do not leave notifications in the error queue */
+    finish = mono_time_ns() + ZC_SEND_BENCH_FINISH_TIMEOUT * 1000000ULL;
+    while (rc == 0 && st.done < st.sent && mono_time_ns() < finish)
+    {
+        if (zc_send_bench_mzc_reap(&st, ZC_SEND_BENCH_POLL_TIMEOUT) < 0)
+            rc = -1;
+    }
+    if (rc == 0 && st.done < st.sent)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EFAIL),
+                         "%llu send calls were not completed",
+                         (unsigned long long)(st.sent - st.done));
+        rc = -1;
+    }
+
+    n = MIN(st.done, ZC_SEND_BENCH_LAG_NUM);
+    qsort(st.lags, n, sizeof(*st.lags), u64_cmp);
+    stats->lag_p50 = u64_sorted_pct(st.lags, n, 500);
+    stats->lag_p99 = u64_sorted_pct(st.lags, n, 990);
+
+cleanup:
+
+    one = 0;
+    setsockopt_f(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+
+    free(mem);
+    free(st.sent_ns);
+    free(st.lags);
+
+    return rc;
+}
+#endif /* ZC_SEND_BENCH_MSG_ZEROCOPY */
+
+/**
+ * Send data with ordinary send() for comparison with zero-copy modes.
+ *
+ * @param lib_flags   How to resolve functions.
+ * @param fd          Socket FD.
+ * @param size        Bytes per send call.
+ * @param deadline    When to stop sending (mono_time_ns()).
+ * @param stats       Where to account results.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+zc_send_bench_copy(tarpc_lib_flags lib_flags, int fd, size_t size,
+                   uint64_t deadline,
+                   tarpc_sockts_zc_send_bench_stats *stats)
+{
+    api_func    send_f;
+    char       *buf;
+    ssize_t     res;
+    int         rc = 0;
+
+    TRY_FIND_FUNC(lib_flags, "send", &send_f);
+
+    buf = TE_ALLOC(size);
+    if (buf == NULL)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_ENOMEM),
+                         "Failed to allocate buffer");
+        return -1;
+    }
+    te_fill_buf(buf, size);
+
+    while (mono_time_ns() < deadline)
+    {
+        res = send_f(fd, buf, size, 0);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            te_rpc_error_set(TE_OS_RC(TE_TA_UNIX, errno), "send() failed");
+            rc = -1;
+            break;
+        }
+
+        stats->bytes += res;
+        stats->calls++;
+    }
+
+    free(buf);
+    return rc;
+}
+
+/**
+ * Stream data from a connected socket for a given time with zero-copy
+ * or ordinary send and measure throughput, CPU time of the sending
+ * thread and lag between sending a buffer and its completion.
+ * Onload zero-copy modes fall back to MSG_ZEROCOPY if the socket is not
+ * accelerated.
+ *
+ * @param in      RPC input.
+ * @param out     RPC output.
+ *
+ * @return @c 0 on success, @c -1 on failure.
+ */
+static int
+sockts_zc_send_bench(tarpc_sockts_zc_send_bench_in *in,
+                     tarpc_sockts_zc_send_bench_out *out)
+{
+    tarpc_sockts_zc_send_bench_stats   *stats = &out->stats;
+    tarpc_sockts_zc_send_mode           mode = in->mode;
+    struct onload_stat                  ostat;
+    uint64_t    start;
+    uint64_t    deadline;
+    uint64_t    user_us;
+    uint64_t    sys_us;
+    uint64_t    user_end_us;
+    uint64_t    sys_end_us;
+    int         rc = -1;
+
+    if (in->size == 0 || in->window == 0 ||
+        in->window > ZC_SEND_BENCH_MAX_WINDOW)
+    {
+        te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                         "Invalid size %u or window %u",
+                         in->size, in->window);
+        return -1;
+    }
+
+    if (mode == TARPC_ZC_SEND_REG_BUFS || mode == TARPC_ZC_SEND_ALLOC_BUFS)
+    {
+        memset(&ostat, 0, sizeof(ostat));
+        if (onload_fd_stat(in->fd, &ostat) <= 0)
+        {
+            RING("%s(): socket %d is not accelerated, MSG_ZEROCOPY is used",
+                 __FUNCTION__, in->fd);
+            mode = TARPC_ZC_SEND_MSG_ZEROCOPY;
+        }
+        free(ostat.stack_name);
+    }
+    stats->mode = mode;
+
+    thread_cpu_time(&user_us, &sys_us);
+    start = mono_time_ns();
+    deadline = start + in->time2run * 1000000ULL;
+
+    switch (mode)
+    {
+        case TARPC_ZC_SEND_REG_BUFS:
+#ifdef ONLOAD_SO_ONLOADZC_COMPLETE
+            rc = zc_send_bench_reg(in->fd, in->size, in->window,
+                                   deadline, stats);
+#else
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EOPNOTSUPP),
+                             "onload_zc_send() with registered buffers "
+                             "is not supported");
+#endif
+            break;
+
+        case TARPC_ZC_SEND_ALLOC_BUFS:
+            rc = zc_send_bench_alloc(in->fd, in->size, deadline, stats);
+            break;
+
+        case TARPC_ZC_SEND_MSG_ZEROCOPY:
+#ifdef ZC_SEND_BENCH_MSG_ZEROCOPY
+            rc = zc_send_bench_mzc(in->common.lib_flags, in->fd, in->size,
+                                   in->window, deadline, stats);
+#else
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EOPNOTSUPP),
+                             "MSG_ZEROCOPY is not supported");
+#endif
+            break;
+
+        case TARPC_ZC_SEND_COPY:
+            rc = zc_send_bench_copy(in->common.lib_flags, in->fd, in->size,
+                                    deadline, stats);
+            break;
+
+        default:
+            te_rpc_error_set(TE_RC(TE_TA_UNIX, TE_EINVAL),
+                             "Unknown send mode %d", mode);
+    }
+
+    stats->duration = (mono_time_ns() - start) / 1000;
+    thread_cpu_time(&user_end_us, &sys_end_us);
+    stats->cpu_user = user_end_us - user_us;
+    stats->cpu_sys = sys_end_us - sys_us;
+    if (stats->duration > 0)
+        stats->mbps = stats->bytes * 8 / stats->duration;
+
+    return rc;
+}
+
+TARPC_FUNC_STATIC(sockts_zc_send_bench, {},
+{
+    MAKE_CALL(out->retval = func(in, out));
+})
@@ -43,6 +43,16 @@ struct tarpc_many_send_in {
     tarpc_int       sock;
     tarpc_int       flags;
     tarpc_size_t    vector<>;
+    string          func_name<>;    /**< send (if empty), sendmsg or
+                                         sendmmsg */
+    tarpc_uint      batch;          /**< Messages per sendmsg()/sendmmsg()
+                                         call */
+    tarpc_size_t    pool_size;      /**< Payload pool size, 0 for the
+                                         longest message length; it
+                                         must not be less than it */
+    string          gen_func<>;     /**< Pattern generator function,
+                                         random data if empty */
+    tarpc_pat_gen_arg gen_arg;      /**< Pattern generator argument */
 };
 
 struct tarpc_many_send_out {
@@ -51,6 +61,8 @@ struct tarpc_many_send_out {
     tarpc_int   retval;     /**< 0 (success) or -1 (failure) */
 
     uint64_t    bytes;      /**< Number of sent bytes */
+    uint64_t    calls;      /**< Number of send calls */
+    uint64_t    duration;   /**< Time spent sending, in nanoseconds */
 };
 
 struct tarpc_many_sendto_in {
@@ -431,11 +443,14 @@ struct tarpc_many_recv_in {
     tarpc_size_t  length;        /**< Packet length */
     uint8_t       last_packet<>; /**< Last packet template */
     tarpc_bool    count_fails;   /**< Dont stop on fail */
+    uint64_t      bucket_us;     /**< Throughput sampling bucket length
+                                      in microseconds, @c 0 to disable */
 };
 
 struct tarpc_many_recv_out {
     struct tarpc_out_arg common;
     tarpc_int fails_num; /**< Fails number */
+    uint64_t  samples<>; /**< Bytes received in each bucket */
     tarpc_int retval;    /**< Received packets number or @c -1 */
 };
 
@@ -446,6 +461,8 @@ struct tarpc_recv_timing_in {
     tarpc_int     fd_aux;         /**< Auxiliary socket descriptor */
     tarpc_size_t  length;         /**< How much bytes should be
                                        received */
+    uint64_t      bucket_us;      /**< Throughput sampling bucket length
+                                       in microseconds, @c 0 to disable */
 };
 
 struct tarpc_recv_timing_out {
@@ -453,6 +470,7 @@ struct tarpc_recv_timing_out {
 
     uint64_t       duration;       /**< Time in microseconds it took to
                                         receive all the data */
+    uint64_t       samples<>;      /**< Bytes received in each bucket */
     tarpc_ssize_t  retval;         /**< Number of bytes received or
                                         @c -1 */
 };
@@ -779,6 +797,40 @@ struct tarpc_sockts_proc_zc_compl_queue_out {
     tarpc_int               retval;
 };
 
+/** Statistics of a queue of sent ZC buffers. */
+struct tarpc_sockts_zc_compl_stats {
+    uint32_t in_flight;     /**< Buffers waiting for completion */
+    uint32_t max_in_flight; /**< Maximum number of buffers waiting
+                                 for completion */
+    uint64_t completed;     /**< Buffers for which completion
+                                 messages arrived */
+    uint64_t dropped;       /**< Buffers removed without completion
+                                 message (socket closed or invalid) */
+    uint32_t lat_num;       /**< Number of the last completions used
+                                 for latency percentiles */
+    uint64_t lat_min;       /**< Minimum completion latency, ns */
+    uint64_t lat_p50;       /**< Median completion latency, ns */
+    uint64_t lat_p90;       /**< 90th percentile of completion
+                                 latency, ns */
+    uint64_t lat_p99;       /**< 99th percentile of completion
+                                 latency, ns */
+    uint64_t lat_p999;      /**< 99.9th percentile of completion
+                                 latency, ns */
+    uint64_t lat_max;       /**< Maximum completion latency, ns */
+};
+
+struct tarpc_sockts_zc_compl_queue_stats_in {
+    struct tarpc_in_arg     common;
+    tarpc_ptr               qhead;
+    tarpc_bool              reset;
+};
+
+struct tarpc_sockts_zc_compl_queue_stats_out {
+    struct tarpc_out_arg                common;
+    struct tarpc_sockts_zc_compl_stats  stats;
+    tarpc_int                           retval;
+};
+
 struct tarpc_simple_zc_send_in {
     struct tarpc_in_arg common;
 
@@ -1332,9 +1384,42 @@ struct tarpc_sockts_iomux_timeout_loop_in {
     struct tarpc_pollfd fds<>;
     tarpc_int           timeout;
     tarpc_uint          n_calls;
+    tarpc_uint          hist_size;  /**< Number of buckets in histograms,
+                                         @c 0 to disable measurement */
+};
+
+/** Wait time of iomux calls measured by sockts_iomux_timeout_loop(). */
+struct tarpc_sockts_iomux_timeout_stats {
+    uint64_t calls;     /**< Number of measured calls */
+    uint64_t wait_min;  /**< Minimum wait time, ns */
+    uint64_t wait_p50;  /**< Median wait time, ns */
+    uint64_t wait_p99;  /**< 99th percentile of wait time, ns */
+    uint64_t wait_p999; /**< 99.9th percentile of wait time, ns */
+    uint64_t wait_max;  /**< Maximum wait time, ns */
 };
 
-typedef struct tarpc_int_retval_out tarpc_sockts_iomux_timeout_loop_out;
+struct tarpc_sockts_iomux_timeout_loop_out {
+    struct tarpc_out_arg common;
+
+    struct tarpc_sockts_iomux_timeout_stats stats;
+    uint64_t    late<>;     /**< Histogram of overshoot over the timeout */
+    uint64_t    early<>;    /**< Histogram of undershoot of the timeout */
+    tarpc_int   retval;
+};
+
+/** Statistics of receiving with sockts_peek_stream_receiver(). */
+struct tarpc_sockts_peek_stream_stats {
+    uint64_t peek_calls;    /**< recv() calls with MSG_PEEK */
+    uint64_t peek_bytes;    /**< Bytes re-read because of MSG_PEEK */
+    uint64_t peek_ns;       /**< Time spent in recv(MSG_PEEK), ns */
+    uint64_t recv_calls;    /**< recv() calls without MSG_PEEK */
+    uint64_t recv_bytes;    /**< Consumed bytes */
+    uint64_t recv_ns;       /**< Time spent in recv() without MSG_PEEK,
+                                 ns */
+    uint64_t duration;      /**< Time from the first to the last recv()
+                                 call, us */
+    uint64_t mbps;          /**< Throughput of consumed data, Mbit/s */
+};
 
 struct tarpc_sockts_peek_stream_receiver_in {
     struct tarpc_in_arg common;
@@ -1342,6 +1427,9 @@ struct tarpc_sockts_peek_stream_receiver_in {
     tarpc_int fd;
     tarpc_int time2run;
     tarpc_int time2wait;
+    tarpc_int peek_count;
+    tarpc_bool fixed_ratio;
+    tarpc_uint batch;
     tarpc_pat_gen_arg gen_arg;
 };
 
@@ -1350,6 +1438,201 @@ struct tarpc_sockts_peek_stream_receiver_out {
 
     tarpc_pat_gen_arg gen_arg;
     uint64_t received;
+    struct tarpc_sockts_peek_stream_stats stats;
+    tarpc_int retval;
+};
+
+/** Statistics of a socket served by sockts_traffic_engine(). */
+struct tarpc_sockts_traffic_engine_stats {
+    uint64_t bytes;     /**< Transferred bytes */
+    uint64_t calls;     /**< Send/receive calls */
+    uint64_t eagain;    /**< Calls failed with EAGAIN */
+};
+
+struct tarpc_sockts_traffic_engine_in {
+    struct tarpc_in_arg common;
+
+    tarpc_int    fds<>;           /**< Sockets */
+    tarpc_bool   snd;             /**< If TRUE, send traffic */
+    string       func_name<>;     /**< Send/receive function */
+    tarpc_size_t size;            /**< Bytes per message */
+    tarpc_uint   batch;           /**< Messages per sendmmsg()/recvmmsg() */
+    tarpc_uint   threads;         /**< Number of threads */
+    tarpc_uint   time2run;        /**< How long to run, in milliseconds */
+    tarpc_uint   sample_interval; /**< Throughput sampling interval,
+                                       in milliseconds, 0 to disable */
+    tarpc_ptr    stop;            /**< Location for stop flag or
+                                       RPC_NULL */
+    tarpc_int    cpus<>;          /**< CPUs to pin threads to, thread i
+                                       is pinned to cpus[i % number];
+                                       empty to not pin */
+};
+
+/** Utilisation of a CPU during sockts_traffic_engine() run. */
+struct tarpc_sockts_traffic_engine_cpu {
+    tarpc_int cpu;      /**< CPU number */
+    uint64_t  busy;     /**< Busy time, in clock ticks */
+    uint64_t  total;    /**< Total time, in clock ticks */
+};
+
+struct tarpc_sockts_traffic_engine_out {
+    struct tarpc_out_arg common;
+
+    struct tarpc_sockts_traffic_engine_stats stats<>; /**< Per socket */
+    uint64_t   samples<>;   /**< Bytes transferred in each interval */
+    uint64_t   duration;    /**< Actual run time, in microseconds */
+    struct tarpc_sockts_traffic_engine_cpu cpu<>; /**< Per CPU from
+                                                       cpus */
+    tarpc_int  retval;
+};
+
+/* sockts_get_cpus() */
+typedef struct tarpc_void_in tarpc_sockts_get_cpus_in;
+
+struct tarpc_sockts_get_cpus_out {
+    struct tarpc_out_arg common;
+
+    tarpc_int   cpus<>;     /**< CPUs the RPC server may run on */
+    tarpc_int   retval;
+};
+
+/** Results of sockts_conn_rate(). */
+struct tarpc_sockts_conn_rate_stats {
+    uint64_t connected; /**< Established connections */
+    uint64_t failed;    /**< Failed connection attempts or
+                             request/response exchanges */
+    uint64_t completed; /**< Request/response exchanges completed by
+                             connecting threads */
+    uint64_t accepted;  /**< Accepted connections */
+    uint64_t served;    /**< Requests answered by accepting threads */
+    uint64_t duration;  /**< Actual run time, in microseconds */
+    uint64_t lat_min;   /**< Minimum connect latency, ns */
+    uint64_t lat_p50;   /**< Median connect latency, ns */
+    uint64_t lat_p90;   /**< 90th percentile of connect latency, ns */
+    uint64_t lat_p99;   /**< 99th percentile of connect latency, ns */
+    uint64_t lat_p999;  /**< 99.9th percentile of connect latency, ns */
+    uint64_t lat_max;   /**< Maximum connect latency, ns */
+    uint64_t acc_lat_min;   /**< Minimum accept4() time, ns */
+    uint64_t acc_lat_p50;   /**< Median accept4() time, ns */
+    uint64_t acc_lat_p90;   /**< 90th percentile of accept4() time, ns */
+    uint64_t acc_lat_p99;   /**< 99th percentile of accept4() time, ns */
+    uint64_t acc_lat_p999;  /**< 99.9th percentile of accept4() time,
+                                 ns */
+    uint64_t acc_lat_max;   /**< Maximum accept4() time, ns */
+};
+
+struct tarpc_sockts_conn_rate_in {
+    struct tarpc_in_arg common;
+
+    struct tarpc_sa addr<>;     /**< Address to connect to, do not
+                                     connect if empty */
+    tarpc_int       listeners<>; /**< Listening sockets to accept
+                                      connections on, a thread per
+                                      socket */
+    tarpc_uint      threads;    /**< Number of connecting threads */
+    tarpc_uint      window;     /**< Connections in flight per thread */
+    tarpc_uint      num;        /**< Connections per thread,
+                                     @c 0 for unlimited */
+    tarpc_uint      time2run;   /**< How long to run, in milliseconds */
+    tarpc_bool      keep;       /**< Keep connections open until the
+                                     end instead of closing them */
+    tarpc_uint      req_size;   /**< Size of request and response
+                                     exchanged over every connection,
+                                     @c 0 to only connect */
+};
+
+struct tarpc_sockts_conn_rate_out {
+    struct tarpc_out_arg common;
+
+    struct tarpc_sockts_conn_rate_stats stats;
+    tarpc_int retval;
+};
+
+/** Results of sockts_epoll_bench(). */
+struct tarpc_sockts_epoll_bench_stats {
+    uint64_t add_ns;      /**< Average time of epoll_ctl(ADD), ns */
+    uint64_t mod_ns;      /**< Average time of epoll_ctl(MOD), ns */
+    uint64_t del_ns;      /**< Average time of epoll_ctl(DEL), ns */
+    uint64_t wait_min;    /**< Minimum epoll_wait() latency, ns */
+    uint64_t wait_p50;    /**< Median epoll_wait() latency, ns */
+    uint64_t wait_p99;    /**< 99th percentile of epoll_wait() latency,
+                               ns */
+    uint64_t wait_max;    /**< Maximum epoll_wait() latency, ns */
+    uint64_t events;      /**< Total number of returned events */
+    uint64_t fair_min;    /**< Least number of reports of a ready socket */
+    uint64_t fair_max;    /**< Most number of reports of a ready socket */
+    uint32_t fairness;    /**< Jain's fairness index of ready sockets
+                               reports multiplied by 1000 */
+    uint64_t unexpected;  /**< Events reported for not ready sockets */
+};
+
+struct tarpc_sockts_epoll_bench_in {
+    struct tarpc_in_arg common;
+
+    tarpc_ptr  socks_arr;   /**< Pointer to the sockets array */
+    tarpc_uint socks_num;   /**< Sockets number */
+    tarpc_uint ready_num;   /**< Number of first sockets expected to be
+                                 ready */
+    uint32_t   events;      /**< Events of the ready sockets */
+    uint32_t   idle_events; /**< Events of the rest sockets */
+    tarpc_uint maxevents;   /**< maxevents of epoll_wait() */
+    tarpc_uint wait_calls;  /**< Number of epoll_wait() calls */
+};
+
+struct tarpc_sockts_epoll_bench_out {
+    struct tarpc_out_arg common;
+
+    struct tarpc_sockts_epoll_bench_stats stats;
+    tarpc_int retval;
+};
+
+/** How to send data in sockts_zc_send_bench(). */
+enum tarpc_sockts_zc_send_mode {
+    TARPC_ZC_SEND_REG_BUFS = 0,     /**< onload_zc_send() with registered
+                                         buffers */
+    TARPC_ZC_SEND_ALLOC_BUFS = 1,   /**< onload_zc_send() with buffers
+                                         from onload_zc_alloc_buffers() */
+    TARPC_ZC_SEND_MSG_ZEROCOPY = 2, /**< send() with MSG_ZEROCOPY */
+    TARPC_ZC_SEND_COPY = 3          /**< Ordinary send() */
+};
+
+/** Results of sockts_zc_send_bench(). */
+struct tarpc_sockts_zc_send_bench_stats {
+    tarpc_sockts_zc_send_mode mode; /**< Actually used mode */
+    uint64_t bytes;         /**< Sent bytes */
+    uint64_t calls;         /**< Send calls */
+    uint64_t duration;      /**< Actual run time, in microseconds */
+    uint64_t mbps;          /**< Throughput, Mbit/s */
+    uint64_t cpu_user;      /**< User CPU time of the sending thread,
+                                 in microseconds */
+    uint64_t cpu_sys;       /**< System CPU time of the sending thread,
+                                 in microseconds */
+    uint64_t window_waits;  /**< How many times sending waited for
+                                 completions */
+    uint64_t completions;   /**< Completed buffers (send calls) */
+    uint64_t copied;        /**< Completions reporting that data was
+                                 copied (MSG_ZEROCOPY only) */
+    uint64_t lag_min;       /**< Minimum completion lag, ns */
+    uint64_t lag_p50;       /**< Median completion lag, ns */
+    uint64_t lag_p99;       /**< 99th percentile of completion lag, ns */
+    uint64_t lag_max;       /**< Maximum completion lag, ns */
+};
+
+struct tarpc_sockts_zc_send_bench_in {
+    struct tarpc_in_arg common;
+
+    tarpc_int                   fd;         /**< Connected socket */
+    tarpc_sockts_zc_send_mode   mode;       /**< How to send */
+    tarpc_uint                  size;       /**< Bytes per send call */
+    tarpc_uint                  window;     /**< Buffers in flight */
+    tarpc_uint                  time2run;   /**< How long to send,
+                                                 in milliseconds */
+};
+
+struct tarpc_sockts_zc_send_bench_out {
+    struct tarpc_out_arg common;
+
+    struct tarpc_sockts_zc_send_bench_stats stats;
     tarpc_int retval;
 };
 
@@ -1404,6 +1687,7 @@ program sapits
         RPC_DEF(sockts_alloc_zc_compl_queue)
         RPC_DEF(sockts_free_zc_compl_queue)
         RPC_DEF(sockts_proc_zc_compl_queue)
+        RPC_DEF(sockts_zc_compl_queue_stats)
         RPC_DEF(simple_zc_send)
         RPC_DEF(simple_zc_recv)
         RPC_DEF(simple_hlrx_recv_zc)
@@ -1448,5 +1732,10 @@ program sapits
         RPC_DEF(connect_send_dur_time)
         RPC_DEF(sockts_iomux_timeout_loop)
         RPC_DEF(sockts_peek_stream_receiver)
+        RPC_DEF(sockts_traffic_engine)
+        RPC_DEF(sockts_get_cpus)
+        RPC_DEF(sockts_conn_rate)
+        RPC_DEF(sockts_epoll_bench)
+        RPC_DEF(sockts_zc_send_bench)
     } = 1;
 } = 2;